@@ -0,0 +1,878 @@
+/*
+ * Copyright 2011-2018 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Benchmark
+ *
+ * Renders a set of procedurally generated scenes, each stressing one part of
+ * the renderer, and reports how long the scene update, BVH build and render
+ * took, how many rays and shader evaluations per second the kernels did and
+ * how much device memory was used for which data. Results are written as
+ * JSON, so they can be compared between builds. Scene files given on the
+ * command line are benchmarked as well. */
+
+#include <stdio.h>
+
+#include "render/background.h"
+#include "render/buffers.h"
+#include "render/camera.h"
+#include "render/graph.h"
+#include "render/light.h"
+#include "render/mesh.h"
+#include "render/nodes.h"
+#include "render/object.h"
+#include "render/scene.h"
+#include "render/session.h"
+#include "render/shader.h"
+#include "device/device.h"
+
+#include "util/util_args.h"
+#include "util/util_foreach.h"
+#include "util/util_function.h"
+#include "util/util_hash.h"
+#include "util/util_logging.h"
+#include "util/util_map.h"
+#include "util/util_path.h"
+#include "util/util_progress.h"
+#include "util/util_stats.h"
+#include "util/util_string.h"
+#include "util/util_thread.h"
+#include "util/util_time.h"
+#include "util/util_transform.h"
+#include "util/util_version.h"
+
+#include "app/cycles_xml.h"
+
+CCL_NAMESPACE_BEGIN
+
+struct Options {
+	int width, height;
+	SessionParams session_params;
+	SceneParams scene_params;
+	vector<string> scenes;
+	vector<string> filepaths;
+	string output_path;
+	bool quiet;
+} options;
+
+/* Phase Timer
+ *
+ * Time between status changes of the session progress, summed up per phase
+ * of the render. */
+
+class PhaseTimer {
+public:
+	PhaseTimer() : progress(NULL), last_time(0.0) {}
+
+	void begin(Progress *progress_)
+	{
+		progress = progress_;
+		last_phase = "";
+		last_time = time_dt();
+	}
+
+	void update()
+	{
+		string status, substatus;
+		progress->get_status(status, substatus);
+
+		thread_scoped_lock lock(mutex);
+		switch_phase(phase_from_status(status, substatus));
+	}
+
+	void end()
+	{
+		thread_scoped_lock lock(mutex);
+		switch_phase("");
+	}
+
+	map<string, double> phases;
+
+protected:
+	static string phase_from_status(const string& status, const string& substatus)
+	{
+		if(string_startswith(status, "Updating")) {
+			if(status == "Updating Scene BVH" || substatus.find("BVH") != string::npos) {
+				return "bvh_build";
+			}
+			return "scene_update";
+		}
+		else if(string_startswith(status, "Loading render kernels")) {
+			return "kernel_load";
+		}
+		else if(string_startswith(status, "Rendered") ||
+		        string_startswith(status, "Path Tracing"))
+		{
+			return "render";
+		}
+		return "";
+	}
+
+	void switch_phase(const string& phase)
+	{
+		double time = time_dt();
+		if(last_phase != "") {
+			phases[last_phase] += time - last_time;
+		}
+		last_phase = phase;
+		last_time = time;
+	}
+
+	Progress *progress;
+	thread_mutex mutex;
+	string last_phase;
+	double last_time;
+};
+
+struct BenchmarkResult {
+	string name;
+	double total_time;
+	map<string, double> phases;
+	KernelStats kernel;
+	size_t mem_used;
+	size_t mem_peak;
+	map<string, size_t> memory;
+};
+
+/* Scene Construction */
+
+static Shader *benchmark_add_shader(Scene *scene, const char *name, ShaderGraph *graph)
+{
+	Shader *shader = new Shader();
+	shader->name = name;
+	shader->set_graph(graph);
+	scene->shaders.push_back(shader);
+	return shader;
+}
+
+static Shader *benchmark_shader_diffuse(Scene *scene, float3 color)
+{
+	ShaderGraph *graph = new ShaderGraph();
+
+	DiffuseBsdfNode *diffuse = new DiffuseBsdfNode();
+	diffuse->color = color;
+	graph->add(diffuse);
+
+	graph->connect(diffuse->output("BSDF"), graph->output()->input("Surface"));
+
+	return benchmark_add_shader(scene, "diffuse", graph);
+}
+
+static Shader *benchmark_shader_emission(Scene *scene, float strength)
+{
+	ShaderGraph *graph = new ShaderGraph();
+
+	EmissionNode *emission = new EmissionNode();
+	emission->color = make_float3(1.0f, 1.0f, 1.0f);
+	emission->strength = strength;
+	graph->add(emission);
+
+	graph->connect(emission->output("Emission"), graph->output()->input("Surface"));
+
+	return benchmark_add_shader(scene, "emission", graph);
+}
+
+static void benchmark_background(Scene *scene, float strength)
+{
+	ShaderGraph *graph = new ShaderGraph();
+
+	BackgroundNode *background = new BackgroundNode();
+	background->color = make_float3(0.8f, 0.85f, 1.0f);
+	background->strength = strength;
+	graph->add(background);
+
+	graph->connect(background->output("Background"), graph->output()->input("Surface"));
+
+	scene->default_background = benchmark_add_shader(scene, "background", graph);
+	scene->background->tag_update(scene);
+}
+
+/* Camera at position, looking at the target with Z up. */
+static void benchmark_camera(Scene *scene, float3 position, float3 target)
+{
+	float3 dir = normalize(target - position);
+	float3 right = normalize(cross(dir, make_float3(0.0f, 0.0f, 1.0f)));
+	float3 up = cross(right, dir);
+
+	Camera *cam = scene->camera;
+	cam->matrix = make_transform(right.x, up.x, dir.x, position.x,
+	                             right.y, up.y, dir.y, position.y,
+	                             right.z, up.z, dir.z, position.z);
+	cam->width = options.width;
+	cam->height = options.height;
+	cam->compute_auto_viewplane();
+	cam->need_update = true;
+	cam->need_device_update = true;
+}
+
+static Mesh *benchmark_add_mesh(Scene *scene, Shader *shader)
+{
+	Mesh *mesh = new Mesh();
+	mesh->used_shaders.push_back(shader);
+	scene->meshes.push_back(mesh);
+	return mesh;
+}
+
+static Object *benchmark_add_object(Scene *scene, Mesh *mesh, const Transform& tfm)
+{
+	Object *object = new Object();
+	object->mesh = mesh;
+	object->tfm = tfm;
+	scene->objects.push_back(object);
+	return object;
+}
+
+static void benchmark_mesh_grid(Mesh *mesh, int resolution, float size)
+{
+	mesh->reserve_mesh((resolution + 1)*(resolution + 1), resolution*resolution*2);
+
+	for(int y = 0; y <= resolution; y++) {
+		for(int x = 0; x <= resolution; x++) {
+			mesh->add_vertex(make_float3((x / (float)resolution - 0.5f) * size,
+			                             (y / (float)resolution - 0.5f) * size,
+			                             0.0f));
+		}
+	}
+
+	for(int y = 0; y < resolution; y++) {
+		for(int x = 0; x < resolution; x++) {
+			int v = y*(resolution + 1) + x;
+			mesh->add_triangle(v, v + 1, v + resolution + 2, 0, false);
+			mesh->add_triangle(v, v + resolution + 2, v + resolution + 1, 0, false);
+		}
+	}
+}
+
+static void benchmark_mesh_sphere(Mesh *mesh, int segments, int rings, float radius)
+{
+	mesh->reserve_mesh(segments*(rings + 1), segments*rings*2);
+
+	for(int r = 0; r <= rings; r++) {
+		float theta = M_PI_F * r / rings;
+		for(int s = 0; s < segments; s++) {
+			float phi = M_2PI_F * s / segments;
+			mesh->add_vertex(make_float3(sinf(theta) * cosf(phi),
+			                             sinf(theta) * sinf(phi),
+			                             cosf(theta)) * radius);
+		}
+	}
+
+	for(int r = 0; r < rings; r++) {
+		for(int s = 0; s < segments; s++) {
+			int v0 = r*segments + s;
+			int v1 = r*segments + (s + 1) % segments;
+			int v2 = v1 + segments;
+			int v3 = v0 + segments;
+			mesh->add_triangle(v0, v3, v2, 0, true);
+			mesh->add_triangle(v0, v2, v1, 0, true);
+		}
+	}
+}
+
+static void benchmark_mesh_box(Mesh *mesh, float3 size)
+{
+	static const int faces[6][4] = {{0, 1, 3, 2}, {4, 6, 7, 5}, {0, 4, 5, 1},
+	                                {2, 3, 7, 6}, {0, 2, 6, 4}, {1, 5, 7, 3}};
+
+	mesh->reserve_mesh(8, 12);
+
+	for(int i = 0; i < 8; i++) {
+		mesh->add_vertex(make_float3((i & 1)? 0.5f: -0.5f,
+		                             (i & 2)? 0.5f: -0.5f,
+		                             (i & 4)? 0.5f: -0.5f) * size);
+	}
+
+	for(int i = 0; i < 6; i++) {
+		mesh->add_triangle(faces[i][0], faces[i][1], faces[i][2], 0, false);
+		mesh->add_triangle(faces[i][0], faces[i][2], faces[i][3], 0, false);
+	}
+}
+
+static void benchmark_ground(Scene *scene, float size)
+{
+	Shader *shader = benchmark_shader_diffuse(scene, make_float3(0.5f, 0.5f, 0.5f));
+	benchmark_mesh_grid(benchmark_add_mesh(scene, shader), 1, size);
+	benchmark_add_object(scene, scene->meshes.back(), transform_identity());
+}
+
+/* Many instances of the same mesh, for the two level BVH. */
+static void scene_instances(Scene *scene)
+{
+	const int grid = 100;
+
+	benchmark_background(scene, 1.0f);
+	benchmark_ground(scene, 2.0f * grid);
+
+	Shader *shader = benchmark_shader_diffuse(scene, make_float3(0.8f, 0.3f, 0.2f));
+	Mesh *mesh = benchmark_add_mesh(scene, shader);
+	benchmark_mesh_sphere(mesh, 32, 16, 0.5f);
+
+	for(int y = 0; y < grid; y++) {
+		for(int x = 0; x < grid; x++) {
+			uint seed = y*grid + x;
+			float scale = 0.5f + hash_int_01(seed);
+			float3 co = make_float3((x - grid * 0.5f) * 2.0f + hash_int_01(seed + 0x1000000),
+			                        (y - grid * 0.5f) * 2.0f + hash_int_01(seed + 0x2000000),
+			                        scale * 0.5f);
+			benchmark_add_object(scene, mesh, transform_translate(co) *
+			                                  transform_scale(scale, scale, scale));
+		}
+	}
+
+	benchmark_camera(scene, make_float3(0.0f, -grid * 1.2f, grid * 0.5f), make_float3(0.0f, 0.0f, 0.0f));
+}
+
+/* Dense hair on a plane. */
+static void scene_hair(Scene *scene)
+{
+	const int num_curves = 200000;
+	const int num_keys = 5;
+
+	benchmark_background(scene, 1.0f);
+	benchmark_ground(scene, 4.0f);
+
+	Shader *shader = benchmark_shader_diffuse(scene, make_float3(0.6f, 0.4f, 0.2f));
+	Mesh *mesh = benchmark_add_mesh(scene, shader);
+	mesh->reserve_curves(num_curves, num_curves*num_keys);
+
+	for(int i = 0; i < num_curves; i++) {
+		float3 root = make_float3(hash_int_01(i*3 + 0) * 2.0f - 1.0f,
+		                          hash_int_01(i*3 + 1) * 2.0f - 1.0f,
+		                          0.0f);
+		float3 bend = make_float3(hash_int_01(i*3 + 2) - 0.5f, 0.1f, 0.0f) * 0.1f;
+
+		mesh->add_curve(mesh->curve_keys.size(), 0);
+		for(int k = 0; k < num_keys; k++) {
+			float t = k / (float)(num_keys - 1);
+			mesh->add_curve_key(root + make_float3(0.0f, 0.0f, t * 0.2f) + bend * t * t,
+			                    0.002f * (1.0f - t * 0.8f));
+		}
+	}
+	benchmark_add_object(scene, mesh, transform_identity());
+
+	benchmark_camera(scene, make_float3(0.0f, -1.5f, 0.6f), make_float3(0.0f, 0.0f, 0.1f));
+}
+
+/* Scattering volume inside a box, lit by a single light. */
+static void scene_volume(Scene *scene)
+{
+	benchmark_background(scene, 0.2f);
+	benchmark_ground(scene, 10.0f);
+
+	ShaderGraph *graph = new ShaderGraph();
+
+	ScatterVolumeNode *scatter = new ScatterVolumeNode();
+	scatter->color = make_float3(0.9f, 0.9f, 0.9f);
+	scatter->density = 2.0f;
+	scatter->anisotropy = 0.3f;
+	graph->add(scatter);
+
+	graph->connect(scatter->output("Volume"), graph->output()->input("Volume"));
+
+	Shader *shader = benchmark_add_shader(scene, "volume", graph);
+	benchmark_mesh_box(benchmark_add_mesh(scene, shader), make_float3(2.0f, 2.0f, 2.0f));
+	benchmark_add_object(scene, scene->meshes.back(), transform_translate(0.0f, 0.0f, 1.0f));
+
+	Light *light = new Light();
+	light->type = LIGHT_POINT;
+	light->co = make_float3(2.0f, -2.0f, 4.0f);
+	light->size = 0.2f;
+	light->shader = benchmark_shader_emission(scene, 500.0f);
+	scene->lights.push_back(light);
+
+	benchmark_camera(scene, make_float3(0.0f, -6.0f, 2.5f), make_float3(0.0f, 0.0f, 1.0f));
+}
+
+/* Many small lights over a field of spheres, for light sampling. */
+static void scene_lights(Scene *scene)
+{
+	const int grid = 32;
+
+	benchmark_background(scene, 0.0f);
+	benchmark_ground(scene, 2.0f * grid);
+
+	Shader *shader = benchmark_shader_diffuse(scene, make_float3(0.8f, 0.8f, 0.8f));
+	Mesh *mesh = benchmark_add_mesh(scene, shader);
+	benchmark_mesh_sphere(mesh, 16, 8, 0.4f);
+
+	Shader *light_shader = benchmark_shader_emission(scene, 5.0f);
+
+	for(int y = 0; y < grid; y++) {
+		for(int x = 0; x < grid; x++) {
+			float3 co = make_float3((x - grid * 0.5f) * 2.0f, (y - grid * 0.5f) * 2.0f, 0.4f);
+			benchmark_add_object(scene, mesh, transform_translate(co));
+
+			Light *light = new Light();
+			light->type = LIGHT_POINT;
+			light->co = co + make_float3(1.0f, 1.0f, 0.3f);
+			light->size = 0.05f;
+			light->shader = light_shader;
+			scene->lights.push_back(light);
+		}
+	}
+
+	benchmark_camera(scene, make_float3(0.0f, -grid * 1.2f, grid * 0.6f), make_float3(0.0f, 0.0f, 0.0f));
+}
+
+/* Layered procedural textures, for shader evaluation. There are no image
+ * files bundled, so the cost of texture lookups comes from noise instead. */
+static void scene_textures(Scene *scene)
+{
+	const int num_layers = 4;
+
+	benchmark_background(scene, 1.0f);
+
+	ShaderGraph *graph = new ShaderGraph();
+	ShaderOutput *color = NULL;
+
+	for(int i = 0; i < num_layers; i++) {
+		NoiseTextureNode *noise = new NoiseTextureNode();
+		noise->scale = 2.0f + i * 3.0f;
+		noise->detail = 8.0f;
+		noise->distortion = 1.0f;
+		graph->add(noise);
+
+		MusgraveTextureNode *musgrave = new MusgraveTextureNode();
+		musgrave->type = NODE_MUSGRAVE_FBM;
+		musgrave->scale = 4.0f + i;
+		musgrave->detail = 8.0f;
+		musgrave->dimension = 2.0f;
+		musgrave->lacunarity = 2.0f;
+		graph->add(musgrave);
+
+		VoronoiTextureNode *voronoi = new VoronoiTextureNode();
+		voronoi->coloring = NODE_VORONOI_CELLS;
+		voronoi->scale = 5.0f + i * 2.0f;
+		graph->add(voronoi);
+
+		WaveTextureNode *wave = new WaveTextureNode();
+		wave->scale = 3.0f + i;
+		wave->distortion = 4.0f;
+		wave->detail = 4.0f;
+		wave->detail_scale = 1.0f;
+		graph->add(wave);
+
+		MixNode *mix = new MixNode();
+		mix->type = NODE_MIX_BLEND;
+		graph->add(mix);
+
+		graph->connect(noise->output("Color"), musgrave->input("Vector"));
+		graph->connect(musgrave->output("Fac"), mix->input("Fac"));
+		graph->connect(voronoi->output("Color"), mix->input("Color1"));
+		graph->connect(wave->output("Color"), mix->input("Color2"));
+
+		if(color) {
+			MixNode *layer = new MixNode();
+			layer->type = NODE_MIX_MUL;
+			layer->fac = 0.5f;
+			graph->add(layer);
+
+			graph->connect(color, layer->input("Color1"));
+			graph->connect(mix->output("Color"), layer->input("Color2"));
+			color = layer->output("Color");
+		}
+		else {
+			color = mix->output("Color");
+		}
+	}
+
+	DiffuseBsdfNode *diffuse = new DiffuseBsdfNode();
+	graph->add(diffuse);
+
+	graph->connect(color, diffuse->input("Color"));
+	graph->connect(diffuse->output("BSDF"), graph->output()->input("Surface"));
+
+	Shader *shader = benchmark_add_shader(scene, "textures", graph);
+
+	benchmark_mesh_grid(benchmark_add_mesh(scene, shader), 1, 10.0f);
+	benchmark_add_object(scene, scene->meshes.back(), transform_identity());
+
+	Mesh *mesh = benchmark_add_mesh(scene, shader);
+	benchmark_mesh_sphere(mesh, 64, 32, 1.0f);
+	benchmark_add_object(scene, mesh, transform_translate(-1.2f, 0.0f, 1.0f));
+	benchmark_add_object(scene, mesh, transform_translate(1.2f, 0.0f, 1.0f));
+
+	benchmark_camera(scene, make_float3(0.0f, -5.0f, 2.0f), make_float3(0.0f, 0.0f, 0.8f));
+}
+
+typedef void (*BenchmarkSceneFunc)(Scene *scene);
+
+static const struct {
+	const char *name;
+	BenchmarkSceneFunc create;
+} benchmark_scenes[] = {
+	{"instances", scene_instances},
+	{"hair", scene_hair},
+	{"volume", scene_volume},
+	{"lights", scene_lights},
+	{"textures", scene_textures},
+	{NULL, NULL},
+};
+
+static BenchmarkSceneFunc benchmark_scene_find(const string& name)
+{
+	for(int i = 0; benchmark_scenes[i].name; i++) {
+		if(name == benchmark_scenes[i].name) {
+			return benchmark_scenes[i].create;
+		}
+	}
+	return NULL;
+}
+
+/* Memory */
+
+/* Device memory used by the scene, grouped by what the data is for. */
+static void benchmark_memory(DeviceScene& dscene, map<string, size_t>& memory)
+{
+	memory["bvh"] = dscene.bvh_nodes.memory_size() +
+	                dscene.bvh_leaf_nodes.memory_size() +
+	                dscene.object_node.memory_size() +
+	                dscene.prim_tri_index.memory_size() +
+	                dscene.prim_tri_verts.memory_size() +
+	                dscene.prim_type.memory_size() +
+	                dscene.prim_visibility.memory_size() +
+	                dscene.prim_index.memory_size() +
+	                dscene.prim_object.memory_size() +
+	                dscene.prim_time.memory_size();
+	memory["meshes"] = dscene.tri_shader.memory_size() +
+	                   dscene.tri_vnormal.memory_size() +
+	                   dscene.tri_vindex.memory_size() +
+	                   dscene.tri_patch.memory_size() +
+	                   dscene.tri_patch_uv.memory_size() +
+	                   dscene.patches.memory_size();
+	memory["curves"] = dscene.curves.memory_size() +
+	                   dscene.curve_keys.memory_size();
+	memory["objects"] = dscene.objects.memory_size() +
+	                    dscene.object_motion_pass.memory_size() +
+	                    dscene.object_motion.memory_size() +
+	                    dscene.object_flag.memory_size() +
+	                    dscene.camera_motion.memory_size() +
+	                    dscene.particles.memory_size();
+	memory["attributes"] = dscene.attributes_map.memory_size() +
+	                       dscene.attributes_float.memory_size() +
+	                       dscene.attributes_float3.memory_size() +
+	                       dscene.attributes_uchar4.memory_size();
+	memory["lights"] = dscene.light_distribution.memory_size() +
+	                   dscene.lights.memory_size() +
+	                   dscene.light_background_marginal_cdf.memory_size() +
+	                   dscene.light_background_conditional_cdf.memory_size() +
+	                   dscene.light_tree_nodes.memory_size() +
+	                   dscene.light_tree_emitters.memory_size() +
+	                   dscene.light_tree_leaf_emitters.memory_size();
+	memory["shaders"] = dscene.svm_nodes.memory_size() +
+	                    dscene.shaders.memory_size() +
+	                    dscene.lookup_table.memory_size();
+}
+
+/* Benchmark */
+
+static BufferParams benchmark_buffer_params()
+{
+	BufferParams buffer_params;
+	buffer_params.width = options.width;
+	buffer_params.height = options.height;
+	buffer_params.full_width = options.width;
+	buffer_params.full_height = options.height;
+	return buffer_params;
+}
+
+static void benchmark_print(const string& str)
+{
+	if(!options.quiet) {
+		fprintf(stderr, "%s\n", str.c_str());
+	}
+}
+
+static void benchmark_run(const string& name,
+                          BenchmarkSceneFunc create,
+                          const string& filepath,
+                          BenchmarkResult& result)
+{
+	benchmark_print("Benchmarking " + name);
+
+	double start_time = time_dt();
+
+	Session *session = new Session(options.session_params);
+
+	PhaseTimer timer;
+	timer.begin(&session->progress);
+	session->progress.set_update_callback(function_bind(&PhaseTimer::update, &timer));
+
+	Scene *scene = new Scene(options.scene_params, session->device);
+	if(create) {
+		create(scene);
+	}
+	else {
+		xml_read_file(scene, filepath.c_str());
+		scene->camera->width = options.width;
+		scene->camera->height = options.height;
+		scene->camera->compute_auto_viewplane();
+	}
+	session->scene = scene;
+
+	BufferParams buffer_params = benchmark_buffer_params();
+	session->reset(buffer_params, options.session_params.samples);
+	session->start();
+	session->wait();
+
+	timer.end();
+
+	result.name = name;
+	result.total_time = time_dt() - start_time;
+	result.phases = timer.phases;
+	result.kernel = session->stats.kernel;
+	result.mem_used = session->stats.mem_used;
+	result.mem_peak = session->stats.mem_peak;
+
+	/* Scene data is still on the device until the session is freed. */
+	benchmark_memory(scene->dscene, result.memory);
+
+	size_t scene_memory = 0;
+	for(map<string, size_t>::iterator it = result.memory.begin(); it != result.memory.end(); it++) {
+		scene_memory += it->second;
+	}
+	result.memory["other"] = (result.mem_used > scene_memory)? result.mem_used - scene_memory: 0;
+
+	delete session;
+}
+
+/* Output */
+
+static string json_string(const string& str)
+{
+	string result = "\"";
+	foreach(char c, str) {
+		if(c == '"' || c == '\\') {
+			result += '\\';
+		}
+		result += c;
+	}
+	return result + "\"";
+}
+
+static void benchmark_write_json(FILE *f, const vector<BenchmarkResult>& results)
+{
+	fprintf(f, "{\n");
+	fprintf(f, "  \"version\": %s,\n", json_string(CYCLES_VERSION_STRING).c_str());
+	fprintf(f, "  \"device\": %s,\n", json_string(options.session_params.device.description).c_str());
+	fprintf(f, "  \"threads\": %d,\n", options.session_params.threads);
+	fprintf(f, "  \"samples\": %d,\n", options.session_params.samples);
+	fprintf(f, "  \"resolution\": [%d, %d],\n", options.width, options.height);
+	fprintf(f, "  \"scenes\": [\n");
+
+	for(size_t i = 0; i < results.size(); i++) {
+		const BenchmarkResult& result = results[i];
+		const KernelStats& kernel = result.kernel;
+
+		map<string, double>::const_iterator render = result.phases.find("render");
+		double render_time = (render != result.phases.end())? render->second: 0.0;
+		double inv_render_time = (render_time > 0.0)? 1.0 / render_time: 0.0;
+
+		fprintf(f, "    {\n");
+		fprintf(f, "      \"name\": %s,\n", json_string(result.name).c_str());
+		fprintf(f, "      \"total_time\": %f,\n", result.total_time);
+
+		fprintf(f, "      \"phases\": {");
+		for(map<string, double>::const_iterator it = result.phases.begin(); it != result.phases.end(); it++) {
+			fprintf(f, "%s\n        %s: %f", (it == result.phases.begin())? "": ",",
+			        json_string(it->first).c_str(), it->second);
+		}
+		fprintf(f, "\n      },\n");
+
+		fprintf(f, "      \"kernel\": {\n");
+		fprintf(f, "        \"camera_rays\": %llu,\n", (unsigned long long)kernel.num_camera_rays);
+		fprintf(f, "        \"shadow_rays\": %llu,\n", (unsigned long long)kernel.num_shadow_rays);
+		fprintf(f, "        \"indirect_rays\": %llu,\n", (unsigned long long)kernel.num_indirect_rays);
+		fprintf(f, "        \"shader_evals\": %llu,\n", (unsigned long long)kernel.num_shader_evals);
+		fprintf(f, "        \"camera_rays_per_second\": %f,\n", kernel.num_camera_rays * inv_render_time);
+		fprintf(f, "        \"shadow_rays_per_second\": %f,\n", kernel.num_shadow_rays * inv_render_time);
+		fprintf(f, "        \"indirect_rays_per_second\": %f,\n", kernel.num_indirect_rays * inv_render_time);
+		fprintf(f, "        \"shader_evals_per_second\": %f\n", kernel.num_shader_evals * inv_render_time);
+		fprintf(f, "      },\n");
+
+		fprintf(f, "      \"memory\": {\n");
+		fprintf(f, "        \"used\": %llu,\n", (unsigned long long)result.mem_used);
+		fprintf(f, "        \"peak\": %llu,\n", (unsigned long long)result.mem_peak);
+		fprintf(f, "        \"breakdown\": {");
+		for(map<string, size_t>::const_iterator it = result.memory.begin(); it != result.memory.end(); it++) {
+			fprintf(f, "%s\n          %s: %llu", (it == result.memory.begin())? "": ",",
+			        json_string(it->first).c_str(), (unsigned long long)it->second);
+		}
+		fprintf(f, "\n        }\n");
+		fprintf(f, "      }\n");
+
+		fprintf(f, "    }%s\n", (i + 1 < results.size())? ",": "");
+	}
+
+	fprintf(f, "  ]\n");
+	fprintf(f, "}\n");
+}
+
+/* Options */
+
+static int files_parse(int argc, const char *argv[])
+{
+	for(int i = 0; i < argc; i++)
+		options.filepaths.push_back(argv[i]);
+
+	return 0;
+}
+
+static void options_parse(int argc, const char **argv)
+{
+	options.width = 512;
+	options.height = 512;
+	options.quiet = false;
+	options.session_params.samples = 16;
+
+	string devicename = "CPU";
+	string scenes = "";
+	bool list = false;
+
+	ArgParse ap;
+	bool help = false, debug = false, version = false;
+	int verbosity = 1;
+
+	ap.options ("Usage: cycles_benchmark [options] [file.xml ...]",
+		"%*", files_parse, "",
+		"--device %s", &devicename, "Device to use",
+		"--scenes %s", &scenes, "Comma separated list of built-in scenes to render, all by default, none if files are given",
+		"--list-scenes", &list, "List the built-in scenes",
+		"--samples %d", &options.session_params.samples, "Number of samples to render",
+		"--threads %d", &options.session_params.threads, "CPU Rendering Threads",
+		"--width %d", &options.width, "Image width in pixel",
+		"--height %d", &options.height, "Image height in pixel",
+		"--tile-width %d", &options.session_params.tile_size.x, "Tile width in pixels",
+		"--tile-height %d", &options.session_params.tile_size.y, "Tile height in pixels",
+		"--output %s", &options.output_path, "File path to write JSON results to, standard output by default",
+		"--quiet", &options.quiet, "Don't print progress messages",
+#ifdef WITH_CYCLES_LOGGING
+		"--debug", &debug, "Enable debug logging",
+		"--verbose %d", &verbosity, "Set verbosity of the logger",
+#endif
+		"--help", &help, "Print help message",
+		"--version", &version, "Print version number",
+		NULL);
+
+	if(ap.parse(argc, argv) < 0) {
+		fprintf(stderr, "%s\n", ap.geterror().c_str());
+		ap.usage();
+		exit(EXIT_FAILURE);
+	}
+
+	if(debug) {
+		util_logging_start();
+		util_logging_verbosity_set(verbosity);
+	}
+
+	if(list) {
+		for(int i = 0; benchmark_scenes[i].name; i++)
+			printf("%s\n", benchmark_scenes[i].name);
+		exit(EXIT_SUCCESS);
+	}
+	else if(version) {
+		printf("%s\n", CYCLES_VERSION_STRING);
+		exit(EXIT_SUCCESS);
+	}
+	else if(help) {
+		ap.usage();
+		exit(EXIT_SUCCESS);
+	}
+
+	if(scenes != "") {
+		string_split(options.scenes, scenes, ",");
+	}
+	else if(options.filepaths.empty()) {
+		for(int i = 0; benchmark_scenes[i].name; i++)
+			options.scenes.push_back(benchmark_scenes[i].name);
+	}
+
+	options.session_params.background = true;
+	options.session_params.progressive = false;
+
+	/* find matching device */
+	DeviceType device_type = Device::type_from_string(devicename.c_str());
+	vector<DeviceInfo>& devices = Device::available_devices();
+	bool device_available = false;
+
+	foreach(DeviceInfo& device, devices) {
+		if(device_type == device.type) {
+			options.session_params.device = device;
+			device_available = true;
+			break;
+		}
+	}
+
+	/* handle invalid configurations */
+	if(options.session_params.device.type == DEVICE_NONE || !device_available) {
+		fprintf(stderr, "Unknown device: %s\n", devicename.c_str());
+		exit(EXIT_FAILURE);
+	}
+	else if(options.session_params.samples <= 0) {
+		fprintf(stderr, "Invalid number of samples: %d\n", options.session_params.samples);
+		exit(EXIT_FAILURE);
+	}
+	else if(options.width <= 0 || options.height <= 0) {
+		fprintf(stderr, "Invalid resolution: %dx%d\n", options.width, options.height);
+		exit(EXIT_FAILURE);
+	}
+
+	foreach(string& name, options.scenes) {
+		if(!benchmark_scene_find(name)) {
+			fprintf(stderr, "Unknown scene: %s\n", name.c_str());
+			exit(EXIT_FAILURE);
+		}
+	}
+}
+
+CCL_NAMESPACE_END
+
+using namespace ccl;
+
+int main(int argc, const char **argv)
+{
+	util_logging_init(argv[0]);
+	path_init();
+	options_parse(argc, argv);
+
+	vector<BenchmarkResult> results;
+
+	foreach(string& name, options.scenes) {
+		results.push_back(BenchmarkResult());
+		benchmark_run(name, benchmark_scene_find(name), "", results.back());
+	}
+
+	foreach(string& filepath, options.filepaths) {
+		results.push_back(BenchmarkResult());
+		benchmark_run(path_filename(filepath), NULL, filepath, results.back());
+	}
+
+	FILE *f = stdout;
+	if(options.output_path != "") {
+		f = path_fopen(options.output_path, "w");
+		if(!f) {
+			fprintf(stderr, "Can't write results to %s\n", options.output_path.c_str());
+			return 1;
+		}
+	}
+
+	benchmark_write_json(f, results);
+
+	if(f != stdout) {
+		fclose(f);
+	}
+
+	return 0;
+}
@@ -18,6 +18,7 @@
 
 #include "render/buffers.h"
 #include "render/camera.h"
+#include "render/denoising.h"
 #include "device/device.h"
 #include "render/scene.h"
 #include "render/session.h"
@@ -52,6 +53,9 @@ struct Options {
 	bool quiet;
 	bool show_help, interactive, pause;
 	string output_path;
+	vector<string> filepaths;
+	bool denoise;
+	int denoise_frame_radius;
 } options;
 
 static void session_print(const string& str)
@@ -180,6 +184,39 @@ static void session_exit()
 	}
 }
 
+static bool denoise_frames()
+{
+	Denoiser denoiser(options.session_params.device, options.session_params.threads);
+
+	/* Frames are overwritten, unless an output directory is given. */
+	foreach(string& filepath, options.filepaths) {
+		denoiser.input.push_back(filepath);
+		if(options.output_path != "")
+			denoiser.output.push_back(path_join(options.output_path, path_filename(filepath)));
+		else
+			denoiser.output.push_back(filepath);
+	}
+
+	denoiser.frame_radius = options.denoise_frame_radius;
+	if(options.session_params.samples != INT_MAX)
+		denoiser.samples = options.session_params.samples;
+
+	if(!options.quiet)
+		session_print(string_printf("Denoising %d frames", (int)options.filepaths.size()));
+
+	if(!denoiser.run()) {
+		fprintf(stderr, "\nError denoising frames: %s\n", denoiser.error.c_str());
+		return false;
+	}
+
+	if(!options.quiet) {
+		session_print("Finished Denoising.");
+		printf("\n");
+	}
+
+	return true;
+}
+
 #ifdef WITH_CYCLES_STANDALONE_GUI
 static void display_info(Progress& progress)
 {
@@ -347,6 +384,9 @@ static int files_parse(int argc, const char *argv[])
 	if(argc > 0)
 		options.filepath = argv[0];
 
+	for(int i = 0; i < argc; i++)
+		options.filepaths.push_back(argv[i]);
+
 	return 0;
 }
 
@@ -357,6 +397,8 @@ static void options_parse(int argc, const char **argv)
 	options.filepath = "";
 	options.session = NULL;
 	options.quiet = false;
+	options.denoise = false;
+	options.denoise_frame_radius = 2;
 
 	/* device names */
 	string device_names = "";
@@ -385,7 +427,7 @@ static void options_parse(int argc, const char **argv)
 	bool help = false, debug = false, version = false;
 	int verbosity = 1;
 
-	ap.options ("Usage: cycles [options] file.xml",
+	ap.options ("Usage: cycles [options] file.xml\n       cycles --denoise [options] frame.exr ...",
 		"%*", files_parse, "",
 		"--device %s", &devicename, ("Devices to use: " + device_names).c_str(),
 #ifdef WITH_OSL
@@ -401,6 +443,8 @@ static void options_parse(int argc, const char **argv)
 		"--tile-width %d", &options.session_params.tile_size.x, "Tile width in pixels",
 		"--tile-height %d", &options.session_params.tile_size.y, "Tile height in pixels",
 		"--list-devices", &list, "List information about all available devices",
+		"--denoise", &options.denoise, "Denoise the given sequence of multilayer EXR frames with denoising data, instead of rendering",
+		"--denoise-frame-radius %d", &options.denoise_frame_radius, "Number of frames before and after each frame used for denoising",
 #ifdef WITH_CYCLES_LOGGING
 		"--debug", &debug, "Enable debug logging",
 		"--verbose %d", &verbosity, "Set verbosity of the logger",
@@ -490,6 +534,14 @@ static void options_parse(int argc, const char **argv)
 		fprintf(stderr, "No file path specified\n");
 		exit(EXIT_FAILURE);
 	}
+	else if(options.denoise && options.session_params.device.type != DEVICE_CPU) {
+		fprintf(stderr, "Denoising of frames only works with CPU device\n");
+		exit(EXIT_FAILURE);
+	}
+	else if(options.denoise_frame_radius < 0) {
+		fprintf(stderr, "Invalid denoising frame radius: %d\n", options.denoise_frame_radius);
+		exit(EXIT_FAILURE);
+	}
 
 	/* For smoother Viewport */
 	options.session_params.start_resolution = 64;
@@ -505,6 +557,10 @@ int main(int argc, const char **argv)
 	path_init();
 	options_parse(argc, argv);
 
+	if(options.denoise) {
+		return denoise_frames()? 0: 1;
+	}
+
 #ifdef WITH_CYCLES_STANDALONE_GUI
 	if(options.session_params.background) {
 #endif
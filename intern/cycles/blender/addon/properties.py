@@ -50,6 +50,7 @@ enum_displacement_methods = (
 enum_bvh_layouts = (
     ('BVH2', "BVH2", "", 1),
     ('BVH4', "BVH4", "", 2),
+    ('BVH8', "BVH8", "", 4),
     )
 
 enum_bvh_types = (
@@ -288,6 +289,33 @@ class CyclesRenderSettings(bpy.types.PropertyGroup):
                 description="Sample all lights (for indirect samples), rather than randomly picking one",
                 default=True,
                 )
+        cls.use_light_tree = BoolProperty(
+                name="Light Tree",
+                description="Pick lights by their estimated contribution to the shading point rather than by area, "
+                            "reduces noise in scenes with many lights. Not used when sampling all lights",
+                default=True,
+                )
+        cls.use_adaptive_sampling = BoolProperty(
+                name="Adaptive Sampling",
+                description="Stop sampling pixels once their noise level is below the threshold, "
+                            "and tiles once all of their pixels are (final renders on the CPU only)",
+                default=False,
+                )
+        cls.adaptive_threshold = FloatProperty(
+                name="Adaptive Sampling Threshold",
+                description="Noise level at which a pixel is considered converged, "
+                            "zero picks a threshold based on the number of samples",
+                min=0.0, max=1.0,
+                default=0.0,
+                precision=4,
+                )
+        cls.adaptive_min_samples = IntProperty(
+                name="Adaptive Min Samples",
+                description="Number of samples every pixel gets before it is tested for convergence, "
+                            "zero picks a number based on the number of samples",
+                min=0, max=4096,
+                default=0,
+                )
         cls.light_sampling_threshold = FloatProperty(
                 name="Light Sampling Threshold",
                 description="Probabilistically terminate light samples when the light contribution is below this threshold (more noise but faster rendering). "
@@ -650,6 +678,20 @@ class CyclesRenderSettings(bpy.types.PropertyGroup):
             items=enum_texture_limit
             )
 
+        cls.use_texture_cache = BoolProperty(
+            name="Texture Cache",
+            description="Read image textures on demand in tiles, at the resolution needed for the render, "
+                        "instead of loading them fully (CPU only)",
+            default=False,
+            )
+
+        cls.texture_cache_size = IntProperty(
+            name="Cache Size",
+            description="Memory used for image textures in the texture cache, in megabytes",
+            default=1024,
+            min=16, max=1048576,
+            )
+
         cls.ao_bounces = IntProperty(
             name="AO Bounces",
             default=0,
@@ -679,7 +721,7 @@ class CyclesRenderSettings(bpy.types.PropertyGroup):
         cls.debug_bvh_layout = EnumProperty(
                 name="BVH Layout",
                 items=enum_bvh_layouts,
-                default='BVH4',
+                default='BVH8',
                 )
         cls.debug_use_cpu_split_kernel = BoolProperty(name="Split Kernel", default=False)
 
@@ -1069,6 +1069,90 @@ static void sync_mesh_fluid_motion(BL::Object& b_ob, Scene *scene, Mesh *mesh)
 	}
 }
 
+/* Hashing of exported data, so meshes kept from a previous frame are only
+ * updated when their data changed. 64 bit FNV-1a on whole words. */
+static void hash_mesh_data(uint64_t& hash, const void *data, size_t size)
+{
+	const uint64_t prime = 0x100000001b3ULL;
+	const uchar *bytes = (const uchar*)data;
+
+	for(; size >= sizeof(uint64_t); bytes += sizeof(uint64_t), size -= sizeof(uint64_t)) {
+		uint64_t word;
+		memcpy(&word, bytes, sizeof(uint64_t));
+		hash = (hash ^ word) * prime;
+	}
+	for(; size > 0; bytes++, size--) {
+		hash = (hash ^ *bytes) * prime;
+	}
+}
+
+template<typename T>
+static void hash_mesh_array(uint64_t& hash, const array<T>& data)
+{
+	const size_t size = data.size();
+	hash_mesh_data(hash, &size, sizeof(size));
+	if(size) {
+		hash_mesh_data(hash, data.data(), size*sizeof(T));
+	}
+}
+
+static void hash_mesh_attributes(uint64_t& hash, const AttributeSet& attributes)
+{
+	foreach(const Attribute& attr, attributes.attributes) {
+		hash_mesh_data(hash, attr.name.c_str(), attr.name.length());
+		hash_mesh_data(hash, &attr.std, sizeof(attr.std));
+		hash_mesh_data(hash, &attr.element, sizeof(attr.element));
+
+		const size_t size = attr.buffer.size();
+		hash_mesh_data(hash, &size, sizeof(size));
+		if(size) {
+			hash_mesh_data(hash, attr.data(), size);
+		}
+	}
+}
+
+static uint64_t mesh_content_hash(const Mesh *mesh)
+{
+	uint64_t hash = 0xcbf29ce484222325ULL;
+
+	hash_mesh_array(hash, mesh->verts);
+	hash_mesh_array(hash, mesh->triangles);
+	hash_mesh_array(hash, mesh->shader);
+	hash_mesh_array(hash, mesh->smooth);
+	hash_mesh_array(hash, mesh->curve_keys);
+	hash_mesh_array(hash, mesh->curve_radius);
+	hash_mesh_array(hash, mesh->curve_first_key);
+	hash_mesh_array(hash, mesh->curve_shader);
+	hash_mesh_attributes(hash, mesh->attributes);
+	hash_mesh_attributes(hash, mesh->curve_attributes);
+
+	foreach(const Shader *shader, mesh->used_shaders) {
+		hash_mesh_data(hash, &shader, sizeof(shader));
+	}
+	hash_mesh_data(hash, &mesh->geometry_flags, sizeof(mesh->geometry_flags));
+
+	return hash;
+}
+
+/* Data which the mesh manager generates from the exported data during its
+ * update, kept meshes would miss it. */
+static bool mesh_has_generated_data(Mesh *mesh)
+{
+	if(mesh->subdivision_type != Mesh::SUBDIVISION_NONE ||
+	   mesh->has_true_displacement())
+	{
+		return true;
+	}
+
+	foreach(const Attribute& attr, mesh->attributes.attributes) {
+		if(attr.element == ATTR_ELEMENT_VOXEL) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
 Mesh *BlenderSync::sync_mesh(BL::Object& b_ob,
                              bool object_updated,
                              bool hide_tris)
@@ -1116,10 +1200,14 @@ Mesh *BlenderSync::sync_mesh(BL::Object& b_ob,
 		requested_geometry_flags |= Mesh::GEOMETRY_CURVES;
 	}
 	Mesh *mesh;
+	const bool mesh_recalc = mesh_map.sync(&mesh, key);
 
-	if(!mesh_map.sync(&mesh, key)) {
+	if(!mesh_recalc) {
+		/* data kept from a previous frame, exported once per frame and
+		 * compared after export below */
+		if(resync_persistent && mesh_persistent_synced.find(mesh) == mesh_persistent_synced.end());
 		/* if transform was applied to mesh, need full update */
-		if(object_updated && mesh->transform_applied);
+		else if(object_updated && mesh->transform_applied);
 		/* test if shaders changed, these can be object level so mesh
 		 * does not get tagged for recalc */
 		else if(mesh->used_shaders != used_shaders);
@@ -1143,6 +1231,10 @@ Mesh *BlenderSync::sync_mesh(BL::Object& b_ob,
 		return mesh;
 
 	mesh_synced.insert(mesh);
+	if(resync_persistent)
+		mesh_persistent_synced.insert(mesh);
+
+	const bool was_transform_applied = mesh->transform_applied;
 
 	/* create derived mesh */
 	array<int> oldtriangles;
@@ -1226,6 +1318,27 @@ Mesh *BlenderSync::sync_mesh(BL::Object& b_ob,
 	               (oldcurve_keys != mesh->curve_keys) ||
 	               (oldcurve_radius != mesh->curve_radius);
 
+	/* With persistent data, meshes which exported the same data as in the
+	 * previous frame are kept as they are on the device, including their BVH.
+	 * Meshes which deform are refit instead of rebuilt. */
+	if(scene->params.persistent_data && !preview) {
+		const uint64_t hash = mesh_content_hash(mesh);
+		map<Mesh*, uint64_t>::iterator it = mesh_hash.find(mesh);
+		const bool unchanged = !mesh_recalc &&
+		                       !rebuild &&
+		                       !(object_updated && was_transform_applied) &&
+		                       scene->need_motion() == Scene::MOTION_NONE &&
+		                       !mesh_has_generated_data(mesh) &&
+		                       it != mesh_hash.end() &&
+		                       it->second == hash;
+
+		mesh_hash[mesh] = hash;
+
+		if(unchanged) {
+			return mesh;
+		}
+	}
+
 	mesh->tag_update(scene, rebuild);
 
 	return mesh;
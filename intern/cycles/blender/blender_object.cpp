@@ -120,7 +120,12 @@ void BlenderSync::sync_light(BL::Object& b_parent,
 	Light *light;
 	ObjectKey key(b_parent, persistent_id, b_ob);
 
-	if(!light_map.sync(&light, b_ob, b_parent, key)) {
+	const bool light_recalc = light_map.sync(&light, b_ob, b_parent, key);
+	/* lights kept from a previous frame are synced again once per frame, the
+	 * first render layer may not include them */
+	const bool light_resync = resync_persistent && light_persistent_synced.insert(light).second;
+
+	if(!light_recalc && !light_resync) {
 		if(light->is_portal)
 			*use_portal = true;
 		return;
@@ -347,9 +352,14 @@ Object *BlenderSync::sync_object(BL::Object& b_parent,
 
 	if(object_map.sync(&object, b_ob, b_parent, key))
 		object_updated = true;
+
+	/* objects kept from a previous frame are synced again once per frame,
+	 * and only tagged for update when their data changed */
+	const bool object_resync = resync_persistent && object_persistent_synced.insert(object).second;
 	
-	/* mesh sync */
-	object->mesh = sync_mesh(b_ob, object_updated, hide_tris);
+	/* mesh sync, meshes with transform applied also change with the
+	 * transform, which is not always tagged (see below) */
+	object->mesh = sync_mesh(b_ob, object_updated || tfm != object->tfm, hide_tris);
 
 	/* special case not tracked by object update flags */
 
@@ -374,7 +384,15 @@ Object *BlenderSync::sync_object(BL::Object& b_parent,
 	/* object sync
 	 * transform comparison should not be needed, but duplis don't work perfect
 	 * in the depsgraph and may not signal changes, so this is a workaround */
-	if(object_updated || (object->mesh && object->mesh->need_update) || tfm != object->tfm) {
+	const bool object_changed = object_updated || (object->mesh && object->mesh->need_update) || tfm != object->tfm;
+
+	if(object_changed || object_resync) {
+		const ustring old_name = object->name;
+		const int old_pass_id = object->pass_id;
+		const uint old_random_id = object->random_id;
+		const float3 old_dupli_generated = object->dupli_generated;
+		const float2 old_dupli_uv = object->dupli_uv;
+
 		object->name = b_ob.name().c_str();
 		object->pass_id = b_ob.pass_index();
 		object->tfm = tfm;
@@ -424,7 +442,17 @@ Object *BlenderSync::sync_object(BL::Object& b_parent,
 			object->random_id =  hash_int_2d(hash_string(object->name.c_str()), 0);
 		}
 
-		object->tag_update(scene);
+		/* motion is synced for every frame, so always tag it */
+		if(object_changed ||
+		   object->use_motion() ||
+		   object->name != old_name ||
+		   object->pass_id != old_pass_id ||
+		   object->random_id != old_random_id ||
+		   !(object->dupli_generated == old_dupli_generated) ||
+		   !(object->dupli_uv == old_dupli_uv))
+		{
+			object->tag_update(scene);
+		}
 	}
 
 	return object;
@@ -637,8 +665,19 @@ void BlenderSync::sync_objects(float motion_time)
 		/* handle removed data and modified pointers */
 		if(light_map.post_sync())
 			scene->light_manager->tag_update(scene);
-		if(mesh_map.post_sync())
+		if(mesh_map.post_sync()) {
 			scene->mesh_manager->tag_update(scene);
+
+			/* forget hashes of deleted meshes */
+			map<Mesh*, uint64_t> used_mesh_hash;
+			foreach(Mesh *mesh, scene->meshes) {
+				map<Mesh*, uint64_t>::iterator it = mesh_hash.find(mesh);
+				if(it != mesh_hash.end()) {
+					used_mesh_hash[mesh] = it->second;
+				}
+			}
+			mesh_hash.swap(used_mesh_hash);
+		}
 		if(object_map.post_sync())
 			scene->object_manager->tag_update(scene);
 		if(particle_system_map.post_sync())
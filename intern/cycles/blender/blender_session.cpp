@@ -193,6 +193,9 @@ void BlenderSession::reset_session(BL::BlendData& b_data_, BL::Scene& b_scene_)
 		 * them rather than trying to distinguish which settings need to be updated
 		 */
 
+		delete sync;
+		sync = NULL;
+
 		delete session;
 
 		create_session();
@@ -210,8 +213,14 @@ void BlenderSession::reset_session(BL::BlendData& b_data_, BL::Scene& b_scene_)
 	 */
 	session->stats.mem_peak = session->stats.mem_used;
 
-	/* sync object should be re-created */
-	sync = new BlenderSync(b_engine, b_data, b_scene, scene, !background, session->progress);
+	/* sync object is kept along with the scene data of the previous frame,
+	 * so only changes are synced */
+	if(sync) {
+		sync->reset(b_data, b_scene);
+	}
+	else {
+		sync = new BlenderSync(b_engine, b_data, b_scene, scene, !background, session->progress);
+	}
 
 	/* for final render we will do full data sync per render layer, only
 	 * do some basic syncing here, no objects or materials for speed */
@@ -428,6 +437,13 @@ void BlenderSession::render()
 		session->params.denoising_feature_strength = get_float(crl, "denoising_feature_strength");
 		session->params.denoising_relative_pca = get_boolean(crl, "denoising_relative_pca");
 
+		/* Adaptive sampling is only implemented for rendering on the CPU. */
+		PointerRNA cscene = RNA_pointer_get(&b_scene.ptr, "cycles");
+		bool use_adaptive_sampling = get_boolean(cscene, "use_adaptive_sampling") &&
+		                             session_params.device.type == DEVICE_CPU;
+		buffer_params.adaptive_sampling = use_adaptive_sampling;
+		scene->film->use_adaptive_sampling = use_adaptive_sampling;
+
 		scene->film->pass_alpha_threshold = b_layer_iter->pass_alpha_threshold();
 		scene->film->tag_passes_update(scene, passes);
 		scene->film->tag_update(scene);
@@ -506,13 +522,22 @@ void BlenderSession::render()
 	session->update_render_tile_cb = function_null;
 
 	/* free all memory used (host and device), so we wouldn't leave render
-	 * engine with extra memory allocated
+	 * engine with extra memory allocated. With persistent data the scene is
+	 * kept for the next frame, only render buffers are freed.
 	 */
 
-	session->device_free();
+	if(scene->params.persistent_data) {
+		/* builtin images may change between frames, they are loaded again */
+		scene->image_manager->device_free_builtin(scene->device);
 
-	delete sync;
-	sync = NULL;
+		session->tile_manager.device_free();
+	}
+	else {
+		session->device_free();
+
+		delete sync;
+		sync = NULL;
+	}
 }
 
 static void populate_bake_data(BakeData *data, const
@@ -1449,6 +1449,13 @@ void BlenderSync::sync_shaders()
 		auto_refresh_update = image_manager->set_animation_frame_update(frame);
 	}
 
+	/* shaders kept from a previous frame may be animated, sync them again
+	 * once per frame */
+	if(resync_persistent && !shader_persistent_synced) {
+		auto_refresh_update = true;
+		shader_persistent_synced = true;
+	}
+
 	shader_map.pre_sync();
 
 	sync_world(auto_refresh_update);
@@ -58,6 +58,8 @@ BlenderSync::BlenderSync(BL::RenderEngine& b_engine,
   particle_system_map(&scene->particle_systems),
   world_map(NULL),
   world_recalc(false),
+  resync_persistent(false),
+  shader_persistent_synced(false),
   scene(scene),
   preview(preview),
   experimental(false),
@@ -74,6 +76,21 @@ BlenderSync::~BlenderSync()
 {
 }
 
+void BlenderSync::reset(BL::BlendData& b_data, BL::Scene& b_scene)
+{
+	this->b_data = b_data;
+	this->b_scene = b_scene;
+	resync_persistent = true;
+	mesh_persistent_synced.clear();
+	light_persistent_synced.clear();
+	object_persistent_synced.clear();
+	shader_persistent_synced = false;
+
+	PointerRNA cscene = RNA_pointer_get(&b_scene.ptr, "cycles");
+	dicing_rate = preview ? RNA_float_get(&cscene, "preview_dicing_rate") : RNA_float_get(&cscene, "dicing_rate");
+	max_subdivisions = RNA_int_get(&cscene, "max_subdivisions");
+}
+
 /* Sync */
 
 bool BlenderSync::sync_recalc()
@@ -284,6 +301,9 @@ void BlenderSync::sync_integrator()
 	integrator->sample_all_lights_direct = get_boolean(cscene, "sample_all_lights_direct");
 	integrator->sample_all_lights_indirect = get_boolean(cscene, "sample_all_lights_indirect");
 	integrator->light_sampling_threshold = get_float(cscene, "light_sampling_threshold");
+	integrator->use_light_tree = get_boolean(cscene, "use_light_tree");
+	integrator->adaptive_threshold = get_float(cscene, "adaptive_threshold");
+	integrator->adaptive_min_samples = get_int(cscene, "adaptive_min_samples");
 
 	int diffuse_samples = get_int(cscene, "diffuse_samples");
 	int glossy_samples = get_int(cscene, "glossy_samples");
@@ -324,6 +344,15 @@ void BlenderSync::sync_integrator()
 		integrator->ao_bounces = 0;
 	}
 
+	/* Light tree is built along with the light distribution. */
+	if(integrator->use_light_tree != previntegrator.use_light_tree ||
+	   integrator->method != previntegrator.method ||
+	   integrator->sample_all_lights_direct != previntegrator.sample_all_lights_direct ||
+	   integrator->sample_all_lights_indirect != previntegrator.sample_all_lights_indirect)
+	{
+		scene->light_manager->tag_update(scene);
+	}
+
 	if(integrator->modified(previntegrator))
 		integrator->tag_update(scene);
 }
@@ -662,6 +691,9 @@ SceneParams BlenderSync::get_scene_params(BL::Scene& b_scene,
 		params.texture_limit = 0;
 	}
 
+	params.use_texture_cache = RNA_boolean_get(&cscene, "use_texture_cache");
+	params.texture_cache_size = RNA_int_get(&cscene, "texture_cache_size");
+
 	params.bvh_layout = DebugFlags().cpu.bvh_layout;
 
 	return params;
@@ -57,6 +57,9 @@ public:
 	            Progress &progress);
 	~BlenderSync();
 
+	/* Reuse synced data for another frame with persistent data. */
+	void reset(BL::BlendData& b_data, BL::Scene& b_scene);
+
 	/* sync */
 	bool sync_recalc();
 	void sync_data(BL::RenderSettings& b_render,
@@ -173,6 +176,18 @@ private:
 	void *world_map;
 	bool world_recalc;
 
+	/* Data was kept from a previous frame. Blender does not tag changes for
+	 * final renders, so everything is exported again and compared against
+	 * the existing data, to only update what changed. */
+	bool resync_persistent;
+	map<Mesh*, uint64_t> mesh_hash;
+	/* Data which was synced for the current frame, render layers may include
+	 * different objects, so this is tracked per item. */
+	set<Mesh*> mesh_persistent_synced;
+	set<Light*> light_persistent_synced;
+	set<Object*> object_persistent_synced;
+	bool shader_persistent_synced;
+
 	Scene *scene;
 	bool preview;
 	bool experimental;
@@ -22,6 +22,7 @@
 
 #include "bvh/bvh2.h"
 #include "bvh/bvh4.h"
+#include "bvh/bvh8.h"
 #include "bvh/bvh_build.h"
 #include "bvh/bvh_node.h"
 
@@ -38,6 +39,7 @@ const char *bvh_layout_name(BVHLayout layout)
 	switch(layout) {
 		case BVH_LAYOUT_BVH2: return "BVH2";
 		case BVH_LAYOUT_BVH4: return "BVH4";
+		case BVH_LAYOUT_BVH8: return "BVH8";
 		case BVH_LAYOUT_NONE: return "NONE";
 		case BVH_LAYOUT_ALL:  return "ALL";
 	}
@@ -81,7 +83,7 @@ int BVHStackEntry::encodeIdx() const
 /* BVH */
 
 BVH::BVH(const BVHParams& params_, const vector<Object*>& objects_)
-: params(params_), objects(objects_)
+: params(params_), objects(objects_), instances(NULL)
 {
 }
 
@@ -92,6 +94,8 @@ BVH *BVH::create(const BVHParams& params, const vector<Object*>& objects)
 			return new BVH2(params, objects);
 		case BVH_LAYOUT_BVH4:
 			return new BVH4(params, objects);
+		case BVH_LAYOUT_BVH8:
+			return new BVH8(params, objects);
 		case BVH_LAYOUT_NONE:
 		case BVH_LAYOUT_ALL:
 			break;
@@ -134,6 +138,12 @@ void BVH::build(Progress& progress)
 	progress.set_substatus("Packing BVH nodes");
 	pack_nodes(root);
 
+	/* merge with instance BVH's */
+	if(params.top_level) {
+		progress.set_substatus("Packing BVH instances");
+		pack_instances();
+	}
+
 	/* free build nodes */
 	root->deleteSubtree();
 }
@@ -283,234 +293,340 @@ void BVH::pack_primitives()
 	}
 }
 
-/* Pack Instances */
+/* Pack Utility */
 
-void BVH::pack_instances(size_t nodes_size, size_t leaf_nodes_size)
+/* Copy packed inner nodes, adjusting child indexes for the offsets of the
+ * nodes in the global arrays. Source and destination may be the same. */
+static void bvh_copy_nodes(int4 *pack_nodes,
+                           const int4 *bvh_nodes,
+                           size_t bvh_nodes_size,
+                           BVHLayout bvh_layout,
+                           int noffset,
+                           int noffset_leaf)
 {
-	/* The BVH's for instances are built separately, but for traversal all
-	 * BVH's are stored in global arrays. This function merges them into the
-	 * top level BVH, adjusting indexes and offsets where appropriate.
-	 */
-	/* TODO(sergey): This code needs adjustment for wider BVH than 4. */
-	const bool use_qbvh = (params.bvh_layout == BVH_LAYOUT_BVH4);
-
-	/* Adjust primitive index to point to the triangle in the global array, for
-	 * meshes with transform applied and already in the top level BVH.
-	 */
-	for(size_t i = 0; i < pack.prim_index.size(); i++)
-		if(pack.prim_index[i] != -1) {
-			if(pack.prim_type[i] & PRIMITIVE_ALL_CURVE)
-				pack.prim_index[i] += objects[pack.prim_object[i]]->mesh->curve_offset;
-			else
-				pack.prim_index[i] += objects[pack.prim_object[i]]->mesh->tri_offset;
+	const bool use_qbvh = (bvh_layout == BVH_LAYOUT_BVH4);
+	const bool use_obvh = (bvh_layout == BVH_LAYOUT_BVH8);
+	size_t pack_nodes_offset = 0;
+
+	for(size_t i = 0; i < bvh_nodes_size; ) {
+		size_t nsize, nsize_bbox;
+		if(bvh_nodes[i].x & PATH_RAY_NODE_UNALIGNED) {
+			if(use_obvh) {
+				nsize = BVH_UNALIGNED_ONODE_SIZE;
+				nsize_bbox = BVH_UNALIGNED_ONODE_CHILD_OFFSET;
+			}
+			else {
+				nsize = use_qbvh
+				            ? BVH_UNALIGNED_QNODE_SIZE
+				            : BVH_UNALIGNED_NODE_SIZE;
+				nsize_bbox = (use_qbvh)? 13: 0;
+			}
+		}
+		else {
+			if(use_obvh) {
+				nsize = BVH_ONODE_SIZE;
+				nsize_bbox = BVH_ONODE_CHILD_OFFSET;
+			}
+			else {
+				nsize = (use_qbvh)? BVH_QNODE_SIZE: BVH_NODE_SIZE;
+				nsize_bbox = (use_qbvh)? 7: 0;
+			}
 		}
 
-	/* track offsets of instanced BVH data in global array */
-	size_t prim_offset = pack.prim_index.size();
-	size_t nodes_offset = nodes_size;
-	size_t nodes_leaf_offset = leaf_nodes_size;
+		if(pack_nodes != bvh_nodes) {
+			memcpy(pack_nodes + pack_nodes_offset,
+			       bvh_nodes + i,
+			       nsize_bbox*sizeof(int4));
+		}
 
-	/* clear array that gives the node indexes for instanced objects */
-	pack.object_node.clear();
+		/* Modify offsets into arrays */
+		int4 data = bvh_nodes[i + nsize_bbox];
 
-	/* reserve */
-	size_t prim_index_size = pack.prim_index.size();
-	size_t prim_tri_verts_size = pack.prim_tri_verts.size();
+		data.z += (data.z < 0)? -noffset_leaf: noffset;
+		data.w += (data.w < 0)? -noffset_leaf: noffset;
 
-	size_t pack_prim_index_offset = prim_index_size;
-	size_t pack_prim_tri_verts_offset = prim_tri_verts_size;
-	size_t pack_nodes_offset = nodes_size;
-	size_t pack_leaf_nodes_offset = leaf_nodes_size;
-	size_t object_offset = 0;
+		if(use_qbvh || use_obvh) {
+			data.x += (data.x < 0)? -noffset_leaf: noffset;
+			data.y += (data.y < 0)? -noffset_leaf: noffset;
+		}
 
-	map<Mesh*, int> mesh_map;
+		pack_nodes[pack_nodes_offset + nsize_bbox] = data;
+
+		/* Wide nodes store the other four children in the next row. */
+		size_t nsize_child = 1;
+		if(use_obvh) {
+			data = bvh_nodes[i + nsize_bbox + 1];
+			data.x += (data.x < 0)? -noffset_leaf: noffset;
+			data.y += (data.y < 0)? -noffset_leaf: noffset;
+			data.z += (data.z < 0)? -noffset_leaf: noffset;
+			data.w += (data.w < 0)? -noffset_leaf: noffset;
+			pack_nodes[pack_nodes_offset + nsize_bbox + 1] = data;
+			nsize_child = 2;
+		}
 
-	foreach(Object *ob, objects) {
-		Mesh *mesh = ob->mesh;
-		BVH *bvh = mesh->bvh;
+		/* Usually this copies nothing, but we better
+		 * be prepared for possible node size extension.
+		 */
+		if(pack_nodes != bvh_nodes) {
+			memcpy(&pack_nodes[pack_nodes_offset + nsize_bbox + nsize_child],
+			       &bvh_nodes[i + nsize_bbox + nsize_child],
+			       sizeof(int4) * (nsize - (nsize_bbox + nsize_child)));
+		}
 
-		if(mesh->need_build_bvh()) {
-			if(mesh_map.find(mesh) == mesh_map.end()) {
-				prim_index_size += bvh->pack.prim_index.size();
-				prim_tri_verts_size += bvh->pack.prim_tri_verts.size();
-				nodes_size += bvh->pack.nodes.size();
-				leaf_nodes_size += bvh->pack.leaf_nodes.size();
+		pack_nodes_offset += nsize;
+		i += nsize;
+	}
+}
 
-				mesh_map[mesh] = 1;
-			}
+/* Copy packed leaf nodes, adjusting primitive indexes for the offset of the
+ * primitives in the global arrays. Source and destination may be the same. */
+static void bvh_copy_leaf_nodes(int4 *pack_leaf_nodes,
+                                const int4 *bvh_leaf_nodes,
+                                size_t bvh_leaf_nodes_size,
+                                int prim_offset)
+{
+	for(size_t i = 0; i < bvh_leaf_nodes_size; i += BVH_NODE_LEAF_SIZE) {
+		int4 data = bvh_leaf_nodes[i];
+		if(data.x < 0) {
+			/* Object instance, primitive index is stored inverted. */
+			data.x -= prim_offset;
+		}
+		else {
+			data.x += prim_offset;
+			data.y += prim_offset;
+		}
+		pack_leaf_nodes[i] = data;
+		for(int j = 1; j < BVH_NODE_LEAF_SIZE; ++j) {
+			pack_leaf_nodes[i + j] = bvh_leaf_nodes[i + j];
 		}
 	}
+}
 
-	mesh_map.clear();
+/* BVH Instances */
 
-	pack.prim_index.resize(prim_index_size);
-	pack.prim_type.resize(prim_index_size);
-	pack.prim_object.resize(prim_index_size);
-	pack.prim_visibility.resize(prim_index_size);
-	pack.prim_tri_verts.resize(prim_tri_verts_size);
-	pack.prim_tri_index.resize(prim_index_size);
-	pack.nodes.resize(nodes_size);
-	pack.leaf_nodes.resize(leaf_nodes_size);
-	pack.object_node.resize(objects.size());
+BVHInstances::BVHInstances()
+: num_nodes(0),
+  num_leaf_nodes(0),
+  num_prims(0),
+  num_prim_tri_verts(0),
+  bvh_layout(BVH_LAYOUT_NONE),
+  use_motion_steps(false)
+{
+}
 
-	if(params.num_motion_curve_steps > 0 || params.num_motion_triangle_steps > 0) {
-		pack.prim_time.resize(prim_index_size);
-	}
+void BVHInstances::clear()
+{
+	num_nodes = 0;
+	num_leaf_nodes = 0;
+	num_prims = 0;
+	num_prim_tri_verts = 0;
+
+	meshes.clear();
+	mesh_node.clear();
+	bvh_layout = BVH_LAYOUT_NONE;
+}
 
-	int *pack_prim_index = (pack.prim_index.size())? &pack.prim_index[0]: NULL;
-	int *pack_prim_type = (pack.prim_type.size())? &pack.prim_type[0]: NULL;
-	int *pack_prim_object = (pack.prim_object.size())? &pack.prim_object[0]: NULL;
-	uint *pack_prim_visibility = (pack.prim_visibility.size())? &pack.prim_visibility[0]: NULL;
-	float4 *pack_prim_tri_verts = (pack.prim_tri_verts.size())? &pack.prim_tri_verts[0]: NULL;
-	uint *pack_prim_tri_index = (pack.prim_tri_index.size())? &pack.prim_tri_index[0]: NULL;
-	int4 *pack_nodes = (pack.nodes.size())? &pack.nodes[0]: NULL;
-	int4 *pack_leaf_nodes = (pack.leaf_nodes.size())? &pack.leaf_nodes[0]: NULL;
-	float2 *pack_prim_time = (pack.prim_time.size())? &pack.prim_time[0]: NULL;
+int BVHInstances::node_offset(const Mesh *mesh) const
+{
+	map<const Mesh*, int>::const_iterator it = mesh_node.find(mesh);
+	return (it != mesh_node.end())? it->second: 0;
+}
+
+bool BVHInstances::update(const BVHParams& params,
+                          const vector<Object*>& objects,
+                          bool force)
+{
+	const bool use_motion = (params.num_motion_curve_steps > 0 ||
+	                         params.num_motion_triangle_steps > 0);
+
+	/* Instanced meshes, in order of first use. */
+	vector<MeshEntry> used_meshes;
+	map<const Mesh*, int> used_mesh_map;
 
-	/* merge */
 	foreach(Object *ob, objects) {
 		Mesh *mesh = ob->mesh;
 
-		/* We assume that if mesh doesn't need own BVH it was already included
-		 * into a top-level BVH and no packing here is needed.
-		 */
-		if(!mesh->need_build_bvh()) {
-			pack.object_node[object_offset++] = 0;
+		if(!mesh->need_build_bvh() ||
+		   used_mesh_map.find(mesh) != used_mesh_map.end())
+		{
 			continue;
 		}
 
-		/* if mesh already added once, don't add it again, but used set
-		 * node offset for this object */
-		map<Mesh*, int>::iterator it = mesh_map.find(mesh);
+		used_mesh_map[mesh] = 1;
 
-		if(mesh_map.find(mesh) != mesh_map.end()) {
-			int noffset = it->second;
-			pack.object_node[object_offset++] = noffset;
-			continue;
-		}
+		MeshEntry entry;
+		entry.mesh = mesh;
+		entry.bvh = mesh->bvh;
+		entry.tri_offset = mesh->tri_offset;
+		entry.curve_offset = mesh->curve_offset;
+		used_meshes.push_back(entry);
+	}
+
+	if(!force &&
+	   used_meshes == meshes &&
+	   params.bvh_layout == bvh_layout &&
+	   use_motion == use_motion_steps)
+	{
+		return false;
+	}
 
-		BVH *bvh = mesh->bvh;
+	clear();
+	meshes = used_meshes;
+	bvh_layout = params.bvh_layout;
+	use_motion_steps = use_motion;
 
-		int noffset = nodes_offset;
-		int noffset_leaf = nodes_leaf_offset;
-		int mesh_tri_offset = mesh->tri_offset;
-		int mesh_curve_offset = mesh->curve_offset;
+	/* track offsets of instanced BVH data in global array */
+	foreach(const MeshEntry& entry, meshes) {
+		const BVH *bvh = entry.bvh;
 
 		/* fill in node indexes for instances */
 		if(bvh->pack.root_index == -1)
-			pack.object_node[object_offset++] = -noffset_leaf-1;
+			mesh_node[entry.mesh] = -(int)num_leaf_nodes-1;
 		else
-			pack.object_node[object_offset++] = noffset;
+			mesh_node[entry.mesh] = (int)num_nodes;
+
+		num_nodes += bvh->pack.nodes.size();
+		num_leaf_nodes += bvh->pack.leaf_nodes.size();
+		num_prims += bvh->pack.prim_index.size();
+		num_prim_tri_verts += bvh->pack.prim_tri_verts.size();
+	}
+
+	return true;
+}
+
+void BVHInstances::pack(const PackedBVHArrays& arrays) const
+{
+	size_t prim_offset = 0;
+	size_t prim_tri_verts_offset = 0;
+	size_t nodes_offset = 0;
+	size_t nodes_leaf_offset = 0;
 
-		mesh_map[mesh] = pack.object_node[object_offset-1];
+	/* merge */
+	foreach(const MeshEntry& entry, meshes) {
+		const BVH *bvh = entry.bvh;
 
 		/* merge primitive, object and triangle indexes */
-		if(bvh->pack.prim_index.size()) {
-			size_t bvh_prim_index_size = bvh->pack.prim_index.size();
-			int *bvh_prim_index = &bvh->pack.prim_index[0];
-			int *bvh_prim_type = &bvh->pack.prim_type[0];
-			uint *bvh_prim_visibility = &bvh->pack.prim_visibility[0];
-			uint *bvh_prim_tri_index = &bvh->pack.prim_tri_index[0];
-			float2 *bvh_prim_time = bvh->pack.prim_time.size()? &bvh->pack.prim_time[0]: NULL;
-
-			for(size_t i = 0; i < bvh_prim_index_size; i++) {
-				if(bvh->pack.prim_type[i] & PRIMITIVE_ALL_CURVE) {
-					pack_prim_index[pack_prim_index_offset] = bvh_prim_index[i] + mesh_curve_offset;
-					pack_prim_tri_index[pack_prim_index_offset] = -1;
-				}
-				else {
-					pack_prim_index[pack_prim_index_offset] = bvh_prim_index[i] + mesh_tri_offset;
-					pack_prim_tri_index[pack_prim_index_offset] =
-					        bvh_prim_tri_index[i] + pack_prim_tri_verts_offset;
-				}
+		const size_t bvh_prim_index_size = bvh->pack.prim_index.size();
+		const bool has_prim_time = arrays.prim_time && bvh->pack.prim_time.size();
 
-				pack_prim_type[pack_prim_index_offset] = bvh_prim_type[i];
-				pack_prim_visibility[pack_prim_index_offset] = bvh_prim_visibility[i];
-				pack_prim_object[pack_prim_index_offset] = 0;  // unused for instances
-				if(bvh_prim_time != NULL) {
-					pack_prim_time[pack_prim_index_offset] = bvh_prim_time[i];
-				}
-				pack_prim_index_offset++;
+		for(size_t i = 0; i < bvh_prim_index_size; i++) {
+			const size_t pack_prim_index = prim_offset + i;
+
+			if(bvh->pack.prim_type[i] & PRIMITIVE_ALL_CURVE) {
+				arrays.prim_index[pack_prim_index] = bvh->pack.prim_index[i] + entry.curve_offset;
+				arrays.prim_tri_index[pack_prim_index] = -1;
+			}
+			else {
+				arrays.prim_index[pack_prim_index] = bvh->pack.prim_index[i] + entry.tri_offset;
+				arrays.prim_tri_index[pack_prim_index] =
+				        bvh->pack.prim_tri_index[i] + prim_tri_verts_offset;
+			}
+
+			arrays.prim_type[pack_prim_index] = bvh->pack.prim_type[i];
+			arrays.prim_visibility[pack_prim_index] = bvh->pack.prim_visibility[i];
+			arrays.prim_object[pack_prim_index] = 0;  // unused for instances
+			if(arrays.prim_time) {
+				arrays.prim_time[pack_prim_index] = (has_prim_time)
+				        ? bvh->pack.prim_time[i]
+				        : make_float2(0.0f, 1.0f);
 			}
 		}
 
 		/* Merge triangle vertices data. */
 		if(bvh->pack.prim_tri_verts.size()) {
-			const size_t prim_tri_size = bvh->pack.prim_tri_verts.size();
-			memcpy(pack_prim_tri_verts + pack_prim_tri_verts_offset,
-			       &bvh->pack.prim_tri_verts[0],
-			       prim_tri_size*sizeof(float4));
-			pack_prim_tri_verts_offset += prim_tri_size;
+			memcpy(arrays.prim_tri_verts + prim_tri_verts_offset,
+			       bvh->pack.prim_tri_verts.data(),
+			       bvh->pack.prim_tri_verts.size()*sizeof(float4));
 		}
 
 		/* merge nodes */
 		if(bvh->pack.leaf_nodes.size()) {
-			int4 *leaf_nodes_offset = &bvh->pack.leaf_nodes[0];
-			size_t leaf_nodes_offset_size = bvh->pack.leaf_nodes.size();
-			for(size_t i = 0, j = 0;
-			    i < leaf_nodes_offset_size;
-			    i += BVH_NODE_LEAF_SIZE, j++)
-			{
-				int4 data = leaf_nodes_offset[i];
-				data.x += prim_offset;
-				data.y += prim_offset;
-				pack_leaf_nodes[pack_leaf_nodes_offset] = data;
-				for(int j = 1; j < BVH_NODE_LEAF_SIZE; ++j) {
-					pack_leaf_nodes[pack_leaf_nodes_offset + j] = leaf_nodes_offset[i + j];
-				}
-				pack_leaf_nodes_offset += BVH_NODE_LEAF_SIZE;
-			}
+			bvh_copy_leaf_nodes(arrays.leaf_nodes + nodes_leaf_offset,
+			                    bvh->pack.leaf_nodes.data(),
+			                    bvh->pack.leaf_nodes.size(),
+			                    prim_offset);
 		}
 
 		if(bvh->pack.nodes.size()) {
-			int4 *bvh_nodes = &bvh->pack.nodes[0];
-			size_t bvh_nodes_size = bvh->pack.nodes.size();
-
-			for(size_t i = 0, j = 0; i < bvh_nodes_size; j++) {
-				size_t nsize, nsize_bbox;
-				if(bvh_nodes[i].x & PATH_RAY_NODE_UNALIGNED) {
-					nsize = use_qbvh
-					            ? BVH_UNALIGNED_QNODE_SIZE
-					            : BVH_UNALIGNED_NODE_SIZE;
-					nsize_bbox = (use_qbvh)? 13: 0;
-				}
-				else {
-					nsize = (use_qbvh)? BVH_QNODE_SIZE: BVH_NODE_SIZE;
-					nsize_bbox = (use_qbvh)? 7: 0;
-				}
+			bvh_copy_nodes(arrays.nodes + nodes_offset,
+			               bvh->pack.nodes.data(),
+			               bvh->pack.nodes.size(),
+			               bvh_layout,
+			               nodes_offset,
+			               nodes_leaf_offset);
+		}
+
+		nodes_offset += bvh->pack.nodes.size();
+		nodes_leaf_offset += bvh->pack.leaf_nodes.size();
+		prim_tri_verts_offset += bvh->pack.prim_tri_verts.size();
+		prim_offset += bvh_prim_index_size;
+	}
+}
 
-				memcpy(pack_nodes + pack_nodes_offset,
-				       bvh_nodes + i,
-				       nsize_bbox*sizeof(int4));
+/* Pack Instances */
 
-				/* Modify offsets into arrays */
-				int4 data = bvh_nodes[i + nsize_bbox];
+void BVH::pack_instances()
+{
+	/* The BVH's for instances are built separately, but for traversal all
+	 * BVH's are stored in global arrays. The merged instance BVH's come
+	 * first, so they can stay in place when only the top level BVH changes.
+	 * The top level BVH follows them, so its indexes and offsets are adjusted
+	 * here, in place. Writing it to the global arrays is up to the caller.
+	 */
+	assert(instances != NULL);
 
-				data.z += (data.z < 0)? -noffset_leaf: noffset;
-				data.w += (data.w < 0)? -noffset_leaf: noffset;
+	const size_t prim_offset = instances->num_prims;
+	const size_t prim_tri_verts_offset = instances->num_prim_tri_verts;
+	const int noffset = instances->num_nodes;
+	const int noffset_leaf = instances->num_leaf_nodes;
+	const size_t num_prims = pack.prim_index.size();
 
-				if(use_qbvh) {
-					data.x += (data.x < 0)? -noffset_leaf: noffset;
-					data.y += (data.y < 0)? -noffset_leaf: noffset;
-				}
+	/* Adjust primitive index to point to the triangle in the global array, for
+	 * meshes with transform applied and already in the top level BVH.
+	 */
+	for(size_t i = 0; i < num_prims; i++) {
+		if(pack.prim_index[i] != -1) {
+			if(pack.prim_type[i] & PRIMITIVE_ALL_CURVE)
+				pack.prim_index[i] += objects[pack.prim_object[i]]->mesh->curve_offset;
+			else
+				pack.prim_index[i] += objects[pack.prim_object[i]]->mesh->tri_offset;
+		}
+		if(pack.prim_tri_index[i] != (uint)-1) {
+			pack.prim_tri_index[i] += prim_tri_verts_offset;
+		}
+	}
 
-				pack_nodes[pack_nodes_offset + nsize_bbox] = data;
+	if(params.num_motion_curve_steps > 0 || params.num_motion_triangle_steps > 0) {
+		pack.prim_time.resize(num_prims);
+	}
 
-				/* Usually this copies nothing, but we better
-				 * be prepared for possible node size extension.
-				 */
-				memcpy(&pack_nodes[pack_nodes_offset + nsize_bbox+1],
-				       &bvh_nodes[i + nsize_bbox+1],
-				       sizeof(int4) * (nsize - (nsize_bbox+1)));
+	/* offset nodes */
+	if(pack.nodes.size()) {
+		bvh_copy_nodes(pack.nodes.data(),
+		               pack.nodes.data(),
+		               pack.nodes.size(),
+		               params.bvh_layout,
+		               noffset,
+		               noffset_leaf);
+	}
+	if(pack.leaf_nodes.size()) {
+		bvh_copy_leaf_nodes(pack.leaf_nodes.data(),
+		                    pack.leaf_nodes.data(),
+		                    pack.leaf_nodes.size(),
+		                    prim_offset);
+	}
 
-				pack_nodes_offset += nsize;
-				i += nsize;
-			}
-		}
+	/* root index to start traversal at, after the instance nodes */
+	pack.root_index = (pack.root_index == -1)? -noffset_leaf-1: noffset;
 
-		nodes_offset += bvh->pack.nodes.size();
-		nodes_leaf_offset += bvh->pack.leaf_nodes.size();
-		prim_offset += bvh->pack.prim_index.size();
+	/* fill in node indexes for instances */
+	pack.object_node.resize(objects.size());
+	for(size_t i = 0; i < objects.size(); i++) {
+		/* We assume that if mesh doesn't need own BVH it was already included
+		 * into a top-level BVH and no node is needed.
+		 */
+		const Mesh *mesh = objects[i]->mesh;
+		pack.object_node[i] = (mesh->need_build_bvh())? instances->node_offset(mesh): 0;
 	}
 }
 
@@ -20,6 +20,7 @@
 
 #include "bvh/bvh_params.h"
 
+#include "util/util_map.h"
 #include "util/util_types.h"
 #include "util/util_vector.h"
 
@@ -27,9 +28,11 @@ CCL_NAMESPACE_BEGIN
 
 class BVHNode;
 struct BVHStackEntry;
+class BVH;
 class BVHParams;
 class BoundBox;
 class LeafNode;
+class Mesh;
 class Object;
 class Progress;
 
@@ -73,6 +76,77 @@ struct PackedBVH {
 	}
 };
 
+/* Packed BVH Arrays
+ *
+ * Destination of the merged BVH data, the global arrays the kernel traverses.
+ * prim_time may be NULL when no motion steps are used. */
+
+struct PackedBVHArrays {
+	int4 *nodes;
+	int4 *leaf_nodes;
+	uint *prim_tri_index;
+	float4 *prim_tri_verts;
+	int *prim_type;
+	uint *prim_visibility;
+	int *prim_index;
+	int *prim_object;
+	float2 *prim_time;
+};
+
+/* BVH Instances
+ *
+ * BVH's of instanced meshes merged into global arrays, ahead of the top level
+ * BVH. Only the layout of the merged range is kept here, the data itself lives
+ * in the global arrays and stays in place between updates. When only objects
+ * change (transforms, visibility, adding or removing instances of the same
+ * meshes), just the top level BVH over the objects is rebuilt and written after
+ * the merged range. */
+
+class BVHInstances
+{
+public:
+	/* Size of the merged range at the front of each global array. */
+	size_t num_nodes;
+	size_t num_leaf_nodes;
+	size_t num_prims;
+	size_t num_prim_tri_verts;
+
+	BVHInstances();
+
+	/* Lay out the BVH's of instanced meshes used by the objects. Returns false
+	 * and keeps the previous layout when the same meshes were merged before and
+	 * none of their BVH's changed since, unless forced. The merged range then
+	 * has to be written again with pack(). */
+	bool update(const BVHParams& params, const vector<Object*>& objects, bool force);
+	void clear();
+
+	/* Write the merged BVH's to the front of the global arrays. */
+	void pack(const PackedBVHArrays& arrays) const;
+
+	/* Index of the root node of the mesh BVH, for object_node. */
+	int node_offset(const Mesh *mesh) const;
+
+protected:
+	struct MeshEntry {
+		const Mesh *mesh;
+		const BVH *bvh;
+		int tri_offset;
+		int curve_offset;
+
+		bool operator==(const MeshEntry& other) const
+		{
+			return mesh == other.mesh && bvh == other.bvh &&
+			       tri_offset == other.tri_offset &&
+			       curve_offset == other.curve_offset;
+		}
+	};
+
+	vector<MeshEntry> meshes;
+	map<const Mesh*, int> mesh_node;
+	BVHLayout bvh_layout;
+	bool use_motion_steps;
+};
+
 /* BVH */
 
 class BVH
@@ -81,6 +155,10 @@ public:
 	PackedBVH pack;
 	BVHParams params;
 	vector<Object*> objects;
+	/* Layout of the merged BVH's of instanced meshes, required for the top
+	 * level BVH. Its pack only holds the top level part, with indexes already
+	 * pointing past the merged range. */
+	BVHInstances *instances;
 
 	static BVH *create(const BVHParams& params, const vector<Object*>& objects);
 	virtual ~BVH() {}
@@ -98,8 +176,8 @@ protected:
 	void pack_primitives();
 	void pack_triangle(int idx, float4 storage[3]);
 
-	/* merge instance BVH's */
-	void pack_instances(size_t nodes_size, size_t leaf_nodes_size);
+	/* offset top level BVH to follow the merged instance BVH's */
+	void pack_instances();
 
 	/* for subclasses to implement */
 	virtual void pack_nodes(const BVHNode *root) = 0;
@@ -177,14 +177,8 @@ void BVH2::pack_nodes(const BVHNode *root)
 	/* Resize arrays */
 	pack.nodes.clear();
 	pack.leaf_nodes.clear();
-	/* For top level BVH, first merge existing BVH's so we know the offsets. */
-	if(params.top_level) {
-		pack_instances(node_size, num_leaf_nodes*BVH_NODE_LEAF_SIZE);
-	}
-	else {
-		pack.nodes.resize(node_size);
-		pack.leaf_nodes.resize(num_leaf_nodes*BVH_NODE_LEAF_SIZE);
-	}
+	pack.nodes.resize(node_size);
+	pack.leaf_nodes.resize(num_leaf_nodes*BVH_NODE_LEAF_SIZE);
 
 	int nextNodeIdx = 0, nextLeafNodeIdx = 0;
 
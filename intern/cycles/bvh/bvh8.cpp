@@ -0,0 +1,443 @@
+/*
+ * Copyright 2011-2018, Blender Foundation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "bvh/bvh8.h"
+
+#include "render/mesh.h"
+#include "render/object.h"
+
+#include "bvh/bvh_node.h"
+#include "bvh/bvh_unaligned.h"
+
+CCL_NAMESPACE_BEGIN
+
+BVH8::BVH8(const BVHParams& params_, const vector<Object*>& objects_)
+: BVH(params_, objects_)
+{
+	params.bvh_layout = BVH_LAYOUT_BVH8;
+}
+
+/* Collapse */
+
+/* Gather up to eight children for the wide node replacing the given binary
+ * node. Inner children are opened up greedily, largest surface area first,
+ * since those are the ones most likely to be hit by a ray.
+ */
+int BVH8::collect_children(const BVHNode *node,
+                           const BVHNode *children[8]) const
+{
+	int num_children = 0;
+	children[num_children++] = node->get_child(0);
+	children[num_children++] = node->get_child(1);
+
+	while(num_children < 8) {
+		int best_child = -1;
+		float best_area = -FLT_MAX;
+		for(int i = 0; i < num_children; i++) {
+			if(children[i]->is_leaf()) {
+				continue;
+			}
+			const float area = children[i]->bounds.safe_area();
+			if(area > best_area) {
+				best_area = area;
+				best_child = i;
+			}
+		}
+		if(best_child == -1) {
+			break;
+		}
+		const BVHNode *child = children[best_child];
+		children[best_child] = child->get_child(0);
+		children[num_children++] = child->get_child(1);
+	}
+
+	return num_children;
+}
+
+bool BVH8::node_is_unaligned(const BVHNode *node) const
+{
+	const BVHNode *children[8];
+	const int num_children = collect_children(node, children);
+	for(int i = 0; i < num_children; i++) {
+		if(children[i]->is_unaligned) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void BVH8::count_nodes(const BVHNode *node,
+                       size_t *num_inner_nodes,
+                       size_t *num_unaligned_nodes) const
+{
+	if(node->is_leaf()) {
+		return;
+	}
+	const BVHNode *children[8];
+	const int num_children = collect_children(node, children);
+	bool has_unaligned = false;
+	for(int i = 0; i < num_children; i++) {
+		has_unaligned |= children[i]->is_unaligned;
+		count_nodes(children[i], num_inner_nodes, num_unaligned_nodes);
+	}
+	(*num_inner_nodes)++;
+	if(has_unaligned) {
+		(*num_unaligned_nodes)++;
+	}
+}
+
+/* Pack */
+
+void BVH8::pack_leaf(const BVHStackEntry& e, const LeafNode *leaf)
+{
+	float4 data[BVH_ONODE_LEAF_SIZE];
+	memset(data, 0, sizeof(data));
+	if(leaf->num_triangles() == 1 && pack.prim_index[leaf->lo] == -1) {
+		/* object */
+		data[0].x = __int_as_float(~(leaf->lo));
+		data[0].y = __int_as_float(0);
+	}
+	else {
+		/* triangle */
+		data[0].x = __int_as_float(leaf->lo);
+		data[0].y = __int_as_float(leaf->hi);
+	}
+	data[0].z = __uint_as_float(leaf->visibility);
+	if(leaf->num_triangles() != 0) {
+		data[0].w = __uint_as_float(pack.prim_type[leaf->lo]);
+	}
+
+	memcpy(&pack.leaf_nodes[e.idx], data, sizeof(float4)*BVH_ONODE_LEAF_SIZE);
+}
+
+void BVH8::pack_inner(const BVHStackEntry& e,
+                      const BVHStackEntry *en,
+                      int num)
+{
+	bool has_unaligned = false;
+	if(params.use_unaligned_nodes) {
+		for(int i = 0; i < num; i++) {
+			if(en[i].node->is_unaligned) {
+				has_unaligned = true;
+				break;
+			}
+		}
+	}
+	if(has_unaligned) {
+		pack_unaligned_inner(e, en, num);
+	}
+	else {
+		pack_aligned_inner(e, en, num);
+	}
+}
+
+void BVH8::pack_aligned_inner(const BVHStackEntry& e,
+                              const BVHStackEntry *en,
+                              int num)
+{
+	BoundBox bounds[8];
+	int child[8];
+	for(int i = 0; i < num; ++i) {
+		bounds[i] = en[i].node->bounds;
+		child[i] = en[i].encodeIdx();
+	}
+	pack_aligned_node(e.idx,
+	                  bounds,
+	                  child,
+	                  e.node->visibility,
+	                  e.node->time_from,
+	                  e.node->time_to,
+	                  num);
+}
+
+void BVH8::pack_aligned_node(int idx,
+                             const BoundBox *bounds,
+                             const int *child,
+                             const uint visibility,
+                             const float time_from,
+                             const float time_to,
+                             const int num)
+{
+	float4 data[BVH_ONODE_SIZE];
+	memset(data, 0, sizeof(data));
+
+	data[0].x = __uint_as_float(visibility & ~PATH_RAY_NODE_UNALIGNED);
+	data[0].y = time_from;
+	data[0].z = time_to;
+
+	/* Each row holds one value of all eight children. */
+	float *rows = &data[2].x;
+
+	for(int i = 0; i < num; i++) {
+		float3 bb_min = bounds[i].min;
+		float3 bb_max = bounds[i].max;
+
+		rows[0*8 + i] = bb_min.x;
+		rows[1*8 + i] = bb_max.x;
+		rows[2*8 + i] = bb_min.y;
+		rows[3*8 + i] = bb_max.y;
+		rows[4*8 + i] = bb_min.z;
+		rows[5*8 + i] = bb_max.z;
+
+		rows[6*8 + i] = __int_as_float(child[i]);
+	}
+
+	for(int i = num; i < 8; i++) {
+		/* We store BB which would never be recorded as intersection
+		 * so kernel might safely assume there are always 8 child nodes.
+		 */
+		rows[0*8 + i] = FLT_MAX;
+		rows[1*8 + i] = -FLT_MAX;
+
+		rows[2*8 + i] = FLT_MAX;
+		rows[3*8 + i] = -FLT_MAX;
+
+		rows[4*8 + i] = FLT_MAX;
+		rows[5*8 + i] = -FLT_MAX;
+
+		rows[6*8 + i] = __int_as_float(0);
+	}
+
+	memcpy(&pack.nodes[idx], data, sizeof(float4)*BVH_ONODE_SIZE);
+}
+
+void BVH8::pack_unaligned_inner(const BVHStackEntry& e,
+                                const BVHStackEntry *en,
+                                int num)
+{
+	Transform aligned_space[8];
+	BoundBox bounds[8];
+	int child[8];
+	for(int i = 0; i < num; ++i) {
+		aligned_space[i] = en[i].node->get_aligned_space();
+		bounds[i] = en[i].node->bounds;
+		child[i] = en[i].encodeIdx();
+	}
+	pack_unaligned_node(e.idx,
+	                    aligned_space,
+	                    bounds,
+	                    child,
+	                    e.node->visibility,
+	                    e.node->time_from,
+	                    e.node->time_to,
+	                    num);
+}
+
+void BVH8::pack_unaligned_node(int idx,
+                               const Transform *aligned_space,
+                               const BoundBox *bounds,
+                               const int *child,
+                               const uint visibility,
+                               const float time_from,
+                               const float time_to,
+                               const int num)
+{
+	float4 data[BVH_UNALIGNED_ONODE_SIZE];
+	memset(data, 0, sizeof(data));
+
+	data[0].x = __uint_as_float(visibility | PATH_RAY_NODE_UNALIGNED);
+	data[0].y = time_from;
+	data[0].z = time_to;
+
+	float *rows = &data[2].x;
+
+	for(int i = 0; i < num; i++) {
+		Transform space = BVHUnaligned::compute_node_transform(
+		        bounds[i],
+		        aligned_space[i]);
+
+		rows[0*8 + i] = space.x.x;
+		rows[1*8 + i] = space.x.y;
+		rows[2*8 + i] = space.x.z;
+
+		rows[3*8 + i] = space.y.x;
+		rows[4*8 + i] = space.y.y;
+		rows[5*8 + i] = space.y.z;
+
+		rows[6*8 + i] = space.z.x;
+		rows[7*8 + i] = space.z.y;
+		rows[8*8 + i] = space.z.z;
+
+		rows[9*8 + i] = space.x.w;
+		rows[10*8 + i] = space.y.w;
+		rows[11*8 + i] = space.z.w;
+
+		rows[12*8 + i] = __int_as_float(child[i]);
+	}
+
+	for(int i = num; i < 8; i++) {
+		/* We store BB which would never be recorded as intersection
+		 * so kernel might safely assume there are always 8 child nodes.
+		 */
+		for(int row = 0; row < 12; row++) {
+			rows[row*8 + i] = NAN;
+		}
+
+		rows[12*8 + i] = __int_as_float(0);
+	}
+
+	memcpy(&pack.nodes[idx], data, sizeof(float4)*BVH_UNALIGNED_ONODE_SIZE);
+}
+
+/* Octo SIMD Nodes */
+
+void BVH8::pack_nodes(const BVHNode *root)
+{
+	/* Calculate size of the arrays required. */
+	size_t num_inner_nodes = 0, num_unaligned_nodes = 0;
+	count_nodes(root, &num_inner_nodes, &num_unaligned_nodes);
+	const size_t num_leaf_nodes = root->getSubtreeSize(BVH_STAT_LEAF_COUNT);
+	size_t node_size;
+	if(params.use_unaligned_nodes) {
+		node_size = (num_unaligned_nodes * BVH_UNALIGNED_ONODE_SIZE) +
+		            (num_inner_nodes - num_unaligned_nodes) * BVH_ONODE_SIZE;
+	}
+	else {
+		node_size = num_inner_nodes * BVH_ONODE_SIZE;
+	}
+	/* Resize arrays. */
+	pack.nodes.clear();
+	pack.leaf_nodes.clear();
+	pack.nodes.resize(node_size);
+	pack.leaf_nodes.resize(num_leaf_nodes*BVH_ONODE_LEAF_SIZE);
+
+	int nextNodeIdx = 0, nextLeafNodeIdx = 0;
+
+	vector<BVHStackEntry> stack;
+	stack.reserve(BVHParams::MAX_DEPTH*2);
+	if(root->is_leaf()) {
+		stack.push_back(BVHStackEntry(root, nextLeafNodeIdx++));
+	}
+	else {
+		stack.push_back(BVHStackEntry(root, nextNodeIdx));
+		nextNodeIdx += node_is_unaligned(root)
+		                       ? BVH_UNALIGNED_ONODE_SIZE
+		                       : BVH_ONODE_SIZE;
+	}
+
+	while(stack.size()) {
+		BVHStackEntry e = stack.back();
+		stack.pop_back();
+
+		if(e.node->is_leaf()) {
+			/* leaf node */
+			const LeafNode *leaf = reinterpret_cast<const LeafNode*>(e.node);
+			pack_leaf(e, leaf);
+		}
+		else {
+			/* Inner node. */
+			const BVHNode *nodes[8];
+			const int numnodes = collect_children(e.node, nodes);
+			/* Push entries on the stack. */
+			for(int i = 0; i < numnodes; ++i) {
+				int idx;
+				if(nodes[i]->is_leaf()) {
+					idx = nextLeafNodeIdx++;
+				}
+				else {
+					idx = nextNodeIdx;
+					nextNodeIdx += node_is_unaligned(nodes[i])
+					                       ? BVH_UNALIGNED_ONODE_SIZE
+					                       : BVH_ONODE_SIZE;
+				}
+				stack.push_back(BVHStackEntry(nodes[i], idx));
+			}
+			/* Set node. */
+			pack_inner(e, &stack[stack.size()-numnodes], numnodes);
+		}
+	}
+	assert(node_size == nextNodeIdx);
+	/* Root index to start traversal at, to handle case of single leaf node. */
+	pack.root_index = (root->is_leaf())? -1: 0;
+}
+
+void BVH8::refit_nodes()
+{
+	assert(!params.top_level);
+
+	BoundBox bbox = BoundBox::empty;
+	uint visibility = 0;
+	refit_node(0, (pack.root_index == -1)? true: false, bbox, visibility);
+}
+
+void BVH8::refit_node(int idx, bool leaf, BoundBox& bbox, uint& visibility)
+{
+	if(leaf) {
+		/* Refit leaf node. */
+		int4 *data = &pack.leaf_nodes[idx];
+		int4 c = data[0];
+
+		BVH::refit_primitives(c.x, c.y, bbox, visibility);
+
+		/* Same as in BVH4::refit_node(), this is a copy of pack_leaf(). */
+		float4 leaf_data[BVH_ONODE_LEAF_SIZE];
+		leaf_data[0].x = __int_as_float(c.x);
+		leaf_data[0].y = __int_as_float(c.y);
+		leaf_data[0].z = __uint_as_float(visibility);
+		leaf_data[0].w = __uint_as_float(c.w);
+		memcpy(&pack.leaf_nodes[idx], leaf_data, sizeof(float4)*BVH_ONODE_LEAF_SIZE);
+	}
+	else {
+		int4 *data = &pack.nodes[idx];
+		bool is_unaligned = (data[0].x & PATH_RAY_NODE_UNALIGNED) != 0;
+		int child[8];
+		memcpy(child,
+		       &data[is_unaligned ? BVH_UNALIGNED_ONODE_CHILD_OFFSET
+		                          : BVH_ONODE_CHILD_OFFSET],
+		       sizeof(child));
+		/* Refit inner node, set bbox from children. */
+		BoundBox child_bbox[8];
+		uint child_visibility[8] = {0};
+		int num_nodes = 0;
+
+		for(int i = 0; i < 8; ++i) {
+			child_bbox[i] = BoundBox::empty;
+			if(child[i] != 0) {
+				refit_node((child[i] < 0)? -child[i]-1: child[i], (child[i] < 0),
+				           child_bbox[i], child_visibility[i]);
+				++num_nodes;
+				bbox.grow(child_bbox[i]);
+				visibility |= child_visibility[i];
+			}
+		}
+
+		if(is_unaligned) {
+			Transform aligned_space[8];
+			for(int i = 0; i < 8; ++i) {
+				aligned_space[i] = transform_identity();
+			}
+			pack_unaligned_node(idx,
+			                    aligned_space,
+			                    child_bbox,
+			                    child,
+			                    visibility,
+			                    0.0f,
+			                    1.0f,
+			                    8);
+		}
+		else {
+			pack_aligned_node(idx,
+			                  child_bbox,
+			                  child,
+			                  visibility,
+			                  0.0f,
+			                  1.0f,
+			                  8);
+		}
+	}
+}
+
+CCL_NAMESPACE_END
@@ -34,6 +34,7 @@
 #include "kernel/kernel_types.h"
 #include "kernel/split/kernel_split_data.h"
 #include "kernel/kernel_globals.h"
+#include "kernel/kernel_adaptive_sampling.h"
 
 #include "kernel/filter/filter.h"
 
@@ -184,14 +185,14 @@ public:
 	KernelFunctions<void(*)(int, int, float*, float*, float*, float*, int*, int)>                               filter_detect_outliers_kernel;
 	KernelFunctions<void(*)(int, int, float*, float*, float*, float*, int*, int)>                               filter_combine_halves_kernel;
 
-	KernelFunctions<void(*)(int, int, float*, float*, float*, int*, int, int, float, float)> filter_nlm_calc_difference_kernel;
+	KernelFunctions<void(*)(int, int, float*, float*, float*, int*, int, int, int, float, float)> filter_nlm_calc_difference_kernel;
 	KernelFunctions<void(*)(float*, float*, int*, int, int)>                                 filter_nlm_blur_kernel;
 	KernelFunctions<void(*)(float*, float*, int*, int, int)>                                 filter_nlm_calc_weight_kernel;
 	KernelFunctions<void(*)(int, int, float*, float*, float*, float*, int*, int, int)>       filter_nlm_update_output_kernel;
 	KernelFunctions<void(*)(float*, float*, int*, int)>                                      filter_nlm_normalize_kernel;
 
 	KernelFunctions<void(*)(float*, int, int, int, float*, int*, int*, int, int, float)>                         filter_construct_transform_kernel;
-	KernelFunctions<void(*)(int, int, float*, float*, float*, int*, float*, float3*, int*, int*, int, int, int)> filter_nlm_construct_gramian_kernel;
+	KernelFunctions<void(*)(int, int, float*, float*, float*, int*, float*, float3*, int*, int*, int, int, int, int)> filter_nlm_construct_gramian_kernel;
 	KernelFunctions<void(*)(int, int, int, float*, int*, float*, float3*, int*, int)>                            filter_finalize_kernel;
 
 	KernelFunctions<void(*)(KernelGlobals *, ccl_constant KernelData*, ccl_global void*, int, ccl_global char*,
@@ -411,6 +412,8 @@ public:
 			info.width = mem.data_width;
 			info.height = mem.data_height;
 			info.depth = mem.data_depth;
+			info.cache = (uint64_t)mem.cached_texture;
+			info.sparse_offsets = (uint64_t)mem.sparse_offsets;
 
 			need_texture_info = true;
 		}
@@ -500,7 +503,7 @@ public:
 			                                    (float*) variance_ptr,
 			                                    difference,
 			                                    local_rect,
-			                                    w, 0,
+			                                    w, 0, 0,
 			                                    a, k_2);
 
 			filter_nlm_blur_kernel()       (difference, blurDifference, local_rect, w, f);
@@ -552,38 +555,46 @@ public:
 		float *difference     = (float*) task->reconstruction_state.temporary_1_ptr;
 		float *blurDifference = (float*) task->reconstruction_state.temporary_2_ptr;
 
+		/* With temporal denoising, the prefiltered neighbor frames are stored
+		 * after the center frame in the denoising buffer and contribute to
+		 * the same regression. */
 		int r = task->radius;
-		for(int i = 0; i < (2*r+1)*(2*r+1); i++) {
-			int dy = i / (2*r+1) - r;
-			int dx = i % (2*r+1) - r;
-
-			int local_rect[4] = {max(0, -dx), max(0, -dy),
-			                     task->reconstruction_state.source_w - max(0, dx),
-			                     task->reconstruction_state.source_h - max(0, dy)};
-			filter_nlm_calc_difference_kernel()(dx, dy,
-			                                    (float*) color_ptr,
-			                                    (float*) color_variance_ptr,
-			                                    difference,
-			                                    local_rect,
-			                                    task->buffer.stride,
-			                                    task->buffer.pass_stride,
-			                                    1.0f,
-			                                    task->nlm_k_2);
-			filter_nlm_blur_kernel()(difference, blurDifference, local_rect, task->buffer.stride, 4);
-			filter_nlm_calc_weight_kernel()(blurDifference, difference, local_rect, task->buffer.stride, 4);
-			filter_nlm_blur_kernel()(difference, blurDifference, local_rect, task->buffer.stride, 4);
-			filter_nlm_construct_gramian_kernel()(dx, dy,
-			                                      blurDifference,
-			                                      (float*)  task->buffer.mem.device_pointer,
-			                                      (float*)  task->storage.transform.device_pointer,
-			                                      (int*)    task->storage.rank.device_pointer,
-			                                      (float*)  task->storage.XtWX.device_pointer,
-			                                      (float3*) task->storage.XtWY.device_pointer,
-			                                      local_rect,
-			                                      &task->reconstruction_state.filter_window.x,
-			                                      task->buffer.stride,
-			                                      4,
-			                                      task->buffer.pass_stride);
+		for(int frame = 0; frame < task->num_frames; frame++) {
+			int frame_offset = frame*task->buffer.frame_stride;
+			for(int i = 0; i < (2*r+1)*(2*r+1); i++) {
+				int dy = i / (2*r+1) - r;
+				int dx = i % (2*r+1) - r;
+
+				int local_rect[4] = {max(0, -dx), max(0, -dy),
+				                     task->reconstruction_state.source_w - max(0, dx),
+				                     task->reconstruction_state.source_h - max(0, dy)};
+				filter_nlm_calc_difference_kernel()(dx, dy,
+				                                    (float*) color_ptr,
+				                                    (float*) color_variance_ptr,
+				                                    difference,
+				                                    local_rect,
+				                                    task->buffer.stride,
+				                                    task->buffer.pass_stride,
+				                                    frame_offset,
+				                                    1.0f,
+				                                    task->nlm_k_2);
+				filter_nlm_blur_kernel()(difference, blurDifference, local_rect, task->buffer.stride, 4);
+				filter_nlm_calc_weight_kernel()(blurDifference, difference, local_rect, task->buffer.stride, 4);
+				filter_nlm_blur_kernel()(difference, blurDifference, local_rect, task->buffer.stride, 4);
+				filter_nlm_construct_gramian_kernel()(dx, dy,
+				                                      blurDifference,
+				                                      (float*)  task->buffer.mem.device_pointer,
+				                                      (float*)  task->storage.transform.device_pointer,
+				                                      (int*)    task->storage.rank.device_pointer,
+				                                      (float*)  task->storage.XtWX.device_pointer,
+				                                      (float3*) task->storage.XtWY.device_pointer,
+				                                      local_rect,
+				                                      &task->reconstruction_state.filter_window.x,
+				                                      task->buffer.stride,
+				                                      4,
+				                                      task->buffer.pass_stride,
+				                                      frame_offset);
+			}
 		}
 		for(int y = 0; y < task->filter_area.w; y++) {
 			for(int x = 0; x < task->filter_area.z; x++) {
@@ -684,6 +695,56 @@ public:
 		return true;
 	}
 
+	bool adaptive_sampling_need_check(KernelGlobals *kg, int sample)
+	{
+		if(!kernel_data.film.pass_adaptive_aux_buffer) {
+			return false;
+		}
+
+		int num_samples = sample + 1;
+		return (num_samples >= kernel_data.integrator.adaptive_min_samples &&
+		        (num_samples % kernel_data.integrator.adaptive_step) == 0);
+	}
+
+	/* Flags converged pixels of the tile, returns true if all of them are. */
+	bool adaptive_sampling_check(KernelGlobals *kg, RenderTile &tile)
+	{
+		float *render_buffer = (float*)tile.buffer;
+		int pass_stride = kernel_data.film.pass_stride;
+
+		for(int y = tile.y; y < tile.y + tile.h; y++) {
+			for(int x = tile.x; x < tile.x + tile.w; x++) {
+				int index = tile.offset + x + y*tile.stride;
+				kernel_adaptive_stopping(kg, render_buffer + index*pass_stride);
+			}
+		}
+
+		bool any = false;
+		for(int y = tile.y; y < tile.y + tile.h; y++) {
+			any |= kernel_adaptive_filter_x(kg, render_buffer, y, tile.x, tile.w,
+			                                tile.offset, tile.stride);
+		}
+		for(int x = tile.x; x < tile.x + tile.w; x++) {
+			any |= kernel_adaptive_filter_y(kg, render_buffer, x, tile.y, tile.h,
+			                                tile.offset, tile.stride);
+		}
+
+		return !any;
+	}
+
+	void adaptive_sampling_add_samples(KernelGlobals *kg, RenderTile &tile, int num_samples)
+	{
+		float *render_buffer = (float*)tile.buffer;
+		int pass_stride = kernel_data.film.pass_stride;
+
+		for(int y = tile.y; y < tile.y + tile.h; y++) {
+			for(int x = tile.x; x < tile.x + tile.w; x++) {
+				int index = tile.offset + x + y*tile.stride;
+				kernel_adaptive_add_samples(kg, render_buffer + index*pass_stride, num_samples);
+			}
+		}
+	}
+
 	void path_trace(DeviceTask &task, RenderTile &tile, KernelGlobals *kg)
 	{
 		scoped_timer timer(&tile.buffers->render_time);
@@ -707,6 +768,19 @@ public:
 
 			tile.sample = sample + 1;
 
+			if(adaptive_sampling_need_check(kg, sample) && adaptive_sampling_check(kg, tile)) {
+				/* All pixels converged, account for the remaining samples
+				 * without rendering them. */
+				int num_remaining = end_sample - tile.sample;
+				if(num_remaining > 0) {
+					adaptive_sampling_add_samples(kg, tile, num_remaining);
+				}
+
+				tile.sample = end_sample;
+				task.update_progress(&tile, tile.w*tile.h*(num_remaining + 1));
+				break;
+			}
+
 			task.update_progress(&tile, tile.w*tile.h);
 		}
 	}
@@ -790,6 +864,8 @@ public:
 			}
 		}
 
+		stats.kernel_add(kg->stats);
+
 		thread_kernel_globals_free((KernelGlobals*)kgbuffer.device_pointer);
 		kg->~KernelGlobals();
 		kgbuffer.free();
@@ -891,6 +967,7 @@ protected:
 			kg.decoupled_volume_steps[i] = NULL;
 		}
 		kg.decoupled_volume_steps_index = 0;
+		kg.stats.reset();
 #ifdef WITH_OSL
 		OSLShader::thread_init(&kg, &kernel_globals, &osl_globals);
 #endif
@@ -1050,6 +1127,12 @@ void device_cpu_info(vector<DeviceInfo>& devices)
 	if (system_cpu_support_sse2()) {
 		info.bvh_layout_mask |= BVH_LAYOUT_BVH4;
 	}
+#ifdef WITH_CYCLES_OPTIMIZED_KERNEL_AVX2
+	/* Wide nodes are only traversed by the AVX2 kernel. */
+	if(DebugFlags().cpu.has_avx2() && system_cpu_support_avx2()) {
+		info.bvh_layout_mask |= BVH_LAYOUT_BVH8;
+	}
+#endif
 	info.has_volume_decoupled = true;
 	info.has_osl = true;
 	info.has_half_images = true;
@@ -1222,6 +1222,8 @@ public:
 		info.width = mem.data_width;
 		info.height = mem.data_height;
 		info.depth = mem.data_depth;
+		info.cache = 0;
+		info.sparse_offsets = 0;
 		need_texture_info = true;
 	}
 
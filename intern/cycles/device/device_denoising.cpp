@@ -55,6 +55,9 @@ void DenoisingTask::init_from_devicetask(const DeviceTask &task)
 	render_buffer.pass_stride = task.pass_stride;
 	render_buffer.denoising_data_offset  = task.pass_denoising_data;
 	render_buffer.denoising_clean_offset = task.pass_denoising_clean;
+	render_buffer.frame_stride = task.denoising_frame_stride;
+
+	num_frames = max(task.denoising_frames, 1);
 
 	/* Expand filter_area by radius pixels and clamp the result to the extent of the neighboring tiles */
 	rect = rect_from_shape(filter_area.x, filter_area.y, filter_area.z, filter_area.w);
@@ -66,9 +69,8 @@ void DenoisingTask::tiles_from_rendertiles(RenderTile *rtiles)
 {
 	tiles = (TilesInfo*) tiles_mem.alloc(sizeof(TilesInfo)/sizeof(int));
 
-	device_ptr buffers[9];
 	for(int i = 0; i < 9; i++) {
-		buffers[i] = rtiles[i].buffer;
+		tile_buffers[i] = rtiles[i].buffer;
 		tiles->offsets[i] = rtiles[i].offset;
 		tiles->strides[i] = rtiles[i].stride;
 	}
@@ -85,32 +87,37 @@ void DenoisingTask::tiles_from_rendertiles(RenderTile *rtiles)
 	render_buffer.stride = rtiles[4].stride;
 	render_buffer.ptr    = rtiles[4].buffer;
 
-	functions.set_tiles(buffers);
+	functions.set_tiles(tile_buffers);
 }
 
-bool DenoisingTask::run_denoising()
+/* Prefilter the features and color of one frame into its section of the
+ * denoising buffer. */
+void DenoisingTask::prefilter_frame(int frame)
 {
-	/* Allocate denoising buffer. */
-	buffer.passes = 14;
-	buffer.width = rect.z - rect.x;
-	buffer.stride = align_up(buffer.width, 4);
-	buffer.h = rect.w - rect.y;
-	buffer.pass_stride = align_up(buffer.stride * buffer.h, divide_up(device->mem_sub_ptr_alignment(), sizeof(float)));
-	buffer.mem.alloc_to_device(buffer.pass_stride * buffer.passes, false);
+	int frame_offset = frame*buffer.frame_stride;
+
+	if(num_frames > 1) {
+		/* Point the tiles to the render buffers of this frame. */
+		device_ptr buffers[9];
+		for(int i = 0; i < 9; i++) {
+			buffers[i] = tile_buffers[i]? tile_buffers[i] + frame*render_buffer.frame_stride*sizeof(float): (device_ptr) 0;
+		}
+		functions.set_tiles(buffers);
+	}
 
 	device_ptr null_ptr = (device_ptr) 0;
 
 	/* Prefilter shadow feature. */
 	{
-		device_sub_ptr unfiltered_a   (buffer.mem, 0,                    buffer.pass_stride);
-		device_sub_ptr unfiltered_b   (buffer.mem, 1*buffer.pass_stride, buffer.pass_stride);
-		device_sub_ptr sample_var     (buffer.mem, 2*buffer.pass_stride, buffer.pass_stride);
-		device_sub_ptr sample_var_var (buffer.mem, 3*buffer.pass_stride, buffer.pass_stride);
-		device_sub_ptr buffer_var     (buffer.mem, 5*buffer.pass_stride, buffer.pass_stride);
-		device_sub_ptr filtered_var   (buffer.mem, 6*buffer.pass_stride, buffer.pass_stride);
-		device_sub_ptr nlm_temporary_1(buffer.mem, 7*buffer.pass_stride, buffer.pass_stride);
-		device_sub_ptr nlm_temporary_2(buffer.mem, 8*buffer.pass_stride, buffer.pass_stride);
-		device_sub_ptr nlm_temporary_3(buffer.mem, 9*buffer.pass_stride, buffer.pass_stride);
+		device_sub_ptr unfiltered_a   (buffer.mem, frame_offset,                        buffer.pass_stride);
+		device_sub_ptr unfiltered_b   (buffer.mem, frame_offset + 1*buffer.pass_stride, buffer.pass_stride);
+		device_sub_ptr sample_var     (buffer.mem, frame_offset + 2*buffer.pass_stride, buffer.pass_stride);
+		device_sub_ptr sample_var_var (buffer.mem, frame_offset + 3*buffer.pass_stride, buffer.pass_stride);
+		device_sub_ptr buffer_var     (buffer.mem, frame_offset + 5*buffer.pass_stride, buffer.pass_stride);
+		device_sub_ptr filtered_var   (buffer.mem, frame_offset + 6*buffer.pass_stride, buffer.pass_stride);
+		device_sub_ptr nlm_temporary_1(buffer.mem, frame_offset + 7*buffer.pass_stride, buffer.pass_stride);
+		device_sub_ptr nlm_temporary_2(buffer.mem, frame_offset + 8*buffer.pass_stride, buffer.pass_stride);
+		device_sub_ptr nlm_temporary_3(buffer.mem, frame_offset + 9*buffer.pass_stride, buffer.pass_stride);
 
 		nlm_state.temporary_1_ptr = *nlm_temporary_1;
 		nlm_state.temporary_2_ptr = *nlm_temporary_2;
@@ -143,17 +150,17 @@ bool DenoisingTask::run_denoising()
 		functions.non_local_means(filtered_b, filtered_a, residual_var, final_b);
 
 		/* Combine the two double-filtered halves to a final shadow feature. */
-		device_sub_ptr shadow_pass(buffer.mem, 4*buffer.pass_stride, buffer.pass_stride);
+		device_sub_ptr shadow_pass(buffer.mem, frame_offset + 4*buffer.pass_stride, buffer.pass_stride);
 		functions.combine_halves(final_a, final_b, *shadow_pass, null_ptr, 0, rect);
 	}
 
 	/* Prefilter general features. */
 	{
-		device_sub_ptr unfiltered     (buffer.mem,  8*buffer.pass_stride, buffer.pass_stride);
-		device_sub_ptr variance       (buffer.mem,  9*buffer.pass_stride, buffer.pass_stride);
-		device_sub_ptr nlm_temporary_1(buffer.mem, 10*buffer.pass_stride, buffer.pass_stride);
-		device_sub_ptr nlm_temporary_2(buffer.mem, 11*buffer.pass_stride, buffer.pass_stride);
-		device_sub_ptr nlm_temporary_3(buffer.mem, 12*buffer.pass_stride, buffer.pass_stride);
+		device_sub_ptr unfiltered     (buffer.mem, frame_offset +  8*buffer.pass_stride, buffer.pass_stride);
+		device_sub_ptr variance       (buffer.mem, frame_offset +  9*buffer.pass_stride, buffer.pass_stride);
+		device_sub_ptr nlm_temporary_1(buffer.mem, frame_offset + 10*buffer.pass_stride, buffer.pass_stride);
+		device_sub_ptr nlm_temporary_2(buffer.mem, frame_offset + 11*buffer.pass_stride, buffer.pass_stride);
+		device_sub_ptr nlm_temporary_3(buffer.mem, frame_offset + 12*buffer.pass_stride, buffer.pass_stride);
 
 		nlm_state.temporary_1_ptr = *nlm_temporary_1;
 		nlm_state.temporary_2_ptr = *nlm_temporary_2;
@@ -163,7 +170,7 @@ bool DenoisingTask::run_denoising()
 		int variance_from[] = { 3, 4, 5, 13, 9, 10, 11};
 		int pass_to[]       = { 1, 2, 3, 0,  5,  6,  7};
 		for(int pass = 0; pass < 7; pass++) {
-			device_sub_ptr feature_pass(buffer.mem, pass_to[pass]*buffer.pass_stride, buffer.pass_stride);
+			device_sub_ptr feature_pass(buffer.mem, frame_offset + pass_to[pass]*buffer.pass_stride, buffer.pass_stride);
 			/* Get the unfiltered pass and its variance from the RenderBuffers. */
 			functions.get_feature(mean_from[pass], variance_from[pass], *unfiltered, *variance);
 			/* Smooth the pass and store the result in the denoising buffers. */
@@ -184,17 +191,34 @@ bool DenoisingTask::run_denoising()
 
 		for(int pass = 0; pass < num_color_passes; pass++) {
 			device_sub_ptr color_pass(storage.temporary_color, pass*buffer.pass_stride, buffer.pass_stride);
-			device_sub_ptr color_var_pass(buffer.mem, variance_to[pass]*buffer.pass_stride, buffer.pass_stride);
+			device_sub_ptr color_var_pass(buffer.mem, frame_offset + variance_to[pass]*buffer.pass_stride, buffer.pass_stride);
 			functions.get_feature(mean_from[pass], variance_from[pass], *color_pass, *color_var_pass);
 		}
 
 		{
-			device_sub_ptr depth_pass    (buffer.mem,                                 0,   buffer.pass_stride);
-			device_sub_ptr color_var_pass(buffer.mem, variance_to[0]*buffer.pass_stride, 3*buffer.pass_stride);
-			device_sub_ptr output_pass   (buffer.mem,     mean_to[0]*buffer.pass_stride, 3*buffer.pass_stride);
+			device_sub_ptr depth_pass    (buffer.mem, frame_offset,                                      buffer.pass_stride);
+			device_sub_ptr color_var_pass(buffer.mem, frame_offset + variance_to[0]*buffer.pass_stride, 3*buffer.pass_stride);
+			device_sub_ptr output_pass   (buffer.mem, frame_offset +     mean_to[0]*buffer.pass_stride, 3*buffer.pass_stride);
 			functions.detect_outliers(storage.temporary_color.device_pointer, *color_var_pass, *depth_pass, *output_pass);
 		}
 	}
+}
+
+bool DenoisingTask::run_denoising()
+{
+	/* Allocate denoising buffer. */
+	buffer.passes = 14;
+	buffer.width = rect.z - rect.x;
+	buffer.stride = align_up(buffer.width, 4);
+	buffer.h = rect.w - rect.y;
+	buffer.pass_stride = align_up(buffer.stride * buffer.h, divide_up(device->mem_sub_ptr_alignment(), sizeof(float)));
+	buffer.frame_stride = buffer.pass_stride * buffer.passes;
+	buffer.mem.alloc_to_device(buffer.frame_stride * num_frames, false);
+
+	/* The first frame goes last, so the tiles point to its buffers afterwards. */
+	for(int frame = num_frames-1; frame >= 0; frame--) {
+		prefilter_frame(frame);
+	}
 
 	storage.w = filter_area.z;
 	storage.h = filter_area.w;
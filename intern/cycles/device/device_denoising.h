@@ -41,8 +41,15 @@ public:
 		int stride;
 		device_ptr ptr;
 		int samples;
+		/* Distance in floats between the buffers of consecutive frames. */
+		int frame_stride;
 	} render_buffer;
 
+	/* Number of frames used for temporal denoising. The render buffers of the
+	 * neighbor frames follow the ones of the frame being denoised, which is
+	 * only supported by the CPU device. */
+	int num_frames;
+
 	TilesInfo *tiles;
 	device_vector<int> tiles_mem;
 	void tiles_from_rendertiles(RenderTile *rtiles);
@@ -151,6 +158,8 @@ public:
 		int stride;
 		int h;
 		int width;
+		/* Distance in floats between the prefiltered passes of consecutive frames. */
+		int frame_stride;
 		device_only_memory<float> mem;
 
 		DenoiseBuffers(Device *device)
@@ -160,6 +169,11 @@ public:
 
 protected:
 	Device *device;
+
+	/* Render buffers of the neighboring tiles, for the first frame. */
+	device_ptr tile_buffers[9];
+
+	void prefilter_frame(int frame);
 };
 
 CCL_NAMESPACE_END
@@ -191,6 +191,11 @@ public:
 	const char *name;
 	InterpolationType interpolation;
 	ExtensionType extension;
+	/* Texels are looked up through the texture cache, CPU only. */
+	CachedTexture *cached_texture;
+	/* Brick offsets of a sparse 3D texture, CPU only. The data then holds
+	 * the bricks, with width, height and depth the size of the full grid. */
+	const int *sparse_offsets;
 
 	/* Pointers. */
 	Device *device;
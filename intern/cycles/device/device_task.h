@@ -75,6 +75,10 @@ public:
 	int pass_stride;
 	int pass_denoising_data;
 	int pass_denoising_clean;
+	/* Temporal denoising, the render buffers of the neighbor frames are
+	 * stored after the ones of the denoised frame. */
+	int denoising_frames;
+	int denoising_frame_stride;
 
 	bool need_finish_queue;
 	bool integrator_branched;
@@ -185,6 +185,7 @@ ccl_device_inline void kernel_filter_nlm_construct_gramian(int x, int y,
 	                                dx, dy,
 	                                stride,
 	                                pass_stride,
+	                                0,
 	                                buffer,
 	                                transform, rank,
 	                                weight, XtWX, XtWY,
@@ -0,0 +1,180 @@
+/*
+ * Copyright 2011-2018 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __KERNEL_ADAPTIVE_SAMPLING_H__
+#define __KERNEL_ADAPTIVE_SAMPLING_H__
+
+CCL_NAMESPACE_BEGIN
+
+/* Adaptive Sampling
+ *
+ * Odd samples are accumulated a second time into an auxiliary buffer, so
+ * each pixel has two independent estimates: the full one and one from half
+ * of the samples. Their difference is used as per pixel error estimate.
+ * Pixels which converged are flagged in the w component of the auxiliary
+ * buffer and not traced anymore. Instead their passes are rescaled, so the
+ * buffer always looks as if every pixel received the same number of
+ * samples and no changes are needed where buffers are read. */
+
+ccl_device_inline ccl_global float4 *kernel_adaptive_aux(KernelGlobals *kg,
+                                                         ccl_global float *buffer,
+                                                         int x, int y,
+                                                         int offset, int stride)
+{
+	int index = offset + x + y*stride;
+	return (ccl_global float4*)(buffer + index*kernel_data.film.pass_stride +
+	                            kernel_data.film.pass_adaptive_aux_buffer);
+}
+
+/* Account for samples which were not taken, by scaling all accumulated
+ * passes of the pixel to the new number of samples. */
+ccl_device void kernel_adaptive_add_samples(KernelGlobals *kg,
+                                            ccl_global float *buffer,
+                                            int num_samples)
+{
+	ccl_global float *sample_count = buffer + kernel_data.film.pass_sample_count;
+
+	if(*sample_count > 0.0f) {
+		const float scale = (*sample_count + num_samples) / *sample_count;
+		const int flag = kernel_data.film.pass_flag;
+		const int converged = kernel_data.film.pass_adaptive_aux_buffer + 3;
+
+		for(int i = 0; i < kernel_data.film.pass_stride; i++) {
+			if(i == kernel_data.film.pass_sample_count || i == converged) {
+				continue;
+			}
+			/* Passes written by the first sample only are not averaged. */
+			if(((flag & PASSMASK(DEPTH)) && i == kernel_data.film.pass_depth) ||
+			   ((flag & PASSMASK(OBJECT_ID)) && i == kernel_data.film.pass_object_id) ||
+			   ((flag & PASSMASK(MATERIAL_ID)) && i == kernel_data.film.pass_material_id))
+			{
+				continue;
+			}
+
+			buffer[i] *= scale;
+		}
+	}
+
+	*sample_count += num_samples;
+}
+
+/* Called before every sample of a pixel, returns false if the pixel has
+ * converged and the sample is to be skipped. */
+ccl_device_inline bool kernel_adaptive_need_sample(KernelGlobals *kg,
+                                                   ccl_global float *buffer)
+{
+	if(!kernel_data.film.pass_adaptive_aux_buffer) {
+		return true;
+	}
+
+	ccl_global float4 *aux = (ccl_global float4*)(buffer + kernel_data.film.pass_adaptive_aux_buffer);
+
+	if((*aux).w == 0.0f) {
+		buffer[kernel_data.film.pass_sample_count] += 1.0f;
+		return true;
+	}
+
+	kernel_adaptive_add_samples(kg, buffer, 1);
+	return false;
+}
+
+/* Per pixel convergence test, after "A Hierarchical Automatic Stopping
+ * Condition for Monte Carlo Global Illumination" by Dammertz et al. The
+ * error is relative to the square root of the intensity, to account for
+ * the response of the eye. */
+ccl_device void kernel_adaptive_stopping(KernelGlobals *kg, ccl_global float *buffer)
+{
+	ccl_global float4 *aux = (ccl_global float4*)(buffer + kernel_data.film.pass_adaptive_aux_buffer);
+	const float sample_count = buffer[kernel_data.film.pass_sample_count];
+
+	if(sample_count == 0.0f) {
+		(*aux).w = 0.0f;
+		return;
+	}
+
+	const float inv_sample_count = 1.0f / sample_count;
+	const float4 I = *((ccl_global float4*)buffer) * inv_sample_count;
+	const float4 A = *aux * inv_sample_count;
+
+	const float error = (fabsf(I.x - A.x) + fabsf(I.y - A.y) + fabsf(I.z - A.z)) /
+	                    sqrtf(max(I.x + I.y + I.z, 1e-4f));
+
+	(*aux).w = (error < kernel_data.integrator.adaptive_threshold)? 1.0f: 0.0f;
+}
+
+/* Grow the region of pixels which did not converge yet by one pixel along a
+ * row of the tile, so noise is not cut off at sharp borders. Returns true
+ * if any pixel of the row did not converge. */
+ccl_device bool kernel_adaptive_filter_x(KernelGlobals *kg,
+                                         ccl_global float *buffer,
+                                         int y, int x, int w,
+                                         int offset, int stride)
+{
+	bool any = false;
+	bool prev = false;
+
+	for(int i = x; i < x + w; i++) {
+		ccl_global float4 *aux = kernel_adaptive_aux(kg, buffer, i, y, offset, stride);
+		const bool active = ((*aux).w == 0.0f);
+
+		if(active) {
+			any = true;
+			if(i > x && !prev) {
+				(*kernel_adaptive_aux(kg, buffer, i - 1, y, offset, stride)).w = 0.0f;
+			}
+		}
+		else if(prev) {
+			(*aux).w = 0.0f;
+		}
+
+		prev = active;
+	}
+
+	return any;
+}
+
+/* Same as above, along a column of the tile. */
+ccl_device bool kernel_adaptive_filter_y(KernelGlobals *kg,
+                                         ccl_global float *buffer,
+                                         int x, int y, int h,
+                                         int offset, int stride)
+{
+	bool any = false;
+	bool prev = false;
+
+	for(int i = y; i < y + h; i++) {
+		ccl_global float4 *aux = kernel_adaptive_aux(kg, buffer, x, i, offset, stride);
+		const bool active = ((*aux).w == 0.0f);
+
+		if(active) {
+			any = true;
+			if(i > y && !prev) {
+				(*kernel_adaptive_aux(kg, buffer, x, i - 1, offset, stride)).w = 0.0f;
+			}
+		}
+		else if(prev) {
+			(*aux).w = 0.0f;
+		}
+
+		prev = active;
+	}
+
+	return any;
+}
+
+CCL_NAMESPACE_END
+
+#endif  /* __KERNEL_ADAPTIVE_SAMPLING_H__ */
@@ -212,6 +212,11 @@ ccl_device_noinline float3 indirect_primitive_emission(KernelGlobals *kg, Shader
 		/* multiple importance sampling, get triangle light pdf,
 		 * and compute weight with respect to BSDF pdf */
 		float pdf = triangle_light_pdf(kg, sd, t);
+#ifdef __LIGHT_TREE__
+		if(kernel_data.integrator.use_light_tree) {
+			pdf *= light_tree_triangle_pdf_scale(kg, sd->P + sd->I*t, sd->object, sd->prim);
+		}
+#endif
 		float mis_weight = power_heuristic(bsdf_pdf, pdf);
 
 		return L*mis_weight;
@@ -271,6 +276,11 @@ ccl_device_noinline bool indirect_lamp_emission(KernelGlobals *kg,
 #endif
 
 		if(!(state->flag & PATH_RAY_MIS_SKIP)) {
+#ifdef __LIGHT_TREE__
+			if(kernel_data.integrator.use_light_tree && ls.type != LIGHT_DISTANT) {
+				ls.pdf *= light_tree_lamp_pdf_scale(kg, ray->P, lamp);
+			}
+#endif
 			/* multiple importance sampling, get regular light pdf,
 			 * and compute weight with respect to BSDF pdf */
 			float mis_weight = power_heuristic(state->ray_pdf, ls.pdf);
@@ -20,6 +20,7 @@
 #define __KERNEL_GLOBALS_H__
 
 #ifdef __KERNEL_CPU__
+#  include "util/util_stats.h"
 #  include "util/util_vector.h"
 #endif
 
@@ -68,6 +69,9 @@ typedef struct KernelGlobals {
 	VolumeStep *decoupled_volume_steps[2];
 	int decoupled_volume_steps_index;
 
+	/* Number of rays and shader evaluations done by this thread. */
+	KernelStats stats;
+
 	/* split kernel */
 	SplitData split_data;
 	SplitParams split_param_data;
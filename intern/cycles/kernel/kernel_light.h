@@ -1071,6 +1071,217 @@ ccl_device int light_distribution_sample(KernelGlobals *kg, float *randu)
 	return index;
 }
 
+/* Light Tree
+ *
+ * Picks an emitter by walking down a BVH over all local lights, choosing each
+ * child proportional to a conservative estimate of the light it sends to the
+ * shading point. The estimate only depends on the position, so the same
+ * probabilities are recomputed for MIS when a BSDF ray hits an emitter.
+ *
+ * The area and lamp pdfs computed by the sampling routines assume selection
+ * by the light distribution, they get rescaled by the ratio of both selection
+ * probabilities. Lights at infinity are not in the tree and keep theirs. */
+
+#ifdef __LIGHT_TREE__
+
+ccl_device_inline float light_distribution_pdf(KernelGlobals *kg, int index)
+{
+	return kernel_tex_fetch(__light_distribution, index+1).totarea -
+	       kernel_tex_fetch(__light_distribution, index).totarea;
+}
+
+ccl_device float light_tree_node_importance(KernelGlobals *kg, int index, float3 P)
+{
+	const ccl_global KernelLightTreeNode *knode = &kernel_tex_fetch(__light_tree_nodes, index);
+
+	const float3 bbox_min = make_float3(knode->bbox_min[0], knode->bbox_min[1], knode->bbox_min[2]);
+	const float3 bbox_max = make_float3(knode->bbox_max[0], knode->bbox_max[1], knode->bbox_max[2]);
+	const float3 centroid = 0.5f*(bbox_min + bbox_max);
+	const float radius = 0.5f*len(bbox_max - bbox_min);
+
+	float distance;
+	const float3 D = normalize_len(P - centroid, &distance);
+
+	/* Distance falloff is meaningless for points inside of the bounds. */
+	const float distance_squared = max(max(distance*distance, radius*radius), 1e-10f);
+
+	float cos_theta_prime = 1.0f;
+	if(distance > radius) {
+		/* Smallest angle between any emitter normal and the direction to P,
+		 * accounting for the extent of the bounds as seen from P. */
+		const float3 axis = make_float3(knode->axis[0], knode->axis[1], knode->axis[2]);
+		const float theta = safe_acosf(dot(axis, D));
+		const float theta_u = safe_asinf(radius/distance);
+		const float theta_prime = max(theta - knode->theta_o - theta_u, 0.0f);
+
+		if(theta_prime >= knode->theta_e) {
+			return 0.0f;
+		}
+		cos_theta_prime = cosf(theta_prime);
+	}
+
+	return knode->energy*cos_theta_prime/distance_squared;
+}
+
+ccl_device int light_tree_sample(KernelGlobals *kg, float3 P, float *randu, float *pdf_scale)
+{
+	const int num_infinite = kernel_data.integrator.num_light_tree_infinite;
+	const float infinite_pdf = kernel_data.integrator.light_tree_infinite_pdf;
+	float u = *randu;
+
+	if(u < infinite_pdf) {
+		/* Uniformly among lights at infinity, as the distribution would. */
+		u = u/infinite_pdf*num_infinite;
+		const int i = min((int)u, num_infinite - 1);
+		*randu = clamp(u - i, 0.0f, 1.0f - 1e-7f);
+		*pdf_scale = 1.0f;
+		return kernel_tex_fetch(__light_tree_leaf_emitters, i);
+	}
+
+	u = (u - infinite_pdf)/(1.0f - infinite_pdf);
+	float pdf = 1.0f - infinite_pdf;
+
+	int index = 0;
+	const ccl_global KernelLightTreeNode *knode = &kernel_tex_fetch(__light_tree_nodes, index);
+
+	while(knode->num_emitters == 0) {
+		const int left = index + 1;
+		const int right = knode->child_index;
+		const float importance_left = light_tree_node_importance(kg, left, P);
+		const float importance_right = light_tree_node_importance(kg, right, P);
+		const float importance = importance_left + importance_right;
+
+		if(importance == 0.0f) {
+			return -1;
+		}
+
+		/* Rescale to reuse the random number, as in light_distribution_sample. */
+		const float prob_left = importance_left/importance;
+		if(u < prob_left) {
+			index = left;
+			u = u/prob_left;
+			pdf *= prob_left;
+		}
+		else {
+			index = right;
+			u = (u - prob_left)/(1.0f - prob_left);
+			pdf *= 1.0f - prob_left;
+		}
+
+		knode = &kernel_tex_fetch(__light_tree_nodes, index);
+	}
+
+	/* Pick an emitter in the leaf proportional to its power. */
+	const int first = knode->child_index;
+	const int num_emitters = knode->num_emitters;
+	int distribution_id = -1;
+	float cdf = 0.0f;
+
+	for(int i = 0; i < num_emitters; i++) {
+		distribution_id = kernel_tex_fetch(__light_tree_leaf_emitters, first + i);
+		const float prob = kernel_tex_fetch(__light_tree_emitters, distribution_id).energy/knode->energy;
+
+		if(u < cdf + prob || i == num_emitters - 1) {
+			u = (u - cdf)/prob;
+			pdf *= prob;
+			break;
+		}
+		cdf += prob;
+	}
+
+	*randu = clamp(u, 0.0f, 1.0f - 1e-7f);
+	*pdf_scale = pdf/light_distribution_pdf(kg, distribution_id);
+
+	return distribution_id;
+}
+
+/* Ratio of the tree and distribution probabilities to pick this emitter. */
+ccl_device float light_tree_pdf_scale(KernelGlobals *kg, float3 P, int distribution_id)
+{
+	const ccl_global KernelLightTreeEmitter *kemitter = &kernel_tex_fetch(__light_tree_emitters, distribution_id);
+	int index = kemitter->leaf_index;
+
+	if(index < 0) {
+		/* Emitter without power, never picked. */
+		return 0.0f;
+	}
+
+	const ccl_global KernelLightTreeNode *knode = &kernel_tex_fetch(__light_tree_nodes, index);
+	float pdf = kemitter->energy/knode->energy;
+
+	/* Walk up to the root, redoing the choices of light_tree_sample(). */
+	int parent = knode->parent_index;
+	while(parent != -1) {
+		knode = &kernel_tex_fetch(__light_tree_nodes, parent);
+
+		const int left = parent + 1;
+		const int right = knode->child_index;
+		const float importance_left = light_tree_node_importance(kg, left, P);
+		const float importance_right = light_tree_node_importance(kg, right, P);
+		const float importance = importance_left + importance_right;
+
+		if(importance == 0.0f) {
+			return 0.0f;
+		}
+
+		pdf *= ((index == left) ? importance_left : importance_right)/importance;
+
+		index = parent;
+		parent = knode->parent_index;
+	}
+
+	pdf *= 1.0f - kernel_data.integrator.light_tree_infinite_pdf;
+
+	return pdf/light_distribution_pdf(kg, distribution_id);
+}
+
+/* Mesh light entries of the distribution are sorted by object and primitive. */
+ccl_device int light_distribution_find_triangle(KernelGlobals *kg, int object, int prim)
+{
+	const int num_triangles = kernel_data.integrator.num_distribution - kernel_data.integrator.num_all_lights;
+	int first = 0;
+	int len = num_triangles;
+
+	while(len > 0) {
+		int half_len = len >> 1;
+		int middle = first + half_len;
+		const ccl_global KernelLightDistribution *kdistribution = &kernel_tex_fetch(__light_distribution, middle);
+
+		if(kdistribution->mesh_light.object_id < object ||
+		   (kdistribution->mesh_light.object_id == object && kdistribution->prim < prim))
+		{
+			first = middle + 1;
+			len = len - half_len - 1;
+		}
+		else {
+			len = half_len;
+		}
+	}
+
+	if(first < num_triangles) {
+		const ccl_global KernelLightDistribution *kdistribution = &kernel_tex_fetch(__light_distribution, first);
+		if(kdistribution->mesh_light.object_id == object && kdistribution->prim == prim) {
+			return first;
+		}
+	}
+
+	return -1;
+}
+
+ccl_device float light_tree_triangle_pdf_scale(KernelGlobals *kg, float3 P, int object, int prim)
+{
+	const int distribution_id = light_distribution_find_triangle(kg, object, prim);
+	return (distribution_id >= 0) ? light_tree_pdf_scale(kg, P, distribution_id) : 0.0f;
+}
+
+ccl_device float light_tree_lamp_pdf_scale(KernelGlobals *kg, float3 P, int lamp)
+{
+	const int distribution_id = kernel_data.integrator.num_distribution - kernel_data.integrator.num_all_lights + lamp;
+	return light_tree_pdf_scale(kg, P, distribution_id);
+}
+
+#endif  /* __LIGHT_TREE__ */
+
 /* Generic Light */
 
 ccl_device bool light_select_reached_max_bounces(KernelGlobals *kg, int index, int bounce)
@@ -1087,7 +1298,21 @@ ccl_device_noinline bool light_sample(KernelGlobals *kg,
                                       LightSample *ls)
 {
 	/* sample index */
-	int index = light_distribution_sample(kg, &randu);
+	int index;
+	float pdf_scale = 1.0f;
+
+#ifdef __LIGHT_TREE__
+	if(kernel_data.integrator.use_light_tree) {
+		index = light_tree_sample(kg, P, &randu, &pdf_scale);
+		if(index < 0) {
+			return false;
+		}
+	}
+	else
+#endif
+	{
+		index = light_distribution_sample(kg, &randu);
+	}
 
 	/* fetch light data */
 	const ccl_global KernelLightDistribution *kdistribution = &kernel_tex_fetch(__light_distribution, index);
@@ -1099,6 +1324,7 @@ ccl_device_noinline bool light_sample(KernelGlobals *kg,
 
 		triangle_light_sample(kg, prim, object, randu, randv, time, ls, P);
 		ls->shader |= shader_flag;
+		ls->pdf *= pdf_scale;
 		return (ls->pdf > 0.0f);
 	}
 	else {
@@ -1108,7 +1334,12 @@ ccl_device_noinline bool light_sample(KernelGlobals *kg,
 			return false;
 		}
 
-		return lamp_light_sample(kg, lamp, randu, randv, P, ls);
+		if(!lamp_light_sample(kg, lamp, randu, randv, P, ls)) {
+			return false;
+		}
+
+		ls->pdf *= pdf_scale;
+		return (ls->pdf > 0.0f);
 	}
 }
 
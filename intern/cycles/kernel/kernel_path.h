@@ -31,6 +31,7 @@
 #include "kernel/kernel_shader.h"
 #include "kernel/kernel_light.h"
 #include "kernel/kernel_passes.h"
+#include "kernel/kernel_adaptive_sampling.h"
 
 #if defined(__VOLUME__) || defined(__SUBSURFACE__)
 #  include "kernel/kernel_volume.h"
@@ -93,6 +94,15 @@ ccl_device_forceinline bool kernel_path_scene_intersect(
 	L->debug_data.num_ray_bounces++;
 #endif  /* __KERNEL_DEBUG__ */
 
+#ifdef __KERNEL_CPU__
+	if(state->flag & PATH_RAY_CAMERA) {
+		kg->stats.num_camera_rays++;
+	}
+	else {
+		kg->stats.num_indirect_rays++;
+	}
+#endif
+
 	return hit;
 }
 
@@ -725,6 +735,10 @@ ccl_device void kernel_path_trace(KernelGlobals *kg,
 
 	buffer += index*pass_stride;
 
+	if(!kernel_adaptive_need_sample(kg, buffer)) {
+		return;
+	}
+
 	/* Initialize random numbers and sample ray. */
 	uint rng_hash;
 	Ray ray;
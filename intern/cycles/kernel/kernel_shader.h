@@ -1002,6 +1002,10 @@ ccl_device void shader_eval_surface(KernelGlobals *kg, ShaderData *sd,
 	sd->num_closure = 0;
 	sd->num_closure_left = max_closures;
 
+#ifdef __KERNEL_CPU__
+	kg->stats.num_shader_evals++;
+#endif
+
 #ifdef __OSL__
 	if(kg->osl)
 		OSLShader::eval_surface(kg, sd, state, path_flag);
@@ -462,6 +462,9 @@ ccl_device_inline bool shadow_blocked(KernelGlobals *kg,
 	if(ray->t == 0.0f) {
 		return false;
 	}
+#ifdef __KERNEL_CPU__
+	kg->stats.num_shadow_rays++;
+#endif
 #ifdef __SHADOW_TRICKS__
 	const uint visibility = (state->flag & PATH_RAY_SHADOW_CATCHER)
 		? PATH_RAY_SHADOW_NON_CATCHER
@@ -82,6 +82,9 @@ CCL_NAMESPACE_BEGIN
 #  ifdef __KERNEL_SSE2__
 #    define __QBVH__
 #  endif
+#  ifdef __KERNEL_AVX2__
+#    define __OBVH__
+#  endif
 #  define __KERNEL_SHADING__
 #  define __KERNEL_ADV_SHADING__
 #  define __BRANCHED_PATH__
@@ -176,6 +179,7 @@ CCL_NAMESPACE_BEGIN
 #define __CLAMP_SAMPLE__
 #define __PATCH_EVAL__
 #define __SHADOW_TRICKS__
+#define __LIGHT_TREE__
 #define __DENOISING_FEATURES__
 #define __SHADER_RAYTRACE__
 
@@ -1272,7 +1276,9 @@ typedef struct KernelFilm {
 	int pass_denoising_clean;
 	int denoising_flags;
 
-	int pad1, pad2, pad3;
+	int pass_adaptive_aux_buffer;
+	int pass_sample_count;
+	int pad1;
 
 #ifdef __KERNEL_DEBUG__
 	int pass_bvh_traversed_nodes;
@@ -1314,6 +1320,12 @@ typedef struct KernelIntegrator {
 	int num_portals;
 	int portal_offset;
 
+	/* light tree */
+	int use_light_tree;
+	int num_light_tree_infinite;
+	float light_tree_infinite_pdf;
+	int light_tree_pad;
+
 	/* bounces */
 	int max_bounce;
 
@@ -1368,6 +1380,12 @@ typedef struct KernelIntegrator {
 	int start_sample;
 
 	int max_closures;
+
+	/* adaptive sampling */
+	float adaptive_threshold;
+	int adaptive_min_samples;
+	int adaptive_step;
+	int adaptive_pad;
 } KernelIntegrator;
 static_assert_align(KernelIntegrator, 16);
 
@@ -1376,8 +1394,9 @@ typedef enum KernelBVHLayout {
 
 	BVH_LAYOUT_BVH2 = (1 << 0),
 	BVH_LAYOUT_BVH4 = (1 << 1),
+	BVH_LAYOUT_BVH8 = (1 << 2),
 
-	BVH_LAYOUT_DEFAULT = BVH_LAYOUT_BVH4,
+	BVH_LAYOUT_DEFAULT = BVH_LAYOUT_BVH8,
 	BVH_LAYOUT_ALL = (unsigned int)(-1),
 } KernelBVHLayout;
 
@@ -1515,6 +1534,33 @@ typedef struct KernelLightDistribution {
 } KernelLightDistribution;
 static_assert_align(KernelLightDistribution, 16);
 
+/* Light tree node, bounds the position, orientation and power of a set of
+ * emitters. Left child directly follows its parent in the array. */
+typedef struct KernelLightTreeNode {
+	float bbox_min[3];
+	float energy;
+	float bbox_max[3];
+	float theta_o;
+	float axis[3];
+	float theta_e;
+	/* Interior node: index of the right child.
+	 * Leaf node: first entry in __light_tree_leaf_emitters. */
+	int child_index;
+	/* Zero for interior nodes. */
+	int num_emitters;
+	int parent_index;
+	int pad;
+} KernelLightTreeNode;
+static_assert_align(KernelLightTreeNode, 16);
+
+/* Indexed like __light_distribution. */
+typedef struct KernelLightTreeEmitter {
+	float energy;
+	int leaf_index;
+	int pad1, pad2;
+} KernelLightTreeEmitter;
+static_assert_align(KernelLightTreeEmitter, 16);
+
 typedef struct KernelParticle {
 	int index;
 	float age;
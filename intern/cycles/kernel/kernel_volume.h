@@ -194,7 +194,11 @@ ccl_device void kernel_volume_shadow_homogeneous(KernelGlobals *kg,
 }
 
 /* heterogeneous volume: integrate stepping through the volume until we
- * reach the end, get absorbed entirely, or run out of iterations */
+ * reach the end, get absorbed entirely, or run out of iterations
+ *
+ * Steps are not skipped based on density here. Empty space around voxel
+ * grids is left out by the volume bounding mesh, and lookups into empty
+ * bricks of sparse grids return without reading voxels. */
 ccl_device void kernel_volume_shadow_heterogeneous(KernelGlobals *kg,
                                                    ccl_addr_space PathState *state,
                                                    Ray *ray,
@@ -453,6 +453,148 @@ template<typename T> struct TextureInterpolator  {
 #undef DATA
 	}
 
+	/* ********  Sparse 3D interpolation ******** */
+
+	static ccl_always_inline int wrap_sparse(int x, int width, uint extension)
+	{
+		return (extension == EXTENSION_REPEAT)? wrap_periodic(x, width):
+		                                        wrap_clamp(x, width);
+	}
+
+	/* Empty bricks all point to the first brick, which is filled with zeros,
+	 * so no special case is needed for them. */
+	static ccl_always_inline float4 read_sparse(const TextureInfo& info,
+	                                            const int *offsets,
+	                                            int x, int y, int z)
+	{
+		const int brick_width = (info.width + TEX_SPARSE_BRICK_MASK) >> TEX_SPARSE_BRICK_SHIFT;
+		const int brick_height = (info.height + TEX_SPARSE_BRICK_MASK) >> TEX_SPARSE_BRICK_SHIFT;
+		const int brick = offsets[(x >> TEX_SPARSE_BRICK_SHIFT) +
+		                          ((y >> TEX_SPARSE_BRICK_SHIFT) +
+		                           (z >> TEX_SPARSE_BRICK_SHIFT) * brick_height) * brick_width];
+		const int voxel = (x & TEX_SPARSE_BRICK_MASK) +
+		                  ((y & TEX_SPARSE_BRICK_MASK) << TEX_SPARSE_BRICK_SHIFT) +
+		                  ((z & TEX_SPARSE_BRICK_MASK) << (2 * TEX_SPARSE_BRICK_SHIFT));
+
+		const T *data = (const T*)info.data;
+		return read(data[(size_t)brick * TEX_SPARSE_BRICK_VOXELS + voxel]);
+	}
+
+	/* Test if all n taps along each axis lie in one empty brick, so a lookup
+	 * in empty space costs a single offset read. Coordinates are wrapped
+	 * already, so with repeat extension the taps are not ordered and every
+	 * one of them has to be checked, not only the first and the last. */
+	static ccl_always_inline bool sparse_brick_empty(const TextureInfo& info,
+	                                                 const int *offsets,
+	                                                 const int *xc,
+	                                                 const int *yc,
+	                                                 const int *zc,
+	                                                 int n)
+	{
+		const int bx = xc[0] >> TEX_SPARSE_BRICK_SHIFT;
+		const int by = yc[0] >> TEX_SPARSE_BRICK_SHIFT;
+		const int bz = zc[0] >> TEX_SPARSE_BRICK_SHIFT;
+		for(int i = 1; i < n; i++) {
+			if(bx != (xc[i] >> TEX_SPARSE_BRICK_SHIFT) ||
+			   by != (yc[i] >> TEX_SPARSE_BRICK_SHIFT) ||
+			   bz != (zc[i] >> TEX_SPARSE_BRICK_SHIFT))
+			{
+				return false;
+			}
+		}
+		const int brick_width = (info.width + TEX_SPARSE_BRICK_MASK) >> TEX_SPARSE_BRICK_SHIFT;
+		const int brick_height = (info.height + TEX_SPARSE_BRICK_MASK) >> TEX_SPARSE_BRICK_SHIFT;
+		return offsets[bx + (by + bz * brick_height) * brick_width] == 0;
+	}
+
+	static ccl_never_inline float4 interp_3d_sparse(const TextureInfo& info,
+	                                                float x, float y, float z,
+	                                                InterpolationType interp)
+	{
+		const int *offsets = (const int*)info.sparse_offsets;
+		const int width = info.width;
+		const int height = info.height;
+		const int depth = info.depth;
+
+		if(info.extension == EXTENSION_CLIP) {
+			if(x < 0.0f || y < 0.0f || z < 0.0f ||
+			   x > 1.0f || y > 1.0f || z > 1.0f)
+			{
+				return make_float4(0.0f, 0.0f, 0.0f, 0.0f);
+			}
+		}
+
+		int ix, iy, iz;
+
+		if(interp == INTERPOLATION_CLOSEST) {
+			frac(x*(float)width, &ix);
+			frac(y*(float)height, &iy);
+			frac(z*(float)depth, &iz);
+
+			return read_sparse(info, offsets,
+			                   wrap_sparse(ix, width, info.extension),
+			                   wrap_sparse(iy, height, info.extension),
+			                   wrap_sparse(iz, depth, info.extension));
+		}
+
+		const float tx = frac(x*(float)width - 0.5f, &ix);
+		const float ty = frac(y*(float)height - 0.5f, &iy);
+		const float tz = frac(z*(float)depth - 0.5f, &iz);
+
+		if(interp == INTERPOLATION_LINEAR) {
+			const int xc[2] = {wrap_sparse(ix, width, info.extension),
+			                   wrap_sparse(ix+1, width, info.extension)};
+			const int yc[2] = {wrap_sparse(iy, height, info.extension),
+			                   wrap_sparse(iy+1, height, info.extension)};
+			const int zc[2] = {wrap_sparse(iz, depth, info.extension),
+			                   wrap_sparse(iz+1, depth, info.extension)};
+			const float u[2] = {1.0f - tx, tx};
+			const float v[2] = {1.0f - ty, ty};
+			const float w[2] = {1.0f - tz, tz};
+
+			if(sparse_brick_empty(info, offsets, xc, yc, zc, 2)) {
+				return make_float4(0.0f, 0.0f, 0.0f, 0.0f);
+			}
+
+			float4 r = make_float4(0.0f, 0.0f, 0.0f, 0.0f);
+			for(int k = 0; k < 2; k++) {
+				for(int j = 0; j < 2; j++) {
+					for(int i = 0; i < 2; i++) {
+						r += (w[k]*v[j]*u[i]) * read_sparse(info, offsets, xc[i], yc[j], zc[k]);
+					}
+				}
+			}
+			return r;
+		}
+
+		/* Tricubic b-spline interpolation. */
+		int xc[4], yc[4], zc[4];
+		for(int i = 0; i < 4; i++) {
+			xc[i] = wrap_sparse(ix+i-1, width, info.extension);
+			yc[i] = wrap_sparse(iy+i-1, height, info.extension);
+			zc[i] = wrap_sparse(iz+i-1, depth, info.extension);
+		}
+
+		if(sparse_brick_empty(info, offsets, xc, yc, zc, 4)) {
+			return make_float4(0.0f, 0.0f, 0.0f, 0.0f);
+		}
+
+		float u[4], v[4], w[4];
+		SET_CUBIC_SPLINE_WEIGHTS(u, tx);
+		SET_CUBIC_SPLINE_WEIGHTS(v, ty);
+		SET_CUBIC_SPLINE_WEIGHTS(w, tz);
+
+		float4 r = make_float4(0.0f, 0.0f, 0.0f, 0.0f);
+		for(int k = 0; k < 4; k++) {
+			for(int j = 0; j < 4; j++) {
+				for(int i = 0; i < 4; i++) {
+					r += (w[k]*v[j]*u[i]) * read_sparse(info, offsets, xc[i], yc[j], zc[k]);
+				}
+			}
+		}
+		return r;
+	}
+
 	static ccl_always_inline float4 interp_3d(const TextureInfo& info,
 	                                          float x, float y, float z,
 	                                          InterpolationType interp)
@@ -460,6 +602,11 @@ template<typename T> struct TextureInterpolator  {
 		if(UNLIKELY(!info.data))
 			return make_float4(0.0f, 0.0f, 0.0f, 0.0f);
 
+		if(info.sparse_offsets) {
+			return interp_3d_sparse(info, x, y, z,
+			                        (interp == INTERPOLATION_NONE)? (InterpolationType)info.interpolation: interp);
+		}
+
 		switch((interp == INTERPOLATION_NONE)? info.interpolation: interp) {
 			case INTERPOLATION_CLOSEST:
 				return interp_3d_closest(info, x, y, z);
@@ -476,6 +623,10 @@ ccl_device float4 kernel_tex_image_interp(KernelGlobals *kg, int id, float x, fl
 {
 	const TextureInfo& info = kernel_tex_fetch(__texture_info, id);
 
+	if(UNLIKELY(info.cache)) {
+		return ((CachedTexture*)info.cache)->lookup(x, y, 0.0f, 0.0f, 0.0f, 0.0f);
+	}
+
 	switch(kernel_tex_type(id)) {
 		case IMAGE_DATA_TYPE_HALF:
 			return TextureInterpolator<half>::interp(info, x, y);
@@ -493,6 +644,20 @@ ccl_device float4 kernel_tex_image_interp(KernelGlobals *kg, int id, float x, fl
 	}
 }
 
+/* Lookup filtered over the footprint given by the screen space derivatives
+ * dx and dy of the texture coordinate. Only images in the texture cache have
+ * mipmaps, others are interpolated at full resolution. */
+ccl_device float4 kernel_tex_image_interp_d(KernelGlobals *kg, int id, float x, float y, float2 dx, float2 dy)
+{
+	const TextureInfo& info = kernel_tex_fetch(__texture_info, id);
+
+	if(UNLIKELY(info.cache)) {
+		return ((CachedTexture*)info.cache)->lookup(x, y, dx.x, dx.y, dy.x, dy.y);
+	}
+
+	return kernel_tex_image_interp(kg, id, x, y);
+}
+
 ccl_device float4 kernel_tex_image_interp_3d(KernelGlobals *kg, int id, float x, float y, float z, InterpolationType interp)
 {
 	const TextureInfo& info = kernel_tex_fetch(__texture_info, id);
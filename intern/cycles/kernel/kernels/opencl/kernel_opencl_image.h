@@ -175,6 +175,12 @@ ccl_device float4 kernel_tex_image_interp(KernelGlobals *kg, int id, float x, fl
 }
 
 
+/* No mipmaps on the GPU, the footprint is ignored. */
+ccl_device float4 kernel_tex_image_interp_d(KernelGlobals *kg, int id, float x, float y, float2 dx, float2 dy)
+{
+	return kernel_tex_image_interp(kg, id, x, y);
+}
+
 ccl_device float4 kernel_tex_image_interp_3d(KernelGlobals *kg, int id, float x, float y, float z, int interp)
 {
 	const ccl_global TextureInfo *info = kernel_tex_info(kg, id);
@@ -16,9 +16,9 @@
 
 CCL_NAMESPACE_BEGIN
 
-ccl_device float4 svm_image_texture(KernelGlobals *kg, int id, float x, float y, uint srgb, uint use_alpha)
+ccl_device float4 svm_image_texture(KernelGlobals *kg, int id, float x, float y, float2 dx, float2 dy, uint srgb, uint use_alpha)
 {
-	float4 r = kernel_tex_image_interp(kg, id, x, y);
+	float4 r = kernel_tex_image_interp_d(kg, id, x, y, dx, dy);
 	const float alpha = r.w;
 
 	if(use_alpha && alpha != 1.0f && alpha != 0.0f) {
@@ -45,13 +45,30 @@ ccl_device_inline float3 texco_remap_square(float3 co)
 	return (co - make_float3(0.5f, 0.5f, 0.5f)) * 2.0f;
 }
 
-ccl_device void svm_node_tex_image(KernelGlobals *kg, ShaderData *sd, float *stack, uint4 node)
+ccl_device void svm_node_tex_image(KernelGlobals *kg, ShaderData *sd, float *stack, uint4 node, int *offset)
 {
 	uint id = node.y;
 	uint co_offset, out_offset, alpha_offset, srgb;
 
 	decode_node_uchar4(node.z, &co_offset, &out_offset, &alpha_offset, &srgb);
 
+	/* Footprint of the lookup, when the texture coordinate is an attribute
+	 * we get it from the differentials of that attribute. */
+	uint4 node2 = read_node(kg, offset);
+	float2 dx = make_float2(0.0f, 0.0f);
+	float2 dy = make_float2(0.0f, 0.0f);
+#ifdef __RAY_DIFFERENTIALS__
+	if(node2.x != ATTR_STD_NOT_FOUND) {
+		const AttributeDescriptor desc = find_attribute(kg, sd, node2.x);
+		if(desc.offset != ATTR_STD_NOT_FOUND) {
+			float3 dco_dx, dco_dy;
+			primitive_attribute_float3(kg, sd, desc, &dco_dx, &dco_dy);
+			dx = make_float2(dco_dx.x, dco_dx.y);
+			dy = make_float2(dco_dy.x, dco_dy.y);
+		}
+	}
+#endif
+
 	float3 co = stack_load_float3(stack, co_offset);
 	float2 tex_co;
 	uint use_alpha = stack_valid(alpha_offset);
@@ -66,7 +83,7 @@ ccl_device void svm_node_tex_image(KernelGlobals *kg, ShaderData *sd, float *sta
 	else {
 		tex_co = make_float2(co.x, co.y);
 	}
-	float4 f = svm_image_texture(kg, id, tex_co.x, tex_co.y, srgb, use_alpha);
+	float4 f = svm_image_texture(kg, id, tex_co.x, tex_co.y, dx, dy, srgb, use_alpha);
 
 	if(stack_valid(out_offset))
 		stack_store_float3(stack, out_offset, make_float3(f.x, f.y, f.z));
@@ -157,15 +174,15 @@ ccl_device void svm_node_tex_image_box(KernelGlobals *kg, ShaderData *sd, float
 	/* Map so that no textures are flipped, rotation is somewhat arbitrary. */
 	if(weight.x > 0.0f) {
 		float2 uv = make_float2((signed_N.x < 0.0f)? 1.0f - co.y: co.y, co.z);
-		f += weight.x*svm_image_texture(kg, id, uv.x, uv.y, srgb, use_alpha);
+		f += weight.x*svm_image_texture(kg, id, uv.x, uv.y, make_float2(0.0f, 0.0f), make_float2(0.0f, 0.0f), srgb, use_alpha);
 	}
 	if(weight.y > 0.0f) {
 		float2 uv = make_float2((signed_N.y > 0.0f)? 1.0f - co.x: co.x, co.z);
-		f += weight.y*svm_image_texture(kg, id, uv.x, uv.y, srgb, use_alpha);
+		f += weight.y*svm_image_texture(kg, id, uv.x, uv.y, make_float2(0.0f, 0.0f), make_float2(0.0f, 0.0f), srgb, use_alpha);
 	}
 	if(weight.z > 0.0f) {
 		float2 uv = make_float2((signed_N.z > 0.0f)? 1.0f - co.y: co.y, co.x);
-		f += weight.z*svm_image_texture(kg, id, uv.x, uv.y, srgb, use_alpha);
+		f += weight.z*svm_image_texture(kg, id, uv.x, uv.y, make_float2(0.0f, 0.0f), make_float2(0.0f, 0.0f), srgb, use_alpha);
 	}
 
 	if(stack_valid(out_offset))
@@ -193,7 +210,7 @@ ccl_device void svm_node_tex_environment(KernelGlobals *kg, ShaderData *sd, floa
 		uv = direction_to_mirrorball(co);
 
 	uint use_alpha = stack_valid(alpha_offset);
-	float4 f = svm_image_texture(kg, id, uv.x, uv.y, srgb, use_alpha);
+	float4 f = svm_image_texture(kg, id, uv.x, uv.y, make_float2(0.0f, 0.0f), make_float2(0.0f, 0.0f), srgb, use_alpha);
 
 	if(stack_valid(out_offset))
 		stack_store_float3(stack, out_offset, make_float3(f.x, f.y, f.z));
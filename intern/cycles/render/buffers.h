@@ -54,6 +54,8 @@ public:
 	bool denoising_data_pass;
 	/* If only some light path types should be denoised, an additional pass is needed. */
 	bool denoising_clean_pass;
+	/* Auxiliary half buffer and sample count for adaptive sampling. */
+	bool adaptive_sampling;
 
 	/* functions */
 	BufferParams();
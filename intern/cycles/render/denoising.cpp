@@ -0,0 +1,516 @@
+/*
+ * Copyright 2011-2018 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "render/denoising.h"
+
+#include "kernel/kernel_types.h"
+
+#include "util/util_foreach.h"
+#include "util/util_image.h"
+#include "util/util_logging.h"
+#include "util/util_task.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+CCL_NAMESPACE_BEGIN
+
+/* Passes as written by Blender when storing the denoising data. */
+static const struct {
+	const char *name;
+	const char *channels;
+	int offset;
+} denoising_passes[] = {
+	{"Denoising Normal",          "XYZ", DENOISING_PASS_NORMAL},
+	{"Denoising Normal Variance", "XYZ", DENOISING_PASS_NORMAL_VAR},
+	{"Denoising Albedo",          "RGB", DENOISING_PASS_ALBEDO},
+	{"Denoising Albedo Variance", "RGB", DENOISING_PASS_ALBEDO_VAR},
+	{"Denoising Depth",           "Z",   DENOISING_PASS_DEPTH},
+	{"Denoising Depth Variance",  "Z",   DENOISING_PASS_DEPTH_VAR},
+	{"Denoising Shadow A",        "XYV", DENOISING_PASS_SHADOW_A},
+	{"Denoising Shadow B",        "XYV", DENOISING_PASS_SHADOW_B},
+	{"Denoising Image",           "RGB", DENOISING_PASS_COLOR},
+	{"Denoising Image Variance",  "RGB", DENOISING_PASS_COLOR_VAR},
+};
+
+static bool denoising_pass_is_variance(int offset)
+{
+	return (offset == DENOISING_PASS_NORMAL_VAR) ||
+	       (offset == DENOISING_PASS_ALBEDO_VAR) ||
+	       (offset == DENOISING_PASS_DEPTH_VAR) ||
+	       (offset == DENOISING_PASS_COLOR_VAR);
+}
+
+/* Render buffer layout used for denoising: the combined pass followed by
+ * the denoising data, like the render buffers of a session. */
+#define DENOISE_PASS_COMBINED 0
+#define DENOISE_PASS_DATA 4
+#define DENOISE_PASS_STRIDE align_up(DENOISE_PASS_DATA + DENOISING_PASS_SIZE_BASE, 4)
+
+/* Denoise Frame */
+
+struct DenoiseLayer {
+	string name;
+	/* Image channels of the combined pass and of the denoising data. */
+	int combined[3];
+	int data[DENOISING_PASS_SIZE_BASE];
+};
+
+class DenoiseFrame {
+public:
+	ImageSpec spec;
+	vector<float> pixels;
+	vector<DenoiseLayer> layers;
+	int samples;
+
+	bool load(const string& filepath, string& error);
+	bool save(const string& filepath, string& error);
+
+	int find_layer(const string& name) const;
+
+	/* Convert a layer to accumulated render buffer values and back. */
+	void read_layer(int layer, int num_samples, float *buffer) const;
+	void write_layer(int layer, int num_samples, const float *buffer);
+
+protected:
+	void find_layers();
+};
+
+bool DenoiseFrame::load(const string& filepath, string& error)
+{
+	ImageInput *in = ImageInput::create(filepath);
+	if(!in) {
+		error = string_printf("Could not open %s", filepath.c_str());
+		return false;
+	}
+
+	if(!in->open(filepath, spec)) {
+		error = string_printf("Could not open %s: %s", filepath.c_str(), in->geterror().c_str());
+		delete in;
+		return false;
+	}
+
+	pixels.resize((size_t)spec.width * spec.height * spec.nchannels);
+	if(!in->read_image(TypeDesc::FLOAT, &pixels[0])) {
+		error = string_printf("Could not read %s: %s", filepath.c_str(), in->geterror().c_str());
+		in->close();
+		delete in;
+		return false;
+	}
+
+	in->close();
+	delete in;
+
+	/* Stored by Blender in the render stamp. */
+	samples = atoi(spec.get_string_attribute("Cycles Samples").c_str());
+
+	find_layers();
+
+	VLOG(1) << "Loaded " << filepath << " with " << layers.size() << " denoisable layers.";
+
+	return true;
+}
+
+bool DenoiseFrame::save(const string& filepath, string& error)
+{
+	ImageOutput *out = ImageOutput::create(filepath);
+	if(!out) {
+		error = string_printf("Could not create %s", filepath.c_str());
+		return false;
+	}
+
+	/* All channels are written back, only the combined passes changed. */
+	ImageSpec out_spec = spec;
+	out_spec.format = TypeDesc::FLOAT;
+	out_spec.channelformats.clear();
+
+	if(!out->open(filepath, out_spec) ||
+	   !out->write_image(TypeDesc::FLOAT, &pixels[0]))
+	{
+		error = string_printf("Could not write %s: %s", filepath.c_str(), out->geterror().c_str());
+		out->close();
+		delete out;
+		return false;
+	}
+
+	out->close();
+	delete out;
+
+	return true;
+}
+
+void DenoiseFrame::find_layers()
+{
+	map<string, int> channels;
+	for(int i = 0; i < spec.nchannels; i++) {
+		channels[spec.channelnames[i]] = i;
+	}
+
+	/* Multilayer channel names are "layer.pass.channel", every layer with a
+	 * complete set of denoising passes is denoised. */
+	const string suffix = ".Denoising Image.R";
+	for(int i = 0; i < spec.nchannels; i++) {
+		const string& channel = spec.channelnames[i];
+		if(!string_endswith(channel, suffix.c_str())) {
+			continue;
+		}
+
+		DenoiseLayer layer;
+		layer.name = channel.substr(0, channel.size() - suffix.size());
+
+		bool complete = true;
+		for(int pass = 0; pass < sizeof(denoising_passes)/sizeof(*denoising_passes) && complete; pass++) {
+			for(int c = 0; denoising_passes[pass].channels[c]; c++) {
+				string name = string_printf("%s.%s.%c", layer.name.c_str(),
+				                                        denoising_passes[pass].name,
+				                                        denoising_passes[pass].channels[c]);
+				map<string, int>::iterator it = channels.find(name);
+				if(it == channels.end()) {
+					complete = false;
+					break;
+				}
+				layer.data[denoising_passes[pass].offset + c] = it->second;
+			}
+		}
+
+		const char *rgb = "RGB";
+		for(int c = 0; c < 3 && complete; c++) {
+			map<string, int>::iterator it = channels.find(string_printf("%s.Combined.%c", layer.name.c_str(), rgb[c]));
+			if(it == channels.end()) {
+				complete = false;
+				break;
+			}
+			layer.combined[c] = it->second;
+		}
+
+		if(complete) {
+			layers.push_back(layer);
+		}
+		else {
+			VLOG(1) << "Layer " << layer.name << " is missing denoising passes, skipping.";
+		}
+	}
+}
+
+int DenoiseFrame::find_layer(const string& name) const
+{
+	for(int i = 0; i < layers.size(); i++) {
+		if(layers[i].name == name) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+void DenoiseFrame::read_layer(int layer_index, int num_samples, float *buffer) const
+{
+	const DenoiseLayer& layer = layers[layer_index];
+	const size_t num_pixels = (size_t)spec.width * spec.height;
+	const float N = (float)num_samples;
+
+	for(size_t i = 0; i < num_pixels; i++, buffer += DENOISE_PASS_STRIDE) {
+		const float *in = &pixels[i*spec.nchannels];
+
+		for(int c = 0; c < 3; c++) {
+			buffer[DENOISE_PASS_COMBINED + c] = in[layer.combined[c]] * N;
+		}
+		buffer[DENOISE_PASS_COMBINED + 3] = N;
+
+		/* Undo the normalization of the stored passes, the variances were
+		 * written as E[x^2] - E[x]^2. */
+		float *data = buffer + DENOISE_PASS_DATA;
+		for(int pass = 0; pass < sizeof(denoising_passes)/sizeof(*denoising_passes); pass++) {
+			const int offset = denoising_passes[pass].offset;
+			const int components = strlen(denoising_passes[pass].channels);
+
+			for(int c = 0; c < components; c++) {
+				const float value = in[layer.data[offset + c]];
+				if(denoising_pass_is_variance(offset)) {
+					const float mean = in[layer.data[offset - components + c]];
+					data[offset + c] = (value + mean*mean) * N;
+				}
+				else {
+					data[offset + c] = value * N;
+				}
+			}
+		}
+	}
+}
+
+void DenoiseFrame::write_layer(int layer_index, int num_samples, const float *buffer)
+{
+	const DenoiseLayer& layer = layers[layer_index];
+	const size_t num_pixels = (size_t)spec.width * spec.height;
+	const float inv_N = 1.0f / num_samples;
+
+	for(size_t i = 0; i < num_pixels; i++, buffer += DENOISE_PASS_STRIDE) {
+		float *out = &pixels[i*spec.nchannels];
+		for(int c = 0; c < 3; c++) {
+			out[layer.combined[c]] = buffer[DENOISE_PASS_COMBINED + c] * inv_N;
+		}
+	}
+}
+
+/* Denoiser */
+
+Denoiser::Denoiser(DeviceInfo& device_info, int threads)
+{
+	frame_radius = 2;
+
+	radius = 8;
+	strength = 0.5f;
+	feature_strength = 0.5f;
+	relative_pca = false;
+
+	samples = 0;
+	tile_size = make_int2(64, 64);
+
+	TaskScheduler::init(threads);
+	device = Device::create(device_info, stats, true);
+}
+
+Denoiser::~Denoiser()
+{
+	for(map<int, DenoiseFrame*>::iterator it = frames.begin(); it != frames.end(); it++) {
+		delete it->second;
+	}
+
+	delete device;
+	TaskScheduler::exit();
+}
+
+bool Denoiser::run()
+{
+	if(!device || device->info.type != DEVICE_CPU) {
+		error = "Denoising of frames is only supported on the CPU";
+		return false;
+	}
+	if(input.empty()) {
+		error = "No input frames specified";
+		return false;
+	}
+	if(input.size() != output.size()) {
+		error = "Number of input and output frames does not match";
+		return false;
+	}
+
+	for(int frame = 0; frame < input.size(); frame++) {
+		/* Neighbors are loaded before the frame is written, so it is fine for
+		 * the output to overwrite the input. */
+		if(!load_frames(frame)) {
+			return false;
+		}
+
+		DenoiseFrame *center = frames[frame];
+		if(center->layers.empty()) {
+			error = string_printf("No layer with denoising data passes in %s", input[frame].c_str());
+			return false;
+		}
+
+		for(int layer = 0; layer < center->layers.size(); layer++) {
+			if(!denoise_layer(center, layer)) {
+				return false;
+			}
+		}
+
+		if(!center->save(output[frame], error)) {
+			return false;
+		}
+
+		VLOG(1) << "Denoised frame " << input[frame] << " into " << output[frame] << ".";
+	}
+
+	return true;
+}
+
+bool Denoiser::load_frames(int frame)
+{
+	/* Free frames which are not part of the neighborhood anymore. */
+	map<int, DenoiseFrame*>::iterator it = frames.begin();
+	while(it != frames.end()) {
+		if(it->first < frame - frame_radius) {
+			delete it->second;
+			frames.erase(it++);
+		}
+		else {
+			it++;
+		}
+	}
+
+	int last = min(frame + frame_radius, (int)input.size() - 1);
+	for(int i = max(frame - frame_radius, 0); i <= last; i++) {
+		if(frames.find(i) != frames.end()) {
+			continue;
+		}
+
+		DenoiseFrame *neighbor = new DenoiseFrame();
+		if(!neighbor->load(input[i], error)) {
+			delete neighbor;
+			return false;
+		}
+		frames[i] = neighbor;
+	}
+
+	return true;
+}
+
+bool Denoiser::denoise_layer(DenoiseFrame *center, int layer)
+{
+	const DenoiseLayer& center_layer = center->layers[layer];
+
+	int num_samples = (samples > 0)? samples: center->samples;
+	if(num_samples < 1) {
+		error = "Number of samples is not stored in the frames and must be specified";
+		return false;
+	}
+
+	/* The frame being denoised comes first, followed by the neighbors which
+	 * have the same layer and resolution. All frames are assumed to be
+	 * rendered with the same number of samples. */
+	vector<DenoiseFrame*> sources;
+	vector<int> source_layers;
+	sources.push_back(center);
+	source_layers.push_back(layer);
+
+	for(map<int, DenoiseFrame*>::iterator it = frames.begin(); it != frames.end(); it++) {
+		DenoiseFrame *neighbor = it->second;
+		int neighbor_layer = neighbor->find_layer(center_layer.name);
+		if(neighbor == center || neighbor_layer == -1 ||
+		   neighbor->spec.width != center->spec.width ||
+		   neighbor->spec.height != center->spec.height)
+		{
+			continue;
+		}
+		sources.push_back(neighbor);
+		source_layers.push_back(neighbor_layer);
+	}
+
+	const int width = center->spec.width;
+	const int height = center->spec.height;
+	const int frame_stride = width*height*DENOISE_PASS_STRIDE;
+
+	device_vector<float> buffer(device, "denoising render buffers", MEM_READ_WRITE);
+	float *data = buffer.alloc((size_t)frame_stride*sources.size());
+	for(int i = 0; i < sources.size(); i++) {
+		sources[i]->read_layer(source_layers[i], num_samples, data + (size_t)i*frame_stride);
+	}
+	buffer.copy_to_device();
+
+	image_size = make_int2(width, height);
+	num_tiles = make_int2(divide_up(width, tile_size.x), divide_up(height, tile_size.y));
+	next_tile = 0;
+	layer_samples = num_samples;
+	layer_buffer = buffer.device_pointer;
+
+	DeviceTask task(DeviceTask::RENDER);
+	task.acquire_tile = function_bind(&Denoiser::acquire_tile, this, _1, _2);
+	task.release_tile = function_bind(&Denoiser::release_tile, this, _1);
+	task.map_neighbor_tiles = function_bind(&Denoiser::map_neighbor_tiles, this, _1, _2);
+	task.unmap_neighbor_tiles = function_bind(&Denoiser::unmap_neighbor_tiles, this, _1, _2);
+	task.need_finish_queue = false;
+	task.integrator_branched = false;
+	task.requested_tile_size = tile_size;
+	task.passes_size = DENOISE_PASS_STRIDE;
+
+	task.denoising_radius = radius;
+	task.denoising_strength = strength;
+	task.denoising_feature_strength = feature_strength;
+	task.denoising_relative_pca = relative_pca;
+	task.pass_stride = DENOISE_PASS_STRIDE;
+	task.pass_denoising_data = DENOISE_PASS_DATA;
+	task.pass_denoising_clean = 0;
+	task.denoising_frames = sources.size();
+	task.denoising_frame_stride = frame_stride;
+
+	VLOG(1) << "Denoising layer " << center_layer.name << " using " << sources.size() << " frames.";
+
+	device->task_add(task);
+	device->task_wait();
+
+	/* The result is written into the combined pass of the first frame. */
+	buffer.copy_from_device(0, width*DENOISE_PASS_STRIDE, height);
+	center->write_layer(layer, num_samples, buffer.data());
+
+	buffer.free();
+
+	return true;
+}
+
+bool Denoiser::acquire_tile(Device * /*device*/, RenderTile& tile)
+{
+	thread_scoped_lock tile_lock(tile_mutex);
+
+	if(next_tile >= num_tiles.x*num_tiles.y) {
+		return false;
+	}
+
+	int tile_index = next_tile++;
+
+	tile.task = RenderTile::DENOISE;
+	tile.tile_index = tile_index;
+	tile.x = (tile_index % num_tiles.x) * tile_size.x;
+	tile.y = (tile_index / num_tiles.x) * tile_size.y;
+	tile.w = min(tile_size.x, image_size.x - tile.x);
+	tile.h = min(tile_size.y, image_size.y - tile.y);
+	tile.start_sample = layer_samples;
+	tile.num_samples = 0;
+	tile.sample = layer_samples;
+	tile.resolution = 1;
+	tile.offset = 0;
+	tile.stride = image_size.x;
+	tile.buffer = layer_buffer;
+	tile.buffers = NULL;
+
+	return true;
+}
+
+void Denoiser::release_tile(RenderTile& /*tile*/)
+{
+}
+
+void Denoiser::map_neighbor_tiles(RenderTile *tiles, Device * /*device*/)
+{
+	/* All tiles are part of the same buffer, so only their extents are
+	 * needed. Tiles outside of the image are empty. */
+	for(int dy = -1, i = 0; dy <= 1; dy++) {
+		for(int dx = -1; dx <= 1; dx++, i++) {
+			int px = tiles[4].x + dx*tile_size.x;
+			int py = tiles[4].y + dy*tile_size.y;
+			if(px >= 0 && py >= 0 && px < image_size.x && py < image_size.y) {
+				tiles[i].buffer = layer_buffer;
+				tiles[i].x = px;
+				tiles[i].y = py;
+				tiles[i].w = min(tile_size.x, image_size.x - px);
+				tiles[i].h = min(tile_size.y, image_size.y - py);
+				tiles[i].offset = 0;
+				tiles[i].stride = image_size.x;
+			}
+			else {
+				tiles[i].buffer = (device_ptr)NULL;
+				tiles[i].x = clamp(px, 0, image_size.x);
+				tiles[i].y = clamp(py, 0, image_size.y);
+				tiles[i].w = tiles[i].h = 0;
+			}
+			tiles[i].buffers = NULL;
+		}
+	}
+}
+
+void Denoiser::unmap_neighbor_tiles(RenderTile * /*tiles*/, Device * /*device*/)
+{
+}
+
+CCL_NAMESPACE_END
@@ -0,0 +1,95 @@
+/*
+ * Copyright 2011-2018 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __DENOISING_H__
+#define __DENOISING_H__
+
+#include "device/device.h"
+
+#include "render/buffers.h"
+
+#include "util/util_map.h"
+#include "util/util_string.h"
+#include "util/util_thread.h"
+#include "util/util_vector.h"
+
+CCL_NAMESPACE_BEGIN
+
+class DenoiseFrame;
+
+/* Denoiser
+ *
+ * Denoises a sequence of frames which were rendered before, with their
+ * denoising data passes stored in multilayer EXR files. Besides the tiles
+ * around a pixel, the same filter also uses the neighboring frames, which
+ * avoids flickering in animations. Runs on the CPU without a scene. */
+
+class Denoiser {
+public:
+	explicit Denoiser(DeviceInfo& device_info, int threads = 0);
+	~Denoiser();
+
+	/* Denoise all input frames, returns false and sets error on failure. */
+	bool run();
+
+	/* Files of the frames in order, output may be the same as input. */
+	vector<string> input;
+	vector<string> output;
+
+	/* Number of frames before and after the current one used for filtering. */
+	int frame_radius;
+
+	/* Filter parameters, same as for denoising while rendering. */
+	int radius;
+	float strength;
+	float feature_strength;
+	bool relative_pca;
+
+	/* Number of samples the frames were rendered with, read from the
+	 * file metadata when zero. */
+	int samples;
+
+	int2 tile_size;
+
+	string error;
+
+protected:
+	Stats stats;
+	Device *device;
+
+	/* Loaded frames of the current neighborhood, by index. */
+	map<int, DenoiseFrame*> frames;
+
+	bool load_frames(int frame);
+	bool denoise_layer(DenoiseFrame *frame, int layer);
+
+	/* Tiles of the layer being denoised, handed out to the device threads. */
+	thread_mutex tile_mutex;
+	int2 image_size;
+	int2 num_tiles;
+	int next_tile;
+	int layer_samples;
+	device_ptr layer_buffer;
+
+	bool acquire_tile(Device *device, RenderTile& tile);
+	void release_tile(RenderTile& tile);
+	void map_neighbor_tiles(RenderTile *tiles, Device *device);
+	void unmap_neighbor_tiles(RenderTile *tiles, Device *device);
+};
+
+CCL_NAMESPACE_END
+
+#endif /* __DENOISING_H__ */
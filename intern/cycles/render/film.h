@@ -60,6 +60,8 @@ public:
 	bool denoising_data_pass;
 	bool denoising_clean_pass;
 	int denoising_flags;
+	/* Auxiliary half buffer and sample count passes for adaptive sampling. */
+	bool use_adaptive_sampling;
 	float pass_alpha_threshold;
 
 	int pass_stride;
@@ -17,6 +17,7 @@
 #include "device/device.h"
 #include "render/image.h"
 #include "render/scene.h"
+#include "render/texture_cache.h"
 
 #include "util/util_foreach.h"
 #include "util/util_logging.h"
@@ -50,6 +51,12 @@ ImageManager::ImageManager(const DeviceInfo& info)
 	max_num_images = TEX_NUM_MAX;
 	has_half_images = info.has_half_images;
 
+	/* Cached textures are looked up by calling back into the host, sparse
+	 * grids are only implemented for CPU kernels. */
+	texture_cache_supported = (info.type == DEVICE_CPU);
+	texture_cache = NULL;
+	sparse_grids_supported = (info.type == DEVICE_CPU);
+
 	for(size_t type = 0; type < IMAGE_DATA_NUM_TYPES; type++) {
 		tex_num_images[type] = 0;
 	}
@@ -61,6 +68,8 @@ ImageManager::~ImageManager()
 		for(size_t slot = 0; slot < images[type].size(); slot++)
 			assert(!images[type][slot]);
 	}
+
+	delete texture_cache;
 }
 
 void ImageManager::set_osl_texture_system(void *texture_system)
@@ -68,6 +77,37 @@ void ImageManager::set_osl_texture_system(void *texture_system)
 	osl_texture_system = texture_system;
 }
 
+void ImageManager::set_texture_cache(bool use_texture_cache, int max_memory_mb)
+{
+	delete texture_cache;
+	texture_cache = NULL;
+
+	if(use_texture_cache && texture_cache_supported) {
+		texture_cache = new TextureCache(max_memory_mb);
+	}
+}
+
+bool ImageManager::can_use_texture_cache(void *builtin_data,
+                                         bool use_alpha,
+                                         const ImageMetaData& metadata)
+{
+	/* Builtin images are already in memory, and the texture system does not
+	 * do volumes. It also always associates alpha, so ignoring the alpha
+	 * channel is only possible when loading the full image. */
+	return texture_cache &&
+	       !builtin_data &&
+	       metadata.depth <= 1 &&
+	       (use_alpha || (metadata.channels != 2 && metadata.channels != 4));
+}
+
+bool ImageManager::image_use_texture_cache(int flat_slot)
+{
+	ImageDataType type;
+	int slot = flattened_slot_to_type_index(flat_slot, &type);
+
+	return images[type][slot]->use_texture_cache;
+}
+
 bool ImageManager::set_animation_frame_update(int frame)
 {
 	if(frame != animation_frame) {
@@ -94,6 +134,14 @@ device_memory *ImageManager::image_memory(int flat_slot)
 	   return img->mem;
 }
 
+const ImageSparseGrid *ImageManager::image_sparse_grid(int flat_slot)
+{
+	ImageDataType type;
+	int slot = flattened_slot_to_type_index(flat_slot, &type);
+
+	return images[type][slot]->sparse_grid;
+}
+
 bool ImageManager::get_image_metadata(const string& filename,
                                       void *builtin_data,
                                       ImageMetaData& metadata)
@@ -296,6 +344,9 @@ int ImageManager::add_image(const string& filename,
 			}
 			if(img->use_alpha != use_alpha) {
 				img->use_alpha = use_alpha;
+				img->use_texture_cache = can_use_texture_cache(builtin_data,
+				                                               use_alpha,
+				                                               metadata);
 				img->need_load = true;
 			}
 			img->users++;
@@ -338,6 +389,9 @@ int ImageManager::add_image(const string& filename,
 	img->users = 1;
 	img->use_alpha = use_alpha;
 	img->mem = NULL;
+	img->use_texture_cache = can_use_texture_cache(builtin_data, use_alpha, metadata);
+	img->cached_texture = NULL;
+	img->sparse_grid = NULL;
 
 	images[type][slot] = img;
 
@@ -491,6 +545,16 @@ bool ImageManager::file_load_image(Image *img,
                                    int texture_limit,
                                    device_vector<DeviceType>& tex_img)
 {
+	if(img->cached_texture) {
+		/* Texels are read on demand by the texture cache, the device only
+		 * needs a placeholder to put into the texture slot. */
+		thread_scoped_lock device_lock(device_mutex);
+		StorageType *pixels = (StorageType*)tex_img.alloc(1, 1);
+		memset(pixels, 0, tex_img.memory_size());
+		tex_img.cached_texture = img->cached_texture;
+		return true;
+	}
+
 	const StorageType alpha_one = (FileFormat == TypeDesc::UINT8)? 255 : 1;
 	ImageInput *in = NULL;
 	int width, height, depth, components;
@@ -682,6 +746,117 @@ bool ImageManager::file_load_image(Image *img,
 	return true;
 }
 
+template<typename DeviceType>
+void ImageManager::image_make_sparse(Image *img, device_vector<DeviceType>& tex_img)
+{
+	/* Only float grids, which is what smoke and fire are stored as. */
+	const int channels = sizeof(DeviceType) / sizeof(float);
+	const int3 resolution = make_int3(tex_img.data_width,
+	                                  tex_img.data_height,
+	                                  tex_img.data_depth);
+	const float *voxels = (const float*)tex_img.data();
+
+	ImageSparseGrid *grid = new ImageSparseGrid();
+	grid->resolution = resolution;
+	grid->brick_resolution = make_int3(
+	        (resolution.x + TEX_SPARSE_BRICK_MASK) >> TEX_SPARSE_BRICK_SHIFT,
+	        (resolution.y + TEX_SPARSE_BRICK_MASK) >> TEX_SPARSE_BRICK_SHIFT,
+	        (resolution.z + TEX_SPARSE_BRICK_MASK) >> TEX_SPARSE_BRICK_SHIFT);
+
+	const int3 bricks = grid->brick_resolution;
+	const size_t num_bricks = ((size_t)bricks.x) * bricks.y * bricks.z;
+	grid->offsets.resize(num_bricks);
+	grid->brick_max.resize(num_bricks);
+
+	/* Find empty bricks, brick 0 is reserved for all of them. */
+	int num_active_bricks = 0;
+	for(int bz = 0; bz < bricks.z; bz++) {
+		for(int by = 0; by < bricks.y; by++) {
+			for(int bx = 0; bx < bricks.x; bx++) {
+				const int x0 = bx << TEX_SPARSE_BRICK_SHIFT;
+				const int y0 = by << TEX_SPARSE_BRICK_SHIFT;
+				const int z0 = bz << TEX_SPARSE_BRICK_SHIFT;
+				const int x1 = min(x0 + TEX_SPARSE_BRICK_SIZE, resolution.x);
+				const int y1 = min(y0 + TEX_SPARSE_BRICK_SIZE, resolution.y);
+				const int z1 = min(z0 + TEX_SPARSE_BRICK_SIZE, resolution.z);
+
+				bool empty = true;
+				float brick_max = 0.0f;
+				for(int z = z0; z < z1; z++) {
+					for(int y = y0; y < y1; y++) {
+						const float *row = voxels + (((size_t)z*resolution.y + y)*resolution.x + x0)*channels;
+						for(int i = 0; i < (x1 - x0)*channels; i++) {
+							if(row[i] != 0.0f) {
+								empty = false;
+								brick_max = max(brick_max, row[i]);
+							}
+						}
+					}
+				}
+
+				const int brick = grid->brick_index(bx, by, bz);
+				grid->offsets[brick] = empty? 0: ++num_active_bricks;
+				grid->brick_max[brick] = brick_max;
+			}
+		}
+	}
+
+	/* Keep dense storage unless a good part of the memory is saved. */
+	const size_t dense_size = ((size_t)resolution.x) * resolution.y * resolution.z;
+	const size_t sparse_size = (num_active_bricks + 1) * (size_t)TEX_SPARSE_BRICK_VOXELS;
+	if(sparse_size > dense_size - dense_size/4) {
+		delete grid;
+		return;
+	}
+
+	vector<float> sparse_voxels(sparse_size * channels, 0.0f);
+	for(int bz = 0; bz < bricks.z; bz++) {
+		for(int by = 0; by < bricks.y; by++) {
+			for(int bx = 0; bx < bricks.x; bx++) {
+				const int offset = grid->offsets[grid->brick_index(bx, by, bz)];
+				if(offset == 0) {
+					continue;
+				}
+
+				const int x0 = bx << TEX_SPARSE_BRICK_SHIFT;
+				const int y0 = by << TEX_SPARSE_BRICK_SHIFT;
+				const int z0 = bz << TEX_SPARSE_BRICK_SHIFT;
+				const int x1 = min(x0 + TEX_SPARSE_BRICK_SIZE, resolution.x);
+				const int y1 = min(y0 + TEX_SPARSE_BRICK_SIZE, resolution.y);
+				const int z1 = min(z0 + TEX_SPARSE_BRICK_SIZE, resolution.z);
+
+				float *brick_voxels = &sparse_voxels[(size_t)offset * TEX_SPARSE_BRICK_VOXELS * channels];
+				for(int z = z0; z < z1; z++) {
+					for(int y = y0; y < y1; y++) {
+						const float *row = voxels + (((size_t)z*resolution.y + y)*resolution.x + x0)*channels;
+						float *brick_row = brick_voxels + (((z - z0)*TEX_SPARSE_BRICK_SIZE + (y - y0)) *
+						                                   TEX_SPARSE_BRICK_SIZE)*channels;
+						memcpy(brick_row, row, sizeof(float)*(x1 - x0)*channels);
+					}
+				}
+			}
+		}
+	}
+
+	VLOG(1) << "Sparse grid " << img->filename << ": "
+	        << num_active_bricks << " of " << num_bricks << " bricks active, "
+	        << string_human_readable_size(dense_size * sizeof(DeviceType)) << " dense, "
+	        << string_human_readable_size(sparse_size * sizeof(DeviceType)) << " sparse.";
+
+	/* Bricks are stored as a 1D array, with the grid size kept for lookups. */
+	{
+		thread_scoped_lock device_lock(device_mutex);
+		float *data = (float*)tex_img.alloc(sparse_size);
+		memcpy(data, &sparse_voxels[0], sizeof(float)*sparse_voxels.size());
+	}
+	tex_img.data_width = resolution.x;
+	tex_img.data_height = resolution.y;
+	tex_img.data_depth = resolution.z;
+	tex_img.sparse_offsets = &grid->offsets[0];
+
+	img->sparse_grid = grid;
+}
+
 void ImageManager::device_load_image(Device *device,
                                      Scene *scene,
                                      ImageDataType type,
@@ -711,6 +886,21 @@ void ImageManager::device_load_image(Device *device,
 		delete img->mem;
 		img->mem = NULL;
 	}
+	if(img->cached_texture) {
+		delete img->cached_texture;
+		img->cached_texture = NULL;
+		texture_cache->invalidate(img->filename);
+	}
+	delete img->sparse_grid;
+	img->sparse_grid = NULL;
+
+	/* Cached images are not loaded here, only opened to check if they can
+	 * be read. On failure the image is loaded fully as usual. */
+	if(img->use_texture_cache) {
+		img->cached_texture = texture_cache->add_texture(img->filename,
+		                                                 img->interpolation,
+		                                                 img->extension);
+	}
 
 	/* Create new texture. */
 	if(type == IMAGE_DATA_TYPE_FLOAT4) {
@@ -731,6 +921,9 @@ void ImageManager::device_load_image(Device *device,
 			pixels[2] = TEX_IMAGE_MISSING_B;
 			pixels[3] = TEX_IMAGE_MISSING_A;
 		}
+		else if(sparse_grids_supported && tex_img->data_depth > 1) {
+			image_make_sparse(img, *tex_img);
+		}
 
 		img->mem = tex_img;
 		img->mem->interpolation = img->interpolation;
@@ -754,6 +947,9 @@ void ImageManager::device_load_image(Device *device,
 
 			pixels[0] = TEX_IMAGE_MISSING_R;
 		}
+		else if(sparse_grids_supported && tex_img->data_depth > 1) {
+			image_make_sparse(img, *tex_img);
+		}
 
 		img->mem = tex_img;
 		img->mem->interpolation = img->interpolation;
@@ -878,6 +1074,12 @@ void ImageManager::device_free_image(Device *, ImageDataType type, int slot)
 			delete img->mem;
 		}
 
+		if(img->cached_texture) {
+			delete img->cached_texture;
+			texture_cache->invalidate(img->filename);
+		}
+
+		delete img->sparse_grid;
 		delete img;
 		images[type][slot] = NULL;
 		--tex_num_images[type];
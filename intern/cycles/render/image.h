@@ -30,6 +30,7 @@ CCL_NAMESPACE_BEGIN
 class Device;
 class Progress;
 class Scene;
+class TextureCache;
 
 class ImageMetaData {
 public:
@@ -44,6 +45,25 @@ public:
 	bool is_linear;
 };
 
+/* 3D image stored as bricks of TEX_SPARSE_BRICK_SIZE^3 voxels, where bricks
+ * with all voxels zero are left out. */
+class ImageSparseGrid {
+public:
+	int3 resolution;
+	int3 brick_resolution;
+	/* Index of every brick in the image data. Empty bricks share the first
+	 * brick, which is all zeros. */
+	vector<int> offsets;
+	/* Largest value of any channel in every brick, so empty space can be
+	 * found without reading the voxels. */
+	vector<float> brick_max;
+
+	int brick_index(int x, int y, int z) const
+	{
+		return x + (y + z*brick_resolution.y)*brick_resolution.x;
+	}
+};
+
 class ImageManager {
 public:
 	explicit ImageManager(const DeviceInfo& info);
@@ -85,7 +105,15 @@ public:
 	void set_osl_texture_system(void *texture_system);
 	bool set_animation_frame_update(int frame);
 
+	/* Read image files on demand through the texture cache, rather than
+	 * loading them fully. Only supported on the CPU, must be set before
+	 * any images are added. */
+	void set_texture_cache(bool use_texture_cache, int max_memory_mb);
+	bool image_use_texture_cache(int flat_slot);
+
 	device_memory *image_memory(int flat_slot);
+	/* Brick layout of sparse 3D images, NULL for dense images. */
+	const ImageSparseGrid *image_sparse_grid(int flat_slot);
 
 	bool need_update;
 
@@ -122,6 +150,11 @@ public:
 		string mem_name;
 		device_memory *mem;
 
+		bool use_texture_cache;
+		CachedTexture *cached_texture;
+
+		ImageSparseGrid *sparse_grid;
+
 		int users;
 	};
 
@@ -136,6 +169,14 @@ private:
 	vector<Image*> images[IMAGE_DATA_NUM_TYPES];
 	void *osl_texture_system;
 
+	bool texture_cache_supported;
+	TextureCache *texture_cache;
+	bool sparse_grids_supported;
+
+	bool can_use_texture_cache(void *builtin_data,
+	                           bool use_alpha,
+	                           const ImageMetaData& metadata);
+
 	bool file_load_image_generic(Image *img,
 	                             ImageInput **in,
 	                             int &width,
@@ -151,6 +192,9 @@ private:
 	                     int texture_limit,
 	                     device_vector<DeviceType>& tex_img);
 
+	template<typename DeviceType>
+	void image_make_sparse(Image *img, device_vector<DeviceType>& tex_img);
+
 	int max_flattened_slot(ImageDataType type);
 	int type_index_to_flattened_slot(int slot, ImageDataType type);
 	int flattened_slot_to_type_index(int flat_slot, ImageDataType *type);
@@ -68,6 +68,11 @@ public:
 	bool sample_all_lights_direct;
 	bool sample_all_lights_indirect;
 	float light_sampling_threshold;
+	bool use_light_tree;
+
+	/* Zero picks a value based on the number of AA samples. */
+	float adaptive_threshold;
+	int adaptive_min_samples;
 
 	enum Method {
 		BRANCHED_PATH = 0,
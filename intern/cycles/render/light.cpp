@@ -19,6 +19,7 @@
 #include "render/integrator.h"
 #include "render/film.h"
 #include "render/light.h"
+#include "render/light_tree.h"
 #include "render/mesh.h"
 #include "render/object.h"
 #include "render/scene.h"
@@ -254,6 +255,15 @@ void LightManager::device_update_distribution(Device *, DeviceScene *dscene, Sce
 
 	bool background_mis = false;
 
+	/* Light tree sampling relies on picking a single light, the branched path
+	 * integrator with sample all lights forces its own selection. */
+	const Integrator *integrator = scene->integrator;
+	const bool use_light_tree = integrator->use_light_tree &&
+	        !(integrator->method == Integrator::BRANCHED_PATH &&
+	          (integrator->sample_all_lights_direct || integrator->sample_all_lights_indirect));
+	vector<LightTreePrimitive> tree_prims;
+	vector<uint> tree_infinite_lights;
+
 	foreach(Light *light, scene->lights) {
 		if(light->is_enabled) {
 			num_lights++;
@@ -334,6 +344,7 @@ void LightManager::device_update_distribution(Device *, DeviceScene *dscene, Sce
 			                         : scene->default_surface;
 
 			if(shader->use_mis && shader->has_surface_emission) {
+				const int distribution_id = (int)offset;
 				distribution[offset].totarea = totarea;
 				distribution[offset].prim = i + mesh->tri_offset;
 				distribution[offset].mesh_light.shader_flag = shader_flag;
@@ -354,7 +365,28 @@ void LightManager::device_update_distribution(Device *, DeviceScene *dscene, Sce
 					p3 = transform_point(&tfm, p3);
 				}
 
-				totarea += triangle_area(p1, p2, p3);
+				const float area = triangle_area(p1, p2, p3);
+				totarea += area;
+
+				if(use_light_tree) {
+					/* Mesh lights emit from both sides, so only position and power
+					 * bound them. Arbitrary shaders are assumed to emit one unit. */
+					float3 emission;
+					float strength = 1.0f;
+					if(shader->is_constant_emission(&emission)) {
+						strength = max(average(emission), 0.0f);
+					}
+
+					LightTreePrimitive prim;
+					prim.bbox = BoundBox(p1);
+					prim.bbox.grow(p2);
+					prim.bbox.grow(p3);
+					prim.energy = area * strength;
+					prim.distribution_id = distribution_id;
+					if(prim.energy > 0.0f) {
+						tree_prims.push_back(prim);
+					}
+				}
 			}
 		}
 
@@ -378,6 +410,15 @@ void LightManager::device_update_distribution(Device *, DeviceScene *dscene, Sce
 		distribution[offset].lamp.size = light->size;
 		totarea += lightarea;
 
+		if(use_light_tree) {
+			if(light->type == LIGHT_DISTANT || light->type == LIGHT_BACKGROUND) {
+				tree_infinite_lights.push_back((uint)offset);
+			}
+			else {
+				light_tree_primitive(scene, light, (int)offset, tree_prims);
+			}
+		}
+
 		if(light->size > 0.0f && light->use_mis)
 			use_lamp_mis = true;
 		if(light->type == LIGHT_BACKGROUND) {
@@ -446,6 +487,12 @@ void LightManager::device_update_distribution(Device *, DeviceScene *dscene, Sce
 		/* CDF */
 		dscene->light_distribution.copy_to_device();
 
+		/* Light tree */
+		device_update_light_tree(dscene,
+		                         tree_prims,
+		                         tree_infinite_lights,
+		                         num_distribution);
+
 		/* Portals */
 		if(num_portals > 0) {
 			kintegrator->portal_offset = light_index;
@@ -460,7 +507,13 @@ void LightManager::device_update_distribution(Device *, DeviceScene *dscene, Sce
 	}
 	else {
 		dscene->light_distribution.free();
+		dscene->light_tree_nodes.free();
+		dscene->light_tree_emitters.free();
+		dscene->light_tree_leaf_emitters.free();
 
+		kintegrator->use_light_tree = false;
+		kintegrator->num_light_tree_infinite = 0;
+		kintegrator->light_tree_infinite_pdf = 0.0f;
 		kintegrator->num_distribution = 0;
 		kintegrator->num_all_lights = 0;
 		kintegrator->pdf_triangles = 0.0f;
@@ -474,6 +527,117 @@ void LightManager::device_update_distribution(Device *, DeviceScene *dscene, Sce
 	}
 }
 
+void LightManager::light_tree_primitive(Scene *scene,
+                                        Light *light,
+                                        int distribution_id,
+                                        vector<LightTreePrimitive>& prims)
+{
+	/* Rough estimate of the emitted power, only relative values matter. */
+	Shader *shader = (light->shader) ? light->shader : scene->default_light;
+	float3 emission;
+	float strength = 1.0f;
+	if(shader->is_constant_emission(&emission)) {
+		strength = max(average(emission), 0.0f);
+	}
+
+	LightTreePrimitive prim;
+	prim.energy = strength;
+	prim.distribution_id = distribution_id;
+
+	if(light->type == LIGHT_AREA) {
+		const float3 axisu = light->axisu*(light->sizeu*light->size);
+		const float3 axisv = light->axisv*(light->sizev*light->size);
+		const float3 corner = light->co - 0.5f*axisu - 0.5f*axisv;
+
+		prim.bbox = BoundBox(corner);
+		prim.bbox.grow(corner + axisu);
+		prim.bbox.grow(corner + axisv);
+		prim.bbox.grow(corner + axisu + axisv);
+		/* Single sided. */
+		prim.orientation = LightTreeOrientation(safe_normalize(light->dir), 0.0f, M_PI_2_F);
+	}
+	else {
+		prim.bbox = BoundBox(light->co);
+		prim.bbox.grow(light->co, light->size);
+
+		if(light->type == LIGHT_SPOT) {
+			prim.orientation = LightTreeOrientation(safe_normalize(light->dir),
+			                                        0.0f,
+			                                        min(0.5f*light->spot_angle, M_PI_F));
+		}
+	}
+
+	if(prim.energy > 0.0f) {
+		prims.push_back(prim);
+	}
+}
+
+void LightManager::device_update_light_tree(DeviceScene *dscene,
+                                            const vector<LightTreePrimitive>& prims,
+                                            const vector<uint>& infinite_lights,
+                                            size_t num_distribution)
+{
+	KernelIntegrator *kintegrator = &dscene->data.integrator;
+
+	dscene->light_tree_nodes.free();
+	dscene->light_tree_emitters.free();
+	dscene->light_tree_leaf_emitters.free();
+
+	kintegrator->use_light_tree = false;
+	kintegrator->num_light_tree_infinite = 0;
+	kintegrator->light_tree_infinite_pdf = 0.0f;
+
+	if(prims.empty()) {
+		/* Nothing to gain over the distribution. */
+		return;
+	}
+
+	LightTree tree(prims, LIGHT_TREE_MAX_PRIMS_IN_LEAF);
+
+	VLOG(1) << "Light tree with " << tree.nodes.size() << " nodes for "
+	        << prims.size() << " emitters, "
+	        << infinite_lights.size() << " lights outside of the tree.";
+
+	/* Lights at infinity are picked with their regular probability and come
+	 * first, leaves reference the emitters after them. */
+	const int num_infinite = (int)infinite_lights.size();
+
+	KernelLightTreeNode *nodes = dscene->light_tree_nodes.alloc(tree.nodes.size());
+	for(size_t i = 0; i < tree.nodes.size(); i++) {
+		nodes[i] = tree.nodes[i];
+		if(nodes[i].num_emitters > 0) {
+			nodes[i].child_index += num_infinite;
+		}
+	}
+
+	uint *leaf_emitters = dscene->light_tree_leaf_emitters.alloc(num_infinite + tree.leaf_emitters.size());
+	for(int i = 0; i < num_infinite; i++) {
+		leaf_emitters[i] = infinite_lights[i];
+	}
+	for(size_t i = 0; i < tree.leaf_emitters.size(); i++) {
+		leaf_emitters[num_infinite + i] = tree.leaf_emitters[i];
+	}
+
+	KernelLightTreeEmitter *emitters = dscene->light_tree_emitters.alloc(num_distribution);
+	for(size_t i = 0; i < num_distribution; i++) {
+		emitters[i].energy = 0.0f;
+		emitters[i].leaf_index = -1;
+		emitters[i].pad1 = emitters[i].pad2 = 0;
+	}
+	for(size_t i = 0; i < prims.size(); i++) {
+		emitters[prims[i].distribution_id].energy = prims[i].energy;
+		emitters[prims[i].distribution_id].leaf_index = tree.prim_leaf[i];
+	}
+
+	dscene->light_tree_nodes.copy_to_device();
+	dscene->light_tree_emitters.copy_to_device();
+	dscene->light_tree_leaf_emitters.copy_to_device();
+
+	kintegrator->use_light_tree = true;
+	kintegrator->num_light_tree_infinite = num_infinite;
+	kintegrator->light_tree_infinite_pdf = num_infinite * kintegrator->pdf_lights;
+}
+
 static void background_cdf(int start,
                            int end,
                            int res,
@@ -869,6 +1033,9 @@ void LightManager::device_update(Device *device, DeviceScene *dscene, Scene *sce
 void LightManager::device_free(Device *, DeviceScene *dscene)
 {
 	dscene->light_distribution.free();
+	dscene->light_tree_nodes.free();
+	dscene->light_tree_emitters.free();
+	dscene->light_tree_leaf_emitters.free();
 	dscene->lights.free();
 	dscene->light_background_marginal_cdf.free();
 	dscene->light_background_conditional_cdf.free();
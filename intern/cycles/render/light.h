@@ -29,6 +29,7 @@ CCL_NAMESPACE_BEGIN
 class Device;
 class DeviceScene;
 class Object;
+struct LightTreePrimitive;
 class Progress;
 class Scene;
 class Shader;
@@ -78,6 +79,10 @@ public:
 	bool has_contribution(Scene *scene);
 };
 
+/* Small leaves keep the in-leaf power based selection cheap, larger ones keep
+ * the tree shallow for scenes with millions of emissive triangles. */
+#define LIGHT_TREE_MAX_PRIMS_IN_LEAF 4
+
 class LightManager {
 public:
 	bool use_light_visibility;
@@ -115,6 +120,15 @@ protected:
 	                              DeviceScene *dscene,
 	                              Scene *scene,
 	                              Progress& progress);
+	void device_update_light_tree(DeviceScene *dscene,
+	                              const vector<LightTreePrimitive>& prims,
+	                              const vector<uint>& infinite_lights,
+	                              size_t num_distribution);
+
+	void light_tree_primitive(Scene *scene,
+	                          Light *light,
+	                          int distribution_id,
+	                          vector<LightTreePrimitive>& prims);
 
 	/* Check whether light manager can use the object as a light-emissive. */
 	bool object_usable_as_light(Object *object);
@@ -0,0 +1,310 @@
+/*
+ * Copyright 2011-2018 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "render/light_tree.h"
+
+#include "util/util_algorithm.h"
+#include "util/util_math.h"
+
+CCL_NAMESPACE_BEGIN
+
+/* Orientation Bounds */
+
+float LightTreeOrientation::measure() const
+{
+	const float theta_w = min(theta_o + theta_e, M_PI_F);
+	const float cos_o = cosf(theta_o);
+	const float sin_o = sinf(theta_o);
+
+	return M_2PI_F * (1.0f - cos_o) +
+	       M_PI_2_F * (2.0f * theta_w * sin_o -
+	                   cosf(theta_o - 2.0f * theta_w) -
+	                   2.0f * theta_o * sin_o +
+	                   cos_o);
+}
+
+LightTreeOrientation LightTreeOrientation::merge(const LightTreeOrientation& cone_a,
+                                                 const LightTreeOrientation& cone_b)
+{
+	/* Make a the wider cone. */
+	const bool swap_cones = (cone_b.theta_o > cone_a.theta_o);
+	const LightTreeOrientation& a = swap_cones ? cone_b : cone_a;
+	const LightTreeOrientation& b = swap_cones ? cone_a : cone_b;
+
+	const float cos_d = clamp(dot(a.axis, b.axis), -1.0f, 1.0f);
+	const float theta_d = acosf(cos_d);
+	const float theta_e = max(a.theta_e, b.theta_e);
+
+	/* b is already inside of a. */
+	if(min(theta_d + b.theta_o, M_PI_F) <= a.theta_o) {
+		return LightTreeOrientation(a.axis, a.theta_o, theta_e);
+	}
+
+	const float theta_o = 0.5f * (a.theta_o + theta_d + b.theta_o);
+	if(theta_o >= M_PI_F) {
+		return LightTreeOrientation(a.axis, M_PI_F, theta_e);
+	}
+
+	/* Rotate the axis of a towards b, in the plane spanned by both. */
+	float3 ortho = b.axis - a.axis * cos_d;
+	float ortho_len = len(ortho);
+	if(ortho_len < 1e-6f) {
+		/* Opposite axes, any perpendicular direction works. */
+		ortho = (fabsf(a.axis.x) < 0.9f) ? make_float3(1.0f, 0.0f, 0.0f) : make_float3(0.0f, 1.0f, 0.0f);
+		ortho = ortho - a.axis * dot(a.axis, ortho);
+		ortho_len = len(ortho);
+	}
+	ortho /= ortho_len;
+
+	const float theta_r = theta_o - a.theta_o;
+	const float3 axis = normalize(a.axis * cosf(theta_r) + ortho * sinf(theta_r));
+
+	return LightTreeOrientation(axis, theta_o, theta_e);
+}
+
+/* Light Tree */
+
+struct LightTree::BucketLess {
+	int dim, bucket, num_buckets;
+	float min_dim, inv_extent;
+
+	BucketLess(int dim, int bucket, int num_buckets, float min_dim, float inv_extent)
+	: dim(dim), bucket(bucket), num_buckets(num_buckets), min_dim(min_dim), inv_extent(inv_extent)
+	{
+	}
+
+	bool operator()(const BuildPrim& prim) const
+	{
+		int b = (int)((prim.centroid[dim] - min_dim) * inv_extent);
+		return clamp(b, 0, num_buckets - 1) < bucket;
+	}
+};
+
+LightTree::LightTree(const vector<LightTreePrimitive>& prims,
+                     int max_prims_in_leaf)
+: prims_(prims),
+  max_prims_in_leaf_(max(max_prims_in_leaf, 1))
+{
+	if(prims.empty()) {
+		return;
+	}
+
+	build_prims_.resize(prims.size());
+	for(size_t i = 0; i < prims.size(); i++) {
+		build_prims_[i].index = (int)i;
+		build_prims_[i].centroid = prims[i].centroid();
+	}
+
+	nodes.reserve(2 * prims.size());
+	leaf_emitters.reserve(prims.size());
+	prim_leaf.resize(prims.size(), -1);
+
+	recursive_build(-1, 0, (int)prims.size());
+
+	build_prims_.clear();
+}
+
+int LightTree::recursive_build(int parent, int start, int end)
+{
+	BoundBox bbox = BoundBox::empty;
+	BoundBox centroid_bbox = BoundBox::empty;
+	LightTreeOrientation orientation = prims_[build_prims_[start].index].orientation;
+	float energy = 0.0f;
+
+	for(int i = start; i < end; i++) {
+		const LightTreePrimitive& prim = prims_[build_prims_[i].index];
+		bbox.grow(prim.bbox);
+		centroid_bbox.grow(build_prims_[i].centroid);
+		orientation = LightTreeOrientation::merge(orientation, prim.orientation);
+		energy += prim.energy;
+	}
+
+	const int node_index = (int)nodes.size();
+	nodes.push_back(KernelLightTreeNode());
+
+	KernelLightTreeNode& node = nodes[node_index];
+	node.bbox_min[0] = bbox.min.x;
+	node.bbox_min[1] = bbox.min.y;
+	node.bbox_min[2] = bbox.min.z;
+	node.bbox_max[0] = bbox.max.x;
+	node.bbox_max[1] = bbox.max.y;
+	node.bbox_max[2] = bbox.max.z;
+	node.axis[0] = orientation.axis.x;
+	node.axis[1] = orientation.axis.y;
+	node.axis[2] = orientation.axis.z;
+	node.theta_o = orientation.theta_o;
+	node.theta_e = orientation.theta_e;
+	node.energy = energy;
+	node.parent_index = parent;
+	node.pad = 0;
+
+	int mid;
+	if(end - start == 1 ||
+	   !find_split(start, end, bbox, centroid_bbox, orientation, &mid))
+	{
+		/* Leaf. */
+		node.child_index = (int)leaf_emitters.size();
+		node.num_emitters = end - start;
+
+		for(int i = start; i < end; i++) {
+			const int index = build_prims_[i].index;
+			leaf_emitters.push_back(prims_[index].distribution_id);
+			prim_leaf[index] = node_index;
+		}
+
+		return node_index;
+	}
+
+	/* Interior, note that the node reference is invalidated by the recursion. */
+	nodes[node_index].num_emitters = 0;
+	recursive_build(node_index, start, mid);
+	const int right = recursive_build(node_index, mid, end);
+	nodes[node_index].child_index = right;
+
+	return node_index;
+}
+
+bool LightTree::find_split(int start, int end,
+                           const BoundBox& bbox,
+                           const BoundBox& centroid_bbox,
+                           const LightTreeOrientation& orientation,
+                           int *r_mid)
+{
+	const int num_buckets = 12;
+	const int count = end - start;
+	const float3 extent = centroid_bbox.size();
+	const float max_extent = max(extent.x, max(extent.y, extent.z));
+
+	if(max_extent <= 0.0f) {
+		/* All centroids coincide, only split when the leaf would get too big. */
+		if(count <= max_prims_in_leaf_) {
+			return false;
+		}
+		*r_mid = start + count / 2;
+		return true;
+	}
+
+	struct Bucket {
+		BoundBox bbox;
+		LightTreeOrientation orientation;
+		float energy;
+		int count;
+	};
+
+	/* Surface area orientation heuristic, cost of a node is proportional to its
+	 * power, the area of its bounds and the solid angle its emitters cover. */
+	float best_cost = FLT_MAX;
+	int best_dim = -1, best_bucket = -1;
+
+	for(int dim = 0; dim < 3; dim++) {
+		if(extent[dim] <= 0.0f) {
+			continue;
+		}
+
+		Bucket buckets[num_buckets];
+		for(int b = 0; b < num_buckets; b++) {
+			buckets[b].bbox = BoundBox::empty;
+			buckets[b].energy = 0.0f;
+			buckets[b].count = 0;
+		}
+
+		const float inv_extent = num_buckets / extent[dim];
+		for(int i = start; i < end; i++) {
+			const LightTreePrimitive& prim = prims_[build_prims_[i].index];
+			int b = (int)((build_prims_[i].centroid[dim] - centroid_bbox.min[dim]) * inv_extent);
+			b = clamp(b, 0, num_buckets - 1);
+
+			if(buckets[b].count == 0) {
+				buckets[b].orientation = prim.orientation;
+			}
+			else {
+				buckets[b].orientation = LightTreeOrientation::merge(buckets[b].orientation, prim.orientation);
+			}
+			buckets[b].bbox.grow(prim.bbox);
+			buckets[b].energy += prim.energy;
+			buckets[b].count++;
+		}
+
+		/* Favor splitting along the longest axis, to avoid thin nodes. */
+		const float regularization = max_extent / extent[dim];
+
+		for(int split = 1; split < num_buckets; split++) {
+			Bucket left, right;
+			left.bbox = right.bbox = BoundBox::empty;
+			left.energy = right.energy = 0.0f;
+			left.count = right.count = 0;
+
+			for(int b = 0; b < num_buckets; b++) {
+				if(buckets[b].count == 0) {
+					continue;
+				}
+				Bucket& side = (b < split) ? left : right;
+				side.orientation = (side.count == 0) ?
+				        buckets[b].orientation :
+				        LightTreeOrientation::merge(side.orientation, buckets[b].orientation);
+				side.bbox.grow(buckets[b].bbox);
+				side.energy += buckets[b].energy;
+				side.count += buckets[b].count;
+			}
+
+			if(left.count == 0 || right.count == 0) {
+				continue;
+			}
+
+			const float cost = regularization *
+			        (left.energy * left.orientation.measure() * left.bbox.safe_area() +
+			         right.energy * right.orientation.measure() * right.bbox.safe_area());
+
+			if(cost < best_cost) {
+				best_cost = cost;
+				best_dim = dim;
+				best_bucket = split;
+			}
+		}
+	}
+
+	if(best_dim == -1) {
+		if(count <= max_prims_in_leaf_) {
+			return false;
+		}
+		*r_mid = start + count / 2;
+		return true;
+	}
+
+	/* Small sets become a leaf unless splitting actually helps. */
+	float energy = 0.0f;
+	for(int i = start; i < end; i++) {
+		energy += prims_[build_prims_[i].index].energy;
+	}
+	const float leaf_cost = energy * orientation.measure() * bbox.safe_area();
+	if(count <= max_prims_in_leaf_ && best_cost >= leaf_cost) {
+		return false;
+	}
+
+	BucketLess less(best_dim, best_bucket, num_buckets,
+	                centroid_bbox.min[best_dim],
+	                num_buckets / extent[best_dim]);
+	BuildPrim *mid = std::partition(&build_prims_[start], &build_prims_[start] + count, less);
+
+	*r_mid = (int)(mid - &build_prims_[0]);
+	if(*r_mid == start || *r_mid == end) {
+		*r_mid = start + count / 2;
+	}
+
+	return true;
+}
+
+CCL_NAMESPACE_END
@@ -0,0 +1,104 @@
+/*
+ * Copyright 2011-2018 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __LIGHT_TREE_H__
+#define __LIGHT_TREE_H__
+
+#include "kernel/kernel_types.h"
+
+#include "util/util_boundbox.h"
+#include "util/util_types.h"
+#include "util/util_vector.h"
+
+CCL_NAMESPACE_BEGIN
+
+/* Bounds on the directions an emitter sends light into: all normals are within
+ * theta_o of the axis, and each normal emits within theta_e of itself.
+ *
+ * See "Importance Sampling of Many Lights with Adaptive Tree Splitting",
+ * Conty Estevez and Kulla, 2018. */
+struct LightTreeOrientation {
+	float3 axis;
+	float theta_o;
+	float theta_e;
+
+	LightTreeOrientation()
+	: axis(make_float3(0.0f, 0.0f, 1.0f)), theta_o(M_PI_F), theta_e(M_PI_2_F)
+	{
+	}
+
+	LightTreeOrientation(const float3& axis_, float theta_o_, float theta_e_)
+	: axis(axis_), theta_o(theta_o_), theta_e(theta_e_)
+	{
+	}
+
+	/* Solid angle measure used by the split heuristic. */
+	float measure() const;
+
+	static LightTreeOrientation merge(const LightTreeOrientation& a,
+	                                  const LightTreeOrientation& b);
+};
+
+struct LightTreePrimitive {
+	BoundBox bbox;
+	LightTreeOrientation orientation;
+	float energy;
+	/* Index into the light distribution. */
+	int distribution_id;
+
+	float3 centroid() const
+	{
+		return bbox.center();
+	}
+};
+
+/* Bounding volume hierarchy over all local emitters, used to pick a light
+ * proportional to its estimated contribution to the shading point.
+ * Lights at infinity (sun, background) are not part of the tree. */
+class LightTree {
+public:
+	LightTree(const vector<LightTreePrimitive>& prims,
+	          int max_prims_in_leaf);
+
+	/* Flattened in depth first order, left child following its parent. */
+	vector<KernelLightTreeNode> nodes;
+	/* Distribution indices of emitters, grouped per leaf. */
+	vector<uint> leaf_emitters;
+	/* Leaf node of every primitive, in input order. */
+	vector<int> prim_leaf;
+
+protected:
+	struct BuildPrim {
+		int index;
+		float3 centroid;
+	};
+	struct BucketLess;
+
+	int recursive_build(int parent, int start, int end);
+	bool find_split(int start, int end,
+	                const BoundBox& bbox,
+	                const BoundBox& centroid_bbox,
+	                const LightTreeOrientation& orientation,
+	                int *r_mid);
+
+	const vector<LightTreePrimitive>& prims_;
+	vector<BuildPrim> build_prims_;
+	int max_prims_in_leaf_;
+};
+
+CCL_NAMESPACE_END
+
+#endif  /* __LIGHT_TREE_H__ */
@@ -419,6 +419,8 @@ Mesh::Mesh()
 {
 	need_update = true;
 	need_update_rebuild = false;
+	need_update_packed = true;
+	need_update_packed_attributes = true;
 	transform_applied = false;
 	transform_negative_scaled = false;
 	transform_normal = transform_identity();
@@ -433,10 +435,14 @@ Mesh::Mesh()
 	curvekey_offset = 0;
 
 	patch_offset = 0;
+	patch_table_offset = 0;
 	face_offset = 0;
 	corner_offset = 0;
 
 	attr_map_offset = 0;
+	attr_float_offset = 0;
+	attr_float3_offset = 0;
+	attr_uchar4_offset = 0;
 
 	num_subd_verts = 0;
 
@@ -1166,10 +1172,13 @@ MeshManager::MeshManager()
 {
 	need_update = true;
 	need_flags_update = true;
+	bvh_instances = new BVHInstances();
+	need_update_bvh_instances = true;
 }
 
 MeshManager::~MeshManager()
 {
+	delete bvh_instances;
 }
 
 void MeshManager::update_osl_attributes(Device *device, Scene *scene, vector<AttributeRequestSet>& mesh_attributes)
@@ -1430,7 +1439,8 @@ static void update_attribute_element_offset(Mesh *mesh,
                                             Attribute *mattr,
                                             AttributePrimitive prim,
                                             TypeDesc& type,
-                                            AttributeDescriptor& desc)
+                                            AttributeDescriptor& desc,
+                                            bool copy_data)
 {
 	if(mattr) {
 		/* store element and type */
@@ -1454,8 +1464,10 @@ static void update_attribute_element_offset(Mesh *mesh,
 			offset = attr_uchar4_offset;
 
 			assert(attr_uchar4.size() >= offset + size);
-			for(size_t k = 0; k < size; k++) {
-				attr_uchar4[offset+k] = data[k];
+			if(copy_data) {
+				for(size_t k = 0; k < size; k++) {
+					attr_uchar4[offset+k] = data[k];
+				}
 			}
 			attr_uchar4_offset += size;
 		}
@@ -1464,8 +1476,10 @@ static void update_attribute_element_offset(Mesh *mesh,
 			offset = attr_float_offset;
 
 			assert(attr_float.size() >= offset + size);
-			for(size_t k = 0; k < size; k++) {
-				attr_float[offset+k] = data[k];
+			if(copy_data) {
+				for(size_t k = 0; k < size; k++) {
+					attr_float[offset+k] = data[k];
+				}
 			}
 			attr_float_offset += size;
 		}
@@ -1474,8 +1488,10 @@ static void update_attribute_element_offset(Mesh *mesh,
 			offset = attr_float3_offset;
 
 			assert(attr_float3.size() >= offset + size * 3);
-			for(size_t k = 0; k < size*3; k++) {
-				attr_float3[offset+k] = (&tfm->x)[k];
+			if(copy_data) {
+				for(size_t k = 0; k < size*3; k++) {
+					attr_float3[offset+k] = (&tfm->x)[k];
+				}
 			}
 			attr_float3_offset += size * 3;
 		}
@@ -1484,8 +1500,10 @@ static void update_attribute_element_offset(Mesh *mesh,
 			offset = attr_float3_offset;
 
 			assert(attr_float3.size() >= offset + size);
-			for(size_t k = 0; k < size; k++) {
-				attr_float3[offset+k] = data[k];
+			if(copy_data) {
+				for(size_t k = 0; k < size; k++) {
+					attr_float3[offset+k] = data[k];
+				}
 			}
 			attr_float3_offset += size;
 		}
@@ -1526,6 +1544,80 @@ static void update_attribute_element_offset(Mesh *mesh,
 	}
 }
 
+static bool attribute_requests_equal(const AttributeRequestSet& a,
+                                     const AttributeRequestSet& b)
+{
+	/* Order matters here, it determines the layout of the packed data. */
+	if(a.requests.size() != b.requests.size()) {
+		return false;
+	}
+
+	for(size_t i = 0; i < a.requests.size(); i++) {
+		if(a.requests[i].name != b.requests[i].name ||
+		   a.requests[i].std != b.requests[i].std)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static void device_pack_mesh_attributes(DeviceScene *dscene,
+                                        Mesh *mesh,
+                                        AttributeRequestSet *attributes)
+{
+	size_t attr_float_offset = mesh->attr_float_offset;
+	size_t attr_float3_offset = mesh->attr_float3_offset;
+	size_t attr_uchar4_offset = mesh->attr_uchar4_offset;
+
+	/* Descriptors are always filled in for the attribute maps, the data
+	 * is only copied if it's not in place yet. */
+	bool copy_data = mesh->need_update_packed_attributes;
+
+	/* todo: we now store std and name attributes from requests even if
+	 * they actually refer to the same mesh attributes, optimize */
+	foreach(AttributeRequest& req, attributes->requests) {
+		Attribute *triangle_mattr = mesh->attributes.find(req);
+		Attribute *curve_mattr = mesh->curve_attributes.find(req);
+		Attribute *subd_mattr = mesh->subd_attributes.find(req);
+
+		update_attribute_element_offset(mesh,
+		                                dscene->attributes_float, attr_float_offset,
+		                                dscene->attributes_float3, attr_float3_offset,
+		                                dscene->attributes_uchar4, attr_uchar4_offset,
+		                                triangle_mattr,
+		                                ATTR_PRIM_TRIANGLE,
+		                                req.triangle_type,
+		                                req.triangle_desc,
+		                                copy_data);
+
+		update_attribute_element_offset(mesh,
+		                                dscene->attributes_float, attr_float_offset,
+		                                dscene->attributes_float3, attr_float3_offset,
+		                                dscene->attributes_uchar4, attr_uchar4_offset,
+		                                curve_mattr,
+		                                ATTR_PRIM_CURVE,
+		                                req.curve_type,
+		                                req.curve_desc,
+		                                copy_data);
+
+		update_attribute_element_offset(mesh,
+		                                dscene->attributes_float, attr_float_offset,
+		                                dscene->attributes_float3, attr_float3_offset,
+		                                dscene->attributes_uchar4, attr_uchar4_offset,
+		                                subd_mattr,
+		                                ATTR_PRIM_SUBD,
+		                                req.subd_type,
+		                                req.subd_desc,
+		                                copy_data);
+	}
+
+	if(copy_data) {
+		mesh->packed_attributes = *attributes;
+	}
+}
+
 void MeshManager::device_update_attributes(Device *device, DeviceScene *dscene, Scene *scene, Progress& progress)
 {
 	progress.set_status("Updating Mesh", "Computing attributes");
@@ -1558,6 +1650,21 @@ void MeshManager::device_update_attributes(Device *device, DeviceScene *dscene,
 	for(size_t i = 0; i < scene->meshes.size(); i++) {
 		Mesh *mesh = scene->meshes[i];
 		AttributeRequestSet& attributes = mesh_attributes[i];
+
+		/* Data of meshes which kept their offsets and requested attributes
+		 * is still in place from the previous update. */
+		if(mesh->attr_float_offset != attr_float_size ||
+		   mesh->attr_float3_offset != attr_float3_size ||
+		   mesh->attr_uchar4_offset != attr_uchar4_size ||
+		   !attribute_requests_equal(mesh->packed_attributes, attributes))
+		{
+			mesh->need_update_packed_attributes = true;
+		}
+
+		mesh->attr_float_offset = attr_float_size;
+		mesh->attr_float3_offset = attr_float3_size;
+		mesh->attr_uchar4_offset = attr_uchar4_size;
+
 		foreach(AttributeRequest& req, attributes.requests) {
 			Attribute *triangle_mattr = mesh->attributes.find(req);
 			Attribute *curve_mattr = mesh->curve_attributes.find(req);
@@ -1584,56 +1691,33 @@ void MeshManager::device_update_attributes(Device *device, DeviceScene *dscene,
 		}
 	}
 
+	/* Arrays which change size lose their contents. */
+	if(dscene->attributes_float.size() != attr_float_size ||
+	   dscene->attributes_float3.size() != attr_float3_size ||
+	   dscene->attributes_uchar4.size() != attr_uchar4_size)
+	{
+		foreach(Mesh *mesh, scene->meshes) {
+			mesh->need_update_packed_attributes = true;
+		}
+	}
+
 	dscene->attributes_float.alloc(attr_float_size);
 	dscene->attributes_float3.alloc(attr_float3_size);
 	dscene->attributes_uchar4.alloc(attr_uchar4_size);
 
-	size_t attr_float_offset = 0;
-	size_t attr_float3_offset = 0;
-	size_t attr_uchar4_offset = 0;
+	/* Fill in attributes, meshes write to separate ranges of the arrays. */
+	TaskPool pool;
 
-	/* Fill in attributes. */
 	for(size_t i = 0; i < scene->meshes.size(); i++) {
-		Mesh *mesh = scene->meshes[i];
-		AttributeRequestSet& attributes = mesh_attributes[i];
-
-		/* todo: we now store std and name attributes from requests even if
-		 * they actually refer to the same mesh attributes, optimize */
-		foreach(AttributeRequest& req, attributes.requests) {
-			Attribute *triangle_mattr = mesh->attributes.find(req);
-			Attribute *curve_mattr = mesh->curve_attributes.find(req);
-			Attribute *subd_mattr = mesh->subd_attributes.find(req);
+		pool.push(function_bind(&device_pack_mesh_attributes,
+		                        dscene,
+		                        scene->meshes[i],
+		                        &mesh_attributes[i]));
+	}
 
-			update_attribute_element_offset(mesh,
-			                                dscene->attributes_float, attr_float_offset,
-			                                dscene->attributes_float3, attr_float3_offset,
-			                                dscene->attributes_uchar4, attr_uchar4_offset,
-			                                triangle_mattr,
-			                                ATTR_PRIM_TRIANGLE,
-			                                req.triangle_type,
-			                                req.triangle_desc);
-
-			update_attribute_element_offset(mesh,
-			                                dscene->attributes_float, attr_float_offset,
-			                                dscene->attributes_float3, attr_float3_offset,
-			                                dscene->attributes_uchar4, attr_uchar4_offset,
-			                                curve_mattr,
-			                                ATTR_PRIM_CURVE,
-			                                req.curve_type,
-			                                req.curve_desc);
-
-			update_attribute_element_offset(mesh,
-			                                dscene->attributes_float, attr_float_offset,
-			                                dscene->attributes_float3, attr_float3_offset,
-			                                dscene->attributes_uchar4, attr_uchar4_offset,
-			                                subd_mattr,
-			                                ATTR_PRIM_SUBD,
-			                                req.subd_type,
-			                                req.subd_desc);
+	pool.wait_work();
 
-			if(progress.get_cancel()) return;
-		}
-	}
+	if(progress.get_cancel()) return;
 
 	/* create attribute lookup maps */
 	if(scene->shader_manager->use_osl())
@@ -1676,6 +1760,18 @@ void MeshManager::mesh_calc_offset(Scene *scene)
 	size_t corner_size = 0;
 
 	foreach(Mesh *mesh, scene->meshes) {
+		/* Packed data of meshes which moved has to be written again. */
+		if(mesh->vert_offset != vert_size ||
+		   mesh->tri_offset != tri_size ||
+		   mesh->curvekey_offset != curve_key_size ||
+		   mesh->curve_offset != curve_size ||
+		   mesh->patch_offset != patch_size ||
+		   mesh->face_offset != face_size ||
+		   mesh->corner_offset != corner_size)
+		{
+			mesh->need_update_packed = true;
+		}
+
 		mesh->vert_offset = vert_size;
 		mesh->tri_offset = tri_size;
 
@@ -1698,6 +1794,9 @@ void MeshManager::mesh_calc_offset(Scene *scene)
 
 			/* patch tables are stored in same array so include them in patch_size */
 			if(mesh->patch_table) {
+				if(mesh->patch_table_offset != patch_size) {
+					mesh->need_update_packed = true;
+				}
 				mesh->patch_table_offset = patch_size;
 				patch_size += mesh->patch_table->total_size();
 			}
@@ -1707,6 +1806,58 @@ void MeshManager::mesh_calc_offset(Scene *scene)
 	}
 }
 
+static void device_pack_mesh(Scene *scene,
+                             DeviceScene *dscene,
+                             Mesh *mesh,
+                             const vector<uint> *tri_prim_index)
+{
+	if(dscene->tri_vindex.size()) {
+		uint4 *tri_vindex = dscene->tri_vindex.data() + mesh->tri_offset;
+
+		if(mesh->need_update_packed) {
+			mesh->pack_shaders(scene,
+			                   dscene->tri_shader.data() + mesh->tri_offset);
+			mesh->pack_normals(dscene->tri_vnormal.data() + mesh->vert_offset);
+			mesh->pack_verts(*tri_prim_index,
+			                 tri_vindex,
+			                 dscene->tri_patch.data() + mesh->tri_offset,
+			                 dscene->tri_patch_uv.data() + mesh->vert_offset,
+			                 mesh->vert_offset,
+			                 mesh->tri_offset);
+		}
+		else {
+			/* Only the primitive index depends on the scene BVH, which is
+			 * built again on every update. */
+			size_t num_triangles = mesh->num_triangles();
+
+			for(size_t i = 0; i < num_triangles; i++) {
+				tri_vindex[i].w = (*tri_prim_index)[i + mesh->tri_offset];
+			}
+		}
+	}
+
+	if(!mesh->need_update_packed) {
+		return;
+	}
+
+	if(dscene->curves.size()) {
+		mesh->pack_curves(scene,
+		                  dscene->curve_keys.data() + mesh->curvekey_offset,
+		                  dscene->curves.data() + mesh->curve_offset,
+		                  mesh->curvekey_offset);
+	}
+
+	if(dscene->patches.size()) {
+		uint *patch_data = dscene->patches.data();
+
+		mesh->pack_patches(&patch_data[mesh->patch_offset], mesh->vert_offset, mesh->face_offset, mesh->corner_offset);
+
+		if(mesh->patch_table) {
+			mesh->patch_table->copy_adjusting_offsets(&patch_data[mesh->patch_table_offset], mesh->patch_table_offset);
+		}
+	}
+}
+
 void MeshManager::device_update_mesh(Device *,
                                      DeviceScene *dscene,
                                      Scene *scene,
@@ -1763,31 +1914,73 @@ void MeshManager::device_update_mesh(Device *,
 		}
 	}
 
+	/* Meshes keep their packed ranges across updates, only meshes which
+	 * changed or moved are packed again. Arrays which change size lose their
+	 * contents, shader ids change when shaders are added or removed. */
+	if(dscene->tri_vindex.size() != tri_size ||
+	   dscene->tri_vnormal.size() != (tri_size? vert_size: 0) ||
+	   dscene->curve_keys.size() != (curve_size? curve_key_size: 0) ||
+	   dscene->curves.size() != curve_size ||
+	   dscene->patches.size() != patch_size ||
+	   packed_shaders != scene->shaders)
+	{
+		foreach(Mesh *mesh, scene->meshes) {
+			mesh->need_update_packed = true;
+		}
+
+		packed_shaders = scene->shaders;
+	}
+
 	/* Fill in all the arrays. */
+	progress.set_status("Updating Mesh", "Packing meshes");
+
 	if(tri_size != 0) {
-		/* normals */
-		progress.set_status("Updating Mesh", "Computing normals");
+		dscene->tri_shader.alloc(tri_size);
+		dscene->tri_vnormal.alloc(vert_size);
+		dscene->tri_vindex.alloc(tri_size);
+		dscene->tri_patch.alloc(tri_size);
+		dscene->tri_patch_uv.alloc(vert_size);
+	}
+	else {
+		dscene->tri_shader.free();
+		dscene->tri_vnormal.free();
+		dscene->tri_vindex.free();
+		dscene->tri_patch.free();
+		dscene->tri_patch_uv.free();
+	}
 
-		uint *tri_shader = dscene->tri_shader.alloc(tri_size);
-		float4 *vnormal = dscene->tri_vnormal.alloc(vert_size);
-		uint4 *tri_vindex = dscene->tri_vindex.alloc(tri_size);
-		uint *tri_patch = dscene->tri_patch.alloc(tri_size);
-		float2 *tri_patch_uv = dscene->tri_patch_uv.alloc(vert_size);
+	if(curve_size != 0) {
+		dscene->curve_keys.alloc(curve_key_size);
+		dscene->curves.alloc(curve_size);
+	}
+	else {
+		dscene->curve_keys.free();
+		dscene->curves.free();
+	}
 
-		foreach(Mesh *mesh, scene->meshes) {
-			mesh->pack_shaders(scene,
-			                   &tri_shader[mesh->tri_offset]);
-			mesh->pack_normals(&vnormal[mesh->vert_offset]);
-			mesh->pack_verts(tri_prim_index,
-			                 &tri_vindex[mesh->tri_offset],
-			                 &tri_patch[mesh->tri_offset],
-			                 &tri_patch_uv[mesh->vert_offset],
-			                 mesh->vert_offset,
-			                 mesh->tri_offset);
-			if(progress.get_cancel()) return;
-		}
+	if(patch_size != 0) {
+		dscene->patches.alloc(patch_size);
+	}
+	else {
+		dscene->patches.free();
+	}
+
+	/* Meshes write to separate ranges of the arrays. */
+	TaskPool pool;
+
+	foreach(Mesh *mesh, scene->meshes) {
+		pool.push(function_bind(&device_pack_mesh,
+		                        scene,
+		                        dscene,
+		                        mesh,
+		                        &tri_prim_index));
+	}
 
-		/* vertex coordinates */
+	pool.wait_work();
+
+	if(progress.get_cancel()) return;
+
+	if(tri_size != 0) {
 		progress.set_status("Updating Mesh", "Copying Mesh to device");
 
 		dscene->tri_shader.copy_to_device();
@@ -1800,14 +1993,6 @@ void MeshManager::device_update_mesh(Device *,
 	if(curve_size != 0) {
 		progress.set_status("Updating Mesh", "Copying Strands to device");
 
-		float4 *curve_keys = dscene->curve_keys.alloc(curve_key_size);
-		float4 *curves = dscene->curves.alloc(curve_size);
-
-		foreach(Mesh *mesh, scene->meshes) {
-			mesh->pack_curves(scene, &curve_keys[mesh->curvekey_offset], &curves[mesh->curve_offset], mesh->curvekey_offset);
-			if(progress.get_cancel()) return;
-		}
-
 		dscene->curve_keys.copy_to_device();
 		dscene->curves.copy_to_device();
 	}
@@ -1815,18 +2000,6 @@ void MeshManager::device_update_mesh(Device *,
 	if(patch_size != 0) {
 		progress.set_status("Updating Mesh", "Copying Patches to device");
 
-		uint *patch_data = dscene->patches.alloc(patch_size);
-
-		foreach(Mesh *mesh, scene->meshes) {
-			mesh->pack_patches(&patch_data[mesh->patch_offset], mesh->vert_offset, mesh->face_offset, mesh->corner_offset);
-
-			if(mesh->patch_table) {
-				mesh->patch_table->copy_adjusting_offsets(&patch_data[mesh->patch_table_offset], mesh->patch_table_offset);
-			}
-
-			if(progress.get_cancel()) return;
-		}
-
 		dscene->patches.copy_to_device();
 	}
 
@@ -1845,6 +2018,29 @@ void MeshManager::device_update_mesh(Device *,
 	}
 }
 
+/* Size a global BVH array for the merged instance BVH's followed by the top
+ * level BVH, and write the top level part. The instance part is preserved
+ * unless it is going to be repacked. */
+template<typename T>
+static T *bvh_array_update(device_vector<T>& dvec,
+                           size_t instances_size,
+                           const array<T>& top_level,
+                           bool repack)
+{
+	const size_t size = instances_size + top_level.size();
+
+	if(size == 0) {
+		dvec.free();
+		return NULL;
+	}
+
+	T *data = (repack)? dvec.alloc(size): dvec.resize(size);
+	if(top_level.size()) {
+		memcpy(data + instances_size, top_level.data(), sizeof(T)*top_level.size());
+	}
+	return data;
+}
+
 void MeshManager::device_update_bvh(Device *device, DeviceScene *dscene, Scene *scene, Progress& progress)
 {
 	/* bvh build */
@@ -1864,10 +2060,26 @@ void MeshManager::device_update_bvh(Device *device, DeviceScene *dscene, Scene *
 	VLOG(1) << "Using " << bvh_layout_name(bparams.bvh_layout)
 	        << " layout.";
 
+	/* Merged instance BVH's are only repacked when one of them changed,
+	 * otherwise just the top level BVH over the objects is rebuilt. */
+	const bool repack = bvh_instances->update(bparams,
+	                                          scene->objects,
+	                                          need_update_bvh_instances);
+	if(repack) {
+		VLOG(1) << "Merging " << bvh_instances->num_nodes
+		        << " nodes of instanced mesh BVH's.";
+	}
+	else {
+		VLOG(1) << "Reusing merged BVH's of instanced meshes.";
+	}
+
 	BVH *bvh = BVH::create(bparams, scene->objects);
+	bvh->instances = bvh_instances;
 	bvh->build(progress);
 
 	if(progress.get_cancel()) {
+		/* Layout changed but the merged range was not written yet. */
+		need_update_bvh_instances |= repack;
 		delete bvh;
 		return;
 	}
@@ -1876,45 +2088,89 @@ void MeshManager::device_update_bvh(Device *device, DeviceScene *dscene, Scene *
 	progress.set_status("Updating Scene BVH", "Copying BVH to device");
 
 	PackedBVH& pack = bvh->pack;
+	const bool use_prim_time = (bparams.num_motion_triangle_steps > 0 ||
+	                            bparams.num_motion_curve_steps > 0);
+
+	/* The merged instance BVH's stay in place at the front of the arrays,
+	 * only the top level BVH after them is written. */
+	PackedBVHArrays arrays;
+	arrays.nodes = bvh_array_update(dscene->bvh_nodes,
+	                                bvh_instances->num_nodes,
+	                                pack.nodes,
+	                                repack);
+	arrays.leaf_nodes = bvh_array_update(dscene->bvh_leaf_nodes,
+	                                     bvh_instances->num_leaf_nodes,
+	                                     pack.leaf_nodes,
+	                                     repack);
+	arrays.prim_tri_index = bvh_array_update(dscene->prim_tri_index,
+	                                         bvh_instances->num_prims,
+	                                         pack.prim_tri_index,
+	                                         repack);
+	arrays.prim_tri_verts = bvh_array_update(dscene->prim_tri_verts,
+	                                         bvh_instances->num_prim_tri_verts,
+	                                         pack.prim_tri_verts,
+	                                         repack);
+	arrays.prim_type = bvh_array_update(dscene->prim_type,
+	                                    bvh_instances->num_prims,
+	                                    pack.prim_type,
+	                                    repack);
+	arrays.prim_visibility = bvh_array_update(dscene->prim_visibility,
+	                                          bvh_instances->num_prims,
+	                                          pack.prim_visibility,
+	                                          repack);
+	arrays.prim_index = bvh_array_update(dscene->prim_index,
+	                                     bvh_instances->num_prims,
+	                                     pack.prim_index,
+	                                     repack);
+	arrays.prim_object = bvh_array_update(dscene->prim_object,
+	                                      bvh_instances->num_prims,
+	                                      pack.prim_object,
+	                                      repack);
+	if(use_prim_time) {
+		arrays.prim_time = bvh_array_update(dscene->prim_time,
+		                                    bvh_instances->num_prims,
+		                                    pack.prim_time,
+		                                    repack);
+	}
+	else {
+		dscene->prim_time.free();
+		arrays.prim_time = NULL;
+	}
+
+	if(repack) {
+		bvh_instances->pack(arrays);
+	}
+	need_update_bvh_instances = false;
 
-	if(pack.nodes.size()) {
-		dscene->bvh_nodes.steal_data(pack.nodes);
+	if(dscene->bvh_nodes.size()) {
 		dscene->bvh_nodes.copy_to_device();
 	}
-	if(pack.leaf_nodes.size()) {
-		dscene->bvh_leaf_nodes.steal_data(pack.leaf_nodes);
+	if(dscene->bvh_leaf_nodes.size()) {
 		dscene->bvh_leaf_nodes.copy_to_device();
 	}
 	if(pack.object_node.size()) {
 		dscene->object_node.steal_data(pack.object_node);
 		dscene->object_node.copy_to_device();
 	}
-	if(pack.prim_tri_index.size()) {
-		dscene->prim_tri_index.steal_data(pack.prim_tri_index);
+	if(dscene->prim_tri_index.size()) {
 		dscene->prim_tri_index.copy_to_device();
 	}
-	if(pack.prim_tri_verts.size()) {
-		dscene->prim_tri_verts.steal_data(pack.prim_tri_verts);
+	if(dscene->prim_tri_verts.size()) {
 		dscene->prim_tri_verts.copy_to_device();
 	}
-	if(pack.prim_type.size()) {
-		dscene->prim_type.steal_data(pack.prim_type);
+	if(dscene->prim_type.size()) {
 		dscene->prim_type.copy_to_device();
 	}
-	if(pack.prim_visibility.size()) {
-		dscene->prim_visibility.steal_data(pack.prim_visibility);
+	if(dscene->prim_visibility.size()) {
 		dscene->prim_visibility.copy_to_device();
 	}
-	if(pack.prim_index.size()) {
-		dscene->prim_index.steal_data(pack.prim_index);
+	if(dscene->prim_index.size()) {
 		dscene->prim_index.copy_to_device();
 	}
-	if(pack.prim_object.size()) {
-		dscene->prim_object.steal_data(pack.prim_object);
+	if(dscene->prim_object.size()) {
 		dscene->prim_object.copy_to_device();
 	}
-	if(pack.prim_time.size()) {
-		dscene->prim_time.steal_data(pack.prim_time);
+	if(dscene->prim_time.size()) {
 		dscene->prim_time.copy_to_device();
 	}
 
@@ -2069,6 +2325,9 @@ void MeshManager::device_update(Device *device, DeviceScene *dscene, Scene *scen
 		}
 
 		if(mesh->need_update) {
+			mesh->need_update_packed = true;
+			mesh->need_update_packed_attributes = true;
+
 			/* Update normals. */
 			mesh->add_face_normals();
 			mesh->add_vertex_normals();
@@ -2136,11 +2395,13 @@ void MeshManager::device_update(Device *device, DeviceScene *dscene, Scene *scen
 	}
 
 	/* Device update. */
-	device_free(device, dscene);
+	device_free(device, dscene, false);
 
 	mesh_calc_offset(scene);
 	if(true_displacement_used) {
+		/* Overwrites prim_tri_verts, including the merged instance BVH's. */
 		device_update_mesh(device, dscene, scene, true, progress);
+		need_update_bvh_instances = true;
 	}
 	if(progress.get_cancel()) return;
 
@@ -2159,6 +2420,7 @@ void MeshManager::device_update(Device *device, DeviceScene *dscene, Scene *scen
 
 			if(mesh->need_build_bvh()) {
 				num_bvh++;
+				need_update_bvh_instances = true;
 			}
 		}
 	}
@@ -2168,7 +2430,7 @@ void MeshManager::device_update(Device *device, DeviceScene *dscene, Scene *scen
 
 	/* Device re-update after displacement. */
 	if(displacement_done) {
-		device_free(device, dscene);
+		device_free(device, dscene, false);
 
 		device_update_attributes(device, dscene, scene, progress);
 		if(progress.get_cancel()) return;
@@ -2219,6 +2481,11 @@ void MeshManager::device_update(Device *device, DeviceScene *dscene, Scene *scen
 	device_update_mesh(device, dscene, scene, false, progress);
 	if(progress.get_cancel()) return;
 
+	foreach(Mesh *mesh, scene->meshes) {
+		mesh->need_update_packed = false;
+		mesh->need_update_packed_attributes = false;
+	}
+
 	need_update = false;
 
 	if(true_displacement_used) {
@@ -2232,30 +2499,39 @@ void MeshManager::device_update(Device *device, DeviceScene *dscene, Scene *scen
 	}
 }
 
-void MeshManager::device_free(Device *device, DeviceScene *dscene)
+void MeshManager::device_free(Device *device, DeviceScene *dscene, bool force_free)
 {
-	dscene->bvh_nodes.free();
-	dscene->bvh_leaf_nodes.free();
+	if(force_free) {
+		dscene->tri_shader.free();
+		dscene->tri_vnormal.free();
+		dscene->tri_vindex.free();
+		dscene->tri_patch.free();
+		dscene->tri_patch_uv.free();
+		dscene->curves.free();
+		dscene->curve_keys.free();
+		dscene->patches.free();
+		dscene->attributes_float.free();
+		dscene->attributes_float3.free();
+		dscene->attributes_uchar4.free();
+
+		/* BVH arrays hold the merged instance BVH's, which are kept
+		 * between updates. */
+		dscene->bvh_nodes.free();
+		dscene->bvh_leaf_nodes.free();
+		dscene->prim_tri_verts.free();
+		dscene->prim_tri_index.free();
+		dscene->prim_type.free();
+		dscene->prim_visibility.free();
+		dscene->prim_index.free();
+		dscene->prim_object.free();
+		dscene->prim_time.free();
+
+		bvh_instances->clear();
+		need_update_bvh_instances = true;
+	}
+
 	dscene->object_node.free();
-	dscene->prim_tri_verts.free();
-	dscene->prim_tri_index.free();
-	dscene->prim_type.free();
-	dscene->prim_visibility.free();
-	dscene->prim_index.free();
-	dscene->prim_object.free();
-	dscene->prim_time.free();
-	dscene->tri_shader.free();
-	dscene->tri_vnormal.free();
-	dscene->tri_vindex.free();
-	dscene->tri_patch.free();
-	dscene->tri_patch_uv.free();
-	dscene->curves.free();
-	dscene->curve_keys.free();
-	dscene->patches.free();
 	dscene->attributes_map.free();
-	dscene->attributes_float.free();
-	dscene->attributes_float3.free();
-	dscene->attributes_uchar4.free();
 
 #ifdef WITH_OSL
 	OSLGlobals *og = (OSLGlobals*)device->osl_memory();
@@ -34,6 +34,7 @@ CCL_NAMESPACE_BEGIN
 
 class Attribute;
 class BVH;
+class BVHInstances;
 class Device;
 class DeviceScene;
 class Mesh;
@@ -237,6 +238,10 @@ public:
 	/* Update Flags */
 	bool need_update;
 	bool need_update_rebuild;
+	/* Packed device arrays of the mesh are outdated, because the mesh changed
+	 * or moved to other offsets in the arrays. Others are kept as they are. */
+	bool need_update_packed;
+	bool need_update_packed_attributes;
 
 	/* BVH */
 	BVH *bvh;
@@ -252,6 +257,11 @@ public:
 	size_t corner_offset;
 
 	size_t attr_map_offset;
+	size_t attr_float_offset;
+	size_t attr_float3_offset;
+	size_t attr_uchar4_offset;
+	/* Attribute requests the packed attribute data is laid out for. */
+	AttributeRequestSet packed_attributes;
 
 	size_t num_subd_verts;
 
@@ -345,13 +355,23 @@ public:
 	void device_update_preprocess(Device *device, Scene *scene, Progress& progress);
 	void device_update(Device *device, DeviceScene *dscene, Scene *scene, Progress& progress);
 
-	void device_free(Device *device, DeviceScene *dscene);
+	/* Unless forced, packed mesh and attribute arrays are kept, so meshes
+	 * which did not change don't need to be packed again. */
+	void device_free(Device *device, DeviceScene *dscene, bool force_free);
 
 	void tag_update(Scene *scene);
 
 	void create_volume_mesh(Scene *scene, Mesh *mesh, Progress &progress);
 
 protected:
+	/* Shaders the packed shader ids refer to, ids are indices in this list. */
+	vector<Shader*> packed_shaders;
+
+	/* BVH's of instanced meshes merged for the scene BVH, kept so only the
+	 * top level BVH is rebuilt when none of the instanced meshes changed. */
+	BVHInstances *bvh_instances;
+	bool need_update_bvh_instances;
+
 	/* Calculate verts/triangles/curves offsets in global arrays. */
 	void mesh_calc_offset(Scene *scene);
 
@@ -16,6 +16,7 @@
 
 #include "render/mesh.h"
 #include "render/attribute.h"
+#include "render/image.h"
 #include "render/scene.h"
 
 #include "util/util_foreach.h"
@@ -396,8 +397,28 @@ void VolumeMeshBuilder::convert_quads_to_tris(const vector<QuadData> &quads,
 struct VoxelAttributeGrid {
 	float *data;
 	int channels;
+	const ImageSparseGrid *sparse_grid;
 };
 
+static const float *voxel_attribute_value(const VoxelAttributeGrid &voxel_grid,
+                                          const int3 &resolution,
+                                          int x, int y, int z)
+{
+	const ImageSparseGrid *sparse_grid = voxel_grid.sparse_grid;
+
+	if(sparse_grid) {
+		const int brick = sparse_grid->brick_index(x >> TEX_SPARSE_BRICK_SHIFT,
+		                                           y >> TEX_SPARSE_BRICK_SHIFT,
+		                                           z >> TEX_SPARSE_BRICK_SHIFT);
+		const size_t voxel = (x & TEX_SPARSE_BRICK_MASK) +
+		                     (((z & TEX_SPARSE_BRICK_MASK) << TEX_SPARSE_BRICK_SHIFT) +
+		                      (y & TEX_SPARSE_BRICK_MASK)) * TEX_SPARSE_BRICK_SIZE;
+		return voxel_grid.data + (sparse_grid->offsets[brick] * (size_t)TEX_SPARSE_BRICK_VOXELS + voxel) * voxel_grid.channels;
+	}
+
+	return voxel_grid.data + compute_voxel_index(resolution, x, y, z) * voxel_grid.channels;
+}
+
 void MeshManager::create_volume_mesh(Scene *scene,
                                      Mesh *mesh,
                                      Progress& progress)
@@ -433,6 +454,7 @@ void MeshManager::create_volume_mesh(Scene *scene,
 		VoxelAttributeGrid voxel_grid;
 		voxel_grid.data = static_cast<float*>(image_memory->host_pointer);
 		voxel_grid.channels = image_memory->data_elements;
+		voxel_grid.sparse_grid = scene->image_manager->image_sparse_grid(voxel->slot);
 		voxel_grids.push_back(voxel_grid);
 	}
 
@@ -488,19 +510,50 @@ void MeshManager::create_volume_mesh(Scene *scene,
 	VolumeMeshBuilder builder(&volume_params);
 	const float isovalue = mesh->volume_isovalue;
 
-	for(int z = 0; z < resolution.z; ++z) {
-		for(int y = 0; y < resolution.y; ++y) {
-			for(int x = 0; x < resolution.x; ++x) {
-				size_t voxel_index = compute_voxel_index(resolution, x, y, z);
+	/* Visit voxels brick by brick, so that bricks which sparse grids know to
+	 * be below the isovalue can be skipped without reading any voxels. */
+	vector<const VoxelAttributeGrid*> brick_grids;
+	brick_grids.reserve(voxel_grids.size());
+
+	for(int bz = 0; bz < resolution.z; bz += TEX_SPARSE_BRICK_SIZE) {
+		for(int by = 0; by < resolution.y; by += TEX_SPARSE_BRICK_SIZE) {
+			for(int bx = 0; bx < resolution.x; bx += TEX_SPARSE_BRICK_SIZE) {
+				brick_grids.clear();
+
+				foreach(const VoxelAttributeGrid &voxel_grid, voxel_grids) {
+					const ImageSparseGrid *sparse_grid = voxel_grid.sparse_grid;
+					if(sparse_grid) {
+						const int brick = sparse_grid->brick_index(bx >> TEX_SPARSE_BRICK_SHIFT,
+						                                           by >> TEX_SPARSE_BRICK_SHIFT,
+						                                           bz >> TEX_SPARSE_BRICK_SHIFT);
+						if(sparse_grid->brick_max[brick] < isovalue) {
+							continue;
+						}
+					}
+					brick_grids.push_back(&voxel_grid);
+				}
 
-				for(size_t i = 0; i < voxel_grids.size(); ++i) {
-					const VoxelAttributeGrid &voxel_grid = voxel_grids[i];
-					const int channels = voxel_grid.channels;
+				if(brick_grids.empty()) {
+					continue;
+				}
 
-					for(int c = 0; c < channels; c++) {
-						if(voxel_grid.data[voxel_index * channels + c] >= isovalue) {
-							builder.add_node_with_padding(x, y, z);
-							break;
+				const int z_end = min(bz + TEX_SPARSE_BRICK_SIZE, resolution.z);
+				const int y_end = min(by + TEX_SPARSE_BRICK_SIZE, resolution.y);
+				const int x_end = min(bx + TEX_SPARSE_BRICK_SIZE, resolution.x);
+
+				for(int z = bz; z < z_end; ++z) {
+					for(int y = by; y < y_end; ++y) {
+						for(int x = bx; x < x_end; ++x) {
+							foreach(const VoxelAttributeGrid *voxel_grid, brick_grids) {
+								const float *value = voxel_attribute_value(*voxel_grid, resolution, x, y, z);
+
+								for(int c = 0; c < voxel_grid->channels; c++) {
+									if(value[c] >= isovalue) {
+										builder.add_node_with_padding(x, y, z);
+										break;
+									}
+								}
+							}
 						}
 					}
 				}
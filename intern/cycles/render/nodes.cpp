@@ -290,6 +290,39 @@ void ImageTextureNode::attributes(Shader *shader, AttributeRequestSet *attribute
 	ShaderNode::attributes(shader, attributes);
 }
 
+/* Attribute the texture coordinate of an image lookup is read from as is, so
+ * the lookup footprint can be computed from its differentials. */
+static uint image_texture_differential_attribute(SVMCompiler& compiler,
+                                                 ShaderInput *vector_in,
+                                                 TextureMapping& tex_mapping)
+{
+	if(!vector_in->link || !tex_mapping.skip()) {
+		return ATTR_STD_NOT_FOUND;
+	}
+
+	ShaderNode *texco = vector_in->link->parent;
+	if(texco->bump != SHADER_BUMP_NONE) {
+		return ATTR_STD_NOT_FOUND;
+	}
+
+	if(texco->type == TextureCoordinateNode::node_type) {
+		if(vector_in->link->name() == "UV" &&
+		   !((TextureCoordinateNode*)texco)->from_dupli)
+		{
+			return compiler.attribute(ATTR_STD_UV);
+		}
+	}
+	else if(texco->type == UVMapNode::node_type) {
+		UVMapNode *uvmap = (UVMapNode*)texco;
+		if(!uvmap->from_dupli) {
+			return (uvmap->attribute != "")? compiler.attribute(uvmap->attribute):
+			                                 compiler.attribute(ATTR_STD_UV);
+		}
+	}
+
+	return ATTR_STD_NOT_FOUND;
+}
+
 void ImageTextureNode::compile(SVMCompiler& compiler)
 {
 	ShaderInput *vector_in = input("Vector");
@@ -324,6 +357,17 @@ void ImageTextureNode::compile(SVMCompiler& compiler)
 					compiler.stack_assign_if_linked(alpha_out),
 					srgb),
 				projection);
+
+			/* Only images in the texture cache have mipmaps to filter with. */
+			uint differential_attr = ATTR_STD_NOT_FOUND;
+			if(projection == NODE_IMAGE_PROJ_FLAT &&
+			   image_manager->image_use_texture_cache(slot))
+			{
+				differential_attr = image_texture_differential_attribute(compiler,
+				                                                         vector_in,
+				                                                         tex_mapping);
+			}
+			compiler.add_node(differential_attr, 0, 0, 0);
 		}
 		else {
 			compiler.add_node(NODE_TEX_IMAGE_BOX,
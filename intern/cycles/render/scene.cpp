@@ -72,6 +72,9 @@ DeviceScene::DeviceScene(Device *device)
   lights(device, "__lights", MEM_TEXTURE),
   light_background_marginal_cdf(device, "__light_background_marginal_cdf", MEM_TEXTURE),
   light_background_conditional_cdf(device, "__light_background_conditional_cdf", MEM_TEXTURE),
+  light_tree_nodes(device, "__light_tree_nodes", MEM_TEXTURE),
+  light_tree_emitters(device, "__light_tree_emitters", MEM_TEXTURE),
+  light_tree_leaf_emitters(device, "__light_tree_leaf_emitters", MEM_TEXTURE),
   particles(device, "__particles", MEM_TEXTURE),
   svm_nodes(device, "__svm_nodes", MEM_TEXTURE),
   shaders(device, "__shaders", MEM_TEXTURE),
@@ -96,6 +99,9 @@ Scene::Scene(const SceneParams& params_, Device *device)
 	object_manager = new ObjectManager();
 	integrator = new Integrator();
 	image_manager = new ImageManager(device->info);
+	/* Texture limit is applied when loading images, which cached ones skip. */
+	image_manager->set_texture_cache(params.use_texture_cache && params.texture_limit == 0,
+	                                 params.texture_cache_size);
 	particle_system_manager = new ParticleSystemManager();
 	curve_system_manager = new CurveSystemManager();
 	bake_manager = new BakeManager();
@@ -138,7 +144,7 @@ void Scene::free_memory(bool final)
 		integrator->device_free(device, &dscene);
 
 		object_manager->device_free(device, &dscene);
-		mesh_manager->device_free(device, &dscene);
+		mesh_manager->device_free(device, &dscene, true);
 		shader_manager->device_free(device, &dscene, this);
 		light_manager->device_free(device, &dscene);
 
@@ -357,8 +363,12 @@ bool Scene::need_reset()
 
 void Scene::reset()
 {
-	shader_manager->reset(this);
-	shader_manager->add_default(this);
+	/* Shaders are kept along with other scene data when it persists between
+	 * renders, otherwise they were freed. */
+	if(shaders.empty()) {
+		shader_manager->reset(this);
+		shader_manager->add_default(this);
+	}
 
 	/* ensure all objects are updated */
 	camera->tag_update();
@@ -105,6 +105,9 @@ public:
 	device_vector<KernelLight> lights;
 	device_vector<float2> light_background_marginal_cdf;
 	device_vector<float2> light_background_conditional_cdf;
+	device_vector<KernelLightTreeNode> light_tree_nodes;
+	device_vector<KernelLightTreeEmitter> light_tree_emitters;
+	device_vector<uint> light_tree_leaf_emitters;
 
 	/* particles */
 	device_vector<KernelParticle> particles;
@@ -166,6 +169,11 @@ public:
 	bool persistent_data;
 	int texture_limit;
 
+	/* Read image textures on demand through a tiled, mipmapped cache of
+	 * limited size (in megabytes), rather than loading them fully. */
+	bool use_texture_cache;
+	int texture_cache_size;
+
 	SceneParams()
 	{
 		shadingsystem = SHADINGSYSTEM_SVM;
@@ -176,6 +184,8 @@ public:
 		num_bvh_time_steps = 0;
 		persistent_data = false;
 		texture_limit = 0;
+		use_texture_cache = false;
+		texture_cache_size = 1024;
 	}
 
 	bool modified(const SceneParams& params)
@@ -186,7 +196,9 @@ public:
 		&& use_bvh_unaligned_nodes == params.use_bvh_unaligned_nodes
 		&& num_bvh_time_steps == params.num_bvh_time_steps
 		&& persistent_data == params.persistent_data
-		&& texture_limit == params.texture_limit); }
+		&& texture_limit == params.texture_limit
+		&& use_texture_cache == params.use_texture_cache
+		&& texture_cache_size == params.texture_cache_size); }
 };
 
 /* Scene */
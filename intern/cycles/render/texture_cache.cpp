@@ -0,0 +1,156 @@
+/*
+ * Copyright 2011-2018 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "render/texture_cache.h"
+
+#include "util/util_logging.h"
+
+#include <OpenImageIO/texture.h>
+
+CCL_NAMESPACE_BEGIN
+
+/* Texture looked up through the OpenImageIO texture system. */
+class OIIOCachedTexture : public CachedTexture {
+public:
+	OIIOCachedTexture(OIIO::TextureSystem *texture_system,
+	                  OIIO::TextureSystem::TextureHandle *handle,
+	                  InterpolationType interpolation,
+	                  ExtensionType extension)
+	: texture_system(texture_system), handle(handle)
+	{
+		switch(interpolation) {
+			case INTERPOLATION_CLOSEST:
+				options.interpmode = TextureOpt::InterpClosest;
+				options.mipmode = TextureOpt::MipModeNoMIP;
+				break;
+			case INTERPOLATION_CUBIC:
+				options.interpmode = TextureOpt::InterpBicubic;
+				break;
+			case INTERPOLATION_SMART:
+				options.interpmode = TextureOpt::InterpSmartBicubic;
+				break;
+			case INTERPOLATION_LINEAR:
+			default:
+				options.interpmode = TextureOpt::InterpBilinear;
+				break;
+		}
+
+		switch(extension) {
+			case EXTENSION_EXTEND:
+				options.swrap = options.twrap = TextureOpt::WrapClamp;
+				break;
+			case EXTENSION_CLIP:
+				options.swrap = options.twrap = TextureOpt::WrapBlack;
+				break;
+			case EXTENSION_REPEAT:
+			default:
+				options.swrap = options.twrap = TextureOpt::WrapPeriodic;
+				break;
+		}
+
+		/* Images without alpha channel are opaque. */
+		options.fill = 1.0f;
+	}
+
+	float4 lookup(float x, float y,
+	              float dxdx, float dydx,
+	              float dxdy, float dydy)
+	{
+		/* Texture system is shared between threads, options are not. */
+		TextureOpt thread_options = options;
+		float result[4];
+
+		/* Image rows are stored bottom to top in Cycles. */
+		if(!texture_system->texture(handle,
+		                            texture_system->get_perthread_info(),
+		                            thread_options,
+		                            x, 1.0f - y,
+		                            dxdx, -dydx,
+		                            dxdy, -dydy,
+		                            4, result))
+		{
+			/* Don't let errors accumulate in the texture system. */
+			string error = texture_system->geterror();
+			(void)error;
+
+			return make_float4(TEX_IMAGE_MISSING_R,
+			                   TEX_IMAGE_MISSING_G,
+			                   TEX_IMAGE_MISSING_B,
+			                   TEX_IMAGE_MISSING_A);
+		}
+
+		return make_float4(result[0], result[1], result[2], result[3]);
+	}
+
+protected:
+	OIIO::TextureSystem *texture_system;
+	OIIO::TextureSystem::TextureHandle *handle;
+	TextureOpt options;
+};
+
+/* Texture Cache */
+
+TextureCache::TextureCache(int max_memory_mb)
+{
+	/* Private texture system, so the memory limit and file handles are not
+	 * shared with OSL or other renders. */
+	texture_system = OIIO::TextureSystem::create(false);
+
+	texture_system->attribute("automip", 1);
+	texture_system->attribute("autotile", 64);
+	texture_system->attribute("gray_to_rgb", 1);
+	texture_system->attribute("max_memory_MB", (float)max_memory_mb);
+}
+
+TextureCache::~TextureCache()
+{
+	VLOG(1) << "Texture cache statistics:\n"
+	        << texture_system->getstats();
+
+	texture_system->invalidate_all(true);
+	OIIO::TextureSystem::destroy(texture_system);
+}
+
+CachedTexture *TextureCache::add_texture(const string& filename,
+                                         InterpolationType interpolation,
+                                         ExtensionType extension)
+{
+	ustring name(filename);
+
+	/* Only the header is read here, pixels are read on the first lookup. */
+	int exists = 0;
+	if(!texture_system->get_texture_info(name, 0, ustring("exists"), TypeDesc::TypeInt, &exists) ||
+	   !exists)
+	{
+		string error = texture_system->geterror();
+		VLOG(1) << "Texture cache can not read " << filename << ": " << error;
+		return NULL;
+	}
+
+	OIIO::TextureSystem::TextureHandle *handle = texture_system->get_texture_handle(name);
+	if(!handle) {
+		return NULL;
+	}
+
+	return new OIIOCachedTexture(texture_system, handle, interpolation, extension);
+}
+
+void TextureCache::invalidate(const string& filename)
+{
+	texture_system->invalidate(ustring(filename));
+}
+
+CCL_NAMESPACE_END
@@ -0,0 +1,57 @@
+/*
+ * Copyright 2011-2018 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __TEXTURE_CACHE_H__
+#define __TEXTURE_CACHE_H__
+
+#include "util/util_image.h"
+#include "util/util_string.h"
+#include "util/util_texture.h"
+
+OIIO_NAMESPACE_BEGIN
+class TextureSystem;
+OIIO_NAMESPACE_END
+
+CCL_NAMESPACE_BEGIN
+
+/* Texture cache for image textures rendered on the CPU with SVM.
+ *
+ * Images are split into tiles and mipmapped by OpenImageIO, only the tiles
+ * touched by lookups are read from disk. Once the memory limit is reached,
+ * tiles which have not been used recently are evicted again. Files which
+ * are already tiled and mipmapped (as written by maketx) are used as is,
+ * others are converted when first opened. */
+class TextureCache {
+public:
+	explicit TextureCache(int max_memory_mb);
+	~TextureCache();
+
+	/* Returns NULL if the file can not be read, the caller owns the
+	 * returned texture. */
+	CachedTexture *add_texture(const string& filename,
+	                           InterpolationType interpolation,
+	                           ExtensionType extension);
+
+	/* Drop any tiles of the file, so it is read again on the next lookup. */
+	void invalidate(const string& filename);
+
+protected:
+	OIIO::TextureSystem *texture_system;
+};
+
+CCL_NAMESPACE_END
+
+#endif  /* __TEXTURE_CACHE_H__ */
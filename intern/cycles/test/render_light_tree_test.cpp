@@ -0,0 +1,160 @@
+/*
+ * Copyright 2011-2018 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "testing/testing.h"
+
+#include "render/light_tree.h"
+
+#include "util/util_math.h"
+
+CCL_NAMESPACE_BEGIN
+
+namespace {
+
+float3 test_direction(int i)
+{
+	const float phi = 2.399963f * i;
+	const float z = 1.0f - 2.0f * ((i % 17) + 0.5f) / 17.0f;
+	const float r = sqrtf(1.0f - z * z);
+	return make_float3(r * cosf(phi), r * sinf(phi), z);
+}
+
+vector<LightTreePrimitive> test_primitives(int num)
+{
+	vector<LightTreePrimitive> prims;
+	for(int i = 0; i < num; i++) {
+		LightTreePrimitive prim;
+		const float3 co = make_float3((i * 7) % 23, (i * 13) % 29, (i * 3) % 5);
+		prim.bbox = BoundBox(co);
+		prim.bbox.grow(co, 0.1f * (i % 4));
+		if(i % 2) {
+			prim.orientation = LightTreeOrientation(test_direction(i), 0.0f, 0.5f);
+		}
+		prim.energy = 1.0f + (i % 10);
+		prim.distribution_id = 100 + i;
+		prims.push_back(prim);
+	}
+	return prims;
+}
+
+bool cone_contains(const LightTreeOrientation& cone, const LightTreeOrientation& inner)
+{
+	const float theta_d = acosf(clamp(dot(cone.axis, inner.axis), -1.0f, 1.0f));
+	return (min(theta_d + inner.theta_o, M_PI_F) <= cone.theta_o + 1e-4f) &&
+	       (inner.theta_e <= cone.theta_e);
+}
+
+}  /* namespace */
+
+TEST(render_light_tree, orientation_merge)
+{
+	const LightTreeOrientation a(make_float3(0.0f, 0.0f, 1.0f), 0.0f, 0.5f);
+	const LightTreeOrientation b(make_float3(1.0f, 0.0f, 0.0f), 0.2f, 0.3f);
+	const LightTreeOrientation c(make_float3(0.0f, 0.0f, -1.0f), 0.0f, M_PI_2_F);
+
+	const LightTreeOrientation ab = LightTreeOrientation::merge(a, b);
+	EXPECT_TRUE(cone_contains(ab, a));
+	EXPECT_TRUE(cone_contains(ab, b));
+	EXPECT_NEAR(ab.theta_o, 0.5f * (M_PI_2_F + 0.2f), 1e-5f);
+	EXPECT_EQ(ab.theta_e, 0.5f);
+
+	/* Opposite axes. */
+	const LightTreeOrientation ac = LightTreeOrientation::merge(a, c);
+	EXPECT_TRUE(cone_contains(ac, a));
+	EXPECT_TRUE(cone_contains(ac, c));
+
+	/* Full sphere stays full. */
+	const LightTreeOrientation full;
+	const LightTreeOrientation full_a = LightTreeOrientation::merge(full, a);
+	EXPECT_EQ(full_a.theta_o, M_PI_F);
+
+	EXPECT_LT(a.measure(), ab.measure());
+	EXPECT_LT(ab.measure(), full.measure());
+}
+
+TEST(render_light_tree, build)
+{
+	const vector<LightTreePrimitive> prims = test_primitives(257);
+	LightTree tree(prims, 4);
+
+	ASSERT_FALSE(tree.nodes.empty());
+	EXPECT_EQ(tree.leaf_emitters.size(), prims.size());
+	EXPECT_EQ(tree.nodes[0].parent_index, -1);
+
+	float total_energy = 0.0f;
+	for(size_t i = 0; i < prims.size(); i++) {
+		total_energy += prims[i].energy;
+	}
+	EXPECT_NEAR(tree.nodes[0].energy, total_energy, 1e-3f);
+
+	for(size_t i = 0; i < tree.nodes.size(); i++) {
+		const KernelLightTreeNode& node = tree.nodes[i];
+
+		if(node.num_emitters == 0) {
+			/* Children point back, and carry all of the power. */
+			const KernelLightTreeNode& left = tree.nodes[i + 1];
+			const KernelLightTreeNode& right = tree.nodes[node.child_index];
+			EXPECT_EQ(left.parent_index, (int)i);
+			EXPECT_EQ(right.parent_index, (int)i);
+			EXPECT_NEAR(left.energy + right.energy, node.energy, 1e-3f * node.energy);
+		}
+		else {
+			EXPECT_LE(node.num_emitters, 4);
+			EXPECT_LE(node.child_index + node.num_emitters, (int)tree.leaf_emitters.size());
+		}
+	}
+
+	/* Every primitive ends up in the leaf it is mapped to, inside of its bounds. */
+	for(size_t i = 0; i < prims.size(); i++) {
+		const int leaf = tree.prim_leaf[i];
+		ASSERT_GE(leaf, 0);
+
+		const KernelLightTreeNode& node = tree.nodes[leaf];
+		bool found = false;
+		for(int j = 0; j < node.num_emitters; j++) {
+			if(tree.leaf_emitters[node.child_index + j] == (uint)prims[i].distribution_id) {
+				found = true;
+			}
+		}
+		EXPECT_TRUE(found);
+
+		EXPECT_LE(node.bbox_min[0], prims[i].bbox.min.x);
+		EXPECT_LE(node.bbox_min[1], prims[i].bbox.min.y);
+		EXPECT_LE(node.bbox_min[2], prims[i].bbox.min.z);
+		EXPECT_GE(node.bbox_max[0], prims[i].bbox.max.x);
+		EXPECT_GE(node.bbox_max[1], prims[i].bbox.max.y);
+		EXPECT_GE(node.bbox_max[2], prims[i].bbox.max.z);
+	}
+}
+
+TEST(render_light_tree, coincident_primitives)
+{
+	vector<LightTreePrimitive> prims = test_primitives(9);
+	for(size_t i = 0; i < prims.size(); i++) {
+		prims[i].bbox = BoundBox(make_float3(1.0f, 2.0f, 3.0f));
+	}
+
+	LightTree tree(prims, 4);
+
+	EXPECT_EQ(tree.leaf_emitters.size(), prims.size());
+	for(size_t i = 0; i < tree.nodes.size(); i++) {
+		if(tree.nodes[i].num_emitters > 0) {
+			EXPECT_LE(tree.nodes[i].num_emitters, 4);
+		}
+	}
+}
+
+CCL_NAMESPACE_END
@@ -21,11 +21,27 @@
 
 CCL_NAMESPACE_BEGIN
 
+/* Work done by the CPU kernels, counted per thread in the kernel globals
+ * and added to the device statistics once the thread is done. */
+struct KernelStats {
+	void reset() {
+		num_camera_rays = 0;
+		num_shadow_rays = 0;
+		num_indirect_rays = 0;
+		num_shader_evals = 0;
+	}
+
+	uint64_t num_camera_rays;
+	uint64_t num_shadow_rays;
+	uint64_t num_indirect_rays;
+	uint64_t num_shader_evals;
+};
+
 class Stats {
 public:
 	enum static_init_t { static_init = 0 };
 
-	Stats() : mem_used(0), mem_peak(0) {}
+	Stats() : mem_used(0), mem_peak(0) { kernel.reset(); }
 	explicit Stats(static_init_t) {}
 
 	void mem_alloc(size_t size) {
@@ -38,8 +54,17 @@ public:
 		atomic_sub_and_fetch_z(&mem_used, size);
 	}
 
+	void kernel_add(const KernelStats& other) {
+		atomic_add_and_fetch_uint64(&kernel.num_camera_rays, other.num_camera_rays);
+		atomic_add_and_fetch_uint64(&kernel.num_shadow_rays, other.num_shadow_rays);
+		atomic_add_and_fetch_uint64(&kernel.num_indirect_rays, other.num_indirect_rays);
+		atomic_add_and_fetch_uint64(&kernel.num_shader_evals, other.num_shader_evals);
+	}
+
 	size_t mem_used;
 	size_t mem_peak;
+
+	KernelStats kernel;
 };
 
 CCL_NAMESPACE_END
@@ -31,6 +31,13 @@ CCL_NAMESPACE_BEGIN
 /* Texture type. */
 #define kernel_tex_type(tex) (tex & IMAGE_DATA_TYPE_MASK)
 
+/* Sparse 3D textures are stored as bricks of voxels, the brick size must be
+ * a power of two. */
+#define TEX_SPARSE_BRICK_SHIFT 3
+#define TEX_SPARSE_BRICK_SIZE (1 << TEX_SPARSE_BRICK_SHIFT)
+#define TEX_SPARSE_BRICK_MASK (TEX_SPARSE_BRICK_SIZE - 1)
+#define TEX_SPARSE_BRICK_VOXELS (TEX_SPARSE_BRICK_SIZE * TEX_SPARSE_BRICK_SIZE * TEX_SPARSE_BRICK_SIZE)
+
 /* Interpolation types for textures
  * cuda also use texture space to store other objects */
 typedef enum InterpolationType {
@@ -83,8 +90,33 @@ typedef struct TextureInfo {
 	uint interpolation, extension;
 	/* Dimensions. */
 	uint width, height, depth;
+	/* CachedTexture to look up texels through on the CPU, zero when the
+	 * image is fully resident in memory. */
+	uint64_t cache;
+	/* Index of every brick into data for sparse 3D textures on the CPU,
+	 * zero for dense textures. */
+	uint64_t sparse_offsets;
 } TextureInfo;
 
+#ifndef __KERNEL_GPU__
+
+/* Image texture which is not loaded into memory up front. Tiles of the
+ * mipmap level matching the lookup footprint are read in on first access
+ * instead, and evicted again when the cache runs out of memory. */
+class CachedTexture {
+public:
+	virtual ~CachedTexture() {}
+
+	/* Filtered lookup, with the footprint given by the screen space
+	 * derivatives of the texture coordinate. Zero derivatives sample the
+	 * full resolution image. */
+	virtual float4 lookup(float x, float y,
+	                      float dxdx, float dydx,
+	                      float dxdy, float dydy) = 0;
+};
+
+#endif  /* __KERNEL_GPU__ */
+
 CCL_NAMESPACE_END
 
 #endif /* __UTIL_TEXTURE_H__ */
@@ -32,6 +32,9 @@
 #include <string.h> /* memcpy */
 #include <stdarg.h>
 #include <sys/types.h>
+#ifndef WIN32
+#  include <pthread.h>
+#endif
 
 #include "MEM_guardedalloc.h"
 
@@ -51,8 +54,80 @@ typedef struct MemHeadAligned {
 	size_t len;
 } MemHeadAligned;
 
-static unsigned int totblock = 0;
-static size_t mem_in_use = 0, mmap_in_use = 0, peak_mem = 0;
+/* Keep memory statistics per thread, this needs to know when threads exit.
+ * Otherwise counters shared by all threads are updated atomically. */
+#ifndef WIN32
+#  define USE_THREAD_STATS
+#endif
+
+#ifdef USE_THREAD_STATS
+/* Comment this to allocate and free small blocks with malloc() directly. */
+#  define USE_THREAD_CACHE
+#endif
+
+#ifdef USE_THREAD_CACHE
+/* Small blocks are allocated with their size rounded up to a size class, so
+ * that freed blocks of a class can be reused for any allocation of it. */
+#  define MEM_CACHE_CLASS_SIZE 16
+#  define MEM_CACHE_NUM_CLASSES 16
+#  define MEM_CACHE_MAX_SIZE (MEM_CACHE_CLASS_SIZE * MEM_CACHE_NUM_CLASSES)
+/* Freed blocks kept per size class and thread, others go back to malloc. */
+#  define MEM_CACHE_MAX_BLOCKS 64
+#  define MEM_CACHE_CLASS(len) ((len) == 0 ? 0 : ((len) - 1) / MEM_CACHE_CLASS_SIZE)
+#endif
+
+#ifdef USE_THREAD_STATS
+/* Memory allocated or freed by a thread before it is added to the shared
+ * total, which the peak memory is updated from. */
+#  define MEM_PEAK_UPDATE_THRESHOLD (1024 * 1024)
+#endif
+
+/* Memory statistics of a thread.
+ *
+ * Counters are only written by the thread using the slot, with relaxed
+ * atomic stores so other threads can read them while summing totals. Counters
+ * of a single slot wrap around when blocks are freed by another thread than
+ * the one allocating them, their sum is still correct.
+ *
+ * Slots are never freed, a slot of an exited thread keeps its counters and
+ * is reused by the next new thread. */
+typedef struct MemThreadStats {
+	size_t totblock;
+	size_t mem_in_use;
+	size_t mmap_in_use;
+
+#ifdef USE_THREAD_STATS
+	struct MemThreadStats *next;
+	/* Slot is used by a running thread. */
+	uint32_t in_use;
+	/* Memory allocated minus memory freed, not yet added to the total,
+	 * wraps around for negative values. */
+	size_t mem_unflushed;
+#endif
+
+#ifdef USE_THREAD_CACHE
+	/* Freed blocks by size class, linked through their first bytes. */
+	void *cache[MEM_CACHE_NUM_CLASSES];
+	unsigned int cache_len[MEM_CACHE_NUM_CLASSES];
+#endif
+} MemThreadStats;
+
+#ifdef USE_THREAD_STATS
+/* Slots of all threads, new slots are added at the head. */
+static MemThreadStats *thread_stats_first = NULL;
+/* Key to notice thread exit, its value is the slot of the thread. */
+static pthread_key_t thread_stats_key;
+static pthread_once_t thread_stats_key_once = PTHREAD_ONCE_INIT;
+#  ifndef __APPLE__
+static __thread MemThreadStats *thread_stats = NULL;
+#  endif
+/* Sum of memory flushed by all threads, used for the peak memory. */
+static size_t mem_in_use_flushed = 0;
+#else
+static MemThreadStats global_stats;
+#endif
+
+static size_t peak_mem = 0;
 static bool malloc_debug_memset = false;
 
 static void (*error_callback)(const char *) = NULL;
@@ -100,6 +175,247 @@ static void print_error(const char *str, ...)
 	}
 }
 
+#ifdef USE_THREAD_STATS
+
+/* Release the slot of an exiting thread. */
+static void mem_thread_stats_release(void *data)
+{
+	MemThreadStats *stats = data;
+
+#ifdef USE_THREAD_CACHE
+	for (int i = 0; i < MEM_CACHE_NUM_CLASSES; i++) {
+		void *block = stats->cache[i];
+		while (block != NULL) {
+			void *block_next = *(void **)PTR_FROM_MEMHEAD((MemHead *)block);
+			free(block);
+			block = block_next;
+		}
+		stats->cache[i] = NULL;
+		stats->cache_len[i] = 0;
+	}
+#endif
+
+#ifndef __APPLE__
+	/* Other destructors may still allocate, that claims a new slot. */
+	thread_stats = NULL;
+#endif
+	atomic_cas_uint32(&stats->in_use, 1, 0);
+}
+
+static void mem_thread_stats_key_create(void)
+{
+	pthread_key_create(&thread_stats_key, mem_thread_stats_release);
+}
+
+static MemThreadStats *mem_thread_stats_claim(void)
+{
+	MemThreadStats *stats;
+
+	pthread_once(&thread_stats_key_once, mem_thread_stats_key_create);
+
+	/* Reuse the slot of an exited thread. */
+	for (stats = thread_stats_first; stats; stats = stats->next) {
+		if (atomic_cas_uint32(&stats->in_use, 0, 1) == 0) {
+			break;
+		}
+	}
+
+	if (stats == NULL) {
+		/* Aligned to cache lines, so that threads do not write to the same ones. */
+		stats = aligned_malloc(sizeof(MemThreadStats), 64);
+
+		if (UNLIKELY(stats == NULL)) {
+			print_error("Could not allocate memory statistics of thread\n");
+			abort();
+		}
+		memset(stats, 0, sizeof(*stats));
+		stats->in_use = 1;
+
+		/* Slots are only added, so summing can walk the list without lock. */
+		MemThreadStats *first;
+		do {
+			first = thread_stats_first;
+			stats->next = first;
+		} while (atomic_cas_ptr((void **)&thread_stats_first, first, stats) != first);
+	}
+
+	pthread_setspecific(thread_stats_key, stats);
+#ifndef __APPLE__
+	thread_stats = stats;
+#endif
+
+	return stats;
+}
+
+MEM_INLINE MemThreadStats *mem_thread_stats_get(void)
+{
+#ifdef __APPLE__
+	/* The key must exist before its value is read, an uninitialized key
+	 * would read another thread specific slot. */
+	pthread_once(&thread_stats_key_once, mem_thread_stats_key_create);
+	MemThreadStats *stats = pthread_getspecific(thread_stats_key);
+#else
+	MemThreadStats *stats = thread_stats;
+#endif
+	if (UNLIKELY(stats == NULL)) {
+		stats = mem_thread_stats_claim();
+	}
+	return stats;
+}
+
+/* Add memory a thread allocated or freed to the total for the peak memory.
+ * Totals for queries are summed from all slots instead. */
+MEM_INLINE void mem_thread_stats_flush(MemThreadStats *stats)
+{
+	const size_t mem_in_use = atomic_add_and_fetch_z(&mem_in_use_flushed, stats->mem_unflushed);
+	stats->mem_unflushed = 0;
+	/* Total is negative while other threads did not flush freed memory yet. */
+	if ((ptrdiff_t)mem_in_use > 0) {
+		update_maximum(&peak_mem, mem_in_use);
+	}
+}
+
+#else  /* USE_THREAD_STATS */
+
+MEM_INLINE MemThreadStats *mem_thread_stats_get(void)
+{
+	return &global_stats;
+}
+
+#endif  /* USE_THREAD_STATS */
+
+/* Counters are only written by the thread owning the slot, so no locked
+ * read-modify-write is needed. Relaxed loads and stores still let other
+ * threads read them without tearing. */
+MEM_INLINE size_t mem_stats_counter_get(size_t *counter)
+{
+#ifdef USE_THREAD_STATS
+	return __atomic_load_n(counter, __ATOMIC_RELAXED);
+#else
+	return atomic_fetch_and_add_z(counter, 0);
+#endif
+}
+
+MEM_INLINE size_t mem_stats_counter_add(size_t *counter, size_t value)
+{
+#ifdef USE_THREAD_STATS
+	const size_t result = __atomic_load_n(counter, __ATOMIC_RELAXED) + value;
+	__atomic_store_n(counter, result, __ATOMIC_RELAXED);
+	return result;
+#else
+	return atomic_add_and_fetch_z(counter, value);
+#endif
+}
+
+MEM_INLINE size_t mem_stats_counter_sub(size_t *counter, size_t value)
+{
+#ifdef USE_THREAD_STATS
+	const size_t result = __atomic_load_n(counter, __ATOMIC_RELAXED) - value;
+	__atomic_store_n(counter, result, __ATOMIC_RELAXED);
+	return result;
+#else
+	return atomic_sub_and_fetch_z(counter, value);
+#endif
+}
+
+/* Sum of the counters of all threads, exact when no thread is allocating. */
+static void mem_thread_stats_sum(MemThreadStats *r_sum)
+{
+	memset(r_sum, 0, sizeof(*r_sum));
+#ifdef USE_THREAD_STATS
+	for (MemThreadStats *stats = thread_stats_first; stats; stats = stats->next)
+#else
+	MemThreadStats *stats = &global_stats;
+#endif
+	{
+		r_sum->totblock += mem_stats_counter_get(&stats->totblock);
+		r_sum->mem_in_use += mem_stats_counter_get(&stats->mem_in_use);
+		r_sum->mmap_in_use += mem_stats_counter_get(&stats->mmap_in_use);
+	}
+}
+
+MEM_INLINE void mem_thread_stats_add(MemThreadStats *stats, size_t len)
+{
+	mem_stats_counter_add(&stats->totblock, 1);
+	const size_t mem_in_use = mem_stats_counter_add(&stats->mem_in_use, len);
+
+#ifdef USE_THREAD_STATS
+	/* Summing totals on every allocation is too slow, so the peak may miss
+	 * up to the threshold of memory of every thread. */
+	(void)mem_in_use;
+	stats->mem_unflushed += len;
+	if (UNLIKELY((ptrdiff_t)stats->mem_unflushed >= MEM_PEAK_UPDATE_THRESHOLD)) {
+		mem_thread_stats_flush(stats);
+	}
+#else
+	update_maximum(&peak_mem, mem_in_use);
+#endif
+}
+
+MEM_INLINE void mem_thread_stats_sub(MemThreadStats *stats, size_t len)
+{
+	mem_stats_counter_sub(&stats->totblock, 1);
+	mem_stats_counter_sub(&stats->mem_in_use, len);
+
+#ifdef USE_THREAD_STATS
+	stats->mem_unflushed -= len;
+	if (UNLIKELY((ptrdiff_t)stats->mem_unflushed <= -MEM_PEAK_UPDATE_THRESHOLD)) {
+		mem_thread_stats_flush(stats);
+	}
+#endif
+}
+
+/* Allocate a block with room for \a len bytes after its header, reusing one
+ * freed before by the thread when possible. */
+MEM_INLINE MemHead *mem_block_alloc(MemThreadStats *stats, size_t len, bool clear)
+{
+#ifdef USE_THREAD_CACHE
+	if (len <= MEM_CACHE_MAX_SIZE) {
+		const size_t size_class = MEM_CACHE_CLASS(len);
+		MemHead *memh = stats->cache[size_class];
+
+		if (memh != NULL) {
+			stats->cache[size_class] = *(void **)PTR_FROM_MEMHEAD(memh);
+			stats->cache_len[size_class]--;
+			if (clear) {
+				memset(PTR_FROM_MEMHEAD(memh), 0, len);
+			}
+			return memh;
+		}
+
+		len = (size_class + 1) * MEM_CACHE_CLASS_SIZE;
+	}
+#else
+	(void)stats;
+#endif
+
+	if (clear) {
+		return (MemHead *)calloc(1, len + sizeof(MemHead));
+	}
+	return (MemHead *)malloc(len + sizeof(MemHead));
+}
+
+MEM_INLINE void mem_block_free(MemThreadStats *stats, MemHead *memh, size_t len)
+{
+#ifdef USE_THREAD_CACHE
+	if (len <= MEM_CACHE_MAX_SIZE) {
+		const size_t size_class = MEM_CACHE_CLASS(len);
+
+		if (stats->cache_len[size_class] < MEM_CACHE_MAX_BLOCKS) {
+			*(void **)PTR_FROM_MEMHEAD(memh) = stats->cache[size_class];
+			stats->cache[size_class] = memh;
+			stats->cache_len[size_class]++;
+			return;
+		}
+	}
+#else
+	(void)stats;
+	(void)len;
+#endif
+
+	free(memh);
+}
+
 #if defined(WIN32)
 static void mem_lock_thread(void)
 {
@@ -137,11 +453,11 @@ void MEM_lockfree_freeN(void *vmemh)
 		return;
 	}
 
-	atomic_sub_and_fetch_u(&totblock, 1);
-	atomic_sub_and_fetch_z(&mem_in_use, len);
+	MemThreadStats *stats = mem_thread_stats_get();
+	mem_thread_stats_sub(stats, len);
 
 	if (MEMHEAD_IS_MMAP(memh)) {
-		atomic_sub_and_fetch_z(&mmap_in_use, len);
+		mem_stats_counter_sub(&stats->mmap_in_use, len);
 #if defined(WIN32)
 		/* our windows mmap implementation is not thread safe */
 		mem_lock_thread();
@@ -161,7 +477,7 @@ void MEM_lockfree_freeN(void *vmemh)
 			aligned_free(MEMHEAD_REAL_PTR(memh_aligned));
 		}
 		else {
-			free(memh);
+			mem_block_free(stats, memh, len);
 		}
 	}
 }
@@ -278,18 +594,17 @@ void *MEM_lockfree_callocN(size_t len, const char *str)
 
 	len = SIZET_ALIGN_4(len);
 
-	memh = (MemHead *)calloc(1, len + sizeof(MemHead));
+	MemThreadStats *stats = mem_thread_stats_get();
+	memh = mem_block_alloc(stats, len, true);
 
 	if (LIKELY(memh)) {
 		memh->len = len;
-		atomic_add_and_fetch_u(&totblock, 1);
-		atomic_add_and_fetch_z(&mem_in_use, len);
-		update_maximum(&peak_mem, mem_in_use);
+		mem_thread_stats_add(stats, len);
 
 		return PTR_FROM_MEMHEAD(memh);
 	}
 	print_error("Calloc returns null: len=" SIZET_FORMAT " in %s, total %u\n",
-	            SIZET_ARG(len), str, (unsigned int) mem_in_use);
+	            SIZET_ARG(len), str, (unsigned int) MEM_lockfree_get_memory_in_use());
 	return NULL;
 }
 
@@ -300,7 +615,7 @@ void *MEM_lockfree_calloc_arrayN(size_t len, size_t size, const char *str)
 		print_error("Calloc array aborted due to integer overflow: "
 		            "len=" SIZET_FORMAT "x" SIZET_FORMAT " in %s, total %u\n",
 		            SIZET_ARG(len), SIZET_ARG(size), str,
-		            (unsigned int) mem_in_use);
+		            (unsigned int) MEM_lockfree_get_memory_in_use());
 		abort();
 		return NULL;
 	}
@@ -314,7 +629,8 @@ void *MEM_lockfree_mallocN(size_t len, const char *str)
 
 	len = SIZET_ALIGN_4(len);
 
-	memh = (MemHead *)malloc(len + sizeof(MemHead));
+	MemThreadStats *stats = mem_thread_stats_get();
+	memh = mem_block_alloc(stats, len, false);
 
 	if (LIKELY(memh)) {
 		if (UNLIKELY(malloc_debug_memset && len)) {
@@ -322,14 +638,12 @@ void *MEM_lockfree_mallocN(size_t len, const char *str)
 		}
 
 		memh->len = len;
-		atomic_add_and_fetch_u(&totblock, 1);
-		atomic_add_and_fetch_z(&mem_in_use, len);
-		update_maximum(&peak_mem, mem_in_use);
+		mem_thread_stats_add(stats, len);
 
 		return PTR_FROM_MEMHEAD(memh);
 	}
 	print_error("Malloc returns null: len=" SIZET_FORMAT " in %s, total %u\n",
-	            SIZET_ARG(len), str, (unsigned int) mem_in_use);
+	            SIZET_ARG(len), str, (unsigned int) MEM_lockfree_get_memory_in_use());
 	return NULL;
 }
 
@@ -340,7 +654,7 @@ void *MEM_lockfree_malloc_arrayN(size_t len, size_t size, const char *str)
 		print_error("Malloc array aborted due to integer overflow: "
 		            "len=" SIZET_FORMAT "x" SIZET_FORMAT " in %s, total %u\n",
 		            SIZET_ARG(len), SIZET_ARG(size), str,
-		            (unsigned int) mem_in_use);
+		            (unsigned int) MEM_lockfree_get_memory_in_use());
 		abort();
 		return NULL;
 	}
@@ -386,14 +700,12 @@ void *MEM_lockfree_mallocN_aligned(size_t len, size_t alignment, const char *str
 
 		memh->len = len | (size_t) MEMHEAD_ALIGN_FLAG;
 		memh->alignment = (short) alignment;
-		atomic_add_and_fetch_u(&totblock, 1);
-		atomic_add_and_fetch_z(&mem_in_use, len);
-		update_maximum(&peak_mem, mem_in_use);
+		mem_thread_stats_add(mem_thread_stats_get(), len);
 
 		return PTR_FROM_MEMHEAD(memh);
 	}
 	print_error("Malloc returns null: len=" SIZET_FORMAT " in %s, total %u\n",
-	            SIZET_ARG(len), str, (unsigned int) mem_in_use);
+	            SIZET_ARG(len), str, (unsigned int) MEM_lockfree_get_memory_in_use());
 	return NULL;
 }
 
@@ -420,19 +732,16 @@ void *MEM_lockfree_mapallocN(size_t len, const char *str)
 #endif
 
 	if (memh != (MemHead *)-1) {
+		MemThreadStats *stats = mem_thread_stats_get();
 		memh->len = len | (size_t) MEMHEAD_MMAP_FLAG;
-		atomic_add_and_fetch_u(&totblock, 1);
-		atomic_add_and_fetch_z(&mem_in_use, len);
-		atomic_add_and_fetch_z(&mmap_in_use, len);
-
-		update_maximum(&peak_mem, mem_in_use);
-		update_maximum(&peak_mem, mmap_in_use);
+		mem_thread_stats_add(stats, len);
+		mem_stats_counter_add(&stats->mmap_in_use, len);
 
 		return PTR_FROM_MEMHEAD(memh);
 	}
 	print_error("Mapalloc returns null, fallback to regular malloc: "
 	            "len=" SIZET_FORMAT " in %s, total %u\n",
-	            SIZET_ARG(len), str, (unsigned int) mmap_in_use);
+	            SIZET_ARG(len), str, (unsigned int) MEM_lockfree_get_mapped_memory_in_use());
 	return MEM_lockfree_callocN(len, str);
 }
 
@@ -453,9 +762,9 @@ void MEM_lockfree_callbackmemlist(void (*func)(void *))
 void MEM_lockfree_printmemlist_stats(void)
 {
 	printf("\ntotal memory len: %.3f MB\n",
-	       (double)mem_in_use / (double)(1024 * 1024));
+	       (double)MEM_lockfree_get_memory_in_use() / (double)(1024 * 1024));
 	printf("peak memory len: %.3f MB\n",
-	       (double)peak_mem / (double)(1024 * 1024));
+	       (double)MEM_lockfree_get_peak_memory() / (double)(1024 * 1024));
 	printf("\nFor more detailed per-block statistics run Blender with memory debugging command line argument.\n");
 
 #ifdef HAVE_MALLOC_STATS
@@ -487,27 +796,33 @@ void MEM_lockfree_set_memory_debug(void)
 
 size_t MEM_lockfree_get_memory_in_use(void)
 {
-	return mem_in_use;
+	MemThreadStats sum;
+	mem_thread_stats_sum(&sum);
+	return sum.mem_in_use;
 }
 
 size_t MEM_lockfree_get_mapped_memory_in_use(void)
 {
-	return mmap_in_use;
+	MemThreadStats sum;
+	mem_thread_stats_sum(&sum);
+	return sum.mmap_in_use;
 }
 
 unsigned int MEM_lockfree_get_memory_blocks_in_use(void)
 {
-	return totblock;
+	MemThreadStats sum;
+	mem_thread_stats_sum(&sum);
+	return (unsigned int)sum.totblock;
 }
 
-/* dummy */
 void MEM_lockfree_reset_peak_memory(void)
 {
-	peak_mem = mem_in_use;
+	peak_mem = MEM_lockfree_get_memory_in_use();
 }
 
 size_t MEM_lockfree_get_peak_memory(void)
 {
+	update_maximum(&peak_mem, MEM_lockfree_get_memory_in_use());
 	return peak_mem;
 }
 
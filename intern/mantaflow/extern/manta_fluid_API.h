@@ -185,6 +185,26 @@ int fluid_get_frame(struct FLUID* fluid);
 float fluid_get_timestep(struct FLUID* fluid);
 void fluid_adapt_timestep(struct FLUID* fluid);
 
+// Grid registry. Handles stay valid for the lifetime of the FLUID object, versions
+// are bumped whenever the solver or Blender changes the contents of a buffer.
+#define FLUID_GRID_FLOAT  0
+#define FLUID_GRID_INT    1
+#define FLUID_GRID_OBJECT 2
+#define FLUID_GRID_VEC3   3
+int fluid_grid_find(struct FLUID *fluid, const char *name);
+int fluid_grid_num(struct FLUID *fluid);
+const char *fluid_grid_name(struct FLUID *fluid, int handle);
+int fluid_grid_type(struct FLUID *fluid, int handle);
+int fluid_grid_is_high(struct FLUID *fluid, int handle);
+float *fluid_grid_get_float(struct FLUID *fluid, int handle);
+int *fluid_grid_get_int(struct FLUID *fluid, int handle);
+unsigned int fluid_grid_version(struct FLUID *fluid, int handle);
+int fluid_grid_is_dirty(struct FLUID *fluid, int handle);
+void fluid_grid_clear_dirty(struct FLUID *fluid, int handle);
+void fluid_grid_tag_changed(struct FLUID *fluid, int handle);
+int fluid_grid_derived_is_current(struct FLUID *fluid, int handle, int source, unsigned int key);
+void fluid_grid_tag_derived(struct FLUID *fluid, int handle, int source, unsigned int key);
+
 #ifdef __cplusplus
 }
 #endif
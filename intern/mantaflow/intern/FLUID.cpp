@@ -31,6 +31,7 @@
 #include <fstream>
 #include <iostream>
 #include <iomanip>
+#include <mutex>
 #include <zlib.h>
 
 #include "FLUID.h"
@@ -52,6 +53,10 @@ std::atomic<bool> FLUID::mantaInitialized(false);
 std::atomic<int> FLUID::solverID(0);
 int FLUID::with_debug(0);
 
+// Solvers for different domains may be created and freed from several depsgraph threads
+// at the same time. Setting up and tearing down the Mantaflow registry is process-wide.
+static std::mutex mantaInitLock;
+
 FLUID::FLUID(int *res, SmokeModifierData *smd) : mCurrentID(++solverID)
 {
 	if (with_debug)
@@ -83,6 +88,7 @@ FLUID::FLUID(int *res, SmokeModifierData *smd) : mCurrentID(++solverID)
 	mConstantScaling    = 64.0f / mMaxRes;
 	mConstantScaling    = (mConstantScaling < 1.0f) ? 1.0f : mConstantScaling;
 	mTotalCells         = mResX * mResY * mResZ;
+	mSavedFrame         = -1;
 
 	// Smoke low res grids
 	mDensity        = NULL;
@@ -91,6 +97,7 @@ FLUID::FLUID(int *res, SmokeModifierData *smd) : mCurrentID(++solverID)
 	mFlowType       = NULL;
 	mNumFlow        = NULL;
 	mHeat           = NULL;
+	mVelocity       = NULL;
 	mVelocityX      = NULL;
 	mVelocityY      = NULL;
 	mVelocityZ      = NULL;
@@ -156,8 +163,11 @@ FLUID::FLUID(int *res, SmokeModifierData *smd) : mCurrentID(++solverID)
 	mSndParticleLife       = NULL;
 
 	// Only start Mantaflow once. No need to start whenever new FLUID objected is allocated
-	if (!mantaInitialized)
-		initializeMantaflow();
+	{
+		std::lock_guard<std::mutex> lock(mantaInitLock);
+		if (!mantaInitialized)
+			initializeMantaflow();
+	}
 
 	// Initialize Mantaflow variables in Python
 	// Liquid
@@ -522,6 +532,7 @@ FLUID::~FLUID()
 	mFlowType       = NULL;
 	mNumFlow        = NULL;
 	mHeat           = NULL;
+	mVelocity       = NULL;
 	mVelocityX      = NULL;
 	mVelocityY      = NULL;
 	mVelocityZ      = NULL;
@@ -639,6 +650,8 @@ void FLUID::terminateMantaflow()
 	if (with_debug)
 		std::cout << "Terminating Mantaflow" << std::endl;
 
+	std::lock_guard<std::mutex> lock(mantaInitLock);
+
 	PyGILState_STATE gilstate = PyGILState_Ensure();
 	Pb::finalize();  // Namespace from Mantaflow (registry)
 	PyGILState_Release(gilstate);
@@ -1054,6 +1067,8 @@ int FLUID::updateFlipStructures(SmokeModifierData *smd, int framenr)
 	if (BLI_exists(targetFile)) {
 		updateParticlesFromFile(targetFile, false);
 	}
+	tagGridChanged("pp");
+	tagGridChanged("pVel");
 	return 1;
 }
 
@@ -1079,6 +1094,8 @@ int FLUID::updateMeshStructures(SmokeModifierData *smd, int framenr)
 	if (BLI_exists(targetFile)) {
 		updateMeshFromFile(targetFile);
 	}
+	tagGridChanged("mesh_nodes");
+	tagGridChanged("mesh_triangles");
 	return 1;
 }
 
@@ -1122,6 +1139,9 @@ int FLUID::updateParticleStructures(SmokeModifierData *smd, int framenr)
 	if (BLI_exists(targetFile)) {
 		updateParticlesFromFile(targetFile, true);
 	}
+	tagGridChanged("ppSnd");
+	tagGridChanged("pVelSnd");
+	tagGridChanged("pLifeSnd");
 	return 1;
 }
 
@@ -1155,23 +1175,32 @@ int FLUID::writeData(SmokeModifierData *smd, int framenr)
 	BLI_path_join(cacheDirData, sizeof(cacheDirData), smd->domain->cache_directory, FLUID_CACHE_DIR_DATA, NULL);
 	BLI_path_make_safe(cacheDirData);
 
-	ss << "fluid_save_data_" << mCurrentID << "('" << escapeSlashes(cacheDirData) << "', " << framenr << ", '" << dformat << "')";
+	// Files of grids unchanged since the previous write are copied instead of re-encoded
+	std::string unchanged;
+	if (mSavedFrame != -1) {
+		std::ostringstream us;
+		us << ", " << getUnchangedCacheFiles() << ", " << mSavedFrame;
+		unchanged = us.str();
+	}
+
+	ss << "fluid_save_data_" << mCurrentID << "('" << escapeSlashes(cacheDirData) << "', " << framenr << ", '" << dformat << "'" << unchanged << ")";
 	pythonCommands.push_back(ss.str());
 
 	if (mUsingSmoke) {
 		ss.str("");
-		ss << "smoke_save_data_" << mCurrentID << "('" << escapeSlashes(cacheDirData) << "', " << framenr << ", '" << dformat << "')";
+		ss << "smoke_save_data_" << mCurrentID << "('" << escapeSlashes(cacheDirData) << "', " << framenr << ", '" << dformat << "'" << unchanged << ")";
 		pythonCommands.push_back(ss.str());
 	}
 	if (mUsingLiquid) {
 		ss.str("");
-		ss << "liquid_save_data_" << mCurrentID << "('" << escapeSlashes(cacheDirData) << "', " << framenr << ", '" << dformat << "')";
+		ss << "liquid_save_data_" << mCurrentID << "('" << escapeSlashes(cacheDirData) << "', " << framenr << ", '" << dformat << "'" << unchanged << ")";
 		pythonCommands.push_back(ss.str());
 		ss.str("");
-		ss << "liquid_save_flip_" << mCurrentID << "('" << escapeSlashes(cacheDirData) << "', " << framenr << ", '" << pformat << "')";
+		ss << "liquid_save_flip_" << mCurrentID << "('" << escapeSlashes(cacheDirData) << "', " << framenr << ", '" << pformat << "'" << unchanged << ")";
 		pythonCommands.push_back(ss.str());
 	}
 	runPythonString(pythonCommands);
+	markCacheFilesSaved(framenr);
 	return 1;
 }
 
@@ -1206,7 +1235,7 @@ int FLUID::readData(SmokeModifierData *smd, int framenr)
 		pythonCommands.push_back(ss.str());
 	}
 	runPythonString(pythonCommands);
-	updatePointers();
+	tagGridsChanged(false);
 	return 1;
 }
 
@@ -1233,7 +1262,7 @@ int FLUID::readNoise(SmokeModifierData *smd, int framenr)
 		pythonCommands.push_back(ss.str());
 	}
 	runPythonString(pythonCommands);
-	updatePointersHigh();
+	tagGridsChanged(true);
 	return 1;
 }
 
@@ -1271,7 +1300,9 @@ int FLUID::readParticles(SmokeModifierData *smd, int framenr)
 		pythonCommands.push_back(ss.str());
 	}
 	runPythonString(pythonCommands);
-	updatePointers();
+	tagGridChanged("ppSnd");
+	tagGridChanged("pVelSnd");
+	tagGridChanged("pLifeSnd");
 	return 1;
 }
 
@@ -1297,6 +1328,7 @@ int FLUID::bakeData(SmokeModifierData *smd, int framenr)
 	pythonCommands.push_back(ss.str());
 
 	runPythonString(pythonCommands);
+	tagSolverGridsChanged(false);
 	return 1;
 }
 
@@ -1324,6 +1356,7 @@ int FLUID::bakeNoise(SmokeModifierData *smd, int framenr)
 	pythonCommands.push_back(ss.str());
 
 	runPythonString(pythonCommands);
+	tagSolverGridsChanged(true);
 	return 1;
 }
 
@@ -1352,6 +1385,8 @@ int FLUID::bakeMesh(SmokeModifierData *smd, int framenr)
 	pythonCommands.push_back(ss.str());
 
 	runPythonString(pythonCommands);
+	tagGridChanged("mesh_nodes");
+	tagGridChanged("mesh_triangles");
 	return 1;
 }
 
@@ -1379,6 +1414,9 @@ int FLUID::bakeParticles(SmokeModifierData *smd, int framenr)
 	pythonCommands.push_back(ss.str());
 
 	runPythonString(pythonCommands);
+	tagGridChanged("ppSnd");
+	tagGridChanged("pVelSnd");
+	tagGridChanged("pLifeSnd");
 	return 1;
 }
 
@@ -1554,30 +1592,51 @@ static PyObject* callPythonFunction(std::string varName, std::string functionNam
 	return (!isAttribute) ? returnedValue : func;
 }
 
-static char* pyObjectToString(PyObject* inputObject)
+/* Conversions below consume the reference returned by callPythonFunction(). They may be
+ * called from any thread, so the GIL has to be held again while touching the object. */
+static std::string pyObjectToString(PyObject* inputObject)
 {
+	std::string result;
+	if (!inputObject) return result;
+
+	PyGILState_STATE gilstate = PyGILState_Ensure();
 	PyObject* encoded = PyUnicode_AsUTF8String(inputObject);
-	char *result = PyBytes_AsString(encoded);
-	Py_DECREF(encoded);
+	if (encoded) {
+		// Copy before releasing, the bytes buffer is owned by the encoded object
+		result = PyBytes_AsString(encoded);
+		Py_DECREF(encoded);
+	}
 	Py_DECREF(inputObject);
+	PyGILState_Release(gilstate);
 	return result;
 }
 
 static double pyObjectToDouble(PyObject* inputObject)
 {
+	if (!inputObject) return 0.0;
+
+	PyGILState_STATE gilstate = PyGILState_Ensure();
 	// Cannot use PyFloat_AsDouble() since its error check crashes - likely because of Real (aka float) type in Mantaflow
-	return PyFloat_AS_DOUBLE(inputObject);
+	double result = PyFloat_AS_DOUBLE(inputObject);
+	Py_DECREF(inputObject);
+	PyGILState_Release(gilstate);
+	return result;
 }
 
 static long pyObjectToLong(PyObject* inputObject)
 {
-	return PyLong_AsLong(inputObject);
+	if (!inputObject) return 0;
+
+	PyGILState_STATE gilstate = PyGILState_Ensure();
+	long result = PyLong_AsLong(inputObject);
+	Py_DECREF(inputObject);
+	PyGILState_Release(gilstate);
+	return result;
 }
 
-static void* stringToPointer(char* inputString)
+static void* stringToPointer(const std::string& inputString)
 {
-	std::string str(inputString);
-	std::istringstream in(str);
+	std::istringstream in(inputString);
 	void *dataPointer = NULL;
 	in >> dataPointer;
 	return dataPointer;
@@ -1905,6 +1964,190 @@ void FLUID::updateParticlesFromFile(const char* filename, bool isSecondary)
 	gzclose(gzf);
 }
 
+void FLUID::registerGrid(const std::string& name, const std::string& object, const std::string& getter, void** target, int type, bool high)
+{
+	if (findGrid(name) != -1) return;
+
+	GridBuffer grid;
+	grid.name    = name;
+	grid.object  = object;
+	grid.getter  = getter;
+	grid.target  = target;
+	grid.type    = type;
+	grid.high    = high;
+	grid.version = 0;
+	grid.savedVersion = 0;
+	grid.hash    = 0;
+	grid.derivedFrom = -1;
+	grid.derivedVersion = 0;
+	grid.derivedKey = 0;
+	grid.dirty   = false;
+	mGrids.push_back(grid);
+}
+
+int FLUID::findGrid(const std::string& name)
+{
+	for (size_t i = 0; i < mGrids.size(); ++i) {
+		if (mGrids[i].name == name) return (int) i;
+	}
+	return -1;
+}
+
+// Only grid (re-)allocation needs a Python round-trip. Buffers keep their address
+// while the solver steps or loads cache files, so these are resolved after init only.
+void FLUID::resolveGrids(bool high)
+{
+	for (std::vector<GridBuffer>::iterator it = mGrids.begin(); it != mGrids.end(); ++it) {
+		if (it->high != high) continue;
+
+		void* dataPointer = stringToPointer(pyObjectToString(callPythonFunction(it->object, it->getter)));
+		if (dataPointer != *it->target) {
+			*it->target = dataPointer;
+			it->version++;
+			it->hash = 0;
+			it->derivedFrom = -1;
+			it->dirty = true;
+		}
+	}
+}
+
+// 64 bit FNV-1a over 32 bit words, with a shift so changes in high bits reach the low ones
+static uint64_t gridContentHash(const uint32_t* data, size_t num)
+{
+	uint64_t hash = 14695981039346656037ULL;
+	for (size_t i = 0; i < num; ++i) {
+		hash = (hash ^ data[i]) * 1099511628211ULL;
+		hash ^= hash >> 29;
+	}
+	return hash;
+}
+
+// Writers tag the grids they filled. The version is only bumped when the contents differ
+// from the last tag, so grids that are rewritten with the same values (static inflow or
+// obstacles, settled solver channels) keep their version. Particle systems have no flat
+// buffer to compare and always count as changed.
+void FLUID::tagGridChanged(int handle)
+{
+	GridBuffer& grid = mGrids[handle];
+	if (grid.type != GRID_TYPE_OBJECT && *grid.target) {
+		size_t num = grid.high ? mTotalCellsHigh : mTotalCells;
+		if (grid.type == GRID_TYPE_VEC3) num *= 3;
+
+		uint64_t hash = gridContentHash((const uint32_t*) *grid.target, num);
+		if (hash == grid.hash) return;
+		grid.hash = hash;
+	}
+	grid.version++;
+	grid.dirty = true;
+}
+
+void FLUID::tagGridChanged(const std::string& name)
+{
+	int handle = findGrid(name);
+	if (handle != -1) tagGridChanged(handle);
+}
+
+bool FLUID::isGridDerivedCurrent(int handle, int source, unsigned int key)
+{
+	const GridBuffer& grid = mGrids[handle];
+	return grid.derivedFrom == source && grid.derivedVersion == mGrids[source].version &&
+	       grid.derivedKey == key;
+}
+
+void FLUID::tagGridDerived(int handle, int source, unsigned int key)
+{
+	tagGridChanged(handle);
+	mGrids[handle].derivedFrom = source;
+	mGrids[handle].derivedVersion = mGrids[source].version;
+	mGrids[handle].derivedKey = key;
+}
+
+void FLUID::tagGridsChanged(bool high)
+{
+	for (int i = 0; i < (int) mGrids.size(); ++i) {
+		if (mGrids[i].high == high) tagGridChanged(i);
+	}
+}
+
+// Grids written by a solver step. Inputs (obstacles, inflow, forces, guiding) are
+// filled on the Blender side and tagged there, so they keep their version here.
+static const char* solverGridsLow[] = {
+	"flags", "vel", "x_vel", "y_vel", "z_vel", "density", "heat", "flame", "fuel", "react",
+	"color_r", "color_g", "color_b", "phi", "pp", "pVel" };
+static const char* solverGridsHigh[] = {
+	"density_high", "flame_high", "fuel_high", "react_high", "color_r_high", "color_g_high", "color_b_high",
+	"texture_u", "texture_v", "texture_w", "texture_u2", "texture_v2", "texture_w2" };
+
+void FLUID::tagSolverGridsChanged(bool high)
+{
+	if (high) {
+		for (size_t i = 0; i < sizeof(solverGridsHigh) / sizeof(solverGridsHigh[0]); ++i)
+			tagGridChanged(solverGridsHigh[i]);
+	}
+	else {
+		for (size_t i = 0; i < sizeof(solverGridsLow) / sizeof(solverGridsLow[0]); ++i)
+			tagGridChanged(solverGridsLow[i]);
+	}
+}
+
+// Data cache files and the registered grids they store. Files without an entry
+// here (e.g. phiObs, phiParts) are always written.
+static const struct {
+	const char* file;
+	const char* grids[3];
+} cacheFileGrids[] = {
+	{ "vel",      { "vel" } },
+	{ "phiObsIn", { "phiObsIn" } },
+	{ "density",  { "density" } },
+	{ "shadow",   { "shadow" } },
+	{ "heat",     { "heat" } },
+	{ "flame",    { "flame" } },
+	{ "fuel",     { "fuel" } },
+	{ "react",    { "react" } },
+	{ "color_r",  { "color_r" } },
+	{ "color_g",  { "color_g" } },
+	{ "color_b",  { "color_b" } },
+	{ "phi",      { "phi" } },
+	{ "phiIn",    { "phiIn" } },
+	{ "pp",       { "pp" } },
+	{ "pVel",     { "pVel" } },
+};
+
+// Python list of the cache files whose grids are all registered and unchanged since the last write
+std::string FLUID::getUnchangedCacheFiles()
+{
+	std::string files = "[";
+	for (size_t i = 0; i < sizeof(cacheFileGrids) / sizeof(cacheFileGrids[0]); ++i) {
+		bool unchanged = true;
+		for (int j = 0; j < 3 && cacheFileGrids[i].grids[j]; ++j) {
+			int handle = findGrid(cacheFileGrids[i].grids[j]);
+			if (handle == -1 || mGrids[handle].version != mGrids[handle].savedVersion) {
+				unchanged = false;
+				break;
+			}
+		}
+		if (unchanged) {
+			if (files.size() > 1) files += ", ";
+			files += "'" + std::string(cacheFileGrids[i].file) + "'";
+		}
+	}
+	return files + "]";
+}
+
+// The cache writer consumed the current grid contents: remember their versions and clear the dirty flags
+void FLUID::markCacheFilesSaved(int framenr)
+{
+	for (size_t i = 0; i < sizeof(cacheFileGrids) / sizeof(cacheFileGrids[0]); ++i) {
+		for (int j = 0; j < 3 && cacheFileGrids[i].grids[j]; ++j) {
+			int handle = findGrid(cacheFileGrids[i].grids[j]);
+			if (handle == -1) continue;
+			mGrids[handle].savedVersion = mGrids[handle].version;
+			mGrids[handle].dirty = false;
+		}
+	}
+	mSavedFrame = framenr;
+}
+
 void FLUID::updatePointers()
 {
 	if (with_debug)
@@ -1924,84 +2167,87 @@ void FLUID::updatePointers()
 	std::string snd_ext    = "_" + snd;
 	std::string mesh_ext   = "_" + mesh;
 
-	mObstacle  = (int*)   stringToPointer(pyObjectToString(callPythonFunction("flags" + solver_ext, func)));
+	registerGrid("flags",    "flags"    + solver_ext, func, (void**) &mObstacle,  GRID_TYPE_INT,   false);
 
-	mVelocityX = (float*) stringToPointer(pyObjectToString(callPythonFunction("x_vel" + solver_ext, func)));
-	mVelocityY = (float*) stringToPointer(pyObjectToString(callPythonFunction("y_vel" + solver_ext, func)));
-	mVelocityZ = (float*) stringToPointer(pyObjectToString(callPythonFunction("z_vel" + solver_ext, func)));
+	registerGrid("vel",      "vel"      + solver_ext, func, (void**) &mVelocity,  GRID_TYPE_VEC3,  false);
+	registerGrid("x_vel",    "x_vel"    + solver_ext, func, (void**) &mVelocityX, GRID_TYPE_FLOAT, false);
+	registerGrid("y_vel",    "y_vel"    + solver_ext, func, (void**) &mVelocityY, GRID_TYPE_FLOAT, false);
+	registerGrid("z_vel",    "z_vel"    + solver_ext, func, (void**) &mVelocityZ, GRID_TYPE_FLOAT, false);
 
-	mForceX    = (float*) stringToPointer(pyObjectToString(callPythonFunction("x_force" + solver_ext, func)));
-	mForceY    = (float*) stringToPointer(pyObjectToString(callPythonFunction("y_force" + solver_ext, func)));
-	mForceZ    = (float*) stringToPointer(pyObjectToString(callPythonFunction("z_force" + solver_ext, func)));
+	registerGrid("x_force",  "x_force"  + solver_ext, func, (void**) &mForceX,    GRID_TYPE_FLOAT, false);
+	registerGrid("y_force",  "y_force"  + solver_ext, func, (void**) &mForceY,    GRID_TYPE_FLOAT, false);
+	registerGrid("z_force",  "z_force"  + solver_ext, func, (void**) &mForceZ,    GRID_TYPE_FLOAT, false);
 
-	mPhiOutIn  = (float*) stringToPointer(pyObjectToString(callPythonFunction("phiOutIn" + solver_ext, func)));
-	mFlowType  = (int*)   stringToPointer(pyObjectToString(callPythonFunction("flowType"   + solver_ext, func)));
-	mNumFlow   = (int*)   stringToPointer(pyObjectToString(callPythonFunction("numFlow"    + solver_ext, func)));
+	registerGrid("phiOutIn", "phiOutIn" + solver_ext, func, (void**) &mPhiOutIn,  GRID_TYPE_FLOAT, false);
+	registerGrid("flowType", "flowType" + solver_ext, func, (void**) &mFlowType,  GRID_TYPE_INT,   false);
+	registerGrid("numFlow",  "numFlow"  + solver_ext, func, (void**) &mNumFlow,   GRID_TYPE_INT,   false);
 
 	if (mUsingObstacle) {
-		mPhiObsIn    = (float*) stringToPointer(pyObjectToString(callPythonFunction("phiObsIn" + solver_ext, func)));
-		mNumObstacle = (int*)   stringToPointer(pyObjectToString(callPythonFunction("numObs"  + solver_ext, func)));
+		registerGrid("phiObsIn", "phiObsIn" + solver_ext, func, (void**) &mPhiObsIn,    GRID_TYPE_FLOAT, false);
+		registerGrid("numObs",   "numObs"   + solver_ext, func, (void**) &mNumObstacle, GRID_TYPE_INT,   false);
 
-		mObVelocityX = (float*) stringToPointer(pyObjectToString(callPythonFunction("x_obvel" + solver_ext, func)));
-		mObVelocityY = (float*) stringToPointer(pyObjectToString(callPythonFunction("y_obvel" + solver_ext, func)));
-		mObVelocityZ = (float*) stringToPointer(pyObjectToString(callPythonFunction("z_obvel" + solver_ext, func)));
+		registerGrid("x_obvel",  "x_obvel"  + solver_ext, func, (void**) &mObVelocityX, GRID_TYPE_FLOAT, false);
+		registerGrid("y_obvel",  "y_obvel"  + solver_ext, func, (void**) &mObVelocityY, GRID_TYPE_FLOAT, false);
+		registerGrid("z_obvel",  "z_obvel"  + solver_ext, func, (void**) &mObVelocityZ, GRID_TYPE_FLOAT, false);
 	}
 
 	if (mUsingGuiding) {
-		mPhiGuideIn = (float*) stringToPointer(pyObjectToString(callPythonFunction("phiGuideIn" + solver_ext, func)));
-		mNumGuide   = (int*)   stringToPointer(pyObjectToString(callPythonFunction("numGuides"      + solver_ext, func)));
+		registerGrid("phiGuideIn", "phiGuideIn" + solver_ext, func, (void**) &mPhiGuideIn,     GRID_TYPE_FLOAT, false);
+		registerGrid("numGuides",  "numGuides"  + solver_ext, func, (void**) &mNumGuide,       GRID_TYPE_INT,   false);
 
-		mGuideVelocityX = (float*) stringToPointer(pyObjectToString(callPythonFunction("x_guidevel" + solver_ext, func)));
-		mGuideVelocityY = (float*) stringToPointer(pyObjectToString(callPythonFunction("y_guidevel" + solver_ext, func)));
-		mGuideVelocityZ = (float*) stringToPointer(pyObjectToString(callPythonFunction("z_guidevel" + solver_ext, func)));
+		registerGrid("x_guidevel", "x_guidevel" + solver_ext, func, (void**) &mGuideVelocityX, GRID_TYPE_FLOAT, false);
+		registerGrid("y_guidevel", "y_guidevel" + solver_ext, func, (void**) &mGuideVelocityY, GRID_TYPE_FLOAT, false);
+		registerGrid("z_guidevel", "z_guidevel" + solver_ext, func, (void**) &mGuideVelocityZ, GRID_TYPE_FLOAT, false);
 	}
 
 	if (mUsingInvel) {
-		mInVelocityX = (float*) stringToPointer(pyObjectToString(callPythonFunction("x_invel" + solver_ext, func)));
-		mInVelocityY = (float*) stringToPointer(pyObjectToString(callPythonFunction("y_invel" + solver_ext, func)));
-		mInVelocityZ = (float*) stringToPointer(pyObjectToString(callPythonFunction("z_invel" + solver_ext, func)));
+		registerGrid("x_invel", "x_invel" + solver_ext, func, (void**) &mInVelocityX, GRID_TYPE_FLOAT, false);
+		registerGrid("y_invel", "y_invel" + solver_ext, func, (void**) &mInVelocityY, GRID_TYPE_FLOAT, false);
+		registerGrid("z_invel", "z_invel" + solver_ext, func, (void**) &mInVelocityZ, GRID_TYPE_FLOAT, false);
 	}
 
 	// Liquid
 	if (mUsingLiquid) {
-		mPhi   = (float*) stringToPointer(pyObjectToString(callPythonFunction("phi"   + solver_ext, func)));
-		mPhiIn = (float*) stringToPointer(pyObjectToString(callPythonFunction("phiIn" + solver_ext, func)));
+		registerGrid("phi",   "phi"   + solver_ext, func, (void**) &mPhi,   GRID_TYPE_FLOAT, false);
+		registerGrid("phiIn", "phiIn" + solver_ext, func, (void**) &mPhiIn, GRID_TYPE_FLOAT, false);
 
-		mFlipParticleData     = (std::vector<pData>*) stringToPointer(pyObjectToString(callPythonFunction("pp"   + solver_ext, func)));
-		mFlipParticleVelocity = (std::vector<pVel>*)  stringToPointer(pyObjectToString(callPythonFunction("pVel" + parts_ext,  func)));
+		registerGrid("pp",   "pp"   + solver_ext, func, (void**) &mFlipParticleData,     GRID_TYPE_OBJECT, false);
+		registerGrid("pVel", "pVel" + parts_ext,  func, (void**) &mFlipParticleVelocity, GRID_TYPE_OBJECT, false);
 
 		if (mUsingMesh) {
-			mMeshNodes     = (std::vector<Node>*)     stringToPointer(pyObjectToString(callPythonFunction("mesh" + mesh_ext, funcNodes)));
-			mMeshTriangles = (std::vector<Triangle>*) stringToPointer(pyObjectToString(callPythonFunction("mesh" + mesh_ext, funcTris)));
+			registerGrid("mesh_nodes",     "mesh" + mesh_ext, funcNodes, (void**) &mMeshNodes,     GRID_TYPE_OBJECT, false);
+			registerGrid("mesh_triangles", "mesh" + mesh_ext, funcTris,  (void**) &mMeshTriangles, GRID_TYPE_OBJECT, false);
 		}
 
 		if (mUsingDrops || mUsingBubbles || mUsingFloats || mUsingTracers) {
-			mSndParticleData     = (std::vector<pData>*) stringToPointer(pyObjectToString(callPythonFunction("ppSnd"    + snd_ext, func)));
-			mSndParticleVelocity = (std::vector<pVel>*)  stringToPointer(pyObjectToString(callPythonFunction("pVelSnd"  + parts_ext,  func)));
-			mSndParticleLife     = (std::vector<float>*) stringToPointer(pyObjectToString(callPythonFunction("pLifeSnd" + parts_ext,  func)));
+			registerGrid("ppSnd",    "ppSnd"    + snd_ext,   func, (void**) &mSndParticleData,     GRID_TYPE_OBJECT, false);
+			registerGrid("pVelSnd",  "pVelSnd"  + parts_ext, func, (void**) &mSndParticleVelocity, GRID_TYPE_OBJECT, false);
+			registerGrid("pLifeSnd", "pLifeSnd" + parts_ext, func, (void**) &mSndParticleLife,     GRID_TYPE_OBJECT, false);
 		}
 	}
 	
 	// Smoke
 	if (mUsingSmoke) {
-		mDensity        = (float*) stringToPointer(pyObjectToString(callPythonFunction("density"    + solver_ext, func)));
-		mEmissionIn     = (float*) stringToPointer(pyObjectToString(callPythonFunction("emissionIn" + solver_ext, func)));
-		mShadow         = (float*) stringToPointer(pyObjectToString(callPythonFunction("shadow"     + solver_ext, func)));
+		registerGrid("density",    "density"    + solver_ext, func, (void**) &mDensity,    GRID_TYPE_FLOAT, false);
+		registerGrid("emissionIn", "emissionIn" + solver_ext, func, (void**) &mEmissionIn, GRID_TYPE_FLOAT, false);
+		registerGrid("shadow",     "shadow"     + solver_ext, func, (void**) &mShadow,     GRID_TYPE_FLOAT, false);
 
 		if (mUsingHeat) {
-			mHeat       = (float*) stringToPointer(pyObjectToString(callPythonFunction("heat"   + solver_ext,    func)));
+			registerGrid("heat",    "heat"    + solver_ext, func, (void**) &mHeat,   GRID_TYPE_FLOAT, false);
 		}
 		if (mUsingFire) {
-			mFlame      = (float*) stringToPointer(pyObjectToString(callPythonFunction("flame"  + solver_ext,   func)));
-			mFuel       = (float*) stringToPointer(pyObjectToString(callPythonFunction("fuel"   + solver_ext,   func)));
-			mReact      = (float*) stringToPointer(pyObjectToString(callPythonFunction("react"  + solver_ext,   func)));
+			registerGrid("flame",   "flame"   + solver_ext, func, (void**) &mFlame,  GRID_TYPE_FLOAT, false);
+			registerGrid("fuel",    "fuel"    + solver_ext, func, (void**) &mFuel,   GRID_TYPE_FLOAT, false);
+			registerGrid("react",   "react"   + solver_ext, func, (void**) &mReact,  GRID_TYPE_FLOAT, false);
 		}
 		if (mUsingColors) {
-			mColorR     = (float*) stringToPointer(pyObjectToString(callPythonFunction("color_r"   + solver_ext, func)));
-			mColorG     = (float*) stringToPointer(pyObjectToString(callPythonFunction("color_g"   + solver_ext, func)));
-			mColorB     = (float*) stringToPointer(pyObjectToString(callPythonFunction("color_b"   + solver_ext, func)));
+			registerGrid("color_r", "color_r" + solver_ext, func, (void**) &mColorR, GRID_TYPE_FLOAT, false);
+			registerGrid("color_g", "color_g" + solver_ext, func, (void**) &mColorG, GRID_TYPE_FLOAT, false);
+			registerGrid("color_b", "color_b" + solver_ext, func, (void**) &mColorB, GRID_TYPE_FLOAT, false);
 		}
 	}
+
+	resolveGrids(false);
 }
 
 void FLUID::updatePointersHigh()
@@ -2024,26 +2270,27 @@ void FLUID::updatePointersHigh()
 	
 	// Smoke
 	if (mUsingSmoke) {
-		mDensityHigh    = (float*) stringToPointer(pyObjectToString(callPythonFunction("density"    + noise_ext, func)));
-		mShadow         = (float*) stringToPointer(pyObjectToString(callPythonFunction("shadow"     + solver_ext, func)));
-		mTextureU       = (float*) stringToPointer(pyObjectToString(callPythonFunction("texture_u"  + solver_ext,   func)));
-		mTextureV       = (float*) stringToPointer(pyObjectToString(callPythonFunction("texture_v"  + solver_ext,   func)));
-		mTextureW       = (float*) stringToPointer(pyObjectToString(callPythonFunction("texture_w"  + solver_ext,   func)));
-		mTextureU2      = (float*) stringToPointer(pyObjectToString(callPythonFunction("texture_u2" + solver_ext,   func)));
-		mTextureV2      = (float*) stringToPointer(pyObjectToString(callPythonFunction("texture_v2" + solver_ext,   func)));
-		mTextureW2      = (float*) stringToPointer(pyObjectToString(callPythonFunction("texture_w2" + solver_ext,   func)));
+		registerGrid("density_high", "density"    + noise_ext,  func, (void**) &mDensityHigh, GRID_TYPE_FLOAT, true);
+		registerGrid("texture_u",    "texture_u"  + solver_ext, func, (void**) &mTextureU,    GRID_TYPE_FLOAT, true);
+		registerGrid("texture_v",    "texture_v"  + solver_ext, func, (void**) &mTextureV,    GRID_TYPE_FLOAT, true);
+		registerGrid("texture_w",    "texture_w"  + solver_ext, func, (void**) &mTextureW,    GRID_TYPE_FLOAT, true);
+		registerGrid("texture_u2",   "texture_u2" + solver_ext, func, (void**) &mTextureU2,   GRID_TYPE_FLOAT, true);
+		registerGrid("texture_v2",   "texture_v2" + solver_ext, func, (void**) &mTextureV2,   GRID_TYPE_FLOAT, true);
+		registerGrid("texture_w2",   "texture_w2" + solver_ext, func, (void**) &mTextureW2,   GRID_TYPE_FLOAT, true);
 		
 		if (mUsingFire) {
-			mFlameHigh  = (float*) stringToPointer(pyObjectToString(callPythonFunction("flame" + noise_ext, func)));
-			mFuelHigh   = (float*) stringToPointer(pyObjectToString(callPythonFunction("fuel"  + noise_ext, func)));
-			mReactHigh  = (float*) stringToPointer(pyObjectToString(callPythonFunction("react" + noise_ext, func)));
+			registerGrid("flame_high",   "flame"   + noise_ext, func, (void**) &mFlameHigh,  GRID_TYPE_FLOAT, true);
+			registerGrid("fuel_high",    "fuel"    + noise_ext, func, (void**) &mFuelHigh,   GRID_TYPE_FLOAT, true);
+			registerGrid("react_high",   "react"   + noise_ext, func, (void**) &mReactHigh,  GRID_TYPE_FLOAT, true);
 		}
 		if (mUsingColors) {
-			mColorRHigh = (float*) stringToPointer(pyObjectToString(callPythonFunction("color_r" + noise_ext, func)));
-			mColorGHigh = (float*) stringToPointer(pyObjectToString(callPythonFunction("color_g" + noise_ext, func)));
-			mColorBHigh = (float*) stringToPointer(pyObjectToString(callPythonFunction("color_b" + noise_ext, func)));
+			registerGrid("color_r_high", "color_r" + noise_ext, func, (void**) &mColorRHigh, GRID_TYPE_FLOAT, true);
+			registerGrid("color_g_high", "color_g" + noise_ext, func, (void**) &mColorGHigh, GRID_TYPE_FLOAT, true);
+			registerGrid("color_b_high", "color_b" + noise_ext, func, (void**) &mColorBHigh, GRID_TYPE_FLOAT, true);
 		}
 	}
+
+	resolveGrids(true);
 }
 
 void FLUID::setFlipParticleData(float* buffer, int numParts)
@@ -2060,6 +2307,7 @@ void FLUID::setFlipParticleData(float* buffer, int numParts)
 		it->flag = bufferPData->flag;
 		bufferPData++;
 	}
+	tagGridChanged("pp");
 }
 
 void FLUID::setSndParticleData(float* buffer, int numParts)
@@ -2076,6 +2324,7 @@ void FLUID::setSndParticleData(float* buffer, int numParts)
 		it->flag = bufferPData->flag;
 		bufferPData++;
 	}
+	tagGridChanged("ppSnd");
 }
 
 void FLUID::setFlipParticleVelocity(float* buffer, int numParts)
@@ -2091,6 +2340,7 @@ void FLUID::setFlipParticleVelocity(float* buffer, int numParts)
 		it->pos[2] = bufferPVel->pos[2];
 		bufferPVel++;
 	}
+	tagGridChanged("pVel");
 }
 
 void FLUID::setSndParticleVelocity(float* buffer, int numParts)
@@ -2106,6 +2356,7 @@ void FLUID::setSndParticleVelocity(float* buffer, int numParts)
 		it->pos[2] = bufferPVel->pos[2];
 		bufferPVel++;
 	}
+	tagGridChanged("pVelSnd");
 }
 
 void FLUID::setSndParticleLife(float* buffer, int numParts)
@@ -2119,6 +2370,7 @@ void FLUID::setSndParticleLife(float* buffer, int numParts)
 		*it = *bufferPType;
 		bufferPType++;
 	}
+	tagGridChanged("pLifeSnd");
 }
 
 void FLUID::saveFluidObstacleData(char *pathname)
@@ -33,6 +33,7 @@
 #include <string>
 #include <vector>
 #include <atomic>
+#include <stdint.h>
 
 struct FLUID {
 public:
@@ -69,6 +70,25 @@ public:
 	void updatePointers();
 	void updatePointersHigh();
 
+	// Grid registry: solver buffers shared with Blender, looked up once by name
+	enum GridType { GRID_TYPE_FLOAT = 0, GRID_TYPE_INT = 1, GRID_TYPE_OBJECT = 2, GRID_TYPE_VEC3 = 3 };
+	int findGrid(const std::string& name);
+	inline int getNumGrids() { return (int) mGrids.size(); }
+	inline bool isValidGrid(int handle) { return handle >= 0 && handle < (int) mGrids.size(); }
+	inline const char* getGridName(int handle) { return mGrids[handle].name.c_str(); }
+	inline int getGridType(int handle) { return mGrids[handle].type; }
+	inline bool isGridHigh(int handle) { return mGrids[handle].high; }
+	inline void* getGridData(int handle) { return *mGrids[handle].target; }
+	inline unsigned int getGridVersion(int handle) { return mGrids[handle].version; }
+	inline bool isGridDirty(int handle) { return mGrids[handle].dirty; }
+	inline void clearGridDirty(int handle) { mGrids[handle].dirty = false; }
+	void tagGridChanged(int handle);
+	void tagGridChanged(const std::string& name);
+	// Grids computed from another grid (e.g. shadow from density): up to date while the
+	// source keeps its version and the other inputs, summarized by key, are the same
+	bool isGridDerivedCurrent(int handle, int source, unsigned int key);
+	void tagGridDerived(int handle, int source, unsigned int key);
+
 	// Write cache
 	int writeData(SmokeModifierData *smd, int framenr);
 	// write call for noise, mesh and particles were left in bake calls for now
@@ -297,6 +317,7 @@ private:
 	// Smoke grids
 	float* mDensity;
 	float* mHeat;
+	float* mVelocity; // MAC grid, 3 floats per cell
 	float* mVelocityX;
 	float* mVelocityY;
 	float* mVelocityZ;
@@ -358,6 +379,33 @@ private:
 	std::vector<pVel>* mSndParticleVelocity;
 	std::vector<float>* mSndParticleLife;
 
+	// Registered solver buffers. The target member mirrors the buffer address so
+	// the typed getters above stay valid, the version is bumped on every change.
+	typedef struct GridBuffer {
+		std::string name;   // registry key, e.g. "density" or "density_high"
+		std::string object; // Python object owning the buffer, e.g. "density_s1"
+		std::string getter; // Python method returning the buffer address
+		void** target;
+		int type;
+		bool high;
+		unsigned int version;
+		unsigned int savedVersion; // version written to the data cache at mSavedFrame
+		uint64_t hash;             // contents at the last version bump, 0 for object grids
+		int derivedFrom;           // source grid this one was last computed from, -1 if none
+		unsigned int derivedVersion;
+		unsigned int derivedKey;
+		bool dirty;
+	} GridBuffer;
+	std::vector<GridBuffer> mGrids;
+	int mSavedFrame; // frame of the last data cache write, -1 if none yet
+
+	void registerGrid(const std::string& name, const std::string& object, const std::string& getter, void** target, int type, bool high);
+	void resolveGrids(bool high);
+	void tagGridsChanged(bool high);
+	void tagSolverGridsChanged(bool high);
+	std::string getUnchangedCacheFiles();
+	void markCacheFilesSaved(int framenr);
+
 	void initDomain(struct SmokeModifierData *smd);
 	void initNoise(struct SmokeModifierData *smd);
 	void initMesh(struct SmokeModifierData *smd);
@@ -921,3 +921,82 @@ extern "C" void fluid_adapt_timestep(FLUID* fluid)
 		fluid->adaptTimestep();
 }
 
+
+/* Grid registry */
+extern "C" int fluid_grid_find(FLUID *fluid, const char *name)
+{
+	if (!fluid || !name) return -1;
+	return fluid->findGrid(name);
+}
+
+extern "C" int fluid_grid_num(FLUID *fluid)
+{
+	if (!fluid) return 0;
+	return fluid->getNumGrids();
+}
+
+extern "C" const char *fluid_grid_name(FLUID *fluid, int handle)
+{
+	if (!fluid || !fluid->isValidGrid(handle)) return NULL;
+	return fluid->getGridName(handle);
+}
+
+extern "C" int fluid_grid_type(FLUID *fluid, int handle)
+{
+	if (!fluid || !fluid->isValidGrid(handle)) return -1;
+	return fluid->getGridType(handle);
+}
+
+extern "C" int fluid_grid_is_high(FLUID *fluid, int handle)
+{
+	if (!fluid || !fluid->isValidGrid(handle)) return 0;
+	return fluid->isGridHigh(handle) ? 1 : 0;
+}
+
+extern "C" float *fluid_grid_get_float(FLUID *fluid, int handle)
+{
+	if (!fluid || !fluid->isValidGrid(handle) || fluid->getGridType(handle) != FLUID::GRID_TYPE_FLOAT) return NULL;
+	return (float*) fluid->getGridData(handle);
+}
+
+extern "C" int *fluid_grid_get_int(FLUID *fluid, int handle)
+{
+	if (!fluid || !fluid->isValidGrid(handle) || fluid->getGridType(handle) != FLUID::GRID_TYPE_INT) return NULL;
+	return (int*) fluid->getGridData(handle);
+}
+
+extern "C" unsigned int fluid_grid_version(FLUID *fluid, int handle)
+{
+	if (!fluid || !fluid->isValidGrid(handle)) return 0;
+	return fluid->getGridVersion(handle);
+}
+
+extern "C" int fluid_grid_is_dirty(FLUID *fluid, int handle)
+{
+	if (!fluid || !fluid->isValidGrid(handle)) return 0;
+	return fluid->isGridDirty(handle) ? 1 : 0;
+}
+
+extern "C" void fluid_grid_clear_dirty(FLUID *fluid, int handle)
+{
+	if (fluid && fluid->isValidGrid(handle))
+		fluid->clearGridDirty(handle);
+}
+
+extern "C" void fluid_grid_tag_changed(FLUID *fluid, int handle)
+{
+	if (fluid && fluid->isValidGrid(handle))
+		fluid->tagGridChanged(handle);
+}
+
+extern "C" int fluid_grid_derived_is_current(FLUID *fluid, int handle, int source, unsigned int key)
+{
+	if (!fluid || !fluid->isValidGrid(handle) || !fluid->isValidGrid(source)) return 0;
+	return fluid->isGridDerivedCurrent(handle, source, key) ? 1 : 0;
+}
+
+extern "C" void fluid_grid_tag_derived(FLUID *fluid, int handle, int source, unsigned int key)
+{
+	if (fluid && fluid->isValidGrid(handle) && fluid->isValidGrid(source))
+		fluid->tagGridDerived(handle, source, key);
+}
@@ -521,11 +521,14 @@ void solvePressureSystem(Grid<Real>& rhs, MACGrid& vel, Grid<Real>& pressure, co
 		gcg->setMGPreconditioner( GridCgInterface::PC_MGP, pmg);
 	}
 
-	// CG solve
-	for (int iter=0; iter<maxIter; iter++) {
-		if (!gcg->iterate()) iter=maxIter;
-		debMsg("FluidSolver::solvePressure iteration "<<iter<<", residual: "<<gcg->getResNorm(), 9);
-	} 
+	// CG solve, only runs kernels so other solver instances can use Python meanwhile
+	{
+		PbAllowThreads allowThreads;
+		for (int iter=0; iter<maxIter; iter++) {
+			if (!gcg->iterate()) iter=maxIter;
+			debMsg("FluidSolver::solvePressure iteration "<<iter<<", residual: "<<gcg->getResNorm(), 9);
+		}
+	}
 	debMsg("FluidSolver::solvePressure iterations:"<<gcg->getIterations()<<", residual:"<<gcg->getResNorm(), 2);
 
 	// Cleanup
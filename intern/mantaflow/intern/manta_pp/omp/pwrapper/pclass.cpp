@@ -37,6 +37,17 @@ void pbPreparePlugin(FluidSolver* parent, const string& name, bool doTime) {
 	if(doTime) TimingData::instance().start(parent, name);
 }
 
+PbAllowThreads::PbAllowThreads() : mState(NULL) {
+	// plugins may also be called from C++ without holding the GIL
+	if (PyGILState_Check())
+		mState = PyEval_SaveThread();
+}
+
+PbAllowThreads::~PbAllowThreads() {
+	if (mState)
+		PyEval_RestoreThread((PyThreadState*)mState);
+}
+
 void pbFinalizePlugin(FluidSolver *parent, const string& name, bool doTime) {
     if(doTime) TimingData::instance().stop(parent, name);
 	
@@ -31,11 +31,6 @@
 using namespace std;
 namespace Manta {
 
-// only supports a single blur size for now, globals stored here
-bool gBlurPrecomputed = false;
-int  gBlurKernelRadius = -1;
-Matrix gBlurKernel;
-
 // *****************************************************************************
 // Helper functions for fluid guiding
 
@@ -222,29 +217,23 @@ void setGradientYWeight(Grid<Real> &W, const int minY, const int maxY, const Rea
 	
 //! Apply Gaussian blur (either 2D or 3D) in a separable way
 void applySeparableGaussianBlur(MACGrid &grid, const FlagGrid &flags, const Matrix &kernel1D) {
-	assertMsg(gBlurPrecomputed, "Error - blue kernel not precomputed");
 	applySeparableKernel(grid, flags, kernel1D);
 }
 
 //! Precomputation performed before the first PD iteration
-void ADMM_precompute_Separable(int blurRadius) {
-	if (gBlurPrecomputed) {
-		assertMsg( gBlurKernelRadius == blurRadius, "More than a single blur radius not supported at the moment." );
-		return;
-	}
+//! (the kernel is built per call, solvers of several domains may run at the same time)
+Matrix ADMM_precompute_Separable(int blurRadius) {
 	int kernelSize = 2 * blurRadius + 1;
-	gBlurKernel = get1DGaussianBlurKernel(kernelSize, kernelSize);
-	gBlurPrecomputed = true;
-	gBlurKernelRadius = blurRadius;
+	return get1DGaussianBlurKernel(kernelSize, kernelSize);
 }
 
 //! Apply approximate multiplication of inverse(M)
-void applyApproxInvM(MACGrid& v, const FlagGrid &flags, const MACGrid& invA) {
+void applyApproxInvM(MACGrid& v, const FlagGrid &flags, const MACGrid& invA, const Matrix &blurKernel) {
 	MACGrid v_new = MACGrid(v.getParent());
 	v_new.copyFrom(v); 
 	v_new.mult(invA);
-	applySeparableGaussianBlur(v_new, flags, gBlurKernel); 
-	applySeparableGaussianBlur(v_new, flags, gBlurKernel);
+	applySeparableGaussianBlur(v_new, flags, blurKernel); 
+	applySeparableGaussianBlur(v_new, flags, blurKernel);
 	v_new.multConst(2.0); 
 	v_new.mult(invA);
 	v.mult(invA);
@@ -253,11 +242,11 @@ void applyApproxInvM(MACGrid& v, const FlagGrid &flags, const MACGrid& invA) {
 
 //! Precompute Q, a reused quantity in the PD iterations
 //! Q = 2*G*G*(velT-velC)-sigma*velC
-void precomputeQ(MACGrid &Q, const FlagGrid &flags, const MACGrid &velT_region, const MACGrid &velC, const Matrix &gBlurKernel, const Real sigma) {
+void precomputeQ(MACGrid &Q, const FlagGrid &flags, const MACGrid &velT_region, const MACGrid &velC, const Matrix &blurKernel, const Real sigma) {
 	Q.copyFrom(velT_region);
 	Q.sub(velC);
-	applySeparableGaussianBlur(Q, flags, gBlurKernel); 
-	applySeparableGaussianBlur(Q, flags, gBlurKernel);
+	applySeparableGaussianBlur(Q, flags, blurKernel); 
+	applySeparableGaussianBlur(Q, flags, blurKernel);
 	Q.multConst(2.0);
 	Q.addScaled(velC, -sigma);
 }
@@ -276,10 +265,10 @@ void precomputeInvA(MACGrid &invA, const Grid<Real> &weight, const Real sigma) {
 }
 
 //! proximal operator of f , guiding 
-void prox_f(MACGrid& v, const FlagGrid &flags, const MACGrid& Q, const MACGrid& velC, const Real sigma, const MACGrid& invA) {
+void prox_f(MACGrid& v, const FlagGrid &flags, const MACGrid& Q, const MACGrid& velC, const Real sigma, const MACGrid& invA, const Matrix &blurKernel) {
 	v.multConst(sigma);
 	v.add(Q);
-	applyApproxInvM(v, flags, invA);
+	applyApproxInvM(v, flags, invA, blurKernel);
 	v.add(velC);
 }
 
@@ -322,9 +311,9 @@ void PD_fluid_guiding(MACGrid& vel, MACGrid& velT, Grid<Real>& pressure, FlagGri
 	MACGrid z0 = MACGrid(parent);
 
 	// precomputation
-	ADMM_precompute_Separable(blurRadius);
+	const Matrix blurKernel = ADMM_precompute_Separable(blurRadius);
 	MACGrid Q = MACGrid(parent);
-	precomputeQ(Q, flags, velT, velC, gBlurKernel, sigma);
+	precomputeQ(Q, flags, velT, velC, blurKernel, sigma);
 	MACGrid invA = MACGrid(parent);
 	precomputeInvA(invA, weight, sigma);
 
@@ -335,7 +324,7 @@ void PD_fluid_guiding(MACGrid& vel, MACGrid& velT, Grid<Real>& pressure, FlagGri
 		x0.copyFrom(x);
 		x.multConst(1.0 / sigma); 
 		x.add(y); 
-		prox_f(x, flags, Q, velC, sigma, invA);
+		prox_f(x, flags, Q, velC, sigma, invA, blurKernel);
 		x.multConst(-sigma); x.addScaled(y, sigma); x.add(x0);
 
 		// z-update
@@ -364,11 +353,8 @@ void PD_fluid_guiding(MACGrid& vel, MACGrid& velT, Grid<Real>& pressure, FlagGri
 	debMsg("PD_fluid_guiding iterations:" << iter, 1);
 } static PyObject* _W_2 (PyObject* _self, PyObject* _linargs, PyObject* _kwds) { try { PbArgs _args(_linargs, _kwds); FluidSolver *parent = _args.obtainParent(); bool noTiming = _args.getOpt<bool>("notiming", -1, 0); pbPreparePlugin(parent, "PD_fluid_guiding" , !noTiming ); PyObject *_retval = 0; { ArgLocker _lock; MACGrid& vel = *_args.getPtr<MACGrid >("vel",0,&_lock); MACGrid& velT = *_args.getPtr<MACGrid >("velT",1,&_lock); Grid<Real>& pressure = *_args.getPtr<Grid<Real> >("pressure",2,&_lock); FlagGrid& flags = *_args.getPtr<FlagGrid >("flags",3,&_lock); Grid<Real>& weight = *_args.getPtr<Grid<Real> >("weight",4,&_lock); int blurRadius = _args.getOpt<int >("blurRadius",5,5,&_lock); Real theta = _args.getOpt<Real >("theta",6,1.0,&_lock); Real tau = _args.getOpt<Real >("tau",7,1.0,&_lock); Real sigma = _args.getOpt<Real >("sigma",8,1.0,&_lock); Real epsRel = _args.getOpt<Real >("epsRel",9,1e-3,&_lock); Real epsAbs = _args.getOpt<Real >("epsAbs",10,1e-3,&_lock); int maxIters = _args.getOpt<int >("maxIters",11,200,&_lock); Grid<Real>* phi = _args.getPtrOpt<Grid<Real> >("phi",12,0,&_lock); Grid<Real>* perCellCorr = _args.getPtrOpt<Grid<Real> >("perCellCorr",13,0,&_lock); MACGrid* fractions = _args.getPtrOpt<MACGrid >("fractions",14,0,&_lock); Real gfClamp = _args.getOpt<Real >("gfClamp",15,1e-04,&_lock); Real cgMaxIterFac = _args.getOpt<Real >("cgMaxIterFac",16,1.5,&_lock); Real cgAccuracy = _args.getOpt<Real >("cgAccuracy",17,1e-3,&_lock); int preconditioner = _args.getOpt<int >("preconditioner",18,1,&_lock); bool zeroPressureFixing = _args.getOpt<bool >("zeroPressureFixing",19,false,&_lock); const Grid<Real> * curv = _args.getPtrOpt<Grid<Real>  >("curv",20,NULL,&_lock); const Real surfTens = _args.getOpt<Real >("surfTens",21,0.,&_lock);   _retval = getPyNone(); PD_fluid_guiding(vel,velT,pressure,flags,weight,blurRadius,theta,tau,sigma,epsRel,epsAbs,maxIters,phi,perCellCorr,fractions,gfClamp,cgMaxIterFac,cgAccuracy,preconditioner,zeroPressureFixing,curv,surfTens);  _args.check(); } pbFinalizePlugin(parent,"PD_fluid_guiding", !noTiming ); return _retval; } catch(std::exception& e) { pbSetError("PD_fluid_guiding",e.what()); return 0; } } static const Pb::Register _RP_PD_fluid_guiding ("","PD_fluid_guiding",_W_2);  extern "C" { void PbRegister_PD_fluid_guiding() { KEEP_UNUSED(_RP_PD_fluid_guiding); } } 
 
-//! reset precomputation
+//! reset precomputation (nothing is kept between calls anymore, kept for existing scripts)
 void releaseBlurPrecomp() {
-	gBlurPrecomputed = false;
-	gBlurKernelRadius = -1;
-	gBlurKernel = 0.f;
 } static PyObject* _W_3 (PyObject* _self, PyObject* _linargs, PyObject* _kwds) { try { PbArgs _args(_linargs, _kwds); FluidSolver *parent = _args.obtainParent(); bool noTiming = _args.getOpt<bool>("notiming", -1, 0); pbPreparePlugin(parent, "releaseBlurPrecomp" , !noTiming ); PyObject *_retval = 0; { ArgLocker _lock;   _retval = getPyNone(); releaseBlurPrecomp();  _args.check(); } pbFinalizePlugin(parent,"releaseBlurPrecomp", !noTiming ); return _retval; } catch(std::exception& e) { pbSetError("releaseBlurPrecomp",e.what()); return 0; } } static const Pb::Register _RP_releaseBlurPrecomp ("","releaseBlurPrecomp",_W_3);  extern "C" { void PbRegister_releaseBlurPrecomp() { KEEP_UNUSED(_RP_releaseBlurPrecomp); } } 
 
 
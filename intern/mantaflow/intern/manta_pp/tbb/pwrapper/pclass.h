@@ -91,6 +91,17 @@ void pbPreparePlugin(FluidSolver* parent, const std::string& name, bool doTime=t
 void pbSetError(const std::string& fn, const std::string& ex);
 
 //!\endcond
+
+//! Releases the Python GIL while in scope, so other solver instances can run their
+//! Python code meanwhile. Only for pure C++ code: no Python calls, and no PbClass
+//! objects may be created or destroyed while the GIL is released.
+class PbAllowThreads {
+public:
+	PbAllowThreads();
+	~PbAllowThreads();
+private:
+	void* mState; // PyThreadState, opaque to avoid including Python.h
+};
 	   
 } // namespace        
 
@@ -350,14 +350,14 @@ def liquid_save_mesh_$ID$(path, framenr, file_format):\n\
 //////////////////////////////////////////////////////////////////////
 
 const std::string liquid_save_data = "\n\
-def liquid_save_data_$ID$(path, framenr, file_format):\n\
+def liquid_save_data_$ID$(path, framenr, file_format, unchanged=[], prev_framenr=None):\n\
     mantaMsg('Liquid save data')\n\
-    fluid_file_export_s$ID$(dict=liquid_data_dict_s$ID$, path=path, framenr=framenr, file_format=file_format)\n";
+    fluid_file_export_s$ID$(dict=liquid_data_dict_s$ID$, path=path, framenr=framenr, file_format=file_format, unchanged=unchanged, prev_framenr=prev_framenr)\n";
 
 const std::string liquid_save_flip = "\n\
-def liquid_save_flip_$ID$(path, framenr, file_format):\n\
+def liquid_save_flip_$ID$(path, framenr, file_format, unchanged=[], prev_framenr=None):\n\
     mantaMsg('Liquid save flip')\n\
-    fluid_file_export_s$ID$(dict=liquid_flip_dict_s$ID$, path=path, framenr=framenr, file_format=file_format)\n";
+    fluid_file_export_s$ID$(dict=liquid_flip_dict_s$ID$, path=path, framenr=framenr, file_format=file_format, unchanged=unchanged, prev_framenr=prev_framenr)\n";
 
 const std::string liquid_save_mesh = "\n\
 def liquid_save_mesh_$ID$(path, framenr, file_format):\n\
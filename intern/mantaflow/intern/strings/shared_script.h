@@ -436,12 +436,19 @@ def fluid_load_data_$ID$(path, framenr, file_format):\n\
 //////////////////////////////////////////////////////////////////////
 
 const std::string fluid_file_export = "\n\
-def fluid_file_export_s$ID$(dict, path, framenr, file_format, mode_override=False):\n\
+def fluid_file_export_s$ID$(dict, path, framenr, file_format, mode_override=False, unchanged=[], prev_framenr=None):\n\
     try:\n\
         framenr = fluid_cache_get_framenr_formatted_$ID$(framenr)\n\
         for name, object in dict.items():\n\
             file = os.path.join(path, name + '_' + framenr + file_format)\n\
-            if not os.path.isfile(file) or mode_override: object.save(file)\n\
+            if os.path.isfile(file) and not mode_override: continue\n\
+            # Grids that did not change since the previous write just duplicate that file\n\
+            if name in unchanged and prev_framenr is not None:\n\
+                prev_file = os.path.join(path, name + '_' + fluid_cache_get_framenr_formatted_$ID$(prev_framenr) + file_format)\n\
+                if os.path.isfile(prev_file):\n\
+                    shutil.copyfile(prev_file, file)\n\
+                    continue\n\
+            object.save(file)\n\
     except Exception as e:\n\
         mantaMsg(str(e))\n\
         pass # Just skip file save errors for now\n";
@@ -452,9 +459,9 @@ def fluid_save_particles_$ID$(path, framenr, file_format):\n\
     fluid_file_export_s$ID$(dict=fluid_particles_dict_s$ID$, path=path, framenr=framenr, file_format=file_format)\n";
 
 const std::string fluid_save_data = "\n\
-def fluid_save_data_$ID$(path, framenr, file_format):\n\
+def fluid_save_data_$ID$(path, framenr, file_format, unchanged=[], prev_framenr=None):\n\
     mantaMsg('Fluid save data low')\n\
-    fluid_file_export_s$ID$(dict=fluid_data_dict_s$ID$, path=path, framenr=framenr, file_format=file_format)\n";
+    fluid_file_export_s$ID$(dict=fluid_data_dict_s$ID$, path=path, framenr=framenr, file_format=file_format, unchanged=unchanged, prev_framenr=prev_framenr)\n";
 
 //////////////////////////////////////////////////////////////////////
 // STANDALONE MODE
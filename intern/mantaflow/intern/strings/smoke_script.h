@@ -505,9 +505,9 @@ def smoke_load_noise_$ID$(path, framenr, file_format):\n\
 //////////////////////////////////////////////////////////////////////
 
 const std::string smoke_save_data = "\n\
-def smoke_save_data_$ID$(path, framenr, file_format):\n\
+def smoke_save_data_$ID$(path, framenr, file_format, unchanged=[], prev_framenr=None):\n\
     mantaMsg('Smoke save data')\n\
-    fluid_file_export_s$ID$(dict=smoke_data_dict_s$ID$, path=path, framenr=framenr, file_format=file_format)\n";
+    fluid_file_export_s$ID$(dict=smoke_data_dict_s$ID$, path=path, framenr=framenr, file_format=file_format, unchanged=unchanged, prev_framenr=prev_framenr)\n";
 
 const std::string smoke_save_noise = "\n\
 def smoke_save_noise_$ID$(path, framenr, file_format):\n\
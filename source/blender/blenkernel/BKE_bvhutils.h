@@ -153,6 +153,9 @@ BVHTree *bvhtree_from_mesh_looptri_ex(
 BVHTree *bvhtree_from_mesh_get(
         struct BVHTreeFromMesh *data, struct DerivedMesh *mesh,
         const int type, const int tree_type);
+BVHTree *bvhtree_from_mesh_get_ex(
+        struct BVHTreeFromMesh *data, struct DerivedMesh *mesh,
+        const int type, const int tree_type, const int build_flag);
 
 /**
  * Frees data allocated by a call to bvhtree_from_mesh_*.
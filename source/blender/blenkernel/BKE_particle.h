@@ -104,6 +104,11 @@ typedef struct SPHData {
 	/* Integrator callbacks. This allows different SPH implementations. */
 	void (*force_cb) (void *sphdata_v, ParticleKey *state, float *force, float *impulse);
 	void (*density_cb) (void *rangedata_v, int index, const float co[3], float squared_dist);
+
+	/* When set, new springs are collected in new_springs (allocated from the
+	 * arena) instead of being added to the particle system right away. */
+	struct MemArena *memarena;
+	struct LinkNode *new_springs;
 } SPHData;
 
 typedef struct ParticleTexture {
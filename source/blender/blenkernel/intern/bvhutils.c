@@ -421,7 +421,8 @@ static BVHTree *bvhtree_from_editmesh_verts_create_tree(
 static BVHTree *bvhtree_from_mesh_verts_create_tree(
         float epsilon, int tree_type, int axis,
         const MVert *vert, const int verts_num,
-        const BLI_bitmap *verts_mask, int verts_num_active)
+        const BLI_bitmap *verts_mask, int verts_num_active,
+        const int build_flag)
 {
 	BLI_assert(vert != NULL);
 	if (verts_mask) {
@@ -431,7 +432,7 @@ static BVHTree *bvhtree_from_mesh_verts_create_tree(
 		verts_num_active = verts_num;
 	}
 
-	BVHTree *tree = BLI_bvhtree_new(verts_num_active, epsilon, tree_type, axis);
+	BVHTree *tree = BLI_bvhtree_new_ex(verts_num_active, epsilon, tree_type, axis, build_flag);
 
 	if (tree) {
 		for (int i = 0; i < verts_num; i++) {
@@ -509,7 +510,7 @@ BVHTree *bvhtree_from_mesh_verts_ex(
         float epsilon, int tree_type, int axis)
 {
 	BVHTree *tree = bvhtree_from_mesh_verts_create_tree(
-	        epsilon, tree_type, axis, vert, verts_num, verts_mask, verts_num_active);
+	        epsilon, tree_type, axis, vert, verts_num, verts_mask, verts_num_active, 0);
 
 	/* Setup BVHTreeFromMesh */
 	bvhtree_from_mesh_verts_setup_data(
@@ -565,7 +566,7 @@ static BVHTree *bvhtree_from_editmesh_edges_create_tree(
 static BVHTree *bvhtree_from_mesh_edges_create_tree(
         const MVert *vert, const MEdge *edge, const int edge_num,
         const BLI_bitmap *edges_mask, int edges_num_active,
-        float epsilon, int tree_type, int axis)
+        float epsilon, int tree_type, int axis, const int build_flag)
 {
 	if (edges_mask) {
 		BLI_assert(IN_RANGE_INCL(edges_num_active, 0, edge_num));
@@ -577,7 +578,7 @@ static BVHTree *bvhtree_from_mesh_edges_create_tree(
 	BLI_assert(edge != NULL);
 
 	/* Create a bvh-tree of the given target */
-	BVHTree *tree = BLI_bvhtree_new(edges_num_active, epsilon, tree_type, axis);
+	BVHTree *tree = BLI_bvhtree_new_ex(edges_num_active, epsilon, tree_type, axis, build_flag);
 	if (tree) {
 		for (int i = 0; i < edge_num; i++) {
 			if (edges_mask && !BLI_BITMAP_TEST_BOOL(edges_mask, i)) {
@@ -664,7 +665,7 @@ BVHTree *bvhtree_from_mesh_edges_ex(
 {
 	BVHTree *tree = bvhtree_from_mesh_edges_create_tree(
 	        vert, edge, edges_num, edges_mask, edges_num_active,
-	        epsilon, tree_type, axis);
+	        epsilon, tree_type, axis, 0);
 
 	/* Setup BVHTreeFromMesh */
 	bvhtree_from_mesh_edges_setup_data(
@@ -684,7 +685,8 @@ BVHTree *bvhtree_from_mesh_edges_ex(
 static BVHTree *bvhtree_from_mesh_faces_create_tree(
         float epsilon, int tree_type, int axis,
         const MVert *vert, const MFace *face, const int faces_num,
-        const BLI_bitmap *faces_mask, int faces_num_active)
+        const BLI_bitmap *faces_mask, int faces_num_active,
+        const int build_flag)
 {
 	BVHTree *tree = NULL;
 	int i;
@@ -699,7 +701,7 @@ static BVHTree *bvhtree_from_mesh_faces_create_tree(
 
 		/* Create a bvh-tree of the given target */
 		/* printf("%s: building BVH, total=%d\n", __func__, numFaces); */
-		tree = BLI_bvhtree_new(faces_num_active, epsilon, tree_type, axis);
+		tree = BLI_bvhtree_new_ex(faces_num_active, epsilon, tree_type, axis, build_flag);
 		if (tree) {
 			if (vert && face) {
 				for (i = 0; i < faces_num; i++) {
@@ -760,7 +762,7 @@ BVHTree *bvhtree_from_mesh_faces_ex(
 	BVHTree *tree = bvhtree_from_mesh_faces_create_tree(
 	        epsilon, tree_type, axis,
 	        vert, face, numFaces,
-	        faces_mask, faces_num_active);
+	        faces_mask, faces_num_active, 0);
 
 	/* Setup BVHTreeFromMesh */
 	bvhtree_from_mesh_faces_setup_data(
@@ -830,7 +832,8 @@ static BVHTree *bvhtree_from_editmesh_looptri_create_tree(
 static BVHTree *bvhtree_from_mesh_looptri_create_tree(
         float epsilon, int tree_type, int axis,
         const MVert *vert, const MLoop *mloop, const MLoopTri *looptri, const int looptri_num,
-        const BLI_bitmap *looptri_mask, int looptri_num_active)
+        const BLI_bitmap *looptri_mask, int looptri_num_active,
+        const int build_flag)
 {
 	BVHTree *tree = NULL;
 	int i;
@@ -845,7 +848,7 @@ static BVHTree *bvhtree_from_mesh_looptri_create_tree(
 
 		/* Create a bvh-tree of the given target */
 		/* printf("%s: building BVH, total=%d\n", __func__, numFaces); */
-		tree = BLI_bvhtree_new(looptri_num_active, epsilon, tree_type, axis);
+		tree = BLI_bvhtree_new_ex(looptri_num_active, epsilon, tree_type, axis, build_flag);
 		if (tree) {
 			if (vert && looptri) {
 				for (i = 0; i < looptri_num; i++) {
@@ -964,7 +967,7 @@ BVHTree *bvhtree_from_mesh_looptri_ex(
 	BVHTree *tree = bvhtree_from_mesh_looptri_create_tree(
 	        epsilon, tree_type, axis,
 	        vert, mloop, looptri, looptri_num,
-	        looptri_mask, looptri_num_active);
+	        looptri_mask, looptri_num_active, 0);
 
 	/* Setup BVHTreeFromMesh */
 	bvhtree_from_mesh_looptri_setup_data(
@@ -978,10 +981,13 @@ BVHTree *bvhtree_from_mesh_looptri_ex(
 
 /**
  * Builds or queries a bvhcache for the cache bvhtree of the request type.
+ *
+ * \param build_flag: Passed to #BLI_bvhtree_new_ex when the tree is not cached yet,
+ * e.g. #BVH_BUILD_SAH for trees which are queried far more often than they are built.
  */
-BVHTree *bvhtree_from_mesh_get(
+BVHTree *bvhtree_from_mesh_get_ex(
         struct BVHTreeFromMesh *data, struct DerivedMesh *dm,
-        const int type, const int tree_type)
+        const int type, const int tree_type, const int build_flag)
 {
 	BVHTree *tree = NULL;
 
@@ -1015,7 +1021,7 @@ BVHTree *bvhtree_from_mesh_get(
 				tree = bvhcache_find(dm->bvhCache, BVHTREE_FROM_VERTS);
 				if (tree == NULL) {
 					tree = bvhtree_from_mesh_verts_create_tree(
-					        0.0, tree_type, 6, mvert, dm->getNumVerts(dm), NULL, -1);
+					        0.0, tree_type, 6, mvert, dm->getNumVerts(dm), NULL, -1, build_flag);
 
 					if (tree) {
 						/* Save on cache for later use */
@@ -1041,7 +1047,7 @@ BVHTree *bvhtree_from_mesh_get(
 				if (tree == NULL) {
 					tree = bvhtree_from_mesh_edges_create_tree(
 					        mvert, medge, dm->getNumEdges(dm),
-					        NULL, -1, 0.0, tree_type, 6);
+					        NULL, -1, 0.0, tree_type, 6, build_flag);
 
 					if (tree) {
 						/* Save on cache for later use */
@@ -1069,7 +1075,7 @@ BVHTree *bvhtree_from_mesh_get(
 					BLI_assert(!(numFaces == 0 && dm->getNumPolys(dm) != 0));
 
 					tree = bvhtree_from_mesh_faces_create_tree(
-					        0.0, tree_type, 6, mvert, mface, numFaces, NULL, -1);
+					        0.0, tree_type, 6, mvert, mface, numFaces, NULL, -1, build_flag);
 
 					if (tree) {
 						/* Save on cache for later use */
@@ -1102,7 +1108,7 @@ BVHTree *bvhtree_from_mesh_get(
 
 					tree = bvhtree_from_mesh_looptri_create_tree(
 					        0.0, tree_type, 6,
-					        mvert, mloop, looptri, looptri_num, NULL, -1);
+					        mvert, mloop, looptri, looptri_num, NULL, -1, build_flag);
 					if (tree) {
 						/* Save on cache for later use */
 						/* printf("BVHTree built and saved on cache\n"); */
@@ -1161,6 +1167,13 @@ BVHTree *bvhtree_from_mesh_get(
 	return tree;
 }
 
+BVHTree *bvhtree_from_mesh_get(
+        struct BVHTreeFromMesh *data, struct DerivedMesh *dm,
+        const int type, const int tree_type)
+{
+	return bvhtree_from_mesh_get_ex(data, dm, type, tree_type, 0);
+}
+
 /** \} */
 
 
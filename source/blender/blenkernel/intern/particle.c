@@ -2064,9 +2064,23 @@ void psys_find_parents(ParticleSimulationData *sim, const bool use_render_params
 
 	BLI_kdtree_balance(tree);
 
-	for (; p < totchild; p++, cpa++) {
-		psys_particle_on_emitter(sim->psmd, from, cpa->num, DMCACHE_ISCHILD, cpa->fuv, cpa->foffset, co, 0, 0, 0, orco, 0);
-		cpa->parent = BLI_kdtree_find_nearest(tree, orco, NULL);
+	if (p < totchild) {
+		float (*child_orco)[3] = MEM_mallocN(sizeof(*child_orco) * (size_t)(totchild - p), __func__);
+		int *child_parent = MEM_mallocN(sizeof(*child_parent) * (size_t)(totchild - p), __func__);
+		const int child_start = p;
+
+		for (; p < totchild; p++, cpa++) {
+			psys_particle_on_emitter(sim->psmd, from, cpa->num, DMCACHE_ISCHILD, cpa->fuv, cpa->foffset, co, 0, 0, 0, child_orco[p - child_start], 0);
+		}
+
+		BLI_kdtree_find_nearest_batch(tree, (const float (*)[3])child_orco, totchild - child_start, child_parent, NULL);
+
+		for (p = child_start, cpa = sim->psys->child + child_start; p < totchild; p++, cpa++) {
+			cpa->parent = child_parent[p - child_start];
+		}
+
+		MEM_freeN(child_orco);
+		MEM_freeN(child_parent);
 	}
 
 	BLI_kdtree_free(tree);
@@ -67,6 +67,7 @@
 #include "BLI_task.h"
 #include "BLI_threads.h"
 #include "BLI_linklist.h"
+#include "BLI_memarena.h"
 
 #include "BKE_animsys.h"
 #include "BKE_boids.h"
@@ -1772,7 +1773,14 @@ static void sph_force_cb(void *sphdata_v, ParticleKey *state, float *force, floa
 					temp_spring.delete_flag = 0;
 
 					/* sph_spring_add is not thread-safe. - z0r */
-					sph_spring_add(psys[0], &temp_spring);
+					if (sphdata->memarena) {
+						ParticleSpring *new_spring = BLI_memarena_alloc(sphdata->memarena, sizeof(*new_spring));
+						*new_spring = temp_spring;
+						BLI_linklist_prepend_arena(&sphdata->new_springs, new_spring, sphdata->memarena);
+					}
+					else {
+						sph_spring_add(psys[0], &temp_spring);
+					}
 				}
 			}
 			else {/* PART_SPRING_HOOKES - Hooke's spring force */
@@ -1988,6 +1996,9 @@ void psys_sph_init(ParticleSimulationData *sim, SPHData *sphdata)
 	sphdata->pa = NULL;
 	sphdata->mass = 1.0f;
 
+	sphdata->memarena = NULL;
+	sphdata->new_springs = NULL;
+
 	if (sim->psys->part->fluid->solver == SPH_SOLVER_DDR) {
 		sphdata->force_cb = sph_force_cb;
 		sphdata->density_cb = sph_density_accum_cb;
@@ -3412,7 +3423,8 @@ static void dynamics_step_sph_ddr_task_cb_ex(
 	/* do global forces & effectors */
 	basic_integrate(sim, p, pa->state.time, data->cfra);
 
-	/* actual fluids calculations */
+	/* actual fluids calculations, new springs go to the arena of this thread */
+	sphdata->memarena = tls->memarena;
 	sph_integrate(sim, pa, pa->state.time, sphdata);
 
 	if (sim->colliders)
@@ -3427,6 +3439,18 @@ static void dynamics_step_sph_ddr_task_cb_ex(
 	}
 }
 
+static void dynamics_step_sph_ddr_task_finalize(
+        void *__restrict userdata,
+        void *__restrict userdata_chunk)
+{
+	DynamicStepSolverTaskData *data = userdata;
+	SPHData *sphdata = userdata_chunk;
+
+	for (LinkNode *link = sphdata->new_springs; link; link = link->next) {
+		sph_spring_add(data->sim->psys, link->link);
+	}
+}
+
 static void dynamics_step_sph_classical_basic_integrate_task_cb_ex(
         void *__restrict userdata, 
         const int p,
@@ -3666,17 +3690,25 @@ static void dynamics_step(ParticleSimulationData *sim, float cfra)
 				/* Apply SPH forces using double-density relaxation algorithm
 				 * (Clavat et. al.) */
 
+				/* New springs are collected per thread and added at the end,
+				 * the springs array must not change while threads read it. */
+				MemArena *memarena = BLI_memarena_new(BLI_MEMARENA_STD_BUFSIZE, __func__);
+
 				ParallelRangeSettings settings;
 				BLI_parallel_range_settings_defaults(&settings);
 				settings.use_threading = (psys->totpart > 100);
 				settings.userdata_chunk = &sphdata;
 				settings.userdata_chunk_size = sizeof(sphdata);
+				settings.func_finalize = dynamics_step_sph_ddr_task_finalize;
+				settings.memarena = memarena;
 				BLI_task_parallel_range(
 				        0, psys->totpart,
 				        &task_data,
 				        dynamics_step_sph_ddr_task_cb_ex,
 				        &settings);
 
+				BLI_memarena_free(memarena);
+
 				sph_springs_modify(psys, timestep);
 			}
 			else {
@@ -41,6 +41,7 @@
 #include <string.h> /* memset */
 
 #include "BLI_blenlib.h"
+#include "BLI_hash_mm2a.h"
 #include "BLI_math.h"
 #include "BLI_kdtree.h"
 #include "BLI_kdopbvh.h"
@@ -965,7 +966,8 @@ static void obstacles_from_derivedmesh(
 			copy_v3_v3(&scs->verts_old[i * 3], co);
 		}
 
-		if (bvhtree_from_mesh_get(&treeData, dm, BVHTREE_FROM_LOOPTRI, 4)) {
+		/* Private copy of the mesh, its tree gets queried for every cell in the domain */
+		if (bvhtree_from_mesh_get_ex(&treeData, dm, BVHTREE_FROM_LOOPTRI, 4, BVH_BUILD_SAH)) {
 			ObstaclesFromDMData data = {
 			    .sds = sds, .mvert = mvert, .mloop = mloop, .looptri = looptri,
 			    .tree = &treeData, .has_velocity = has_velocity, .vert_vel = vert_vel,
@@ -1020,6 +1022,16 @@ static void update_obstacleflags(SmokeDomainSettings *sds, Object **collobjs, in
 	sds->active_fields = active_fields;
 }
 
+/* Tag grids written on the Blender side in the registry, so consumers of the shared
+ * solver buffers can tell which channels changed. The version is only bumped when the
+ * contents differ from the last tag. */
+static void smoke_tag_grids_changed(struct FLUID *fluid, const char *const names[], int totname)
+{
+	for (int i = 0; i < totname; i++) {
+		fluid_grid_tag_changed(fluid, fluid_grid_find(fluid, names[i]));
+	}
+}
+
 /* Animated obstacles: dx_step = ((x_new - x_old) / totalsteps) * substep */
 static void update_obstacles(Scene *scene, Object *ob, SmokeDomainSettings *sds, float dt)
 {
@@ -1052,6 +1064,7 @@ static void update_obstacles(Scene *scene, Object *ob, SmokeDomainSettings *sds,
 	int *num_obstacles = fluid_get_num_obstacle(sds->fluid);
 	int *num_guides = fluid_get_num_guide(sds->fluid);
 	unsigned int z;
+	bool cleared_obstacle_cells = false;
 
 	/* Grid reset before writing again */
 	for (z = 0; z < sds->res[0] * sds->res[1] * sds->res[2]; z++)
@@ -1103,6 +1116,7 @@ static void update_obstacles(Scene *scene, Object *ob, SmokeDomainSettings *sds,
 	{
 		if (obstacles[z] & 2) // mantaflow convention: FlagObstacle
 		{
+			cleared_obstacle_cells = true;
 			velxOrig[z] = 0;
 			velyOrig[z] = 0;
 			velzOrig[z] = 0;
@@ -1132,18 +1146,51 @@ static void update_obstacles(Scene *scene, Object *ob, SmokeDomainSettings *sds,
 			velzGuide[z] /= num_guides[z];
 		}
 	}
+
+	/* Only tag what was actually written above, untouched grids keep their version */
+	if (phiObsIn) {
+		const char *const changed[] = {"phiObsIn", "numObs", "x_obvel", "y_obvel", "z_obvel"};
+		smoke_tag_grids_changed(sds->fluid, changed, ARRAY_SIZE(changed));
+	}
+	if (phiGuideIn) {
+		const char *const changed[] = {"phiGuideIn", "numGuides", "x_guidevel", "y_guidevel", "z_guidevel"};
+		smoke_tag_grids_changed(sds->fluid, changed, ARRAY_SIZE(changed));
+	}
+	if (cleared_obstacle_cells) {
+		const char *const changed[] = {
+		    "x_vel", "y_vel", "z_vel", "density", "fuel", "flame", "color_r", "color_g", "color_b"};
+		smoke_tag_grids_changed(sds->fluid, changed, ARRAY_SIZE(changed));
+	}
 }
 
 /**********************************************************
  *	Flow emission code
  **********************************************************/
 
+/* Emission maps store their cells in bricks of EM_BRICK_SIZE^3 cells which are aligned to the
+ * domain grid, so bricks of different maps line up. Only bricks touched by an emitter get
+ * storage, emission, combining and applying maps then scale with the emitter footprint instead
+ * of its bounding box. */
+#define EM_BRICK_SIZE 8
+#define EM_BRICK_CELLS (EM_BRICK_SIZE * EM_BRICK_SIZE * EM_BRICK_SIZE)
+
+#define EM_BRICK_EMPTY -1
+#define EM_BRICK_PENDING -2
+
 typedef struct EmissionMap {
+	/* Brick storage, used_bricks * EM_BRICK_CELLS cells (times hires_mul^3 for high res maps). */
 	float *influence;
 	float *influence_high;
 	float *velocity;
 	float* distances;
 	float* distances_high;
+	/* Storage slot for every brick in brick bounds, EM_BRICK_EMPTY if unused. */
+	int *brick_slot;
+	/* Linear brick index for every storage slot. */
+	int *slot_brick;
+	int brick_min[3], brick_res[3];
+	int total_bricks, used_bricks;
+	int hires_mul;
 	int min[3], max[3], res[3];
 	int hmin[3], hmax[3], hres[3];
 	int total_cells, valid;
@@ -1190,29 +1237,140 @@ static void clampBoundsInDomain(SmokeDomainSettings *sds, int min[3], int max[3]
 	}
 }
 
-static void em_allocateData(EmissionMap *em, bool use_velocity, int hires_mul)
+/* Linear brick index of the brick holding the given cell (global low res coordinates),
+ * -1 if it lies outside of the brick bounds. */
+BLI_INLINE int em_brickIndex(const EmissionMap *em, int x, int y, int z)
+{
+	const int bx = divide_floor_i(x, EM_BRICK_SIZE) - em->brick_min[0];
+	const int by = divide_floor_i(y, EM_BRICK_SIZE) - em->brick_min[1];
+	const int bz = divide_floor_i(z, EM_BRICK_SIZE) - em->brick_min[2];
+
+	if (bx < 0 || by < 0 || bz < 0 || bx >= em->brick_res[0] || by >= em->brick_res[1] || bz >= em->brick_res[2])
+		return -1;
+	return bx + em->brick_res[0] * (by + em->brick_res[1] * bz);
+}
+
+/* Storage index of a cell given in global low res coordinates, -1 if its brick has no storage. */
+BLI_INLINE int em_cellIndex(const EmissionMap *em, int x, int y, int z)
+{
+	const int brick = em->brick_slot ? em_brickIndex(em, x, y, z) : -1;
+	const int slot = (brick != -1) ? em->brick_slot[brick] : EM_BRICK_EMPTY;
+
+	if (slot < 0)
+		return -1;
+	return slot * EM_BRICK_CELLS +
+	       mod_i(x, EM_BRICK_SIZE) + EM_BRICK_SIZE * (mod_i(y, EM_BRICK_SIZE) + EM_BRICK_SIZE * mod_i(z, EM_BRICK_SIZE));
+}
+
+/* Storage index of a cell given in global high res coordinates, -1 if its brick has no storage. */
+BLI_INLINE int em_cellIndexHigh(const EmissionMap *em, int x, int y, int z)
+{
+	const int hsize = EM_BRICK_SIZE * em->hires_mul;
+	const int brick = em->brick_slot ?
+	                  em_brickIndex(em, divide_floor_i(x, em->hires_mul), divide_floor_i(y, em->hires_mul), divide_floor_i(z, em->hires_mul)) :
+	                  -1;
+	const int slot = (brick != -1) ? em->brick_slot[brick] : EM_BRICK_EMPTY;
+
+	if (slot < 0)
+		return -1;
+	return slot * hsize * hsize * hsize + mod_i(x, hsize) + hsize * (mod_i(y, hsize) + hsize * mod_i(z, hsize));
+}
+
+/* Global low res cell range of a used brick, clipped to the map bounds. */
+static void em_brickBounds(const EmissionMap *em, int slot, int r_min[3], int r_max[3])
+{
+	const int brick = em->slot_brick[slot];
+	const int b[3] = {
+	    brick % em->brick_res[0],
+	    (brick / em->brick_res[0]) % em->brick_res[1],
+	    brick / (em->brick_res[0] * em->brick_res[1]),
+	};
+
+	for (int i = 0; i < 3; i++) {
+		r_min[i] = max_ii((b[i] + em->brick_min[i]) * EM_BRICK_SIZE, em->min[i]);
+		r_max[i] = min_ii((b[i] + em->brick_min[i] + 1) * EM_BRICK_SIZE, em->max[i]);
+	}
+}
+
+/* Setup brick bounds for the current map bounds, all bricks start out empty. */
+static bool em_initBricks(EmissionMap *em)
 {
 	int i, res[3];
 
 	for (i = 0; i < 3; i++) {
 		res[i] = em->max[i] - em->min[i];
 		if (res[i] <= 0)
-			return;
+			return false;
 	}
 	em->total_cells = res[0] * res[1] * res[2];
 	copy_v3_v3_int(em->res, res);
 
+	em->total_bricks = 1;
+	for (i = 0; i < 3; i++) {
+		em->brick_min[i] = divide_floor_i(em->min[i], EM_BRICK_SIZE);
+		em->brick_res[i] = divide_floor_i(em->max[i] - 1, EM_BRICK_SIZE) - em->brick_min[i] + 1;
+		em->total_bricks *= em->brick_res[i];
+	}
+
+	em->brick_slot = MEM_mallocN(sizeof(int) * em->total_bricks, "smoke_flow_brick_slot");
+	copy_vn_i(em->brick_slot, em->total_bricks, EM_BRICK_EMPTY);
+	em->used_bricks = 0;
+	return true;
+}
 
-	em->influence = MEM_callocN(sizeof(float) * em->total_cells, "smoke_flow_influence");
+/* Request storage for all bricks overlapping the given global cell range [min, max). */
+static void em_activateBricks(EmissionMap *em, const int min[3], const int max[3])
+{
+	int bmin[3], bmax[3];
+
+	for (int i = 0; i < 3; i++) {
+		const int cmin = max_ii(min[i], em->min[i]);
+		const int cmax = min_ii(max[i], em->max[i]);
+		if (cmax <= cmin)
+			return;
+		bmin[i] = divide_floor_i(cmin, EM_BRICK_SIZE) - em->brick_min[i];
+		bmax[i] = divide_floor_i(cmax - 1, EM_BRICK_SIZE) - em->brick_min[i];
+	}
+
+	for (int bz = bmin[2]; bz <= bmax[2]; bz++) {
+		for (int by = bmin[1]; by <= bmax[1]; by++) {
+			int *slot = &em->brick_slot[bmin[0] + em->brick_res[0] * (by + em->brick_res[1] * bz)];
+			for (int bx = bmin[0]; bx <= bmax[0]; bx++, slot++) {
+				if (*slot == EM_BRICK_EMPTY) {
+					*slot = EM_BRICK_PENDING;
+					em->used_bricks++;
+				}
+			}
+		}
+	}
+}
+
+/* Allocate storage for all requested bricks. Cells start out with no influence and infinite distance. */
+static void em_allocateStorage(EmissionMap *em, bool use_velocity, int hires_mul)
+{
+	const size_t total_cells = (size_t)em->used_bricks * EM_BRICK_CELLS;
+	int i, slot = 0;
+
+	em->slot_brick = MEM_mallocN(sizeof(int) * max_ii(em->used_bricks, 1), "smoke_flow_slot_brick");
+	for (i = 0; i < em->total_bricks; i++) {
+		if (em->brick_slot[i] == EM_BRICK_PENDING) {
+			em->slot_brick[slot] = i;
+			em->brick_slot[i] = slot++;
+		}
+	}
+	BLI_assert(slot == em->used_bricks);
+
+	em->influence = MEM_callocN(sizeof(float) * max_zz(total_cells, 1), "smoke_flow_influence");
 	if (use_velocity)
-		em->velocity = MEM_callocN(sizeof(float) * em->total_cells * 3, "smoke_flow_velocity");
-	
-	em->distances = MEM_callocN(sizeof(float) * em->total_cells, "fluid_flow_distances");
-	memset(em->distances, 0x7f7f7f7f, sizeof(float) * em->total_cells); // init to inf
+		em->velocity = MEM_callocN(sizeof(float) * max_zz(total_cells, 1) * 3, "smoke_flow_velocity");
+
+	em->distances = MEM_mallocN(sizeof(float) * max_zz(total_cells, 1), "fluid_flow_distances");
+	memset(em->distances, 0x7f7f7f7f, sizeof(float) * total_cells); // init to inf
 
 	/* allocate high resolution map if required */
+	em->hires_mul = max_ii(hires_mul, 1);
 	if (hires_mul > 1) {
-		int total_cells_high = em->total_cells * (hires_mul * hires_mul * hires_mul);
+		size_t total_cells_high = total_cells * (hires_mul * hires_mul * hires_mul);
 
 		for (i = 0; i < 3; i++) {
 			em->hmin[i] = em->min[i] * hires_mul;
@@ -1220,13 +1378,22 @@ static void em_allocateData(EmissionMap *em, bool use_velocity, int hires_mul)
 			em->hres[i] = em->res[i] * hires_mul;
 		}
 
-		em->influence_high = MEM_callocN(sizeof(float) * total_cells_high, "smoke_flow_influence_high");
-		em->distances_high = MEM_callocN(sizeof(float) * total_cells_high, "fluid_flow_distances_high");
+		em->influence_high = MEM_callocN(sizeof(float) * max_zz(total_cells_high, 1), "smoke_flow_influence_high");
+		em->distances_high = MEM_mallocN(sizeof(float) * max_zz(total_cells_high, 1), "fluid_flow_distances_high");
 		memset(em->distances_high, 0x7f7f7f7f, sizeof(float) * total_cells_high); // init to inf
 	}
 	em->valid = 1;
 }
 
+/* Allocate a map with storage for all of its cells. */
+static void em_allocateData(EmissionMap *em, bool use_velocity, int hires_mul)
+{
+	if (!em_initBricks(em))
+		return;
+	em_activateBricks(em, em->min, em->max);
+	em_allocateStorage(em, use_velocity, hires_mul);
+}
+
 static void em_freeData(EmissionMap *em)
 {
 	if (em->influence)
@@ -1239,11 +1406,108 @@ static void em_freeData(EmissionMap *em)
 		MEM_freeN(em->distances);
 	if (em->distances_high)
 		MEM_freeN(em->distances_high);
+	if (em->brick_slot)
+		MEM_freeN(em->brick_slot);
+	if (em->slot_brick)
+		MEM_freeN(em->slot_brick);
+}
+
+/* Storage slot in the given map of the brick that is stored in slot of the output map, or -1. */
+static int em_matchingSlot(const EmissionMap *output, int slot, const EmissionMap *em)
+{
+	int min[3], max[3], brick;
+
+	if (!em->brick_slot || !em->slot_brick)
+		return -1;
+
+	em_brickBounds(output, slot, min, max);
+	brick = em_brickIndex(em, min[0], min[1], min[2]);
+	return (brick != -1) ? max_ii(em->brick_slot[brick], -1) : -1;
+}
+
+typedef struct EmissionCombineData {
+	EmissionMap *output;
+	EmissionMap *em1, *em2;
+	int additive;
+	float sample_size;
+} EmissionCombineData;
+
+static void em_combineMaps_task_cb(
+        void *__restrict userdata,
+        const int slot,
+        const ParallelRangeTLS *__restrict UNUSED(tls))
+{
+	EmissionCombineData *data = userdata;
+	EmissionMap *output = data->output;
+	EmissionMap *em1 = data->em1;
+	EmissionMap *em2 = data->em2;
+	const int slot1 = em_matchingSlot(output, slot, em1);
+	const int slot2 = em_matchingSlot(output, slot, em2);
+	const int hcells = (output->influence_high) ? EM_BRICK_CELLS * output->hires_mul * output->hires_mul * output->hires_mul : 0;
+	const size_t out = (size_t)slot * EM_BRICK_CELLS;
+	const size_t hout = (size_t)slot * hcells;
+
+	/* Cells outside of a map's bounds but inside of its bricks hold neutral values, which keep
+	 * the output unchanged. So whole bricks can be combined without any bounds checks. */
+
+	/* initialize with first input if in range */
+	if (slot1 != -1) {
+		const size_t in = (size_t)slot1 * EM_BRICK_CELLS;
+
+		memcpy(&output->influence[out], &em1->influence[in], sizeof(float) * EM_BRICK_CELLS);
+		memcpy(&output->distances[out], &em1->distances[in], sizeof(float) * EM_BRICK_CELLS);
+		if (output->velocity && em1->velocity) {
+			memcpy(&output->velocity[out * 3], &em1->velocity[in * 3], sizeof(float) * EM_BRICK_CELLS * 3);
+		}
+		if (hcells && em1->influence_high) {
+			memcpy(&output->influence_high[hout], &em1->influence_high[(size_t)slot1 * hcells], sizeof(float) * hcells);
+			memcpy(&output->distances_high[hout], &em1->distances_high[(size_t)slot1 * hcells], sizeof(float) * hcells);
+		}
+	}
+
+	/* apply second input if in range */
+	if (slot2 != -1) {
+		const size_t in = (size_t)slot2 * EM_BRICK_CELLS;
+
+		for (int i = 0; i < EM_BRICK_CELLS; i++) {
+			const size_t index_out = out + i;
+			const size_t index_in = in + i;
+
+			/* values */
+			if (data->additive) {
+				output->influence[index_out] += em2->influence[index_in] * data->sample_size;
+			}
+			else {
+				output->influence[index_out] = MAX2(em2->influence[index_in], output->influence[index_out]);
+			}
+			output->distances[index_out] = MIN2(em2->distances[index_in], output->distances[index_out]);
+			if (output->velocity && em2->velocity) {
+				/* last sample replaces the velocity */
+				output->velocity[index_out * 3]     = ADD_IF_LOWER(output->velocity[index_out * 3], em2->velocity[index_in * 3]);
+				output->velocity[index_out * 3 + 1] = ADD_IF_LOWER(output->velocity[index_out * 3 + 1], em2->velocity[index_in * 3 + 1]);
+				output->velocity[index_out * 3 + 2] = ADD_IF_LOWER(output->velocity[index_out * 3 + 2], em2->velocity[index_in * 3 + 2]);
+			}
+		}
+
+		if (hcells && em2->influence_high) {
+			const size_t hin = (size_t)slot2 * hcells;
+
+			for (int i = 0; i < hcells; i++) {
+				if (data->additive) {
+					output->influence_high[hout + i] += em2->influence_high[hin + i] * data->sample_size;
+				}
+				else {
+					output->influence_high[hout + i] = MAX2(em2->influence_high[hin + i], output->influence_high[hout + i]);
+				}
+				output->distances_high[hout + i] = MIN2(em2->distances_high[hin + i], output->distances_high[hout + i]);
+			}
+		}
+	}
 }
 
 static void em_combineMaps(EmissionMap *output, EmissionMap *em2, int hires_multiplier, int additive, float sample_size)
 {
-	int i, x, y, z;
+	int i;
 
 	/* copyfill input 1 struct and clear output for new allocation */
 	EmissionMap em1;
@@ -1260,90 +1524,33 @@ static void em_combineMaps(EmissionMap *output, EmissionMap *em2, int hires_mult
 			output->max[i] = em2->max[i];
 		}
 	}
-	/* allocate output map */
-	em_allocateData(output, (em1.velocity || em2->velocity), hires_multiplier);
-
-	/* base resolution inputs */
-	for (x = output->min[0]; x < output->max[0]; x++)
-		for (y = output->min[1]; y < output->max[1]; y++)
-			for (z = output->min[2]; z < output->max[2]; z++) {
-				int index_out = smoke_get_index(x - output->min[0], output->res[0], y - output->min[1], output->res[1], z - output->min[2]);
-
-				/* initialize with first input if in range */
-				if (x >= em1.min[0] && x < em1.max[0] &&
-				    y >= em1.min[1] && y < em1.max[1] &&
-				    z >= em1.min[2] && z < em1.max[2])
-				{
-					int index_in = smoke_get_index(x - em1.min[0], em1.res[0], y - em1.min[1], em1.res[1], z - em1.min[2]);
-
-					/* values */
-					output->influence[index_out] = em1.influence[index_in];
-					output->distances[index_out] = em1.distances[index_in];
-					if (output->velocity && em1.velocity) {
-						copy_v3_v3(&output->velocity[index_out * 3], &em1.velocity[index_in * 3]);
-					}
-				}
-
-				/* apply second input if in range */
-				if (x >= em2->min[0] && x < em2->max[0] &&
-				    y >= em2->min[1] && y < em2->max[1] &&
-				    z >= em2->min[2] && z < em2->max[2])
-				{
-					int index_in = smoke_get_index(x - em2->min[0], em2->res[0], y - em2->min[1], em2->res[1], z - em2->min[2]);
-
-					/* values */
-					if (additive) {
-						output->influence[index_out] += em2->influence[index_in] * sample_size;
-					}
-					else {
-						output->influence[index_out] = MAX2(em2->influence[index_in], output->influence[index_out]);
-					}
-					output->distances[index_out] = MIN2(em2->distances[index_in], output->distances[index_out]);
-					if (output->velocity && em2->velocity) {
-						/* last sample replaces the velocity */
-						output->velocity[index_out * 3]		= ADD_IF_LOWER(output->velocity[index_out * 3], em2->velocity[index_in * 3]);
-						output->velocity[index_out * 3 + 1] = ADD_IF_LOWER(output->velocity[index_out * 3 + 1], em2->velocity[index_in * 3 + 1]);
-						output->velocity[index_out * 3 + 2] = ADD_IF_LOWER(output->velocity[index_out * 3 + 2], em2->velocity[index_in * 3 + 2]);
-					}
-				}
-	} // low res loop
-
 
+	/* allocate output map, only bricks used by any of the inputs get storage */
+	if (em_initBricks(output)) {
+		const EmissionMap *inputs[2] = {&em1, em2};
 
-	/* initialize high resolution input if available */
-	if (output->influence_high) {
-		for (x = output->hmin[0]; x < output->hmax[0]; x++)
-			for (y = output->hmin[1]; y < output->hmax[1]; y++)
-				for (z = output->hmin[2]; z < output->hmax[2]; z++) {
-					int index_out = smoke_get_index(x - output->hmin[0], output->hres[0], y - output->hmin[1], output->hres[1], z - output->hmin[2]);
-
-					/* initialize with first input if in range */
-					if (x >= em1.hmin[0] && x < em1.hmax[0] &&
-					    y >= em1.hmin[1] && y < em1.hmax[1] &&
-					    z >= em1.hmin[2] && z < em1.hmax[2])
-					{
-						int index_in = smoke_get_index(x - em1.hmin[0], em1.hres[0], y - em1.hmin[1], em1.hres[1], z - em1.hmin[2]);
-						/* values */
-						output->influence_high[index_out] = em1.influence_high[index_in];
-					}
+		for (i = 0; i < 2; i++) {
+			const EmissionMap *em = inputs[i];
+			for (int slot = 0; em->slot_brick && slot < em->used_bricks; slot++) {
+				int min[3], max[3];
+				em_brickBounds(em, slot, min, max);
+				em_activateBricks(output, min, max);
+			}
+		}
+		em_allocateStorage(output, (em1.velocity || em2->velocity), hires_multiplier);
 
-					/* apply second input if in range */
-					if (x >= em2->hmin[0] && x < em2->hmax[0] &&
-					    y >= em2->hmin[1] && y < em2->hmax[1] &&
-					    z >= em2->hmin[2] && z < em2->hmax[2])
-					{
-						int index_in = smoke_get_index(x - em2->hmin[0], em2->hres[0], y - em2->hmin[1], em2->hres[1], z - em2->hmin[2]);
+		EmissionCombineData data = {
+		    .output = output, .em1 = &em1, .em2 = em2,
+		    .additive = additive, .sample_size = sample_size,
+		};
 
-						/* values */
-						if (additive) {
-							output->influence_high[index_out] += em2->distances_high[index_in] * sample_size;
-						}
-						else {
-							output->distances_high[index_out] = MAX2(em2->distances_high[index_in], output->distances_high[index_out]);
-						}
-						output->distances_high[index_out] = MIN2(em2->distances_high[index_in], output->distances_high[index_out]);
-					}
-		} // high res loop
+		ParallelRangeSettings settings;
+		BLI_parallel_range_settings_defaults(&settings);
+		settings.use_threading = (output->used_bricks > 8);
+		BLI_task_parallel_range(0, output->used_bricks,
+		                        &data,
+		                        em_combineMaps_task_cb,
+		                        &settings);
 	}
 
 	/* free original data */
@@ -1359,8 +1566,6 @@ typedef struct EmitFromParticlesData {
 	float *particle_vel;
 	float hr;
 
-	int *min, *max, *res;
-
 	float solid;
 	float smooth;
 	float hr_smooth;
@@ -1368,24 +1573,23 @@ typedef struct EmitFromParticlesData {
 
 static void emit_from_particles_task_cb(
         void *__restrict userdata,
-        const int z,
+        const int slot,
         const ParallelRangeTLS *__restrict UNUSED(tls))
 {
 	EmitFromParticlesData *data = userdata;
 	SmokeFlowSettings *sfs = data->sfs;
 	EmissionMap *em = data->em;
 	const int hires_multiplier = data->hires_multiplier;
+	int min[3], max[3];
 
-	for (int x = data->min[0]; x < data->max[0]; x++) {
-		for (int y = data->min[1]; y < data->max[1]; y++) {
-			/* take low res samples where possible */
-			if (hires_multiplier <= 1 || !(x % hires_multiplier || y % hires_multiplier || z % hires_multiplier)) {
-				/* get low res space coordinates */
-				const int lx = x / hires_multiplier;
-				const int ly = y / hires_multiplier;
-				const int lz = z / hires_multiplier;
+	/* only cells of bricks close to any particle are sampled */
+	em_brickBounds(em, slot, min, max);
 
-				const int index = smoke_get_index(lx - em->min[0], em->res[0], ly - em->min[1], em->res[1], lz - em->min[2]);
+	/* take low res samples */
+	for (int lz = min[2]; lz < max[2]; lz++) {
+		for (int ly = min[1]; ly < max[1]; ly++) {
+			for (int lx = min[0]; lx < max[0]; lx++) {
+				const int index = em_cellIndex(em, lx, ly, lz);
 				const float ray_start[3] = {((float)lx) + 0.5f, ((float)ly) + 0.5f, ((float)lz) + 0.5f};
 
 				/* find particle distance from the kdtree */
@@ -1403,29 +1607,33 @@ static void emit_from_particles_task_cb(
 					}
 				}
 			}
+		}
+	}
 
-			/* take high res samples if required */
-			if (hires_multiplier > 1) {
-				/* get low res space coordinates */
-				const float lx = ((float)x) * data->hr;
-				const float ly = ((float)y) * data->hr;
-				const float lz = ((float)z) * data->hr;
+	/* take high res samples if required */
+	if (hires_multiplier > 1) {
+		for (int z = min[2] * hires_multiplier; z < max[2] * hires_multiplier; z++) {
+			for (int y = min[1] * hires_multiplier; y < max[1] * hires_multiplier; y++) {
+				for (int x = min[0] * hires_multiplier; x < max[0] * hires_multiplier; x++) {
+					/* get low res space coordinates */
+					const float lx = ((float)x) * data->hr;
+					const float ly = ((float)y) * data->hr;
+					const float lz = ((float)z) * data->hr;
 
-				const int index = smoke_get_index(
-				                      x - data->min[0], data->res[0], y - data->min[1], data->res[1], z - data->min[2]);
-				const float ray_start[3] = {lx + 0.5f * data->hr, ly + 0.5f * data->hr, lz + 0.5f * data->hr};
+					const int index = em_cellIndexHigh(em, x, y, z);
+					const float ray_start[3] = {lx + 0.5f * data->hr, ly + 0.5f * data->hr, lz + 0.5f * data->hr};
 
-				/* find particle distance from the kdtree */
-				KDTreeNearest nearest;
-				const float range = data->solid + data->hr_smooth;
-				BLI_kdtree_find_nearest(data->tree, ray_start, &nearest);
+					/* find particle distance from the kdtree */
+					KDTreeNearest nearest;
+					const float range = data->solid + data->hr_smooth;
+					BLI_kdtree_find_nearest(data->tree, ray_start, &nearest);
 
-				if (nearest.dist < range) {
-					em->influence_high[index] = (nearest.dist < data->solid) ?
-					                            1.0f : (1.0f - (nearest.dist - data->solid) / data->smooth);
+					if (nearest.dist < range) {
+						em->influence_high[index] = (nearest.dist < data->solid) ?
+						                            1.0f : (1.0f - (nearest.dist - data->solid) / data->smooth);
+					}
 				}
 			}
-
 		}
 	}
 }
@@ -1526,23 +1734,41 @@ static void emit_from_particles(
 
 		/* set emission map */
 		clampBoundsInDomain(sds, em->min, em->max, NULL, NULL, bounds_margin, dt);
-		em_allocateData(em, sfs->flags & MOD_SMOKE_FLOW_INITVELOCITY, hires_multiplier);
+		if (em_initBricks(em)) {
+			/* Outflow and geometry flows affect the whole emitter bounds, everything else only
+			 * needs the bricks within particle range. */
+			if (ELEM(sfs->behavior, MOD_SMOKE_FLOW_BEHAVIOR_OUTFLOW, MOD_SMOKE_FLOW_BEHAVIOR_GEOMETRY)) {
+				em_activateBricks(em, em->min, em->max);
+			}
+			else {
+				for (p = 0; p < valid_particles; p++) {
+					int min[3], max[3];
+					for (int i = 0; i < 3; i++) {
+						const int cell = (int)floor(particle_pos[p * 3 + i]);
+						min[i] = cell - bounds_margin;
+						max[i] = cell + bounds_margin + 1;
+					}
+					em_activateBricks(em, min, max);
+				}
+			}
+			em_allocateStorage(em, sfs->flags & MOD_SMOKE_FLOW_INITVELOCITY, hires_multiplier);
+		}
 
-		if (!(sfs->flags & MOD_SMOKE_FLOW_USE_PART_SIZE)) {
+		if (em->brick_slot && !(sfs->flags & MOD_SMOKE_FLOW_USE_PART_SIZE)) {
 			for (p = 0; p < valid_particles; p++)
 			{
 				int cell[3];
 				size_t i = 0;
-				size_t index = 0;
+				int index;
 				int badcell = 0;
 
 				/* 1. get corresponding cell */
-				cell[0] = floor(particle_pos[p * 3]) - em->min[0];
-				cell[1] = floor(particle_pos[p * 3 + 1]) - em->min[1];
-				cell[2] = floor(particle_pos[p * 3 + 2]) - em->min[2];
+				cell[0] = floor(particle_pos[p * 3]);
+				cell[1] = floor(particle_pos[p * 3 + 1]);
+				cell[2] = floor(particle_pos[p * 3 + 2]);
 				/* check if cell is valid (in the domain boundary) */
 				for (i = 0; i < 3; i++) {
-					if ((cell[i] > em->res[i] - 1) || (cell[i] < 0)) {
+					if ((cell[i] > em->max[i] - 1) || (cell[i] < em->min[i])) {
 						badcell = 1;
 						break;
 					}
@@ -1550,7 +1776,8 @@ static void emit_from_particles(
 				if (badcell)
 					continue;
 				/* get cell index */
-				index = smoke_get_index(cell[0], em->res[0], cell[1], em->res[1], cell[2]);
+				index = em_cellIndex(em, cell[0], cell[1], cell[2]);
+				BLI_assert(index != -1);
 				/* Add influence to emission map */
 				em->influence[index] = 1.0f;
 				/* Uses particle velocity as initial velocity for smoke */
@@ -1560,32 +1787,24 @@ static void emit_from_particles(
 				}
 			}   // particles loop
 		}
-		else if (valid_particles > 0) { // MOD_SMOKE_FLOW_USE_PART_SIZE
-			int min[3], max[3], res[3];
+		else if (em->brick_slot && valid_particles > 0) { // MOD_SMOKE_FLOW_USE_PART_SIZE
 			const float hr = 1.0f / ((float)hires_multiplier);
 			/* slightly adjust high res antialias smoothness based on number of divisions
 			 * to allow smaller details but yet not differing too much from the low res size */
 			const float hr_smooth = smooth * powf(hr, 1.0f / 3.0f);
 
-			/* setup loop bounds */
-			for (int i = 0; i < 3; i++) {
-				min[i] = em->min[i] * hires_multiplier;
-				max[i] = em->max[i] * hires_multiplier;
-				res[i] = em->res[i] * hires_multiplier;
-			}
-
 			BLI_kdtree_balance(tree);
 
 			EmitFromParticlesData data = {
 				.sfs = sfs, .tree = tree, .hires_multiplier = hires_multiplier, .hr = hr,
-			    .em = em, .particle_vel = particle_vel, .min = min, .max = max, .res = res,
+			    .em = em, .particle_vel = particle_vel,
 			    .solid = solid, .smooth = smooth, .hr_smooth = hr_smooth,
 			};
 
 			ParallelRangeSettings settings;
 			BLI_parallel_range_settings_defaults(&settings);
 			settings.scheduling_mode = TASK_SCHEDULING_DYNAMIC;
-			BLI_task_parallel_range(min[2], max[2],
+			BLI_task_parallel_range(0, em->used_bricks,
 			                        &data,
 			                        emit_from_particles_task_cb,
 			                        &settings);
@@ -1616,28 +1835,35 @@ static void update_mesh_distances(int index, float *mesh_distances, BVHTreeFromM
 							  {  0.0f, 1.0f,  1.0f }, { 0.0f,  1.0f, -1.0f }, {  0.0f, -1.0f,  1.0f }, {  0.0f, -1.0f, -1.0f },
 							  {  1.0f, 1.0f,  1.0f }, { 1.0f, -1.0f,  1.0f }, { -1.0f,  1.0f,  1.0f }, { -1.0f, -1.0f,  1.0f },
 							  {  1.0f, 1.0f, -1.0f }, { 1.0f, -1.0f, -1.0f }, { -1.0f,  1.0f, -1.0f }, { -1.0f, -1.0f, -1.0f } };
-	size_t ray_cnt = sizeof ray_dirs / sizeof ray_dirs[0];
+	const int ray_cnt = sizeof ray_dirs / sizeof ray_dirs[0];
+	float ray_starts[26][3];
+	BVHTreeRayHit hit_tree[26];
 
 	/* If stays true, a point is considered to be inside the mesh */
 	bool inside = true;
 
-	/* Check all ray directions */
 	for (int i = 0; i < ray_cnt; i++) {
-		BVHTreeRayHit hit_tree = {0};
-		hit_tree.index = -1;
-		hit_tree.dist = 9999;
-
 		normalize_v3(ray_dirs[i]);
-		BLI_bvhtree_ray_cast(treeData->tree, ray_start, ray_dirs[i], 0.0f, &hit_tree, treeData->raycast_callback, treeData);
+		copy_v3_v3(ray_starts[i], ray_start);
+		hit_tree[i].index = -1;
+		hit_tree[i].dist = 9999;
+	}
 
+	/* All rays start at the same point, cast them together */
+	BLI_bvhtree_ray_cast_batch(treeData->tree, (const float (*)[3])ray_starts, (const float (*)[3])ray_dirs,
+	                           0.0f, hit_tree, ray_cnt,
+	                           treeData->raycast_callback, treeData, BVH_RAYCAST_DEFAULT);
+
+	/* Check all ray directions */
+	for (int i = 0; i < ray_cnt; i++) {
 		/* Ray did not hit mesh. Current point definitely not inside mesh. */
-		if (hit_tree.index == -1) { inside = false; continue; }
+		if (hit_tree[i].index == -1) { inside = false; continue; }
 
 		/* Save new minimum hit dist */
-		min_dist = MIN2(min_dist, hit_tree.dist);
+		min_dist = MIN2(min_dist, hit_tree[i].dist);
 
 		/* Ray and normal are in opposing directions. Current point definitely not inside mesh. */
-		if (dot_v3v3(ray_dirs[i], hit_tree.no) < 0) { inside = false; }
+		if (dot_v3v3(ray_dirs[i], hit_tree[i].no) < 0) { inside = false; }
 	}
 
 	/* Levelset is negative inside mesh */
@@ -1822,8 +2048,7 @@ static void emit_from_derivedmesh_task_cb(
 				const int ly = y / hires_multiplier;
 				const int lz = z / hires_multiplier;
 
-				const int index = smoke_get_index(
-				                      lx - em->min[0], em->res[0], ly - em->min[1], em->res[1], lz - em->min[2]);
+				const int index = em_cellIndex(em, lx, ly, lz);
 				const float ray_start[3] = {((float)lx) + 0.5f, ((float)ly) + 0.5f, ((float)lz) + 0.5f};
 
 				/* Emission for smoke and fire. Result in em->influence. Also, calculate invels */
@@ -1844,8 +2069,7 @@ static void emit_from_derivedmesh_task_cb(
 				const float ly = ((float)y) * data->hr;
 				const float lz = ((float)z) * data->hr;
 
-				const int index = smoke_get_index(
-				                      x - data->min[0], data->res[0], y - data->min[1], data->res[1], z - data->min[2]);
+				const int index = em_cellIndexHigh(em, x, y, z);
 				const float ray_start[3] = {lx + 0.5f * data->hr, ly + 0.5f * data->hr, lz + 0.5f * data->hr};
 
 				/* Emission for smoke and fire high. Result in em->influence_high */
@@ -1959,7 +2183,8 @@ static void emit_from_derivedmesh(Object *flow_ob, SmokeDomainSettings *sds, Smo
 			res[i] = em->res[i] * hires_multiplier;
 		}
 
-		if (bvhtree_from_mesh_get(&treeData, dm, BVHTREE_FROM_LOOPTRI, 4)) {
+		/* Private copy of the mesh, its tree gets queried for every cell in the emission bounds */
+		if (bvhtree_from_mesh_get_ex(&treeData, dm, BVHTREE_FROM_LOOPTRI, 4, BVH_BUILD_SAH)) {
 			const float hr = 1.0f / ((float)hires_multiplier);
 
 			EmitFromDMData data = {
@@ -2004,121 +2229,426 @@ static void emit_from_derivedmesh(Object *flow_ob, SmokeDomainSettings *sds, Smo
  *	Smoke step
  **********************************************************/
 
-static void adjustDomainResolution(SmokeDomainSettings *sds, int new_shift[3], EmissionMap *emaps, unsigned int numflowobj, float dt)
-{
-	const int block_size = sds->noise_scale;
-	int min[3] = {32767, 32767, 32767}, max[3] = {-32767, -32767, -32767}, res[3];
-	int total_cells = 1, res_changed = 0, shift_changed = 0;
+/* Number of cells the adaptive domain is padded with on each side when it has to be reallocated.
+ * Content that keeps growing slowly then fits into the existing grids for a few more steps instead
+ * of forcing a new solver allocation every single step. */
+#define ADAPTIVE_DOMAIN_SLACK 2
+
+/* Content and velocity bounds of the adaptive domain. Used as per-thread chunk when scanning the grids. */
+typedef struct AdaptiveBounds {
+	int min[3], max[3];
 	float min_vel[3], max_vel[3];
-	int x, y, z;
-	float *density = smoke_get_density(sds->fluid);
-	float *fuel = smoke_get_fuel(sds->fluid);
-	float *bigdensity = smoke_turbulence_get_density(sds->fluid);
-	float *bigfuel = smoke_turbulence_get_fuel(sds->fluid);
-	float *vx = smoke_get_velocity_x(sds->fluid);
-	float *vy = smoke_get_velocity_y(sds->fluid);
-	float *vz = smoke_get_velocity_z(sds->fluid);
+} AdaptiveBounds;
+
+typedef struct AdaptiveBoundsData {
+	SmokeDomainSettings *sds;
+	const int *new_shift;
+	EmissionMap *em;
+
+	float *density, *fuel;
+	float *bigdensity, *bigfuel;
+	float *vx, *vy, *vz;
 	int wt_res[3];
+	int block_size;
 
-	if (sds->flags & MOD_SMOKE_NOISE && sds->fluid) {
-		smoke_turbulence_get_res(sds->fluid, wt_res);
+	/* Final bounds, merged from all threads. */
+	AdaptiveBounds bounds;
+} AdaptiveBoundsData;
+
+BLI_INLINE void adaptive_bounds_insert(AdaptiveBounds *bounds, int x, int y, int z)
+{
+	if (bounds->min[0] > x) bounds->min[0] = x;
+	if (bounds->min[1] > y) bounds->min[1] = y;
+	if (bounds->min[2] > z) bounds->min[2] = z;
+	if (bounds->max[0] < x) bounds->max[0] = x;
+	if (bounds->max[1] < y) bounds->max[1] = y;
+	if (bounds->max[2] < z) bounds->max[2] = z;
+}
+
+BLI_INLINE bool adaptive_bounds_contains(const AdaptiveBounds *bounds, int x, int y, int z)
+{
+	return (x >= bounds->min[0] && x <= bounds->max[0] &&
+	        y >= bounds->min[1] && y <= bounds->max[1] &&
+	        z >= bounds->min[2] && z <= bounds->max[2]);
+}
+
+static void adaptive_bounds_init(AdaptiveBounds *bounds)
+{
+	for (int i = 0; i < 3; i++) {
+		bounds->min[i] = 32767;
+		bounds->max[i] = -32767;
 	}
+	INIT_MINMAX(bounds->min_vel, bounds->max_vel);
+}
 
-	INIT_MINMAX(min_vel, max_vel);
+static void adaptive_bounds_finalize(void *__restrict userdata, void *__restrict userdata_chunk)
+{
+	AdaptiveBoundsData *data = userdata;
+	AdaptiveBounds *bounds = userdata_chunk;
 
-	/* Calculate bounds for current domain content */
-	for (x = sds->res_min[0]; x <  sds->res_max[0]; x++)
-		for (y =  sds->res_min[1]; y <  sds->res_max[1]; y++)
-			for (z =  sds->res_min[2]; z <  sds->res_max[2]; z++)
-			{
-				int xn = x - new_shift[0];
-				int yn = y - new_shift[1];
-				int zn = z - new_shift[2];
-				int index;
-				float max_den;
-				
-				/* skip if cell already belongs to new area */
-				if (xn >= min[0] && xn <= max[0] && yn >= min[1] && yn <= max[1] && zn >= min[2] && zn <= max[2])
-					continue;
+	for (int i = 0; i < 3; i++) {
+		data->bounds.min[i] = min_ii(data->bounds.min[i], bounds->min[i]);
+		data->bounds.max[i] = max_ii(data->bounds.max[i], bounds->max[i]);
+	}
+	minmax_v3v3_v3(data->bounds.min_vel, data->bounds.max_vel, bounds->min_vel);
+	minmax_v3v3_v3(data->bounds.min_vel, data->bounds.max_vel, bounds->max_vel);
+}
 
-				index = smoke_get_index(x - sds->res_min[0], sds->res[0], y - sds->res_min[1], sds->res[1], z - sds->res_min[2]);
-				max_den = (fuel) ? MAX2(density[index], fuel[index]) : density[index];
-
-				/* check high resolution bounds if max density isnt already high enough */
-				if (max_den < sds->adapt_threshold && sds->flags & MOD_SMOKE_NOISE && sds->fluid) {
-					int i, j, k;
-					/* high res grid index */
-					int xx = (x - sds->res_min[0]) * block_size;
-					int yy = (y - sds->res_min[1]) * block_size;
-					int zz = (z - sds->res_min[2]) * block_size;
-
-					for (i = 0; i < block_size; i++)
-						for (j = 0; j < block_size; j++)
-							for (k = 0; k < block_size; k++)
-							{
-								int big_index = smoke_get_index(xx + i, wt_res[0], yy + j, wt_res[1], zz + k);
-								float den = (bigfuel) ? MAX2(bigdensity[big_index], bigfuel[big_index]) : bigdensity[big_index];
-								if (den > max_den) {
-									max_den = den;
-								}
+static void adaptive_bounds_grid_task_cb(
+        void *__restrict userdata,
+        const int z,
+        const ParallelRangeTLS *__restrict tls)
+{
+	AdaptiveBoundsData *data = userdata;
+	AdaptiveBounds *bounds = tls->userdata_chunk;
+	SmokeDomainSettings *sds = data->sds;
+	const int block_size = data->block_size;
+	const int zn = z - data->new_shift[2];
+
+	for (int y = sds->res_min[1]; y < sds->res_max[1]; y++) {
+		const int yn = y - data->new_shift[1];
+		size_t index = smoke_get_index(0, sds->res[0], y - sds->res_min[1], sds->res[1], z - sds->res_min[2]);
+
+		for (int x = sds->res_min[0]; x < sds->res_max[0]; x++, index++) {
+			const int xn = x - data->new_shift[0];
+
+			/* velocity bounds */
+			if (bounds->min_vel[0] > data->vx[index]) bounds->min_vel[0] = data->vx[index];
+			if (bounds->min_vel[1] > data->vy[index]) bounds->min_vel[1] = data->vy[index];
+			if (bounds->min_vel[2] > data->vz[index]) bounds->min_vel[2] = data->vz[index];
+			if (bounds->max_vel[0] < data->vx[index]) bounds->max_vel[0] = data->vx[index];
+			if (bounds->max_vel[1] < data->vy[index]) bounds->max_vel[1] = data->vy[index];
+			if (bounds->max_vel[2] < data->vz[index]) bounds->max_vel[2] = data->vz[index];
+
+			/* skip density check if cell already belongs to new area */
+			if (adaptive_bounds_contains(bounds, xn, yn, zn))
+				continue;
+
+			float max_den = (data->fuel) ? MAX2(data->density[index], data->fuel[index]) : data->density[index];
+
+			/* check high resolution bounds if max density isnt already high enough */
+			if (max_den < sds->adapt_threshold && data->bigdensity) {
+				/* high res grid index */
+				const int xx = (x - sds->res_min[0]) * block_size;
+				const int yy = (y - sds->res_min[1]) * block_size;
+				const int zz = (z - sds->res_min[2]) * block_size;
+
+				for (int k = 0; k < block_size; k++) {
+					for (int j = 0; j < block_size; j++) {
+						const size_t big_index = smoke_get_index(xx, data->wt_res[0], yy + j, data->wt_res[1], zz + k);
+						for (int i = 0; i < block_size; i++) {
+							const float den = (data->bigfuel) ?
+							                  MAX2(data->bigdensity[big_index + i], data->bigfuel[big_index + i]) :
+							                  data->bigdensity[big_index + i];
+							if (den > max_den) {
+								max_den = den;
 							}
+						}
+					}
 				}
+			}
 
-				/* content bounds (use shifted coordinates) */
-				if (max_den >= sds->adapt_threshold) {
-					if (min[0] > xn) min[0] = xn;
-					if (min[1] > yn) min[1] = yn;
-					if (min[2] > zn) min[2] = zn;
-					if (max[0] < xn) max[0] = xn;
-					if (max[1] < yn) max[1] = yn;
-					if (max[2] < zn) max[2] = zn;
-				}
+			/* content bounds (use shifted coordinates) */
+			if (max_den >= sds->adapt_threshold) {
+				adaptive_bounds_insert(bounds, xn, yn, zn);
+			}
+		}
+	}
+}
 
-				/* velocity bounds */
-				if (min_vel[0] > vx[index]) min_vel[0] = vx[index];
-				if (min_vel[1] > vy[index]) min_vel[1] = vy[index];
-				if (min_vel[2] > vz[index]) min_vel[2] = vz[index];
-				if (max_vel[0] < vx[index]) max_vel[0] = vx[index];
-				if (max_vel[1] < vy[index]) max_vel[1] = vy[index];
-				if (max_vel[2] < vz[index]) max_vel[2] = vz[index];
+static void adaptive_bounds_emission_task_cb(
+        void *__restrict userdata,
+        const int slot,
+        const ParallelRangeTLS *__restrict tls)
+{
+	AdaptiveBoundsData *data = userdata;
+	AdaptiveBounds *bounds = tls->userdata_chunk;
+	EmissionMap *em = data->em;
+	const float threshold = data->sds->adapt_threshold;
+	int min[3], max[3];
+
+	em_brickBounds(em, slot, min, max);
+
+	for (int z = min[2]; z < max[2]; z++) {
+		for (int y = min[1]; y < max[1]; y++) {
+			for (int x = min[0]; x < max[0]; x++) {
+				/* density bounds */
+				if (em->influence[em_cellIndex(em, x, y, z)] >= threshold) {
+					adaptive_bounds_insert(bounds, x, y, z);
+				}
 			}
+		}
+	}
+}
 
-	/* also apply emission maps */
+/* Scan emission maps for content. Maps which lie completely inside of the bounds gathered so far
+ * cannot extend them and are skipped without touching their cells. */
+static void adaptive_bounds_from_emission(AdaptiveBoundsData *data, EmissionMap *emaps, unsigned int numflowobj)
+{
 	for (int i = 0; i < numflowobj; i++) {
 		EmissionMap *em = &emaps[i];
+		AdaptiveBounds bounds;
 
-		for (x = em->min[0]; x < em->max[0]; x++)
-			for (y = em->min[1]; y < em->max[1]; y++)
-				for (z = em->min[2]; z < em->max[2]; z++)
-				{
-					int index = smoke_get_index(x - em->min[0], em->res[0], y - em->min[1], em->res[1], z - em->min[2]);
-					float max_den = em->influence[index];
-
-					/* density bounds */
-					if (max_den >= sds->adapt_threshold) {
-						if (min[0] > x) min[0] = x;
-						if (min[1] > y) min[1] = y;
-						if (min[2] > z) min[2] = z;
-						if (max[0] < x) max[0] = x;
-						if (max[1] < y) max[1] = y;
-						if (max[2] < z) max[2] = z;
-					}
+		if (!em->influence || em->used_bricks == 0)
+			continue;
+		if (adaptive_bounds_contains(&data->bounds, em->min[0], em->min[1], em->min[2]) &&
+		    adaptive_bounds_contains(&data->bounds, em->max[0] - 1, em->max[1] - 1, em->max[2] - 1))
+		{
+			continue;
+		}
+
+		adaptive_bounds_init(&bounds);
+		data->em = em;
+
+		ParallelRangeSettings settings;
+		BLI_parallel_range_settings_defaults(&settings);
+		settings.use_threading = (em->used_bricks > 8);
+		settings.userdata_chunk = &bounds;
+		settings.userdata_chunk_size = sizeof(bounds);
+		settings.func_finalize = adaptive_bounds_finalize;
+		BLI_task_parallel_range(0, em->used_bricks,
+		                        data,
+		                        adaptive_bounds_emission_task_cb,
+		                        &settings);
+	}
+	data->em = NULL;
+}
+
+/* Check whether the old domain grids, seen from the shifted coordinates, still hold the new content
+ * bounds and are not oversized by more than the slack. The grids can then be kept without copying. */
+static bool adaptive_domain_fits(SmokeDomainSettings *sds, const int new_shift[3], const int min[3], const int max[3])
+{
+	const int adapt = sds->adapt_res;
+
+	for (int i = 0; i < 3; i++) {
+		const int old_min = sds->res_min[i] - new_shift[i];
+		const int old_max = sds->res_max[i] - new_shift[i];
+
+		if (min[i] < old_min || max[i] > old_max)
+			return false;
+		if (old_min < -adapt || old_max > sds->base_res[i] + adapt)
+			return false;
+		if ((old_max - old_min) - (max[i] - min[i]) > 2 * ADAPTIVE_DOMAIN_SLACK)
+			return false;
+	}
+	return true;
+}
+
+typedef struct AdaptiveCopyData {
+	/* Pairs of old and new grids, low and high resolution. */
+	float *grids[2][16];
+	float *grids_high[2][8];
+	int num_grids, num_grids_high;
+
+	/* Overlap of old and new domain in old cell coordinates. */
+	int min[3], max[3];
+	/* Offset of the overlap in old and new grids. */
+	int old_offset[3], new_offset[3];
+	int old_res[3], new_res[3];
+	int old_res_high[3], new_res_high[3];
+	int block_size;
+} AdaptiveCopyData;
+
+static void adaptive_copy_task_cb(
+        void *__restrict userdata,
+        const int z,
+        const ParallelRangeTLS *__restrict UNUSED(tls))
+{
+	AdaptiveCopyData *data = userdata;
+	const int block_size = data->block_size;
+	const int row_len = data->max[0] - data->min[0];
+	const int zo = z - data->min[2] + data->old_offset[2];
+	const int zn = z - data->min[2] + data->new_offset[2];
+
+	for (int y = data->min[1]; y < data->max[1]; y++) {
+		const int yo = y - data->min[1] + data->old_offset[1];
+		const int yn = y - data->min[1] + data->new_offset[1];
+		const size_t index_old = smoke_get_index(data->old_offset[0], data->old_res[0], yo, data->old_res[1], zo);
+		const size_t index_new = smoke_get_index(data->new_offset[0], data->new_res[0], yn, data->new_res[1], zn);
+
+		/* cells are contiguous along x, copy whole rows at once */
+		for (int i = 0; i < data->num_grids; i++) {
+			memcpy(data->grids[1][i] + index_new, data->grids[0][i] + index_old, sizeof(float) * row_len);
+		}
+
+		if (data->num_grids_high == 0)
+			continue;
+
+		for (int k = 0; k < block_size; k++) {
+			for (int j = 0; j < block_size; j++) {
+				const size_t big_index_old = smoke_get_index(
+				        data->old_offset[0] * block_size, data->old_res_high[0],
+				        yo * block_size + j, data->old_res_high[1], zo * block_size + k);
+				const size_t big_index_new = smoke_get_index(
+				        data->new_offset[0] * block_size, data->new_res_high[0],
+				        yn * block_size + j, data->new_res_high[1], zn * block_size + k);
+
+				for (int i = 0; i < data->num_grids_high; i++) {
+					memcpy(data->grids_high[1][i] + big_index_new, data->grids_high[0][i] + big_index_old,
+					       sizeof(float) * row_len * block_size);
 				}
+			}
+		}
 	}
+}
+
+BLI_INLINE void adaptive_copy_add(AdaptiveCopyData *data, float *grid_old, float *grid_new)
+{
+	if (grid_old && grid_new) {
+		BLI_assert(data->num_grids < ARRAY_SIZE(data->grids[0]));
+		data->grids[0][data->num_grids] = grid_old;
+		data->grids[1][data->num_grids] = grid_new;
+		data->num_grids++;
+	}
+}
+
+BLI_INLINE void adaptive_copy_add_high(AdaptiveCopyData *data, float *grid_old, float *grid_new)
+{
+	if (grid_old && grid_new) {
+		BLI_assert(data->num_grids_high < ARRAY_SIZE(data->grids_high[0]));
+		data->grids_high[0][data->num_grids_high] = grid_old;
+		data->grids_high[1][data->num_grids_high] = grid_new;
+		data->num_grids_high++;
+	}
+}
+
+/* Copy the overlapping region of the old fluid into the newly allocated one. */
+static void adaptive_copy_fluid(
+        SmokeDomainSettings *sds, struct FLUID *fluid_old,
+        const int new_shift[3], const int min[3], const int res[3])
+{
+	/* low res smoke */
+	float *o_dens, *o_react, *o_flame, *o_fuel, *o_heat, *o_vx, *o_vy, *o_vz, *o_r, *o_g, *o_b;
+	float *n_dens, *n_react, *n_flame, *n_fuel, *n_heat, *n_vx, *n_vy, *n_vz, *n_r, *n_g, *n_b;
+	float dummy, *dummy_s;
+	int *dummy_p;
+	AdaptiveCopyData data = {{{NULL}}};
+
+	for (int i = 0; i < 3; i++) {
+		/* overlap in old cell coordinates, new cell x maps to old cell x + new_shift */
+		data.min[i] = max_ii(sds->res_min[i], min[i] + new_shift[i]);
+		data.max[i] = min_ii(sds->res_max[i], min[i] + new_shift[i] + res[i]);
+		if (data.max[i] <= data.min[i])
+			return;
+
+		data.old_offset[i] = data.min[i] - sds->res_min[i];
+		data.new_offset[i] = data.min[i] - min[i] - new_shift[i];
+		data.old_res[i] = sds->res[i];
+		data.new_res[i] = res[i];
+	}
+
+	smoke_export(fluid_old, &dummy, &dummy, &o_dens, &o_react, &o_flame, &o_fuel, &o_heat, &o_vx, &o_vy, &o_vz, &o_r, &o_g, &o_b, &dummy_p, &dummy_s);
+	smoke_export(sds->fluid, &dummy, &dummy, &n_dens, &n_react, &n_flame, &n_fuel, &n_heat, &n_vx, &n_vy, &n_vz, &n_r, &n_g, &n_b, &dummy_p, &dummy_s);
+
+	adaptive_copy_add(&data, o_dens, n_dens);
+	adaptive_copy_add(&data, o_heat, n_heat);
+	if (n_fuel && o_fuel) {
+		adaptive_copy_add(&data, o_flame, n_flame);
+		adaptive_copy_add(&data, o_fuel, n_fuel);
+		adaptive_copy_add(&data, o_react, n_react);
+	}
+	if (n_r && o_r) {
+		adaptive_copy_add(&data, o_r, n_r);
+		adaptive_copy_add(&data, o_g, n_g);
+		adaptive_copy_add(&data, o_b, n_b);
+	}
+	adaptive_copy_add(&data, o_vx, n_vx);
+	adaptive_copy_add(&data, o_vy, n_vy);
+	adaptive_copy_add(&data, o_vz, n_vz);
+
+	/* high res smoke */
+	if (sds->flags & MOD_SMOKE_NOISE) {
+		float *o_wt_dens, *o_wt_react, *o_wt_flame, *o_wt_fuel, *o_wt_tcu, *o_wt_tcv, *o_wt_tcw, *o_wt_tcu2, *o_wt_tcv2, *o_wt_tcw2, *o_wt_r, *o_wt_g, *o_wt_b;
+		float *n_wt_dens, *n_wt_react, *n_wt_flame, *n_wt_fuel, *n_wt_tcu, *n_wt_tcv, *n_wt_tcw, *n_wt_tcu2, *n_wt_tcv2, *n_wt_tcw2, *n_wt_r, *n_wt_g, *n_wt_b;
+
+		smoke_turbulence_export(fluid_old, &o_wt_dens, &o_wt_react, &o_wt_flame, &o_wt_fuel, &o_wt_r, &o_wt_g, &o_wt_b, &o_wt_tcu, &o_wt_tcv, &o_wt_tcw, &o_wt_tcu2, &o_wt_tcv2, &o_wt_tcw2);
+		smoke_turbulence_get_res(fluid_old, data.old_res_high);
+		smoke_turbulence_export(sds->fluid, &n_wt_dens, &n_wt_react, &n_wt_flame, &n_wt_fuel, &n_wt_r, &n_wt_g, &n_wt_b, &n_wt_tcu, &n_wt_tcv, &n_wt_tcw, &n_wt_tcu2, &n_wt_tcv2, &n_wt_tcw2);
+		copy_v3_v3_int(data.new_res_high, sds->res_wt);
+		data.block_size = sds->noise_scale;
+
+		/* texture coordinates live on the low res grid */
+		adaptive_copy_add(&data, o_wt_tcu, n_wt_tcu);
+		adaptive_copy_add(&data, o_wt_tcv, n_wt_tcv);
+		adaptive_copy_add(&data, o_wt_tcw, n_wt_tcw);
+		adaptive_copy_add(&data, o_wt_tcu2, n_wt_tcu2);
+		adaptive_copy_add(&data, o_wt_tcv2, n_wt_tcv2);
+		adaptive_copy_add(&data, o_wt_tcw2, n_wt_tcw2);
+
+		adaptive_copy_add_high(&data, o_wt_dens, n_wt_dens);
+		if (n_wt_flame && o_wt_flame) {
+			adaptive_copy_add_high(&data, o_wt_flame, n_wt_flame);
+			adaptive_copy_add_high(&data, o_wt_fuel, n_wt_fuel);
+			adaptive_copy_add_high(&data, o_wt_react, n_wt_react);
+		}
+		if (n_wt_r && o_wt_r) {
+			adaptive_copy_add_high(&data, o_wt_r, n_wt_r);
+			adaptive_copy_add_high(&data, o_wt_g, n_wt_g);
+			adaptive_copy_add_high(&data, o_wt_b, n_wt_b);
+		}
+	}
+
+	ParallelRangeSettings settings;
+	BLI_parallel_range_settings_defaults(&settings);
+	settings.use_threading = (sds->total_cells > 10000);
+	BLI_task_parallel_range(data.min[2], data.max[2],
+	                        &data,
+	                        adaptive_copy_task_cb,
+	                        &settings);
+}
+
+static void adjustDomainResolution(SmokeDomainSettings *sds, int new_shift[3], EmissionMap *emaps, unsigned int numflowobj, float dt)
+{
+	int min[3], max[3], res[3];
+	int total_cells = 1;
+	bool has_content = true;
+	AdaptiveBoundsData data = {
+	    .sds = sds, .new_shift = new_shift,
+	    .density = smoke_get_density(sds->fluid), .fuel = smoke_get_fuel(sds->fluid),
+	    .vx = smoke_get_velocity_x(sds->fluid), .vy = smoke_get_velocity_y(sds->fluid), .vz = smoke_get_velocity_z(sds->fluid),
+	    .block_size = sds->noise_scale,
+	};
+
+	if (sds->flags & MOD_SMOKE_NOISE && sds->fluid) {
+		data.bigdensity = smoke_turbulence_get_density(sds->fluid);
+		data.bigfuel = smoke_turbulence_get_fuel(sds->fluid);
+		smoke_turbulence_get_res(sds->fluid, data.wt_res);
+	}
+
+	adaptive_bounds_init(&data.bounds);
+
+	/* Calculate bounds for current domain content */
+	{
+		AdaptiveBounds bounds;
+		adaptive_bounds_init(&bounds);
+
+		ParallelRangeSettings settings;
+		BLI_parallel_range_settings_defaults(&settings);
+		settings.use_threading = (sds->total_cells > 10000);
+		settings.userdata_chunk = &bounds;
+		settings.userdata_chunk_size = sizeof(bounds);
+		settings.func_finalize = adaptive_bounds_finalize;
+		BLI_task_parallel_range(sds->res_min[2], sds->res_max[2],
+		                        &data,
+		                        adaptive_bounds_grid_task_cb,
+		                        &settings);
+	}
+
+	/* also apply emission maps */
+	adaptive_bounds_from_emission(&data, emaps, numflowobj);
 
 	/* calculate new bounds based on these values */
-	mul_v3_fl(min_vel, 1.0f / sds->dx);
-	mul_v3_fl(max_vel, 1.0f / sds->dx);
-	clampBoundsInDomain(sds, min, max, min_vel, max_vel, sds->adapt_margin + 1, dt);
+	copy_v3_v3_int(min, data.bounds.min);
+	copy_v3_v3_int(max, data.bounds.max);
+	mul_v3_fl(data.bounds.min_vel, 1.0f / sds->dx);
+	mul_v3_fl(data.bounds.max_vel, 1.0f / sds->dx);
+	clampBoundsInDomain(sds, min, max, data.bounds.min_vel, data.bounds.max_vel, sds->adapt_margin + 1, dt);
 
 	for (int i = 0; i < 3; i++) {
 		/* calculate new resolution */
 		res[i] = max[i] - min[i];
 		total_cells *= res[i];
 
-		if (new_shift[i])
-			shift_changed = 1;
-
 		/* if no content set minimum dimensions */
 		if (res[i] <= 0) {
 			int j;
@@ -2127,15 +2657,35 @@ static void adjustDomainResolution(SmokeDomainSettings *sds, int new_shift[3], E
 				max[j] = 1;
 				res[j] = 1;
 			}
-			res_changed = 1;
 			total_cells = 1;
+			has_content = false;
 			break;
 		}
-		if (min[i] != sds->res_min[i] || max[i] != sds->res_max[i])
-			res_changed = 1;
 	}
 
-	if (res_changed || shift_changed) {
+	/* Content still fits into the current grids: only the domain bounds move along with the shift,
+	 * the grid data stays where it is and the solver does not need to be reallocated. */
+	if (sds->fluid && adaptive_domain_fits(sds, new_shift, min, max)) {
+		for (int i = 0; i < 3; i++) {
+			sds->res_min[i] -= new_shift[i];
+			sds->res_max[i] -= new_shift[i];
+		}
+		return;
+	}
+
+	/* Leave some room for growth around the new content */
+	if (has_content) {
+		const int adapt = sds->adapt_res;
+		total_cells = 1;
+		for (int i = 0; i < 3; i++) {
+			min[i] = max_ii(min[i] - ADAPTIVE_DOMAIN_SLACK, -adapt);
+			max[i] = min_ii(max[i] + ADAPTIVE_DOMAIN_SLACK, sds->base_res[i] + adapt);
+			res[i] = max[i] - min[i];
+			total_cells *= res[i];
+		}
+	}
+
+	{
 		struct FLUID *fluid_old = sds->fluid;
 
 		/* allocate new fluid data */
@@ -2145,109 +2695,8 @@ static void adjustDomainResolution(SmokeDomainSettings *sds, int new_shift[3], E
 		}
 
 		/* copy values from old fluid to new */
-		if (sds->total_cells > 1 && total_cells > 1) {
-			/* low res smoke */
-			float *o_dens, *o_react, *o_flame, *o_fuel, *o_heat, *o_vx, *o_vy, *o_vz, *o_r, *o_g, *o_b;
-			float *n_dens, *n_react, *n_flame, *n_fuel, *n_heat, *n_vx, *n_vy, *n_vz, *n_r, *n_g, *n_b;
-			float dummy, *dummy_s;
-			int *dummy_p;
-			/* high res smoke */
-			int wt_res_old[3];
-			float *o_wt_dens, *o_wt_react, *o_wt_flame, *o_wt_fuel, *o_wt_tcu, *o_wt_tcv, *o_wt_tcw, *o_wt_tcu2, *o_wt_tcv2, *o_wt_tcw2, *o_wt_r, *o_wt_g, *o_wt_b;
-			float *n_wt_dens, *n_wt_react, *n_wt_flame, *n_wt_fuel, *n_wt_tcu, *n_wt_tcv, *n_wt_tcw, *n_wt_tcu2, *n_wt_tcv2, *n_wt_tcw2, *n_wt_r, *n_wt_g, *n_wt_b;
-
-			smoke_export(fluid_old, &dummy, &dummy, &o_dens, &o_react, &o_flame, &o_fuel, &o_heat, &o_vx, &o_vy, &o_vz, &o_r, &o_g, &o_b, &dummy_p, &dummy_s);
-			smoke_export(sds->fluid, &dummy, &dummy, &n_dens, &n_react, &n_flame, &n_fuel, &n_heat, &n_vx, &n_vy, &n_vz, &n_r, &n_g, &n_b, &dummy_p, &dummy_s);
-
-			if (sds->flags & MOD_SMOKE_NOISE) {
-				smoke_turbulence_export(fluid_old, &o_wt_dens, &o_wt_react, &o_wt_flame, &o_wt_fuel, &o_wt_r, &o_wt_g, &o_wt_b, &o_wt_tcu, &o_wt_tcv, &o_wt_tcw, &o_wt_tcu2, &o_wt_tcv2, &o_wt_tcw2);
-				smoke_turbulence_get_res(fluid_old, wt_res_old);
-				smoke_turbulence_export(sds->fluid, &n_wt_dens, &n_wt_react, &n_wt_flame, &n_wt_fuel, &n_wt_r, &n_wt_g, &n_wt_b, &n_wt_tcu, &n_wt_tcv, &n_wt_tcw, &n_wt_tcu2, &n_wt_tcv2, &n_wt_tcw2);
-			}
-
-			for (x = sds->res_min[0]; x < sds->res_max[0]; x++)
-				for (y = sds->res_min[1]; y < sds->res_max[1]; y++)
-					for (z = sds->res_min[2]; z < sds->res_max[2]; z++)
-					{
-						/* old grid index */
-						int xo = x - sds->res_min[0];
-						int yo = y - sds->res_min[1];
-						int zo = z - sds->res_min[2];
-						int index_old = smoke_get_index(xo, sds->res[0], yo, sds->res[1], zo);
-						/* new grid index */
-						int xn = x - min[0] - new_shift[0];
-						int yn = y - min[1] - new_shift[1];
-						int zn = z - min[2] - new_shift[2];
-						int index_new = smoke_get_index(xn, res[0], yn, res[1], zn);
-
-						/* skip if outside new domain */
-						if (xn < 0 || xn >= res[0] ||
-						    yn < 0 || yn >= res[1] ||
-						    zn < 0 || zn >= res[2])
-							continue;
-
-						/* copy data */
-						n_dens[index_new] = o_dens[index_old];
-						/* heat */
-						if (n_heat && o_heat) {
-							n_heat[index_new] = o_heat[index_old];
-						}
-						/* fuel */
-						if (n_fuel && o_fuel) {
-							n_flame[index_new] = o_flame[index_old];
-							n_fuel[index_new] = o_fuel[index_old];
-							n_react[index_new] = o_react[index_old];
-						}
-						/* color */
-						if (o_r && n_r) {
-							n_r[index_new] = o_r[index_old];
-							n_g[index_new] = o_g[index_old];
-							n_b[index_new] = o_b[index_old];
-						}
-						n_vx[index_new] = o_vx[index_old];
-						n_vy[index_new] = o_vy[index_old];
-						n_vz[index_new] = o_vz[index_old];
-
-						if (sds->flags & MOD_SMOKE_NOISE && fluid_old) {
-							int i, j, k;
-							/* old grid index */
-							int xx_o = xo * block_size;
-							int yy_o = yo * block_size;
-							int zz_o = zo * block_size;
-							/* new grid index */
-							int xx_n = xn * block_size;
-							int yy_n = yn * block_size;
-							int zz_n = zn * block_size;
-
-							n_wt_tcu[index_new] = o_wt_tcu[index_old];
-							n_wt_tcv[index_new] = o_wt_tcv[index_old];
-							n_wt_tcw[index_new] = o_wt_tcw[index_old];
-							
-							n_wt_tcu2[index_new] = o_wt_tcu2[index_old];
-							n_wt_tcv2[index_new] = o_wt_tcv2[index_old];
-							n_wt_tcw2[index_new] = o_wt_tcw2[index_old];
-
-							for (i = 0; i < block_size; i++)
-								for (j = 0; j < block_size; j++)
-									for (k = 0; k < block_size; k++)
-									{
-										int big_index_old = smoke_get_index(xx_o + i, wt_res_old[0], yy_o + j, wt_res_old[1], zz_o + k);
-										int big_index_new = smoke_get_index(xx_n + i, sds->res_wt[0], yy_n + j, sds->res_wt[1], zz_n + k);
-										/* copy data */
-										n_wt_dens[big_index_new] = o_wt_dens[big_index_old];
-										if (n_wt_flame && o_wt_flame) {
-											n_wt_flame[big_index_new] = o_wt_flame[big_index_old];
-											n_wt_fuel[big_index_new] = o_wt_fuel[big_index_old];
-											n_wt_react[big_index_new] = o_wt_react[big_index_old];
-										}
-										if (n_wt_r && o_wt_r) {
-											n_wt_r[big_index_new] = o_wt_r[big_index_old];
-											n_wt_g[big_index_new] = o_wt_g[big_index_old];
-											n_wt_b[big_index_new] = o_wt_b[big_index_old];
-										}
-									}
-						}
-					}
+		if (sds->total_cells > 1 && total_cells > 1 && fluid_old && sds->fluid) {
+			adaptive_copy_fluid(sds, fluid_old, new_shift, min, res);
 		}
 		smoke_free(fluid_old);
 
@@ -2424,6 +2873,74 @@ static void update_flowsflags(SmokeDomainSettings *sds, Object **flowobjs, int n
 	sds->active_fields = active_fields;
 }
 
+typedef struct ApplyEmissionData {
+	SmokeDomainSettings *sds;
+	SmokeModifierData *smd;
+	EmissionMap *em;
+
+	float *phi_in, *phiout_in;
+	float *density, *heat, *fuel, *react;
+	float *color_r, *color_g, *color_b;
+	float *emission_in;
+	float *velx_initial, *vely_initial, *velz_initial;
+} ApplyEmissionData;
+
+static void apply_emission_task_cb(
+        void *__restrict userdata,
+        const int slot,
+        const ParallelRangeTLS *__restrict UNUSED(tls))
+{
+	ApplyEmissionData *data = userdata;
+	SmokeDomainSettings *sds = data->sds;
+	SmokeFlowSettings *sfs = data->smd->flow;
+	EmissionMap *em = data->em;
+	int min[3], max[3];
+
+	em_brickBounds(em, slot, min, max);
+
+	/* make sure emission cells are inside the new domain boundary */
+	for (int i = 0; i < 3; i++) {
+		min[i] = max_ii(min[i], sds->res_min[i]);
+		max[i] = min_ii(max[i], sds->res_min[i] + sds->res[i]);
+		if (max[i] <= min[i])
+			return;
+	}
+
+	for (int gz = min[2]; gz < max[2]; gz++) {
+		for (int gy = min[1]; gy < max[1]; gy++) {
+			for (int gx = min[0]; gx < max[0]; gx++) {
+				/* get emission map index */
+				const int e_index = em_cellIndex(em, gx, gy, gz);
+
+				/* get domain index */
+				const size_t d_index = smoke_get_index(gx - sds->res_min[0], sds->res[0], gy - sds->res_min[1], sds->res[1], gz - sds->res_min[2]);
+
+				if (sfs->behavior == MOD_SMOKE_FLOW_BEHAVIOR_OUTFLOW) { // outflow
+					apply_outflow_fields(d_index, em->distances[e_index], data->density, data->heat, data->fuel, data->react,
+					                     data->color_r, data->color_g, data->color_b, data->phiout_in);
+				}
+				else if (sfs->behavior == MOD_SMOKE_FLOW_BEHAVIOR_GEOMETRY && data->smd->time > 2) {
+					apply_inflow_fields(sfs, 0.0f, 9999.0f, d_index, data->density, data->heat, data->fuel, data->react,
+					                    data->color_r, data->color_g, data->color_b, data->phi_in, data->emission_in);
+				}
+				else if (sfs->behavior == MOD_SMOKE_FLOW_BEHAVIOR_INFLOW || sfs->behavior == MOD_SMOKE_FLOW_BEHAVIOR_GEOMETRY) { // inflow
+					/* only apply inflow if enabled */
+					if (sfs->flags & MOD_SMOKE_FLOW_USE_INFLOW) {
+						apply_inflow_fields(sfs, em->influence[e_index], em->distances[e_index], d_index, data->density, data->heat, data->fuel, data->react,
+						                    data->color_r, data->color_g, data->color_b, data->phi_in, data->emission_in);
+						/* initial velocity */
+						if (sfs->flags & MOD_SMOKE_FLOW_INITVELOCITY) {
+							data->velx_initial[d_index] = em->velocity[e_index * 3];
+							data->vely_initial[d_index] = em->velocity[e_index * 3 + 1];
+							data->velz_initial[d_index] = em->velocity[e_index * 3 + 2];
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
 static void update_flowsfluids(Scene *scene, Object *ob, SmokeDomainSettings *sds, float time_per_frame, float frame_length, int frame, bool is_first_frame)
 {
 	EmissionMap *emaps = NULL;
@@ -2573,34 +3090,32 @@ static void update_flowsfluids(Scene *scene, Object *ob, SmokeDomainSettings *sd
 		adjustDomainResolution(sds, new_shift, emaps, numflowobj, time_per_frame);
 	}
 
-	float *phi_in = liquid_get_phiin(sds->fluid);
-	float *phiout_in = liquid_get_phioutin(sds->fluid);
-	float *density = smoke_get_density(sds->fluid);
-	float *color_r = smoke_get_color_r(sds->fluid);
-	float *color_g = smoke_get_color_g(sds->fluid);
-	float *color_b = smoke_get_color_b(sds->fluid);
-	float *fuel = smoke_get_fuel(sds->fluid);
-	float *heat = smoke_get_heat(sds->fluid);
-	float *react = smoke_get_react(sds->fluid);
-	float *emission_in = fluid_get_emission_in(sds->fluid);
-	float *bigdensity = smoke_turbulence_get_density(sds->fluid);
-	float *bigfuel = smoke_turbulence_get_fuel(sds->fluid);
-	float *bigreact = smoke_turbulence_get_react(sds->fluid);
-	float *bigcolor_r = smoke_turbulence_get_color_r(sds->fluid);
-	float *bigcolor_g = smoke_turbulence_get_color_g(sds->fluid);
-	float *bigcolor_b = smoke_turbulence_get_color_b(sds->fluid);
-	float *velx_initial = smoke_get_in_velocity_x(sds->fluid);
-	float *vely_initial = smoke_get_in_velocity_y(sds->fluid);
-	float *velz_initial = smoke_get_in_velocity_z(sds->fluid);
+	ApplyEmissionData data = {
+	    .sds = sds,
+	    .phi_in = liquid_get_phiin(sds->fluid),
+	    .phiout_in = liquid_get_phioutin(sds->fluid),
+	    .density = smoke_get_density(sds->fluid),
+	    .color_r = smoke_get_color_r(sds->fluid),
+	    .color_g = smoke_get_color_g(sds->fluid),
+	    .color_b = smoke_get_color_b(sds->fluid),
+	    .fuel = smoke_get_fuel(sds->fluid),
+	    .heat = smoke_get_heat(sds->fluid),
+	    .react = smoke_get_react(sds->fluid),
+	    .emission_in = fluid_get_emission_in(sds->fluid),
+	    .velx_initial = smoke_get_in_velocity_x(sds->fluid),
+	    .vely_initial = smoke_get_in_velocity_y(sds->fluid),
+	    .velz_initial = smoke_get_in_velocity_z(sds->fluid),
+	};
 	unsigned int z;
+	bool emitted = false;
 
 	/* Grid reset before writing again */
 	for (z = 0; z < sds->res[0] * sds->res[1] * sds->res[2]; z++)
 	{
-		if (phi_in)
-			phi_in[z] = 9999;
-		if (phiout_in)
-			phiout_in[z] = 9999;
+		if (data.phi_in)
+			data.phi_in[z] = 9999;
+		if (data.phiout_in)
+			data.phiout_in[z] = 9999;
 	}
 
 	/* Apply emission data */
@@ -2611,145 +3126,24 @@ static void update_flowsfluids(Scene *scene, Object *ob, SmokeDomainSettings *sd
 
 		// check for initialized smoke object
 		if ((smd2->type & MOD_SMOKE_TYPE_FLOW) && smd2->flow) {
-			SmokeFlowSettings *sfs = smd2->flow;
 			EmissionMap *em = &emaps[flowIndex];
-			int bigres[3];
-			float *velocity_map = em->velocity;
-			float *emission_map = em->influence;
-			float *emission_map_high = em->influence_high;
-			float* distance_map = em->distances;
-			float* distance_map_high = em->distances_high;
-
-			int ii, jj, kk, gx, gy, gz, ex, ey, ez, dx, dy, dz, block_size;
-			size_t e_index, d_index, index_big;
-
-			// loop through every emission map cell
-			for (gx = em->min[0]; gx < em->max[0]; gx++)
-				for (gy = em->min[1]; gy < em->max[1]; gy++)
-					for (gz = em->min[2]; gz < em->max[2]; gz++)
-					{
-						/* get emission map index */
-						ex = gx - em->min[0];
-						ey = gy - em->min[1];
-						ez = gz - em->min[2];
-						e_index = smoke_get_index(ex, em->res[0], ey, em->res[1], ez);
-
-						/* get domain index */
-						dx = gx - sds->res_min[0];
-						dy = gy - sds->res_min[1];
-						dz = gz - sds->res_min[2];
-						d_index = smoke_get_index(dx, sds->res[0], dy, sds->res[1], dz);
-						/* make sure emission cell is inside the new domain boundary */
-						if (dx < 0 || dy < 0 || dz < 0 || dx >= sds->res[0] || dy >= sds->res[1] || dz >= sds->res[2]) continue;
-
-						if (sfs->behavior == MOD_SMOKE_FLOW_BEHAVIOR_OUTFLOW) { // outflow
-							apply_outflow_fields(d_index, distance_map[e_index], density, heat, fuel, react, color_r, color_g, color_b, phiout_in);
-						}
-						else if (sfs->behavior == MOD_SMOKE_FLOW_BEHAVIOR_GEOMETRY && smd2->time > 2) {
-							apply_inflow_fields(sfs, 0.0f, 9999.0f, d_index, density, heat, fuel, react, color_r, color_g, color_b, phi_in, emission_in);
-						}
-						else if (sfs->behavior == MOD_SMOKE_FLOW_BEHAVIOR_INFLOW || sfs->behavior == MOD_SMOKE_FLOW_BEHAVIOR_GEOMETRY) { // inflow
-							/* only apply inflow if enabled */
-							if (sfs->flags & MOD_SMOKE_FLOW_USE_INFLOW) {
-								apply_inflow_fields(sfs, emission_map[e_index], distance_map[e_index], d_index, density, heat, fuel, react, color_r, color_g, color_b, phi_in, emission_in);
-								/* initial velocity */
-								if (sfs->flags & MOD_SMOKE_FLOW_INITVELOCITY) {
-									velx_initial[d_index] = velocity_map[e_index * 3];
-									vely_initial[d_index] = velocity_map[e_index * 3 + 1];
-									velz_initial[d_index] = velocity_map[e_index * 3 + 2];
-								}
-							}
-						}
 
-						// TODO (sebbas): For now, just using manta interpolated grids for noise
-						/* loop through high res blocks if high res enabled */
-//						if (bigdensity && sds->noise_scale > 1) {
-//							// neighbor cell emission densities (for high resolution smoke smooth interpolation)
-//							float c000, c001, c010, c011,  c100, c101, c110, c111;
-//
-//							smoke_turbulence_get_res(sds->fluid, bigres);
-//
-//							block_size = sds->noise_scale;  // high res block size
-//
-//							c000 = (ex > 0 && ey > 0 && ez > 0) ? emission_map[smoke_get_index(ex - 1, em->res[0], ey - 1, em->res[1], ez - 1)] : 0;
-//							c001 = (ex > 0 && ey > 0) ? emission_map[smoke_get_index(ex - 1, em->res[0], ey - 1, em->res[1], ez)] : 0;
-//							c010 = (ex > 0 && ez > 0) ? emission_map[smoke_get_index(ex - 1, em->res[0], ey, em->res[1], ez - 1)] : 0;
-//							c011 = (ex > 0) ? emission_map[smoke_get_index(ex - 1, em->res[0], ey, em->res[1], ez)] : 0;
-//
-//							c100 = (ey > 0 && ez > 0) ? emission_map[smoke_get_index(ex, em->res[0], ey - 1, em->res[1], ez - 1)] : 0;
-//							c101 = (ey > 0) ? emission_map[smoke_get_index(ex, em->res[0], ey - 1, em->res[1], ez)] : 0;
-//							c110 = (ez > 0) ? emission_map[smoke_get_index(ex, em->res[0], ey, em->res[1], ez - 1)] : 0;
-//							c111 = emission_map[smoke_get_index(ex, em->res[0], ey, em->res[1], ez)]; // this cell
-//
-//							for (ii = 0; ii < block_size; ii++)
-//								for (jj = 0; jj < block_size; jj++)
-//									for (kk = 0; kk < block_size; kk++)
-//									{
-//
-//										float fx, fy, fz, interpolated_value;
-//										int shift_x = 0, shift_y = 0, shift_z = 0;
-//
-//
-//										/* Use full sample emission map if enabled and available */
-//										if ((sds->highres_sampling == SM_HRES_FULLSAMPLE) && emission_map_high) {
-//											interpolated_value = emission_map_high[smoke_get_index(ex * block_size + ii, em->res[0] * block_size, ey * block_size + jj, em->res[1] * block_size, ez * block_size + kk)]; // this cell
-//										}
-//										else if (sds->highres_sampling == SM_HRES_NEAREST) {
-//											/* without interpolation use same low resolution
-//											 * block value for all hi-res blocks */
-//											interpolated_value = c111;
-//										}
-//										/* Fall back to interpolated */
-//										else
-//										{
-//											/* get relative block position
-//											 * for interpolation smoothing */
-//											fx = (float)ii / block_size + 0.5f / block_size;
-//											fy = (float)jj / block_size + 0.5f / block_size;
-//											fz = (float)kk / block_size + 0.5f / block_size;
-//
-//											/* calculate trilinear interpolation */
-//											interpolated_value = c000 * (1 - fx) * (1 - fy) * (1 - fz) +
-//																 c100 * fx * (1 - fy) * (1 - fz) +
-//																 c010 * (1 - fx) * fy * (1 - fz) +
-//																 c001 * (1 - fx) * (1 - fy) * fz +
-//																 c101 * fx * (1 - fy) * fz +
-//																 c011 * (1 - fx) * fy * fz +
-//																 c110 * fx * fy * (1 - fz) +
-//																 c111 * fx * fy * fz;
-//
-//
-//											/* add some contrast / sharpness
-//											 * depending on hi-res block size */
-//											interpolated_value = (interpolated_value - 0.4f) * (block_size / 2) + 0.4f;
-//											CLAMP(interpolated_value, 0.0f, 1.0f);
-//
-//											/* shift smoke block index
-//											 * (because pixel center is actually
-//											 * in halfway of the low res block) */
-//											shift_x = (dx < 1) ? 0 : block_size / 2;
-//											shift_y = (dy < 1) ? 0 : block_size / 2;
-//											shift_z = (dz < 1) ? 0 : block_size / 2;
-//										}
-//
-//										/* get shifted index for current high resolution block */
-//										index_big = smoke_get_index(block_size * dx + ii - shift_x, bigres[0], block_size * dy + jj - shift_y, bigres[1], block_size * dz + kk - shift_z);
-//
-//										if (sfs->behavior == MOD_SMOKE_FLOW_BEHAVIOR_OUTFLOW) { // outflow
-//											if (interpolated_value) {
-//												apply_outflow_fields(index_big, distance_map_high[index_big], bigdensity, NULL, bigfuel, bigreact, bigcolor_r, bigcolor_g, bigcolor_b, NULL);
-//											}
-//										}
-//										else if (sfs->behavior == MOD_SMOKE_FLOW_BEHAVIOR_GEOMETRY && smd2->time > 2) {
-//											apply_inflow_fields(sfs, 0.0f, 0.5f, index_big, bigdensity, NULL, bigfuel, bigreact, bigcolor_r, bigcolor_g, bigcolor_b, NULL, NULL);
-//										}
-//										else if (sfs->behavior == MOD_SMOKE_FLOW_BEHAVIOR_INFLOW || sfs->behavior == MOD_SMOKE_FLOW_BEHAVIOR_GEOMETRY) { // inflow
-//											// TODO (sebbas) inflow map highres?
-//											apply_inflow_fields(sfs, interpolated_value, distance_map_high[index_big], index_big, bigdensity, NULL, bigfuel, bigreact, bigcolor_r, bigcolor_g, bigcolor_b, NULL, NULL);
-//										}
-//									} // hires loop
-//						}  // bigdensity
-					} // low res loop
+			/* bricks are disjoint, so every brick can be applied to the domain independently */
+			if (em->used_bricks > 0) {
+				data.smd = smd2;
+				data.em = em;
+
+				ParallelRangeSettings settings;
+				BLI_parallel_range_settings_defaults(&settings);
+				settings.use_threading = (em->used_bricks > 8);
+				BLI_task_parallel_range(0, em->used_bricks,
+				                        &data,
+				                        apply_emission_task_cb,
+				                        &settings);
+				emitted = true;
+			}
+
+			// TODO (sebbas): For now, just using manta interpolated grids for noise
 
 			// free emission maps
 			em_freeData(em);
@@ -2759,6 +3153,19 @@ static void update_flowsfluids(Scene *scene, Object *ob, SmokeDomainSettings *sd
 
 	if (flowobjs) MEM_freeN(flowobjs);
 	if (emaps) MEM_freeN(emaps);
+
+	/* Inflow levelsets are rebuilt every step, but keep their version when the flows did not
+	 * move. Emission grids are only written when a flow emitted. */
+	{
+		const char *const changed[] = {"phiIn", "phiOutIn"};
+		smoke_tag_grids_changed(sds->fluid, changed, ARRAY_SIZE(changed));
+	}
+	if (emitted) {
+		const char *const changed[] = {
+		    "density", "heat", "fuel", "react", "color_r", "color_g", "color_b",
+		    "emissionIn", "x_invel", "y_invel", "z_invel"};
+		smoke_tag_grids_changed(sds->fluid, changed, ARRAY_SIZE(changed));
+	}
 }
 
 typedef struct UpdateEffectorsData {
@@ -2866,6 +3273,9 @@ static void update_effectors(Scene *scene, Object *ob, SmokeDomainSettings *sds,
 		                        &data,
 		                        update_effectors_task_cb,
 		                        &settings);
+
+		const char *const changed[] = {"x_force", "y_force", "z_force"};
+		smoke_tag_grids_changed(sds->fluid, changed, ARRAY_SIZE(changed));
 	}
 
 	pdEndEffectors(&effectors);
@@ -3380,6 +3790,15 @@ static void smoke_calc_transparency(SmokeDomainSettings *sds, Scene *scene)
 	light[1] = (light[1] - sds->p0[1]) / sds->cell_size[1] - 0.5f - (float)sds->res_min[1];
 	light[2] = (light[2] - sds->p0[2]) / sds->cell_size[2] - 0.5f - (float)sds->res_min[2];
 
+	/* The shadow only depends on density and the light position in cell space, skip the
+	 * ray march when neither changed since it was last computed */
+	const int shadow_grid = fluid_grid_find(sds->fluid, "shadow");
+	const int density_grid = fluid_grid_find(sds->fluid, "density");
+	const unsigned int light_key = BLI_hash_mm2((const unsigned char *)light, sizeof(light), 0);
+	if (fluid_grid_derived_is_current(sds->fluid, shadow_grid, density_grid, light_key)) {
+		return;
+	}
+
 	for (a = 0; a < size; a++)
 		shadow[a] = -1.0f;
 
@@ -3433,6 +3852,8 @@ static void smoke_calc_transparency(SmokeDomainSettings *sds, Scene *scene)
 				shadow[index] = tRay;
 			}
 	}
+
+	fluid_grid_tag_derived(sds->fluid, shadow_grid, density_grid, light_key);
 }
 
 void smoke_step(Scene *scene, Object *ob, SmokeModifierData *smd, int frame, bool is_first_frame)
@@ -3462,8 +3883,6 @@ void smoke_step(Scene *scene, Object *ob, SmokeModifierData *smd, int frame, boo
 
 	time_per_frame = 0;
 
-	BLI_mutex_lock(&object_update_lock);
-
 	// loop as long as time_per_frame (sum of sudivdt) does not exceed dt (actual framelength)
 	while (time_per_frame < dt)
 	{
@@ -3472,6 +3891,11 @@ void smoke_step(Scene *scene, Object *ob, SmokeModifierData *smd, int frame, boo
 		sdt = fluid_get_timestep(sds->fluid);
 		time_per_frame += sdt;
 
+		/* Flow, obstacle and effector objects are evaluated at subframes and may be shared
+		 * between domains, so only this part is serialized. The solver step itself works on
+		 * data owned by this domain and can run alongside other domains. */
+		BLI_mutex_lock(&object_update_lock);
+
 		// Calculate inflow geometry
 		update_flowsfluids(scene, ob, sds, time_per_frame, dt, frame, is_first_frame);
 
@@ -3480,13 +3904,17 @@ void smoke_step(Scene *scene, Object *ob, SmokeModifierData *smd, int frame, boo
 
 		if (sds->total_cells > 1) {
 			update_effectors(scene, ob, sds, sdt); // DG TODO? problem --> uses forces instead of velocity, need to check how they need to be changed with variable dt
+		}
+
+		BLI_mutex_unlock(&object_update_lock);
+
+		if (sds->total_cells > 1) {
 			fluid_bake_data(sds->fluid, smd, frame);
 		}
 	}
 	if (sds->type == MOD_SMOKE_DOMAIN_TYPE_GAS) {
 		smoke_calc_transparency(sds, scene);
 	}
-	BLI_mutex_unlock(&object_update_lock);
 }
 
 /* get smoke velocity and density at given coordinates
@@ -29,6 +29,14 @@
 typedef struct BArrayStore BArrayStore;
 typedef struct BArrayState BArrayState;
 
+/* BLI_array_store_create_ex flag */
+enum {
+	/* cut chunks where the data matches instead of at fixed offsets */
+	BLI_ARRAY_STORE_CONTENT_DEFINED_CHUNKS = (1 << 0),
+};
+
+BArrayStore *BLI_array_store_create_ex(
+        unsigned int stride, unsigned int chunk_count, const int flag);
 BArrayStore *BLI_array_store_create(
         unsigned int stride, unsigned int chunk_count);
 void BLI_array_store_destroy(
@@ -32,6 +32,9 @@ struct BArrayStore_AtSize {
 	int                  stride_table_len;
 };
 
+BArrayStore *BLI_array_store_at_size_ensure_ex(
+        struct BArrayStore_AtSize *bs_stride,
+        const int stride, const int chunk_size, const int flag);
 BArrayStore *BLI_array_store_at_size_ensure(
         struct BArrayStore_AtSize *bs_stride,
         const int stride, const int chunk_size);
@@ -74,6 +74,10 @@ typedef struct GHashIterState {
 enum {
 	GHASH_FLAG_ALLOW_DUPES  = (1 << 0),  /* Only checked for in debug mode */
 	GHASH_FLAG_ALLOW_SHRINK = (1 << 1),  /* Allow to shrink buckets' size. */
+	/* Store entries inline in an open addressing table (fewer allocations & cache misses),
+	 * only valid at creation (see #BLI_ghash_new_flag).
+	 * Pointers to keys & values are only valid until the next insertion or removal. */
+	GHASH_FLAG_OPEN_ADDRESSING = (1 << 2),
 
 #ifdef GHASH_INTERNAL_API
 	/* Internal usage only */
@@ -89,6 +93,9 @@ enum {
 GHash *BLI_ghash_new_ex(
         GHashHashFP hashfp, GHashCmpFP cmpfp, const char *info,
         const unsigned int nentries_reserve) ATTR_MALLOC ATTR_WARN_UNUSED_RESULT;
+GHash *BLI_ghash_new_flag(
+        GHashHashFP hashfp, GHashCmpFP cmpfp, const char *info,
+        const unsigned int nentries_reserve, const unsigned int flag) ATTR_MALLOC ATTR_WARN_UNUSED_RESULT;
 GHash *BLI_ghash_new(
         GHashHashFP hashfp, GHashCmpFP cmpfp, const char *info) ATTR_MALLOC ATTR_WARN_UNUSED_RESULT;
 GHash *BLI_ghash_copy(
@@ -177,6 +184,9 @@ typedef GHashIterState GSetIterState;
 GSet  *BLI_gset_new_ex(
         GSetHashFP hashfp, GSetCmpFP cmpfp, const char *info,
         const unsigned int nentries_reserve) ATTR_MALLOC ATTR_WARN_UNUSED_RESULT;
+GSet  *BLI_gset_new_flag(
+        GSetHashFP hashfp, GSetCmpFP cmpfp, const char *info,
+        const unsigned int nentries_reserve, const unsigned int flag) ATTR_MALLOC ATTR_WARN_UNUSED_RESULT;
 GSet  *BLI_gset_new(GSetHashFP hashfp, GSetCmpFP cmpfp, const char *info) ATTR_MALLOC ATTR_WARN_UNUSED_RESULT;
 GSet  *BLI_gset_copy(GSet *gs, GSetKeyCopyFP keycopyfp) ATTR_MALLOC ATTR_WARN_UNUSED_RESULT;
 unsigned int BLI_gset_len(GSet *gs) ATTR_WARN_UNUSED_RESULT;
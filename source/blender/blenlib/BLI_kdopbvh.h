@@ -87,6 +87,7 @@ enum {
 	BVH_RAYCAST_WATERTIGHT		= (1 << 0),
 };
 #define BVH_RAYCAST_DEFAULT (BVH_RAYCAST_WATERTIGHT)
+
 #define BVH_RAYCAST_DIST_MAX (FLT_MAX / 2.0f)
 
 /* callback must update nearest in case it finds a nearest result */
@@ -111,6 +112,14 @@ typedef bool (*BVHTree_WalkLeafCallback)(const BVHTreeAxisRange *bounds, int ind
 typedef bool (*BVHTree_WalkOrderCallback)(const BVHTreeAxisRange *bounds, char axis, void *userdata);
 
 
+/* flags for BLI_bvhtree_new_ex */
+enum {
+	/* build the tree using the surface area heuristic, instead of splitting at the median,
+	 * slower to build but faster to query, especially for unevenly distributed elements */
+	BVH_BUILD_SAH		= (1 << 0),
+};
+
+BVHTree *BLI_bvhtree_new_ex(int maxsize, float epsilon, char tree_type, char axis, const int flag);
 BVHTree *BLI_bvhtree_new(int maxsize, float epsilon, char tree_type, char axis);
 void BLI_bvhtree_free(BVHTree *tree);
 
@@ -138,6 +147,9 @@ float BLI_bvhtree_get_epsilon(const BVHTree *tree);
 int BLI_bvhtree_find_nearest(
         BVHTree *tree, const float co[3], BVHTreeNearest *nearest,
         BVHTree_NearestPointCallback callback, void *userdata);
+void BLI_bvhtree_find_nearest_batch(
+        BVHTree *tree, const float (*co)[3], BVHTreeNearest *nearest, const int co_num,
+        BVHTree_NearestPointCallback callback, void *userdata);
 
 int BLI_bvhtree_ray_cast_ex(
         BVHTree *tree, const float co[3], const float dir[3], float radius, BVHTreeRayHit *hit,
@@ -146,6 +158,12 @@ int BLI_bvhtree_ray_cast_ex(
 int BLI_bvhtree_ray_cast(
         BVHTree *tree, const float co[3], const float dir[3], float radius, BVHTreeRayHit *hit,
         BVHTree_RayCastCallback callback, void *userdata);
+/* cast rays in packets, coherent rays should be next to each other */
+void BLI_bvhtree_ray_cast_batch(
+        BVHTree *tree, const float (*co)[3], const float (*dir)[3], float radius,
+        BVHTreeRayHit *hit, const int ray_num,
+        BVHTree_RayCastCallback callback, void *userdata,
+        int flag);
 
 void BLI_bvhtree_ray_cast_all_ex(
         BVHTree *tree, const float co[3], const float dir[3], float radius, float hit_dist,
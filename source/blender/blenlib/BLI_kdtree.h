@@ -66,6 +66,17 @@ void BLI_kdtree_range_search_cb(
         const KDTree *tree, const float co[3], float range,
         bool (*search_cb)(void *user_data, int index, const float co[3], float dist_sq), void *user_data);
 
+void BLI_kdtree_find_nearest_batch(
+        const KDTree *tree, const float (*co)[3], const int co_num,
+        int *r_index, KDTreeNearest *r_nearest) ATTR_NONNULL(1, 2);
+void BLI_kdtree_find_nearest_n_batch(
+        const KDTree *tree, const float (*co)[3], const int co_num,
+        KDTreeNearest *r_nearest, int *r_found, unsigned int n) ATTR_NONNULL(1, 2, 4, 5);
+void BLI_kdtree_range_search_cb_batch(
+        const KDTree *tree, const float (*co)[3], const int co_num, float range,
+        bool (*search_cb)(void *user_data, int co_index, int index, const float co[3], float dist_sq),
+        void *user_data) ATTR_NONNULL(1, 2, 5);
+
 int BLI_kdtree_calc_duplicates_fast(
         const KDTree *tree, const float range, bool use_index_order,
         int *doubles);
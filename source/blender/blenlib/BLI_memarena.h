@@ -57,6 +57,9 @@ void               *BLI_memarena_calloc(struct MemArena *ma, size_t size) ATTR_W
 
 void BLI_memarena_clear(MemArena *ma) ATTR_NONNULL(1);
 
+struct MemArena    *BLI_memarena_new_thread_local(const struct MemArena *ma) ATTR_WARN_UNUSED_RESULT ATTR_NONNULL(1) ATTR_MALLOC;
+void                BLI_memarena_merge(struct MemArena *ma, struct MemArena *ma_src) ATTR_NONNULL(1, 2);
+
 #ifdef __cplusplus
 }
 #endif
@@ -38,11 +38,14 @@ extern "C" {
 #include "BLI_utildefines.h"
 
 struct BLI_mempool;
+struct MemArena;
 
 /* Task Scheduler
  * 
- * Central scheduler that holds running threads ready to execute tasks. A single
- * queue holds the task from all pools.
+ * Central scheduler that holds running threads ready to execute tasks. Each
+ * thread has its own queue of tasks it pushed, idle threads steal tasks from
+ * the queues of others. Tasks pushed from threads which are not part of the
+ * scheduler go to a shared queue.
  *
  * Init/exit must be called before/after any task pools are created/freed, and
  * must be called from the main threads. All other scheduler and pool functions
@@ -126,7 +129,8 @@ typedef enum eTaskSchedulingMode {
 	 * amount of compute power.
 	 */
 	TASK_SCHEDULING_STATIC,
-	/* Task scheduler will schedule small amount of work to each worker thread.
+	/* Task scheduler will split the work further whenever some worker thread
+	 * runs out of it, and size chunks of iterations after their run time.
 	 * Has more run time overhead, but deals much better with cases when each
 	 * part of the work requires totally different amount of compute power.
 	 */
@@ -141,6 +145,11 @@ typedef struct ParallelRangeTLS {
 	 * worker threads. This is similar to OpenMP's firstprivate.
 	 */
 	void *userdata_chunk;
+	/* Arena and pool of the thread, when given in the settings. Allocating
+	 * from them needs no locking, see ParallelRangeSettings.
+	 */
+	struct MemArena *memarena;
+	struct BLI_mempool *mempool;
 } ParallelRangeTLS;
 
 typedef void (*TaskParallelRangeFunc)(void *__restrict userdata,
@@ -159,7 +168,7 @@ typedef struct ParallelRangeSettings {
 	bool use_threading;
 	/* Scheduling mode to use for this parallel range invocation. */
 	eTaskSchedulingMode scheduling_mode;
-	/* Each instance of looping chunks will get a copy of this data
+	/* Each thread working on the range will get a copy of this data
 	 * (similar to OpenMP's firstprivate).
 	 */
 	void *userdata_chunk;        /* Pointer to actual data. */
@@ -177,8 +186,17 @@ typedef struct ParallelRangeSettings {
 	 *   thread which will be doing 16 iterators each.
 	 * This is a preferred way to tell scheduler when to start threading than
 	 * having a global use_threading switch based on just range size.
+	 * With dynamic scheduling this is the smallest part the range is split into.
 	 */
 	int min_iter_per_thread;
+	/* Optional arena and pool for allocations from the callback. Every thread
+	 * allocates from its own arena and pool with the same settings (see
+	 * ParallelRangeTLS), those are merged into these ones once the whole range
+	 * has been processed, before func_finalize is called. Memory is then freed
+	 * all at once with them.
+	 */
+	struct MemArena *memarena;
+	struct BLI_mempool *mempool;
 } ParallelRangeSettings;
 
 BLI_INLINE void BLI_parallel_range_settings_defaults(
@@ -208,6 +226,15 @@ void BLI_task_parallel_mempool(
         TaskParallelMempoolFunc func,
         const bool use_threading);
 
+typedef void (*TaskParallelMempoolFuncEx)(void *userdata,
+                                          MempoolIterData *iter,
+                                          const ParallelRangeTLS *__restrict tls);
+void BLI_task_parallel_mempool_ex(
+        struct BLI_mempool *mempool,
+        void *userdata,
+        TaskParallelMempoolFuncEx func,
+        const ParallelRangeSettings *settings);
+
 /* TODO(sergey): Think of a better place for this. */
 BLI_INLINE void BLI_parallel_range_settings_defaults(
         ParallelRangeSettings *settings)
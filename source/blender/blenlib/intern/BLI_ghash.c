@@ -31,6 +31,8 @@
  * A general (pointer -> pointer) chaining hash table
  * for 'Abstract Data Types' (known as an ADT Hash Table).
  *
+ * Optionally (#GHASH_FLAG_OPEN_ADDRESSING) entries are stored inline in an open addressing table instead.
+ *
  * \note edgehash.c is based on this, make sure they stay in sync.
  */
 
@@ -44,6 +46,11 @@
 #include "BLI_sys_types.h"  /* for intptr_t support */
 #include "BLI_utildefines.h"
 #include "BLI_mempool.h"
+#include "BLI_math_bits.h"
+
+#ifdef __SSE2__
+#  include <emmintrin.h>
+#endif
 
 #define GHASH_INTERNAL_API
 #include "BLI_ghash.h"  /* own include */
@@ -87,9 +94,27 @@ BLI_STATIC_ASSERT(ARRAY_SIZE(hashsizes) == GHASH_MAX_SIZE, "Invalid 'hashsizes'
 #define GHASH_LIMIT_GROW(_nbkt)   (((_nbkt) * 3) /  4)
 #define GHASH_LIMIT_SHRINK(_nbkt) (((_nbkt) * 3) / 16)
 
+/**
+ * Open addressing tables are a power of two number of slots, probed by groups.
+ * They can be filled more than chained buckets, since a whole group is tested at once.
+ */
+#define GHASH_OA_GROUP_SIZE 16
+#define GHASH_OA_BIT_MIN 4
+#define GHASH_OA_BIT_MAX 30
+#define GHASH_OA_LIMIT_GROW(_nslot)   (((_nslot) /  8) * 7)
+#define GHASH_OA_LIMIT_SHRINK(_nslot) (((_nslot) / 32) * 7)
+
+/* Control bytes of free slots, full ones store the low 7 bits of the hash. */
+#define GHASH_OA_CTRL_EMPTY   0x80
+#define GHASH_OA_CTRL_DELETED 0xfe
+
 /* WARNING! Keep in sync with ugly _gh_Entry in header!!! */
 typedef struct Entry {
-	struct Entry *next;
+	union {
+		struct Entry *next;
+		/* Open addressing slots: hash of the key (see #ghash_bucket_index). */
+		uintptr_t hash;
+	};
 
 	void *key;
 } Entry;
@@ -119,6 +144,16 @@ struct GHash {
 	uint bucket_mask, bucket_bit, bucket_bit_min;
 #endif
 
+	/* Open addressing, slots replace buckets & entrypool, 'nbuckets' is the number of slots. */
+	char *slots;
+	uchar *ctrl;
+	uint slot_size;
+	uint slot_bit, slot_bit_min;
+	/* Number of empty slots which can still be used before resizing. */
+	uint growth_left;
+	/* Copy of the last removed entry, returned in place of the freed mempool entry. */
+	GHashEntry slot_removed;
+
 	uint nentries;
 	uint flag;
 };
@@ -166,6 +201,13 @@ BLI_INLINE uint ghash_entryhash(GHash *gh, const Entry *e)
  */
 BLI_INLINE uint ghash_bucket_index(GHash *gh, const uint hash)
 {
+	if (gh->flag & GHASH_FLAG_OPEN_ADDRESSING) {
+		/* Open addressing probes from the full hash, only mix it so the low bits used for the first group
+		 * and control byte depend on all bits (pointers, integers often only differ in a few). */
+		uint h = hash ^ (hash >> 16);
+		h *= 0x85ebca6bu;
+		return h ^ (h >> 13);
+	}
 #ifdef GHASH_USE_MODULO_BUCKETS
 	return hash % gh->nbuckets;
 #else
@@ -198,6 +240,303 @@ BLI_INLINE uint ghash_find_next_bucket_index(GHash *gh, uint curr_bucket)
 	return 0;
 }
 
+/**
+ * Open addressing (#GHASH_FLAG_OPEN_ADDRESSING).
+ *
+ * Entries are stored inline in one array of slots (no mempool, no pointer chasing),
+ * with one control byte per slot, either free (empty or deleted) or holding 7 bits of the entry's hash.
+ * Slots are probed by groups of #GHASH_OA_GROUP_SIZE, testing all control bytes of a group at once (SIMD),
+ * so the comparison callback is mostly only called for the searched key
+ * and the number of slots visited doesn't cause branch mispredictions (unlike linear or Robin Hood probing).
+ *
+ * Slots share the #Entry / #GHashEntry layout, their first member storing the (mixed) hash instead of
+ * the next entry, so the same code (and the inline iterator API) can read keys and values from both,
+ * and resizing doesn't need to call the hash callback.
+ *
+ * \note Entries move when the GHash is resized,
+ * pointers returned by lookup & ensure functions are only valid until the next insertion or removal.
+ */
+
+BLI_INLINE Entry *ghash_oa_slot(GHash *gh, const uint slot_index)
+{
+	return (Entry *)(gh->slots + (size_t)slot_index * gh->slot_size);
+}
+
+BLI_INLINE void ghash_oa_slot_copy(GHash *gh, Entry *dst, const Entry *src)
+{
+	if (gh->flag & GHASH_FLAG_IS_GSET) {
+		*dst = *src;
+	}
+	else {
+		*(GHashEntry *)dst = *(const GHashEntry *)src;
+	}
+}
+
+BLI_INLINE bool ghash_oa_ctrl_is_full(const uchar ctrl)
+{
+	return (ctrl & 0x80) == 0;
+}
+
+/**
+ * \return A bit-mask of the group's control bytes equal to \a value.
+ */
+BLI_INLINE uint ghash_oa_group_match(const uchar *ctrl, const uchar value)
+{
+#ifdef __SSE2__
+	const __m128i group = _mm_loadu_si128((const __m128i *)ctrl);
+	return (uint)_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8((char)value)));
+#else
+	uint match = 0;
+	for (uint i = 0; i < GHASH_OA_GROUP_SIZE; i++) {
+		if (ctrl[i] == value) {
+			match |= 1u << i;
+		}
+	}
+	return match;
+#endif
+}
+
+/**
+ * \return A bit-mask of the group's free (empty or deleted) slots.
+ */
+BLI_INLINE uint ghash_oa_group_match_free(const uchar *ctrl)
+{
+#ifdef __SSE2__
+	return (uint)_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)ctrl));
+#else
+	uint match = 0;
+	for (uint i = 0; i < GHASH_OA_GROUP_SIZE; i++) {
+		if (!ghash_oa_ctrl_is_full(ctrl[i])) {
+			match |= 1u << i;
+		}
+	}
+	return match;
+#endif
+}
+
+/**
+ * Groups are probed in triangular number steps from the first one,
+ * visiting all of them since their number is a power of two.
+ */
+BLI_INLINE uint ghash_oa_group_first(GHash *gh, const uint hash, uint *r_group_mask)
+{
+	*r_group_mask = (gh->nbuckets / GHASH_OA_GROUP_SIZE) - 1;
+	return (hash >> 7) & *r_group_mask;
+}
+
+BLI_INLINE Entry *ghash_oa_lookup_entry_ex(
+        GHash *gh, const void *key, const uint hash)
+{
+	const uchar tag = (uchar)(hash & 0x7f);
+	uint group_mask;
+	uint group = ghash_oa_group_first(gh, hash, &group_mask);
+
+	for (uint step = 1; ; group = (group + step++) & group_mask) {
+		const uchar *ctrl = gh->ctrl + group * GHASH_OA_GROUP_SIZE;
+		for (uint match = ghash_oa_group_match(ctrl, tag); match; match &= match - 1) {
+			Entry *e = ghash_oa_slot(gh, group * GHASH_OA_GROUP_SIZE + bitscan_forward_uint(match));
+			if (LIKELY(gh->cmpfp(key, e->key) == false)) {
+				return e;
+			}
+		}
+		/* Insertion would have used this empty slot, the key can't be in following groups. */
+		if (ghash_oa_group_match(ctrl, GHASH_OA_CTRL_EMPTY)) {
+			return NULL;
+		}
+	}
+}
+
+/**
+ * \return The index of the first free slot for \a hash (there is always one).
+ */
+BLI_INLINE uint ghash_oa_find_free(GHash *gh, const uint hash)
+{
+	uint group_mask;
+	uint group = ghash_oa_group_first(gh, hash, &group_mask);
+
+	for (uint step = 1; ; group = (group + step++) & group_mask) {
+		const uint match = ghash_oa_group_match_free(gh->ctrl + group * GHASH_OA_GROUP_SIZE);
+		if (match) {
+			return group * GHASH_OA_GROUP_SIZE + bitscan_forward_uint(match);
+		}
+	}
+}
+
+static void ghash_oa_resize(GHash *gh, const uint slot_bit)
+{
+	char *slots_old = gh->slots;
+	const uchar *ctrl_old = gh->ctrl;
+	const uint nslots_old = gh->nbuckets;
+
+	gh->slot_bit = slot_bit;
+	gh->nbuckets = 1u << slot_bit;
+	gh->limit_grow   = GHASH_OA_LIMIT_GROW(gh->nbuckets);
+	gh->limit_shrink = GHASH_OA_LIMIT_SHRINK(gh->nbuckets);
+	gh->growth_left = (gh->nentries < gh->limit_grow) ? gh->limit_grow - gh->nentries : 0;
+
+	/* Control bytes are stored after the slots, in the same allocation. */
+	gh->slots = MEM_mallocN((size_t)gh->nbuckets * (gh->slot_size + 1), __func__);
+	gh->ctrl = (uchar *)gh->slots + (size_t)gh->nbuckets * gh->slot_size;
+	memset(gh->ctrl, GHASH_OA_CTRL_EMPTY, gh->nbuckets);
+
+	if (slots_old) {
+		for (uint i = 0; i < nslots_old; i++) {
+			if (ghash_oa_ctrl_is_full(ctrl_old[i])) {
+				const Entry *e = (const Entry *)(slots_old + (size_t)i * gh->slot_size);
+				const uint slot_index = ghash_oa_find_free(gh, (uint)e->hash);
+				gh->ctrl[slot_index] = ctrl_old[i];
+				ghash_oa_slot_copy(gh, ghash_oa_slot(gh, slot_index), e);
+			}
+		}
+		MEM_freeN(slots_old);
+	}
+}
+
+static void ghash_oa_expand(GHash *gh, const uint nentries, const bool user_defined)
+{
+	uint slot_bit = gh->slot_bit;
+
+	if (LIKELY(gh->slots && (nentries <= gh->limit_grow))) {
+		return;
+	}
+
+	while ((nentries > GHASH_OA_LIMIT_GROW(1u << slot_bit)) &&
+	       (slot_bit < GHASH_OA_BIT_MAX))
+	{
+		slot_bit++;
+	}
+
+	if (user_defined) {
+		gh->slot_bit_min = slot_bit;
+	}
+
+	if ((slot_bit != gh->slot_bit) || !gh->slots) {
+		ghash_oa_resize(gh, slot_bit);
+	}
+}
+
+static void ghash_oa_contract(
+        GHash *gh, const uint nentries, const bool user_defined, const bool force_shrink)
+{
+	uint slot_bit = gh->slot_bit;
+
+	if (!(force_shrink || (gh->flag & GHASH_FLAG_ALLOW_SHRINK))) {
+		return;
+	}
+
+	if (LIKELY(gh->slots && (nentries > gh->limit_shrink))) {
+		return;
+	}
+
+	while ((nentries < GHASH_OA_LIMIT_SHRINK(1u << slot_bit)) &&
+	       (slot_bit > gh->slot_bit_min))
+	{
+		slot_bit--;
+	}
+
+	if (user_defined) {
+		gh->slot_bit_min = slot_bit;
+	}
+
+	if ((slot_bit != gh->slot_bit) || !gh->slots) {
+		ghash_oa_resize(gh, slot_bit);
+	}
+}
+
+/**
+ * Insert \a key (and \a val, ignored for GSet), returns its slot.
+ */
+static Entry *ghash_oa_insert_ex(
+        GHash *gh, void *key, void *val, const uint hash)
+{
+	uint slot_index;
+	Entry *e;
+
+	BLI_assert((gh->flag & GHASH_FLAG_ALLOW_DUPES) || (BLI_ghash_haskey(gh, key) == 0));
+
+	slot_index = ghash_oa_find_free(gh, hash);
+	if (UNLIKELY((gh->growth_left == 0) && (gh->ctrl[slot_index] == GHASH_OA_CTRL_EMPTY))) {
+		if (gh->nentries + 1 > gh->limit_grow) {
+			ghash_oa_expand(gh, gh->nentries + 1, false);
+		}
+		else {
+			/* Only deleted slots are in the way, clear them. */
+			ghash_oa_resize(gh, gh->slot_bit);
+		}
+		slot_index = ghash_oa_find_free(gh, hash);
+	}
+
+	if (gh->ctrl[slot_index] == GHASH_OA_CTRL_EMPTY) {
+		gh->growth_left--;
+	}
+	gh->ctrl[slot_index] = (uchar)(hash & 0x7f);
+	gh->nentries++;
+
+	e = ghash_oa_slot(gh, slot_index);
+	e->hash = hash;
+	e->key = key;
+	if ((gh->flag & GHASH_FLAG_IS_GSET) == 0) {
+		((GHashEntry *)e)->val = val;
+	}
+	return e;
+}
+
+/**
+ * Remove the entry in slot \a slot_index, returns a copy of it (valid until the next removal).
+ */
+static Entry *ghash_oa_remove_slot(GHash *gh, const uint slot_index)
+{
+	uchar *ctrl_group = gh->ctrl + (slot_index & ~(uint)(GHASH_OA_GROUP_SIZE - 1));
+
+	ghash_oa_slot_copy(gh, &gh->slot_removed.e, ghash_oa_slot(gh, slot_index));
+
+	/* Probing only continues past full groups, and a group which has been full never has empty slots again,
+	 * so the slot can be emptied if any other is, otherwise it has to be kept as deleted. */
+	if (ghash_oa_group_match(ctrl_group, GHASH_OA_CTRL_EMPTY)) {
+		gh->ctrl[slot_index] = GHASH_OA_CTRL_EMPTY;
+		gh->growth_left++;
+	}
+	else {
+		gh->ctrl[slot_index] = GHASH_OA_CTRL_DELETED;
+	}
+
+	ghash_oa_contract(gh, --gh->nentries, false, false);
+
+	return &gh->slot_removed.e;
+}
+
+static Entry *ghash_oa_remove_ex(
+        GHash *gh, const void *key,
+        GHashKeyFreeFP keyfreefp, GHashValFreeFP valfreefp,
+        const uint hash)
+{
+	Entry *e = ghash_oa_lookup_entry_ex(gh, key, hash);
+
+	BLI_assert(!valfreefp || !(gh->flag & GHASH_FLAG_IS_GSET));
+
+	if (e) {
+		if (keyfreefp) {
+			keyfreefp(e->key);
+		}
+		if (valfreefp) {
+			valfreefp(((GHashEntry *)e)->val);
+		}
+		return ghash_oa_remove_slot(gh, (uint)(((char *)e - gh->slots) / gh->slot_size));
+	}
+
+	return NULL;
+}
+
+/**
+ * Free an entry returned by #ghash_remove_ex or #ghash_pop.
+ */
+BLI_INLINE void ghash_entry_free(GHash *gh, Entry *e)
+{
+	if (gh->entrypool) {
+		BLI_mempool_free(gh->entrypool, e);
+	}
+}
+
 /**
  * Expand buckets to the next size up or down.
  */
@@ -272,6 +611,11 @@ static void ghash_buckets_expand(
 {
 	uint new_nbuckets;
 
+	if (gh->flag & GHASH_FLAG_OPEN_ADDRESSING) {
+		ghash_oa_expand(gh, nentries, user_defined);
+		return;
+	}
+
 	if (LIKELY(gh->buckets && (nentries < gh->limit_grow))) {
 		return;
 	}
@@ -316,6 +660,11 @@ static void ghash_buckets_contract(
 {
 	uint new_nbuckets;
 
+	if (gh->flag & GHASH_FLAG_OPEN_ADDRESSING) {
+		ghash_oa_contract(gh, nentries, user_defined, force_shrink);
+		return;
+	}
+
 	if (!(force_shrink || (gh->flag & GHASH_FLAG_ALLOW_SHRINK))) {
 		return;
 	}
@@ -364,6 +713,15 @@ static void ghash_buckets_contract(
  */
 BLI_INLINE void ghash_buckets_reset(GHash *gh, const uint nentries)
 {
+	if (gh->flag & GHASH_FLAG_OPEN_ADDRESSING) {
+		MEM_SAFE_FREE(gh->slots);
+		gh->slot_bit = GHASH_OA_BIT_MIN;
+		gh->slot_bit_min = GHASH_OA_BIT_MIN;
+		gh->nentries = 0;
+		ghash_oa_expand(gh, nentries, (nentries != 0));
+		return;
+	}
+
 	MEM_SAFE_FREE(gh->buckets);
 
 #ifdef GHASH_USE_MODULO_BUCKETS
@@ -393,6 +751,11 @@ BLI_INLINE Entry *ghash_lookup_entry_ex(
         GHash *gh, const void *key, const uint bucket_index)
 {
 	Entry *e;
+
+	if (gh->flag & GHASH_FLAG_OPEN_ADDRESSING) {
+		return ghash_oa_lookup_entry_ex(gh, key, bucket_index);
+	}
+
 	/* If we do not store GHash, not worth computing it for each entry here!
 	 * Typically, comparison function will be quicker, and since it's needed in the end anyway... */
 	for (e = gh->buckets[bucket_index]; e; e = e->next) {
@@ -446,10 +809,18 @@ static GHash *ghash_new(
 	gh->cmpfp = cmpfp;
 
 	gh->buckets = NULL;
+	gh->slots = NULL;
+	gh->ctrl = NULL;
+	gh->slot_size = (uint)GHASH_ENTRY_SIZE(flag & GHASH_FLAG_IS_GSET);
 	gh->flag = flag;
 
 	ghash_buckets_reset(gh, nentries_reserve);
-	gh->entrypool = BLI_mempool_create(GHASH_ENTRY_SIZE(flag & GHASH_FLAG_IS_GSET), 64, 64, BLI_MEMPOOL_NOP);
+	if (flag & GHASH_FLAG_OPEN_ADDRESSING) {
+		gh->entrypool = NULL;
+	}
+	else {
+		gh->entrypool = BLI_mempool_create(gh->slot_size, 64, 64, BLI_MEMPOOL_NOP);
+	}
 
 	return gh;
 }
@@ -461,10 +832,16 @@ static GHash *ghash_new(
 BLI_INLINE void ghash_insert_ex(
         GHash *gh, void *key, void *val, const uint bucket_index)
 {
+	BLI_assert(!(gh->flag & GHASH_FLAG_IS_GSET));
+
+	if (gh->flag & GHASH_FLAG_OPEN_ADDRESSING) {
+		ghash_oa_insert_ex(gh, key, val, bucket_index);
+		return;
+	}
+
 	GHashEntry *e = BLI_mempool_alloc(gh->entrypool);
 
 	BLI_assert((gh->flag & GHASH_FLAG_ALLOW_DUPES) || (BLI_ghash_haskey(gh, key) == 0));
-	BLI_assert(!(gh->flag & GHASH_FLAG_IS_GSET));
 
 	e->e.next = gh->buckets[bucket_index];
 	e->e.key = key;
@@ -490,16 +867,39 @@ BLI_INLINE void ghash_insert_ex_keyonly_entry(
 	ghash_buckets_expand(gh, ++gh->nentries, false);
 }
 
+/**
+ * Insert a new entry for \a key and return it, the value (if any) is left for the caller to initialize.
+ */
+BLI_INLINE Entry *ghash_insert_ex_keyonly_new(
+        GHash *gh, void *key, const uint bucket_index)
+{
+	Entry *e;
+
+	if (gh->flag & GHASH_FLAG_OPEN_ADDRESSING) {
+		return ghash_oa_insert_ex(gh, key, NULL, bucket_index);
+	}
+
+	e = BLI_mempool_alloc(gh->entrypool);
+	ghash_insert_ex_keyonly_entry(gh, key, bucket_index, e);
+	return e;
+}
+
 /**
  * Insert function that doesn't set the value (use for GSet)
  */
 BLI_INLINE void ghash_insert_ex_keyonly(
         GHash *gh, void *key, const uint bucket_index)
 {
+	BLI_assert((gh->flag & GHASH_FLAG_IS_GSET) != 0);
+
+	if (gh->flag & GHASH_FLAG_OPEN_ADDRESSING) {
+		ghash_oa_insert_ex(gh, key, NULL, bucket_index);
+		return;
+	}
+
 	Entry *e = BLI_mempool_alloc(gh->entrypool);
 
 	BLI_assert((gh->flag & GHASH_FLAG_ALLOW_DUPES) || (BLI_ghash_haskey(gh, key) == 0));
-	BLI_assert((gh->flag & GHASH_FLAG_IS_GSET) != 0);
 
 	e->next = gh->buckets[bucket_index];
 	e->key = key;
@@ -571,13 +971,17 @@ BLI_INLINE bool ghash_insert_safe_keyonly(
 }
 
 /**
- * Remove the entry and return it, caller must free from gh->entrypool.
+ * Remove the entry and return it, caller must free it with #ghash_entry_free.
  */
 static Entry *ghash_remove_ex(
         GHash *gh, const void *key,
         GHashKeyFreeFP keyfreefp, GHashValFreeFP valfreefp,
         const uint bucket_index)
 {
+	if (gh->flag & GHASH_FLAG_OPEN_ADDRESSING) {
+		return ghash_oa_remove_ex(gh, key, keyfreefp, valfreefp, bucket_index);
+	}
+
 	Entry *e_prev;
 	Entry *e = ghash_lookup_entry_prev_ex(gh, key, &e_prev, bucket_index);
 
@@ -605,7 +1009,7 @@ static Entry *ghash_remove_ex(
 }
 
 /**
- * Remove a random entry and return it (or NULL if empty), caller must free from gh->entrypool.
+ * Remove a random entry and return it (or NULL if empty), caller must free it with #ghash_entry_free.
  */
 static Entry *ghash_pop(GHash *gh, GHashIterState *state)
 {
@@ -614,6 +1018,17 @@ static Entry *ghash_pop(GHash *gh, GHashIterState *state)
 		return NULL;
 	}
 
+	if (gh->flag & GHASH_FLAG_OPEN_ADDRESSING) {
+		if (curr_bucket >= gh->nbuckets) {
+			curr_bucket = 0;
+		}
+		while (!ghash_oa_ctrl_is_full(gh->ctrl[curr_bucket])) {
+			curr_bucket = (curr_bucket + 1) & (gh->nbuckets - 1);
+		}
+		state->curr_bucket = curr_bucket;
+		return ghash_oa_remove_slot(gh, curr_bucket);
+	}
+
 	/* Note: using first_bucket_index here allows us to avoid potential huge number of loops over buckets,
 	 *       in case we are popping from a large ghash with few items in it... */
 	curr_bucket = ghash_find_next_bucket_index(gh, curr_bucket);
@@ -639,6 +1054,21 @@ static void ghash_free_cb(
 	BLI_assert(keyfreefp  || valfreefp);
 	BLI_assert(!valfreefp || !(gh->flag & GHASH_FLAG_IS_GSET));
 
+	if (gh->flag & GHASH_FLAG_OPEN_ADDRESSING) {
+		for (i = 0; i < gh->nbuckets; i++) {
+			Entry *e = ghash_oa_slot(gh, i);
+			if (ghash_oa_ctrl_is_full(gh->ctrl[i])) {
+				if (keyfreefp) {
+					keyfreefp(e->key);
+				}
+				if (valfreefp) {
+					valfreefp(((GHashEntry *)e)->val);
+				}
+			}
+		}
+		return;
+	}
+
 	for (i = 0; i < gh->nbuckets; i++) {
 		Entry *e;
 
@@ -666,6 +1096,24 @@ static GHash *ghash_copy(GHash *gh, GHashKeyCopyFP keycopyfp, GHashValCopyFP val
 	BLI_assert(!valcopyfp || !(gh->flag & GHASH_FLAG_IS_GSET));
 
 	gh_new = ghash_new(gh->hashfp, gh->cmpfp, __func__, 0, gh->flag);
+
+	if (gh->flag & GHASH_FLAG_OPEN_ADDRESSING) {
+		/* Same size and hashes, the slots can be copied as they are. */
+		ghash_oa_resize(gh_new, gh->slot_bit);
+		memcpy(gh_new->slots, gh->slots, (size_t)gh->nbuckets * (gh->slot_size + 1));
+		gh_new->growth_left = gh->growth_left;
+		if (keycopyfp || valcopyfp) {
+			for (i = 0; i < gh->nbuckets; i++) {
+				Entry *e = ghash_oa_slot(gh, i);
+				if (ghash_oa_ctrl_is_full(gh->ctrl[i])) {
+					ghash_entry_copy(gh_new, ghash_oa_slot(gh_new, i), gh, e, keycopyfp, valcopyfp);
+				}
+			}
+		}
+		gh_new->nentries = gh->nentries;
+		return gh_new;
+	}
+
 	ghash_buckets_expand(gh_new, reserve_nentries_new, false);
 
 	BLI_assert(gh_new->nbuckets == gh->nbuckets);
@@ -714,6 +1162,20 @@ GHash *BLI_ghash_new_ex(
 	return ghash_new(hashfp, cmpfp, info, nentries_reserve, 0);
 }
 
+/**
+ * A version of #BLI_ghash_new_ex which takes creation flags.
+ *
+ * \param flag  Only #GHASH_FLAG_OPEN_ADDRESSING has to be passed here,
+ * other flags can also be set later with #BLI_ghash_flag_set.
+ */
+GHash *BLI_ghash_new_flag(
+        GHashHashFP hashfp, GHashCmpFP cmpfp, const char *info,
+        const uint nentries_reserve, const uint flag)
+{
+	BLI_assert((flag & GHASH_FLAG_IS_GSET) == 0);
+	return ghash_new(hashfp, cmpfp, info, nentries_reserve, flag);
+}
+
 /**
  * Wraps #BLI_ghash_new_ex with zero entries reserved.
  */
@@ -858,8 +1320,7 @@ bool BLI_ghash_ensure_p(GHash *gh, void *key, void ***r_val)
 	const bool haskey = (e != NULL);
 
 	if (!haskey) {
-		e = BLI_mempool_alloc(gh->entrypool);
-		ghash_insert_ex_keyonly_entry(gh, key, bucket_index, (Entry *)e);
+		e = (GHashEntry *)ghash_insert_ex_keyonly_new(gh, key, bucket_index);
 	}
 
 	*r_val = &e->val;
@@ -882,8 +1343,7 @@ bool BLI_ghash_ensure_p_ex(
 
 	if (!haskey) {
 		/* pass 'key' incase we resize */
-		e = BLI_mempool_alloc(gh->entrypool);
-		ghash_insert_ex_keyonly_entry(gh, (void *)key, bucket_index, (Entry *)e);
+		e = (GHashEntry *)ghash_insert_ex_keyonly_new(gh, (void *)key, bucket_index);
 		e->e.key = NULL;  /* caller must re-assign */
 	}
 
@@ -906,7 +1366,7 @@ bool BLI_ghash_remove(GHash *gh, const void *key, GHashKeyFreeFP keyfreefp, GHas
 	const uint bucket_index = ghash_bucket_index(gh, hash);
 	Entry *e = ghash_remove_ex(gh, key, keyfreefp, valfreefp, bucket_index);
 	if (e) {
-		BLI_mempool_free(gh->entrypool, e);
+		ghash_entry_free(gh, (Entry *)e);
 		return true;
 	}
 	else {
@@ -931,7 +1391,7 @@ void *BLI_ghash_popkey(GHash *gh, const void *key, GHashKeyFreeFP keyfreefp)
 	BLI_assert(!(gh->flag & GHASH_FLAG_IS_GSET));
 	if (e) {
 		void *val = e->val;
-		BLI_mempool_free(gh->entrypool, e);
+		ghash_entry_free(gh, (Entry *)e);
 		return val;
 	}
 	else {
@@ -967,7 +1427,7 @@ bool BLI_ghash_pop(
 		*r_key = e->e.key;
 		*r_val = e->val;
 
-		BLI_mempool_free(gh->entrypool, e);
+		ghash_entry_free(gh, (Entry *)e);
 		return true;
 	}
 	else {
@@ -991,7 +1451,9 @@ void BLI_ghash_clear_ex(
 		ghash_free_cb(gh, keyfreefp, valfreefp);
 
 	ghash_buckets_reset(gh, nentries_reserve);
-	BLI_mempool_clear_ex(gh->entrypool, nentries_reserve ? (int)nentries_reserve : -1);
+	if (gh->entrypool) {
+		BLI_mempool_clear_ex(gh->entrypool, nentries_reserve ? (int)nentries_reserve : -1);
+	}
 }
 
 /**
@@ -1011,12 +1473,17 @@ void BLI_ghash_clear(GHash *gh, GHashKeyFreeFP keyfreefp, GHashValFreeFP valfree
  */
 void BLI_ghash_free(GHash *gh, GHashKeyFreeFP keyfreefp, GHashValFreeFP valfreefp)
 {
-	BLI_assert((int)gh->nentries == BLI_mempool_len(gh->entrypool));
+	BLI_assert(!gh->entrypool || (int)gh->nentries == BLI_mempool_len(gh->entrypool));
 	if (keyfreefp || valfreefp)
 		ghash_free_cb(gh, keyfreefp, valfreefp);
 
-	MEM_freeN(gh->buckets);
-	BLI_mempool_destroy(gh->entrypool);
+	if (gh->flag & GHASH_FLAG_OPEN_ADDRESSING) {
+		MEM_freeN(gh->slots);
+	}
+	else {
+		MEM_freeN(gh->buckets);
+		BLI_mempool_destroy(gh->entrypool);
+	}
 	MEM_freeN(gh);
 }
 
@@ -1025,6 +1492,7 @@ void BLI_ghash_free(GHash *gh, GHashKeyFreeFP keyfreefp, GHashValFreeFP valfreef
  */
 void BLI_ghash_flag_set(GHash *gh, uint flag)
 {
+	BLI_assert((flag & GHASH_FLAG_OPEN_ADDRESSING) == 0);
 	gh->flag |= flag;
 }
 
@@ -1033,6 +1501,7 @@ void BLI_ghash_flag_set(GHash *gh, uint flag)
  */
 void BLI_ghash_flag_clear(GHash *gh, uint flag)
 {
+	BLI_assert((flag & GHASH_FLAG_OPEN_ADDRESSING) == 0);
 	gh->flag &= ~flag;
 }
 
@@ -1042,6 +1511,21 @@ void BLI_ghash_flag_clear(GHash *gh, uint flag)
 /** \name GHash Iterator API
  * \{ */
 
+/**
+ * Step \a ghi to the next used slot of an open addressing GHash.
+ */
+BLI_INLINE void ghash_oa_iterator_next(GHashIterator *ghi)
+{
+	GHash *gh = ghi->gh;
+	ghi->curEntry = NULL;
+	while (++ghi->curBucket < gh->nbuckets) {
+		if (ghash_oa_ctrl_is_full(gh->ctrl[ghi->curBucket])) {
+			ghi->curEntry = ghash_oa_slot(gh, ghi->curBucket);
+			break;
+		}
+	}
+}
+
 /**
  * Create a new GHashIterator. The hash table must not be mutated
  * while the iterator is in use, and the iterator will step exactly
@@ -1070,7 +1554,12 @@ void BLI_ghashIterator_init(GHashIterator *ghi, GHash *gh)
 	ghi->gh = gh;
 	ghi->curEntry = NULL;
 	ghi->curBucket = UINT_MAX;  /* wraps to zero */
-	if (gh->nentries) {
+	if (gh->flag & GHASH_FLAG_OPEN_ADDRESSING) {
+		if (gh->nentries) {
+			ghash_oa_iterator_next(ghi);
+		}
+	}
+	else if (gh->nentries) {
 		do {
 			ghi->curBucket++;
 			if (UNLIKELY(ghi->curBucket == ghi->gh->nbuckets))
@@ -1087,7 +1576,10 @@ void BLI_ghashIterator_init(GHashIterator *ghi, GHash *gh)
  */
 void BLI_ghashIterator_step(GHashIterator *ghi)
 {
-	if (ghi->curEntry) {
+	if (ghi->curEntry && (ghi->gh->flag & GHASH_FLAG_OPEN_ADDRESSING)) {
+		ghash_oa_iterator_next(ghi);
+	}
+	else if (ghi->curEntry) {
 		ghi->curEntry = ghi->curEntry->next;
 		while (!ghi->curEntry) {
 			ghi->curBucket++;
@@ -1173,6 +1665,16 @@ GSet *BLI_gset_new_ex(
 	return (GSet *)ghash_new(hashfp, cmpfp, info, nentries_reserve, GHASH_FLAG_IS_GSET);
 }
 
+/**
+ * Set counterpart to #BLI_ghash_new_flag.
+ */
+GSet *BLI_gset_new_flag(
+        GSetHashFP hashfp, GSetCmpFP cmpfp, const char *info,
+        const uint nentries_reserve, const uint flag)
+{
+	return (GSet *)ghash_new(hashfp, cmpfp, info, nentries_reserve, flag | GHASH_FLAG_IS_GSET);
+}
+
 GSet *BLI_gset_new(GSetHashFP hashfp, GSetCmpFP cmpfp, const char *info)
 {
 	return BLI_gset_new_ex(hashfp, cmpfp, info, 0);
@@ -1228,8 +1730,7 @@ bool BLI_gset_ensure_p_ex(GSet *gs, const void *key, void ***r_key)
 
 	if (!haskey) {
 		/* pass 'key' incase we resize */
-		e = BLI_mempool_alloc(((GHash *)gs)->entrypool);
-		ghash_insert_ex_keyonly_entry((GHash *)gs, (void *)key, bucket_index, (Entry *)e);
+		e = ghash_insert_ex_keyonly_new((GHash *)gs, (void *)key, bucket_index);
 		e->key = NULL;  /* caller must re-assign */
 	}
 
@@ -1287,7 +1788,7 @@ bool BLI_gset_pop(
 	if (e) {
 		*r_key = e->key;
 
-		BLI_mempool_free(((GHash *)gs)->entrypool, e);
+		ghash_entry_free((GHash *)gs, e);
 		return true;
 	}
 	else {
@@ -1317,12 +1818,12 @@ void BLI_gset_free(GSet *gs, GSetKeyFreeFP keyfreefp)
 
 void BLI_gset_flag_set(GSet *gs, uint flag)
 {
-	((GHash *)gs)->flag |= flag;
+	BLI_ghash_flag_set((GHash *)gs, flag);
 }
 
 void BLI_gset_flag_clear(GSet *gs, uint flag)
 {
-	((GHash *)gs)->flag &= ~flag;
+	BLI_ghash_flag_clear((GHash *)gs, flag);
 }
 
 /** \} */
@@ -1354,7 +1855,7 @@ void *BLI_gset_pop_key(GSet *gs, const void *key)
 	Entry *e = ghash_remove_ex((GHash *)gs, key, NULL, NULL, bucket_index);
 	if (e) {
 		void *key_ret = e->key;
-		BLI_mempool_free(((GHash *)gs)->entrypool, e);
+		ghash_entry_free((GHash *)gs, e);
 		return key_ret;
 	}
 	else {
@@ -1382,6 +1883,40 @@ int BLI_gset_buckets_len(GSet *gs)
 	return BLI_ghash_buckets_len((GHash *)gs);
 }
 
+/**
+ * Number of entries in each bucket
+ * (for open addressing, number of entries probing from each group).
+ */
+static uint *ghash_buckets_lengths(GHash *gh, uint *r_nbuckets)
+{
+	uint *lengths;
+	uint i;
+
+	if (gh->flag & GHASH_FLAG_OPEN_ADDRESSING) {
+		const uint ngroups = gh->nbuckets / GHASH_OA_GROUP_SIZE;
+		lengths = MEM_callocN(sizeof(*lengths) * ngroups, __func__);
+		for (i = 0; i < gh->nbuckets; i++) {
+			if (ghash_oa_ctrl_is_full(gh->ctrl[i])) {
+				uint group_mask;
+				lengths[ghash_oa_group_first(gh, (uint)ghash_oa_slot(gh, i)->hash, &group_mask)]++;
+			}
+		}
+		*r_nbuckets = ngroups;
+	}
+	else {
+		lengths = MEM_callocN(sizeof(*lengths) * gh->nbuckets, __func__);
+		for (i = 0; i < gh->nbuckets; i++) {
+			Entry *e;
+			for (e = gh->buckets[i]; e; e = e->next) {
+				lengths[i]++;
+			}
+		}
+		*r_nbuckets = gh->nbuckets;
+	}
+
+	return lengths;
+}
+
 /**
  * Measure how well the hash function performs (1.0 is approx as good as random distribution),
  * and return a few other stats like load, variance of the distribution of the entries in the buckets, etc.
@@ -1393,6 +1928,8 @@ double BLI_ghash_calc_quality_ex(
         double *r_prop_empty_buckets, double *r_prop_overloaded_buckets, int *r_biggest_bucket)
 {
 	double mean;
+	uint *lengths;
+	uint nbuckets;
 	uint i;
 
 	if (gh->nentries == 0) {
@@ -1415,7 +1952,9 @@ double BLI_ghash_calc_quality_ex(
 		return 0.0;
 	}
 
-	mean = (double)gh->nentries / (double)gh->nbuckets;
+	lengths = ghash_buckets_lengths(gh, &nbuckets);
+
+	mean = (double)gh->nentries / (double)nbuckets;
 	if (r_load) {
 		*r_load = mean;
 	}
@@ -1428,15 +1967,11 @@ double BLI_ghash_calc_quality_ex(
 		 * See https://en.wikipedia.org/wiki/Algorithms_for_calculating_variance#Two-pass_algorithm
 		 */
 		double sum = 0.0;
-		for (i = 0; i < gh->nbuckets; i++) {
-			int count = 0;
-			Entry *e;
-			for (e = gh->buckets[i]; e; e = e->next) {
-				count++;
-			}
+		for (i = 0; i < nbuckets; i++) {
+			const int count = (int)lengths[i];
 			sum += ((double)count - mean) * ((double)count - mean);
 		}
-		*r_variance = sum / (double)(gh->nbuckets - 1);
+		*r_variance = sum / (double)(nbuckets - 1);
 	}
 
 	{
@@ -1445,12 +1980,8 @@ double BLI_ghash_calc_quality_ex(
 		uint64_t sum_overloaded = 0;
 		uint64_t sum_empty = 0;
 
-		for (i = 0; i < gh->nbuckets; i++) {
-			uint64_t count = 0;
-			Entry *e;
-			for (e = gh->buckets[i]; e; e = e->next) {
-				count++;
-			}
+		for (i = 0; i < nbuckets; i++) {
+			const uint64_t count = lengths[i];
 			if (r_biggest_bucket) {
 				*r_biggest_bucket = max_ii(*r_biggest_bucket, (int)count);
 			}
@@ -1463,13 +1994,14 @@ double BLI_ghash_calc_quality_ex(
 			sum += count * (count + 1);
 		}
 		if (r_prop_overloaded_buckets) {
-			*r_prop_overloaded_buckets = (double)sum_overloaded / (double)gh->nbuckets;
+			*r_prop_overloaded_buckets = (double)sum_overloaded / (double)nbuckets;
 		}
 		if (r_prop_empty_buckets) {
-			*r_prop_empty_buckets = (double)sum_empty / (double)gh->nbuckets;
+			*r_prop_empty_buckets = (double)sum_empty / (double)nbuckets;
 		}
-		return ((double)sum * (double)gh->nbuckets /
-		        ((double)gh->nentries * (gh->nentries + 2 * gh->nbuckets - 1)));
+		MEM_freeN(lengths);
+		return ((double)sum * (double)nbuckets /
+		        ((double)gh->nentries * (gh->nentries + 2 * nbuckets - 1)));
 	}
 }
 double BLI_gset_calc_quality_ex(
@@ -44,6 +44,11 @@
  *   #BLI_bvhtree_overlap, #BVHOverlapData_Shared, #BVHOverlapData_Thread
  * - Range Query:
  *   #BLI_bvhtree_range_query
+ * - Batched ray-cast and nearest point, traversing packets of queries at once:
+ *   #BLI_bvhtree_ray_cast_batch, #BLI_bvhtree_find_nearest_batch
+ *
+ * Trees are built as balanced implicit trees by default,
+ * #BVH_BUILD_SAH builds them using the surface area heuristic instead.
  */
 
 #include <assert.h>
@@ -55,8 +60,15 @@
 #include "BLI_stack.h"
 #include "BLI_kdopbvh.h"
 #include "BLI_math.h"
+#include "BLI_math_bits.h"
 #include "BLI_task.h"
 
+#include "atomic_ops.h"
+
+#ifdef __SSE2__
+#  include <emmintrin.h>
+#endif
+
 #include "BLI_strict_flags.h"
 
 /* used for iterative_raycast */
@@ -71,6 +83,9 @@
 
 #define MAX_TREETYPE 32
 
+/* Number of queries traversed at once by the batched queries. */
+#define BVH_PACKET_SIZE 4
+
 /* Setting zero so we can catch bugs in BLI_task/KDOPBVH.
  * TODO(sergey): Deduplicate the limits with PBVH from BKE.
  */
@@ -112,11 +127,12 @@ struct BVHTree {
 	axis_t start_axis, stop_axis;  /* bvhtree_kdop_axes array indices according to axis */
 	axis_t axis;                   /* kdop type (6 => OBB, 7 => AABB, ...) */
 	char tree_type;                /* type of tree (4 => quadtree) */
+	char flag;                     /* BVH_BUILD_* flags */
 };
 
 /* optimization, ensure we stay small */
-BLI_STATIC_ASSERT((sizeof(void *) == 8 && sizeof(BVHTree) <= 48) ||
-                  (sizeof(void *) == 4 && sizeof(BVHTree) <= 32),
+BLI_STATIC_ASSERT((sizeof(void *) == 8 && sizeof(BVHTree) <= 56) ||
+                  (sizeof(void *) == 4 && sizeof(BVHTree) <= 36),
                   "over sized")
 
 /* avoid duplicating vars in BVHOverlapData_Thread */
@@ -946,15 +962,284 @@ static void non_recursive_bvh_div_nodes(
 /** \} */
 
 
+/* -------------------------------------------------------------------- */
+
+/** \name SAH Build
+ *
+ * Alternative to the implicit tree, used with #BVH_BUILD_SAH.
+ *
+ * Leafs are split where the surface area heuristic estimates the lowest cost of
+ * traversing the children, instead of at the median. Candidate splits are
+ * binned along each axis. The tree is not balanced, so branches are stored in
+ * the order they are created, which still puts children after their parents.
+ * \{ */
+
+#define SAH_BINS 16
+
+typedef struct BVHSAHBuildData {
+	const BVHTree *tree;
+	BVHNode *branches_array;
+	BVHNode **leafs_array;
+	/* Number of branches used so far. */
+	unsigned int num_branches;
+} BVHSAHBuildData;
+
+typedef struct BVHSAHChildrenData {
+	BVHSAHBuildData *build;
+	BVHNode *node;
+	int nth_positions[MAX_TREETYPE + 1];
+} BVHSAHChildrenData;
+
+static float bv_surface_area(const float bv[6])
+{
+	const float x = bv[1] - bv[0], y = bv[3] - bv[2], z = bv[5] - bv[4];
+	return x * y + y * z + z * x;
+}
+
+static void bv_expand(float bv[6], const float other[6])
+{
+	for (int i = 0; i < 6; i += 2) {
+		bv[i] = min_ff(bv[i], other[i]);
+		bv[i + 1] = max_ff(bv[i + 1], other[i + 1]);
+	}
+}
+
+static void bv_init(float bv[6])
+{
+	for (int i = 0; i < 6; i += 2) {
+		bv[i] = FLT_MAX;
+		bv[i + 1] = -FLT_MAX;
+	}
+}
+
+BLI_INLINE float bv_centroid(const float *bv, const int axis)
+{
+	return (bv[2 * axis] + bv[2 * axis + 1]) * 0.5f;
+}
+
+BLI_INLINE int sah_bin_index(const float centroid, const float min, const float scale)
+{
+	return min_ii((int)((centroid - min) * scale), SAH_BINS - 1);
+}
+
+/**
+ * Partition the leafs in range [begin, end) in two, returning the position of the split.
+ * Both parts are never empty.
+ */
+static int sah_split_leafs(BVHNode **leafs_array, const int begin, const int end, int *r_axis)
+{
+	float centroid_bv[6];
+	int i, axis;
+
+	bv_init(centroid_bv);
+	for (i = begin; i < end; i++) {
+		for (axis = 0; axis < 3; axis++) {
+			const float centroid = bv_centroid(leafs_array[i]->bv, axis);
+			centroid_bv[2 * axis] = min_ff(centroid_bv[2 * axis], centroid);
+			centroid_bv[2 * axis + 1] = max_ff(centroid_bv[2 * axis + 1], centroid);
+		}
+	}
+
+	float best_cost = FLT_MAX;
+	int best_axis = -1, best_bin = 0;
+
+	for (axis = 0; axis < 3; axis++) {
+		const float scale = (float)SAH_BINS / (centroid_bv[2 * axis + 1] - centroid_bv[2 * axis]);
+		if (!isfinite(scale)) {
+			continue;
+		}
+
+		float bin_bv[SAH_BINS][6];
+		int bin_count[SAH_BINS] = {0};
+
+		for (int bin = 0; bin < SAH_BINS; bin++) {
+			bv_init(bin_bv[bin]);
+		}
+		for (i = begin; i < end; i++) {
+			const float *bv = leafs_array[i]->bv;
+			const int bin = sah_bin_index(bv_centroid(bv, axis), centroid_bv[2 * axis], scale);
+			bv_expand(bin_bv[bin], bv);
+			bin_count[bin]++;
+		}
+
+		/* Sweep from the right to get the cost of the right side of each split,
+		 * then from the left to evaluate them. */
+		float right_cost[SAH_BINS];
+		float bv[6];
+		int count = 0;
+
+		bv_init(bv);
+		for (int bin = SAH_BINS - 1; bin > 0; bin--) {
+			bv_expand(bv, bin_bv[bin]);
+			count += bin_count[bin];
+			right_cost[bin] = (count != 0) ? bv_surface_area(bv) * (float)count : FLT_MAX;
+		}
+
+		bv_init(bv);
+		count = 0;
+		for (int bin = 0; bin < SAH_BINS - 1; bin++) {
+			bv_expand(bv, bin_bv[bin]);
+			count += bin_count[bin];
+			if (count == 0 || right_cost[bin + 1] == FLT_MAX) {
+				continue;
+			}
+
+			const float cost = bv_surface_area(bv) * (float)count + right_cost[bin + 1];
+			if (cost < best_cost) {
+				best_cost = cost;
+				best_axis = axis;
+				best_bin = bin;
+			}
+		}
+	}
+
+	if (best_axis == -1) {
+		/* All centroids are in the same place, any split is as good as another. */
+		*r_axis = 0;
+		return (begin + end) / 2;
+	}
+
+	const float min = centroid_bv[2 * best_axis];
+	const float scale = (float)SAH_BINS / (centroid_bv[2 * best_axis + 1] - min);
+	int left = begin, right = end - 1;
+
+	while (left <= right) {
+		if (sah_bin_index(bv_centroid(leafs_array[left]->bv, best_axis), min, scale) <= best_bin) {
+			left++;
+		}
+		else {
+			SWAP(BVHNode *, leafs_array[left], leafs_array[right]);
+			right--;
+		}
+	}
+
+	*r_axis = best_axis;
+	return left;
+}
+
+static void sah_bvh_build_node(BVHSAHBuildData *data, BVHNode *node, const int begin, const int end);
+
+static void sah_bvh_build_children_task_cb(
+        void *__restrict userdata,
+        const int k,
+        const ParallelRangeTLS *__restrict UNUSED(tls))
+{
+	BVHSAHChildrenData *children_data = userdata;
+	BVHNode *child = children_data->node->children[k];
+
+	/* Leafs are stored before branches. */
+	if (child >= children_data->build->branches_array) {
+		sah_bvh_build_node(children_data->build,
+		                   child,
+		                   children_data->nth_positions[k],
+		                   children_data->nth_positions[k + 1]);
+	}
+}
+
+/**
+ * Build the node for leafs in range [begin, end), which has at least two of them.
+ * The range with most leafs is split in two until there are as many as children
+ * fit in the node, or all of them have a single leaf.
+ */
+static void sah_bvh_build_node(BVHSAHBuildData *data, BVHNode *node, const int begin, const int end)
+{
+	const BVHTree *tree = data->tree;
+	BVHSAHChildrenData children_data = {.build = data, .node = node};
+	int *nth_positions = children_data.nth_positions;
+	int num_children = 1;
+	int k;
+
+	refit_kdop_hull(tree, node, begin, end);
+
+	nth_positions[0] = begin;
+	nth_positions[1] = end;
+
+	while (num_children < tree->tree_type) {
+		int largest = 0;
+		for (k = 1; k < num_children; k++) {
+			if (nth_positions[k + 1] - nth_positions[k] > nth_positions[largest + 1] - nth_positions[largest]) {
+				largest = k;
+			}
+		}
+		if (nth_positions[largest + 1] - nth_positions[largest] < 2) {
+			break;
+		}
+
+		int split_axis;
+		const int split = sah_split_leafs(
+		        data->leafs_array, nth_positions[largest], nth_positions[largest + 1], &split_axis);
+
+		/* The first split divides all leafs, use its axis for traversal order. */
+		if (num_children == 1) {
+			node->main_axis = (char)split_axis;
+		}
+
+		for (k = num_children; k > largest; k--) {
+			nth_positions[k + 1] = nth_positions[k];
+		}
+		nth_positions[largest + 1] = split;
+		num_children++;
+	}
+
+	for (k = 0; k < num_children; k++) {
+		BVHNode *child;
+
+		if (nth_positions[k + 1] - nth_positions[k] == 1) {
+			child = data->leafs_array[nth_positions[k]];
+		}
+		else {
+			child = &data->branches_array[atomic_fetch_and_add_uint32(&data->num_branches, 1)];
+		}
+
+		node->children[k] = child;
+		child->parent = node;
+	}
+	node->totnode = (char)num_children;
+
+	ParallelRangeSettings settings;
+	BLI_parallel_range_settings_defaults(&settings);
+	settings.use_threading = (end - begin > KDOPBVH_THREAD_LEAF_THRESHOLD);
+	settings.scheduling_mode = TASK_SCHEDULING_DYNAMIC;
+	BLI_task_parallel_range(0, num_children, &children_data, sah_bvh_build_children_task_cb, &settings);
+}
+
+/**
+ * Build the tree using binned SAH splits, returns the number of branches.
+ *
+ * Every branch has at least two children, so there are less branches than leafs.
+ */
+static int sah_bvh_build(const BVHTree *tree, BVHNode *branches_array, BVHNode **leafs_array, int num_leafs)
+{
+	BLI_assert(num_leafs > 1);
+
+	BVHSAHBuildData data = {
+		.tree = tree, .branches_array = branches_array, .leafs_array = leafs_array,
+		.num_branches = 1,
+	};
+
+	BVHNode *root = &branches_array[0];
+	root->parent = NULL;
+
+	sah_bvh_build_node(&data, root, 0, num_leafs);
+
+	return (int)data.num_branches;
+}
+
+#undef SAH_BINS
+
+/** \} */
+
+
 /* -------------------------------------------------------------------- */
 
 /** \name BLI_bvhtree API
  * \{ */
 
 /**
+ * \param flag: #BVH_BUILD_SAH to build the tree using the surface area heuristic.
  * \note many callers don't check for ``NULL`` return.
  */
-BVHTree *BLI_bvhtree_new(int maxsize, float epsilon, char tree_type, char axis)
+BVHTree *BLI_bvhtree_new_ex(int maxsize, float epsilon, char tree_type, char axis, const int flag)
 {
 	BVHTree *tree;
 	int numnodes, i;
@@ -972,6 +1257,7 @@ BVHTree *BLI_bvhtree_new(int maxsize, float epsilon, char tree_type, char axis)
 		tree->epsilon = epsilon;
 		tree->tree_type = tree_type;
 		tree->axis = axis;
+		tree->flag = (char)flag;
 
 		if (axis == 26) {
 			tree->start_axis = 0;
@@ -1001,8 +1287,14 @@ BVHTree *BLI_bvhtree_new(int maxsize, float epsilon, char tree_type, char axis)
 		}
 
 
-		/* Allocate arrays */
-		numnodes = maxsize + implicit_needed_branches(tree_type, maxsize) + tree_type;
+		/* Allocate arrays, SAH trees may have as many branches as a binary tree. */
+		numnodes = maxsize + tree_type;
+		if (flag & BVH_BUILD_SAH) {
+			numnodes += max_ii(1, maxsize - 1);
+		}
+		else {
+			numnodes += implicit_needed_branches(tree_type, maxsize);
+		}
 
 		tree->nodes = MEM_callocN(sizeof(BVHNode *) * (size_t)numnodes, "BVHNodes");
 		tree->nodebv = MEM_callocN(sizeof(float) * (size_t)(axis * numnodes), "BVHNodeBV");
@@ -1038,6 +1330,11 @@ fail:
 	return NULL;
 }
 
+BVHTree *BLI_bvhtree_new(int maxsize, float epsilon, char tree_type, char axis)
+{
+	return BLI_bvhtree_new_ex(maxsize, epsilon, tree_type, axis, 0);
+}
+
 void BLI_bvhtree_free(BVHTree *tree)
 {
 	if (tree) {
@@ -1057,12 +1354,17 @@ void BLI_bvhtree_balance(BVHTree *tree)
 	 * (some big bug goes here if its being called more than once per tree) */
 	BLI_assert(tree->totbranch == 0);
 
-	/* Build the implicit tree */
-	non_recursive_bvh_div_nodes(tree, tree->nodearray + (tree->totleaf - 1), leafs_array, tree->totleaf);
+	if ((tree->flag & BVH_BUILD_SAH) && tree->totleaf > 1) {
+		tree->totbranch = sah_bvh_build(tree, tree->nodearray + tree->totleaf, leafs_array, tree->totleaf);
+	}
+	else {
+		/* Build the implicit tree */
+		non_recursive_bvh_div_nodes(tree, tree->nodearray + (tree->totleaf - 1), leafs_array, tree->totleaf);
+		tree->totbranch = implicit_needed_branches(tree->tree_type, tree->totleaf);
+	}
 
 	/* current code expects the branches to be linked to the nodes array
 	 * we perform that linkage here */
-	tree->totbranch = implicit_needed_branches(tree->tree_type, tree->totleaf);
 	for (int i = 0; i < tree->totbranch; i++) {
 		tree->nodes[tree->totleaf + i] = &tree->nodearray[tree->totleaf + i];
 	}
@@ -1605,6 +1907,142 @@ int BLI_bvhtree_find_nearest(
 	return data.nearest.index;
 }
 
+/* Batched queries are traversed in packets, testing all queries of a packet
+ * against a node at once. */
+typedef struct BVHNearestPacketData {
+	const BVHTree *tree;
+	BVHTree_NearestPointCallback callback;
+	void *userdata;
+
+	const float *co[BVH_PACKET_SIZE];
+	BVHTreeNearest *nearest[BVH_PACKET_SIZE];
+
+	/* Coordinates and distances of the queries, by axis and then query. */
+	float proj[3][BVH_PACKET_SIZE];
+	float dist_sq[BVH_PACKET_SIZE];
+} BVHNearestPacketData;
+
+/* Returns the mask of queries in the packet which may have a nearer point in the node. */
+static int nearest_packet_test(const BVHNearestPacketData *data, const BVHNode *node, const int mask)
+{
+	const float *bv = node->bv;
+
+#ifdef __SSE2__
+	const __m128 zero = _mm_setzero_ps();
+	__m128 dist_sq = zero;
+
+	for (int i = 0; i != 3; i++, bv += 2) {
+		const __m128 proj = _mm_loadu_ps(data->proj[i]);
+		const __m128 dl = _mm_sub_ps(_mm_set1_ps(bv[0]), proj);
+		const __m128 du = _mm_sub_ps(proj, _mm_set1_ps(bv[1]));
+		const __m128 d = _mm_max_ps(_mm_max_ps(dl, du), zero);
+		dist_sq = _mm_add_ps(dist_sq, _mm_mul_ps(d, d));
+	}
+
+	return mask & _mm_movemask_ps(_mm_cmplt_ps(dist_sq, _mm_loadu_ps(data->dist_sq)));
+#else
+	int result = 0;
+
+	for (int j = 0; j < BVH_PACKET_SIZE; j++) {
+		float dist_sq = 0.0f;
+
+		for (int i = 0; i != 3; i++) {
+			const float d = max_fff(bv[2 * i] - data->proj[i][j], data->proj[i][j] - bv[2 * i + 1], 0.0f);
+			dist_sq += d * d;
+		}
+		if (dist_sq < data->dist_sq[j]) {
+			result |= 1 << j;
+		}
+	}
+
+	return mask & result;
+#endif
+}
+
+static void dfs_find_nearest_packet(BVHNearestPacketData *data, BVHNode *node, int mask)
+{
+	mask = nearest_packet_test(data, node, mask);
+
+	if (mask == 0) {
+		return;
+	}
+
+	if (node->totnode == 0) {
+		for (int j = 0; j < BVH_PACKET_SIZE; j++) {
+			if (mask & (1 << j)) {
+				BVHTreeNearest *nearest = data->nearest[j];
+				if (data->callback) {
+					data->callback(data->userdata, node->index, data->co[j], nearest);
+				}
+				else {
+					const float proj[3] = {data->proj[0][j], data->proj[1][j], data->proj[2][j]};
+					nearest->index = node->index;
+					nearest->dist_sq = calc_nearest_point_squared(proj, node, nearest->co);
+				}
+				data->dist_sq[j] = nearest->dist_sq;
+			}
+		}
+	}
+	else {
+		/* Same heuristic as #dfs_find_nearest_dfs, for the first query. */
+		const int j = bitscan_forward_i(mask);
+		int i;
+
+		if (data->proj[node->main_axis][j] <= node->children[0]->bv[node->main_axis * 2 + 1]) {
+			for (i = 0; i != node->totnode; i++) {
+				dfs_find_nearest_packet(data, node->children[i], mask);
+			}
+		}
+		else {
+			for (i = node->totnode - 1; i >= 0; i--) {
+				dfs_find_nearest_packet(data, node->children[i], mask);
+			}
+		}
+	}
+}
+
+/**
+ * Find the nearest node for many coordinates, same as calling #BLI_bvhtree_find_nearest for each.
+ *
+ * Coordinates are queried in packets, coherent ones next to each other traverse the tree together.
+ *
+ * \param nearest: Array of \a co_num results, their \a dist_sq and \a index have to be initialized.
+ */
+void BLI_bvhtree_find_nearest_batch(
+        BVHTree *tree, const float (*co)[3], BVHTreeNearest *nearest, const int co_num,
+        BVHTree_NearestPointCallback callback, void *userdata)
+{
+	BVHNearestPacketData data;
+	BVHNode *root = tree->nodes[tree->totleaf];
+
+	if (root == NULL) {
+		return;
+	}
+
+	data.tree = tree;
+	data.callback = callback;
+	data.userdata = userdata;
+
+	for (int start = 0; start < co_num; start += BVH_PACKET_SIZE) {
+		const int num = min_ii(BVH_PACKET_SIZE, co_num - start);
+
+		/* Unused queries of the last packet repeat the first one, masked out. */
+		for (int j = 0; j < BVH_PACKET_SIZE; j++) {
+			const int index = start + ((j < num) ? j : 0);
+
+			data.co[j] = co[index];
+			data.nearest[j] = &nearest[index];
+			for (int i = 0; i < 3; i++) {
+				data.proj[i][j] = co[index][i];
+			}
+			data.dist_sq[j] = nearest[index].dist_sq;
+		}
+
+		dfs_find_nearest_packet(&data, root, (1 << num) - 1);
+	}
+}
+
+
 /** \} */
 
 
@@ -1931,6 +2369,196 @@ void BLI_bvhtree_ray_cast_all(
 	BLI_bvhtree_ray_cast_all_ex(tree, co, dir, radius, hit_dist, callback, userdata, BVH_RAYCAST_DEFAULT);
 }
 
+typedef struct BVHRayCastPacketData {
+	const BVHTree *tree;
+	BVHTree_RayCastCallback callback;
+	void *userdata;
+
+	BVHTreeRay ray[BVH_PACKET_SIZE];
+	BVHTreeRayHit *hit[BVH_PACKET_SIZE];
+
+#ifdef USE_KDOPBVH_WATERTIGHT
+	struct IsectRayPrecalc isect_precalc[BVH_PACKET_SIZE];
+#endif
+
+	/* Origins, inverse directions and hit distances of the rays,
+	 * by axis and then ray. */
+	float origin[3][BVH_PACKET_SIZE];
+	float idot_axis[3][BVH_PACKET_SIZE];
+	float dist[BVH_PACKET_SIZE];
+	float radius;
+} BVHRayCastPacketData;
+
+/**
+ * Returns the mask of rays in the packet which hit the bounding volume of the node
+ * closer than their current hit, and the distances to it.
+ * Same as #fast_ray_nearest_hit, but takes the radius into account.
+ */
+static int ray_packet_nearest_hit(
+        const BVHRayCastPacketData *data, const BVHNode *node, const int mask, float r_dist[BVH_PACKET_SIZE])
+{
+	const float *bv = node->bv;
+
+	/* Axis aligned rays have an infinite inverse direction, like in #fast_ray_nearest_hit.
+	 * Starting on a slab plane then gives a NaN distance, the operand order below makes
+	 * such a slab drop out instead of limiting the ray. */
+#ifdef __SSE2__
+	__m128 low = _mm_set1_ps(-INFINITY);
+	__m128 upper = _mm_set1_ps(INFINITY);
+
+	for (int i = 0; i != 3; i++, bv += 2) {
+		const __m128 origin = _mm_loadu_ps(data->origin[i]);
+		const __m128 idot = _mm_loadu_ps(data->idot_axis[i]);
+		const __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(bv[0] - data->radius), origin), idot);
+		const __m128 t2 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(bv[1] + data->radius), origin), idot);
+		/* min/max return their second operand when either one is NaN */
+		low = _mm_max_ps(_mm_min_ps(t2, t1), low);
+		upper = _mm_min_ps(_mm_max_ps(t1, t2), upper);
+	}
+
+	_mm_storeu_ps(r_dist, low);
+
+	const __m128 hit = _mm_and_ps(
+	        _mm_and_ps(_mm_cmple_ps(low, upper), _mm_cmpge_ps(upper, _mm_setzero_ps())),
+	        _mm_cmplt_ps(low, _mm_loadu_ps(data->dist)));
+
+	return mask & _mm_movemask_ps(hit);
+#else
+	int result = 0;
+
+	for (int j = 0; j < BVH_PACKET_SIZE; j++) {
+		float low = -INFINITY, upper = INFINITY;
+
+		for (int i = 0; i != 3; i++) {
+			const float t1 = (bv[2 * i] - data->radius - data->origin[i][j]) * data->idot_axis[i][j];
+			const float t2 = (bv[2 * i + 1] + data->radius - data->origin[i][j]) * data->idot_axis[i][j];
+			const float t_near = (t2 < t1) ? t2 : t1;
+			const float t_far = (t1 > t2) ? t1 : t2;
+			if (t_near > low) low = t_near;
+			if (t_far < upper) upper = t_far;
+		}
+
+		r_dist[j] = low;
+		if (low <= upper && upper >= 0.0f && low < data->dist[j]) {
+			result |= 1 << j;
+		}
+	}
+
+	return mask & result;
+#endif
+}
+
+static void dfs_raycast_packet(BVHRayCastPacketData *data, BVHNode *node, int mask)
+{
+	float dist[BVH_PACKET_SIZE];
+
+	mask = ray_packet_nearest_hit(data, node, mask, dist);
+
+	if (mask == 0) {
+		return;
+	}
+
+	if (node->totnode == 0) {
+		for (int j = 0; j < BVH_PACKET_SIZE; j++) {
+			if (mask & (1 << j)) {
+				BVHTreeRayHit *hit = data->hit[j];
+				if (data->callback) {
+					data->callback(data->userdata, node->index, &data->ray[j], hit);
+				}
+				else {
+					hit->index = node->index;
+					hit->dist  = dist[j];
+					madd_v3_v3v3fl(hit->co, data->ray[j].origin, data->ray[j].direction, dist[j]);
+				}
+				data->dist[j] = hit->dist;
+			}
+		}
+	}
+	else {
+		/* pick loop direction to dive into the tree (based on direction of the first ray and split axis) */
+		const int j = bitscan_forward_i(mask);
+		int i;
+
+		if (data->ray[j].direction[node->main_axis] > 0.0f) {
+			for (i = 0; i != node->totnode; i++) {
+				dfs_raycast_packet(data, node->children[i], mask);
+			}
+		}
+		else {
+			for (i = node->totnode - 1; i >= 0; i--) {
+				dfs_raycast_packet(data, node->children[i], mask);
+			}
+		}
+	}
+}
+
+/**
+ * Cast many rays, same as calling #BLI_bvhtree_ray_cast_ex for each.
+ *
+ * Rays are cast in packets, coherent ones next to each other traverse the tree together.
+ *
+ * \param hit: Array of \a ray_num results, their \a dist and \a index have to be initialized.
+ */
+void BLI_bvhtree_ray_cast_batch(
+        BVHTree *tree, const float (*co)[3], const float (*dir)[3], float radius,
+        BVHTreeRayHit *hit, const int ray_num,
+        BVHTree_RayCastCallback callback, void *userdata,
+        int flag)
+{
+	BVHRayCastPacketData data;
+	BVHNode *root = tree->nodes[tree->totleaf];
+
+	if (root == NULL) {
+		return;
+	}
+
+	data.tree = tree;
+	data.callback = callback;
+	data.userdata = userdata;
+	data.radius = radius;
+
+	for (int start = 0; start < ray_num; start += BVH_PACKET_SIZE) {
+		const int num = min_ii(BVH_PACKET_SIZE, ray_num - start);
+
+		/* Unused rays of the last packet repeat the first one, masked out. */
+		for (int j = 0; j < BVH_PACKET_SIZE; j++) {
+			const int index = start + ((j < num) ? j : 0);
+			BVHTreeRay *ray = &data.ray[j];
+
+			BLI_ASSERT_UNIT_V3(dir[index]);
+
+			copy_v3_v3(ray->origin, co[index]);
+			copy_v3_v3(ray->direction, dir[index]);
+			ray->radius = radius;
+
+#ifdef USE_KDOPBVH_WATERTIGHT
+			if (flag & BVH_RAYCAST_WATERTIGHT) {
+				isect_ray_tri_watertight_v3_precalc(&data.isect_precalc[j], ray->direction);
+				ray->isect_precalc = &data.isect_precalc[j];
+			}
+			else {
+				ray->isect_precalc = NULL;
+			}
+#endif
+
+			for (int i = 0; i < 3; i++) {
+				data.origin[i][j] = ray->origin[i];
+				data.idot_axis[i][j] = 1.0f / ray->direction[i];
+			}
+
+			data.hit[j] = &hit[index];
+			data.dist[j] = hit[index].dist;
+		}
+
+		dfs_raycast_packet(&data, root, (1 << num) - 1);
+	}
+
+#ifndef USE_KDOPBVH_WATERTIGHT
+	UNUSED_VARS(flag);
+#endif
+}
+
+
 /** \} */
 
 /* -------------------------------------------------------------------- */
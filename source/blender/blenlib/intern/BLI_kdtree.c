@@ -29,6 +29,7 @@
 
 #include "BLI_math.h"
 #include "BLI_kdtree.h"
+#include "BLI_task.h"
 #include "BLI_utildefines.h"
 #include "BLI_strict_flags.h"
 
@@ -61,6 +62,11 @@ struct KDTree {
 
 #define KD_NODE_UNSET ((uint)-1)
 
+/* Subtrees with more nodes are balanced in parallel. */
+#define KD_THREAD_BALANCE_THRESHOLD 8192
+/* Batches with more queries are run in parallel. */
+#define KD_THREAD_QUERY_THRESHOLD 1024
+
 /**
  * Creates or free a kdtree
  */
@@ -113,17 +119,13 @@ void BLI_kdtree_insert(KDTree *tree, int index, const float co[3])
 #endif
 }
 
-static uint kdtree_balance(KDTreeNode *nodes, uint totnode, uint axis, const uint ofs)
+/* Reorder nodes so that the median on \a axis is at its sorted position,
+ * with smaller nodes before and larger ones after it. */
+static uint kdtree_partition(KDTreeNode *nodes, uint totnode, uint axis)
 {
-	KDTreeNode *node;
 	float co;
 	uint left, right, median, i, j;
 
-	if (totnode <= 0)
-		return KD_NODE_UNSET;
-	else if (totnode == 1)
-		return 0 + ofs;
-	
 	/* quicksort style sorting around median */
 	left = 0;
 	right = totnode - 1;
@@ -151,14 +153,80 @@ static uint kdtree_balance(KDTreeNode *nodes, uint totnode, uint axis, const uin
 			left = i + 1;
 	}
 
+	return median;
+}
+
+typedef struct KDTreeBalanceData {
+	KDTreeNode *nodes[2];
+	uint totnode[2];
+	uint ofs[2];
+	uint axis;
+
+	/* Roots of both subtrees. */
+	uint root[2];
+} KDTreeBalanceData;
+
+static uint kdtree_balance(KDTreeNode *nodes, uint totnode, uint axis, const uint ofs);
+
+static void kdtree_balance_task_cb(
+        void *__restrict userdata,
+        const int i,
+        const ParallelRangeTLS *__restrict UNUSED(tls))
+{
+	KDTreeBalanceData *data = userdata;
+	data->root[i] = kdtree_balance(data->nodes[i], data->totnode[i], data->axis, data->ofs[i]);
+}
+
+/**
+ * Nodes are stored depth first: every node is followed by its left subtree,
+ * and then by its right subtree. Traversal mostly descends into the node
+ * directly following the current one, and nodes of a subtree are close
+ * to each other in memory.
+ */
+static uint kdtree_balance(KDTreeNode *nodes, uint totnode, uint axis, const uint ofs)
+{
+	KDTreeNode *node;
+	uint median;
+
+	if (totnode <= 0)
+		return KD_NODE_UNSET;
+	else if (totnode == 1) {
+		nodes[0].left = nodes[0].right = KD_NODE_UNSET;
+		return 0 + ofs;
+	}
+
+	median = kdtree_partition(nodes, totnode, axis);
+
+	/* Move the median to the front, the node it replaces belongs to the
+	 * left subtree which is stored right after it. */
+	SWAP(KDTreeNode_head, *(KDTreeNode_head *)&nodes[0], *(KDTreeNode_head *)&nodes[median]);
+
 	/* set node and sort subnodes */
-	node = &nodes[median];
+	node = &nodes[0];
 	node->d = axis;
-	axis = (axis + 1) % 3;
-	node->left = kdtree_balance(nodes, median, axis, ofs);
-	node->right = kdtree_balance(nodes + median + 1, (totnode - (median + 1)), axis, (median + 1) + ofs);
 
-	return median + ofs;
+	KDTreeBalanceData data = {
+		.nodes = {nodes + 1, nodes + median + 1},
+		.totnode = {median, totnode - (median + 1)},
+		.ofs = {ofs + 1, (median + 1) + ofs},
+		.axis = (axis + 1) % 3,
+	};
+
+	if (totnode > KD_THREAD_BALANCE_THRESHOLD) {
+		ParallelRangeSettings settings;
+		BLI_parallel_range_settings_defaults(&settings);
+		settings.scheduling_mode = TASK_SCHEDULING_DYNAMIC;
+		BLI_task_parallel_range(0, 2, &data, kdtree_balance_task_cb, &settings);
+	}
+	else {
+		data.root[0] = kdtree_balance(data.nodes[0], data.totnode[0], data.axis, data.ofs[0]);
+		data.root[1] = kdtree_balance(data.nodes[1], data.totnode[1], data.axis, data.ofs[1]);
+	}
+
+	node->left = data.root[0];
+	node->right = data.root[1];
+
+	return ofs;
 }
 
 void BLI_kdtree_balance(KDTree *tree)
@@ -675,6 +743,148 @@ finally:
 		MEM_freeN(stack);
 }
 
+/* -------------------------------------------------------------------- */
+/** \name Batched Queries
+ *
+ * Run many queries on the same tree, in parallel when there are enough of them.
+ * \{ */
+
+typedef struct KDTreeBatchData {
+	const KDTree *tree;
+	const float (*co)[3];
+
+	/* Nearest. */
+	int *r_index;
+	KDTreeNearest *r_nearest;
+	int *r_found;
+	uint n;
+
+	/* Range. */
+	float range;
+	bool (*search_cb)(void *user_data, int co_index, int index, const float co[3], float dist_sq);
+	void *user_data;
+	int co_index;
+} KDTreeBatchData;
+
+static void kdtree_batch_settings(ParallelRangeSettings *settings, const int co_num)
+{
+	BLI_parallel_range_settings_defaults(settings);
+	settings->use_threading = (co_num > KD_THREAD_QUERY_THRESHOLD);
+	settings->scheduling_mode = TASK_SCHEDULING_DYNAMIC;
+}
+
+static void kdtree_find_nearest_batch_cb(
+        void *__restrict userdata,
+        const int i,
+        const ParallelRangeTLS *__restrict UNUSED(tls))
+{
+	const KDTreeBatchData *data = userdata;
+	KDTreeNearest *r_nearest = data->r_nearest ? &data->r_nearest[i] : NULL;
+	const int index = BLI_kdtree_find_nearest(data->tree, data->co[i], r_nearest);
+
+	if (data->r_index) {
+		data->r_index[i] = index;
+	}
+}
+
+/**
+ * Find the nearest point to each of \a co, see #BLI_kdtree_find_nearest.
+ *
+ * \param r_index: Optional array of \a co_num indices, -1 when no node is found.
+ * \param r_nearest: Optional array of \a co_num results.
+ */
+void BLI_kdtree_find_nearest_batch(
+        const KDTree *tree, const float (*co)[3], const int co_num,
+        int *r_index, KDTreeNearest *r_nearest)
+{
+	KDTreeBatchData data = {
+		.tree = tree,
+		.co = co,
+		.r_index = r_index,
+		.r_nearest = r_nearest,
+	};
+
+	ParallelRangeSettings settings;
+	kdtree_batch_settings(&settings, co_num);
+	BLI_task_parallel_range(0, co_num, &data, kdtree_find_nearest_batch_cb, &settings);
+}
+
+static void kdtree_find_nearest_n_batch_cb(
+        void *__restrict userdata,
+        const int i,
+        const ParallelRangeTLS *__restrict UNUSED(tls))
+{
+	const KDTreeBatchData *data = userdata;
+	data->r_found[i] = BLI_kdtree_find_nearest_n(data->tree, data->co[i], &data->r_nearest[(uint)i * data->n], data->n);
+}
+
+/**
+ * Find the \a n nearest points to each of \a co, see #BLI_kdtree_find_nearest_n.
+ *
+ * \param r_nearest: An array of \a co_num * \a n results, \a n for every query.
+ * \param r_found: An array of \a co_num numbers of points found.
+ */
+void BLI_kdtree_find_nearest_n_batch(
+        const KDTree *tree, const float (*co)[3], const int co_num,
+        KDTreeNearest *r_nearest, int *r_found, uint n)
+{
+	KDTreeBatchData data = {
+		.tree = tree,
+		.co = co,
+		.r_nearest = r_nearest,
+		.r_found = r_found,
+		.n = n,
+	};
+
+	ParallelRangeSettings settings;
+	kdtree_batch_settings(&settings, co_num);
+	BLI_task_parallel_range(0, co_num, &data, kdtree_find_nearest_n_batch_cb, &settings);
+}
+
+static bool kdtree_range_search_batch_search_cb(void *user_data, int index, const float co[3], float dist_sq)
+{
+	const KDTreeBatchData *data = user_data;
+	return data->search_cb(data->user_data, data->co_index, index, co, dist_sq);
+}
+
+static void kdtree_range_search_cb_batch_cb(
+        void *__restrict userdata,
+        const int i,
+        const ParallelRangeTLS *__restrict UNUSED(tls))
+{
+	KDTreeBatchData data = *(const KDTreeBatchData *)userdata;
+	data.co_index = i;
+	BLI_kdtree_range_search_cb(data.tree, data.co[i], data.range, kdtree_range_search_batch_search_cb, &data);
+}
+
+/**
+ * Run #BLI_kdtree_range_search_cb for each of \a co.
+ *
+ * \param search_cb: Called with the index of the query in \a co for every node found in \a range,
+ * false return value ends the search of that query.
+ *
+ * \note The callback may run from multiple threads at once.
+ */
+void BLI_kdtree_range_search_cb_batch(
+        const KDTree *tree, const float (*co)[3], const int co_num, float range,
+        bool (*search_cb)(void *user_data, int co_index, int index, const float co[3], float dist_sq),
+        void *user_data)
+{
+	KDTreeBatchData data = {
+		.tree = tree,
+		.co = co,
+		.range = range,
+		.search_cb = search_cb,
+		.user_data = user_data,
+	};
+
+	ParallelRangeSettings settings;
+	kdtree_batch_settings(&settings, co_num);
+	BLI_task_parallel_range(0, co_num, &data, kdtree_range_search_cb_batch_cb, &settings);
+}
+
+/** \} */
+
 /**
  * Use when we want to loop over nodes ordered by index.
  * Requires indices to be aligned with nodes.
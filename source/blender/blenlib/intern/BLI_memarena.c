@@ -196,3 +196,48 @@ void BLI_memarena_clear(MemArena *ma)
 #endif
 
 }
+
+/**
+ * Create an arena with the same settings as \a ma,
+ * for a thread which can't allocate from \a ma since other threads do.
+ * Merge it back into \a ma with #BLI_memarena_merge once threads are done.
+ */
+MemArena *BLI_memarena_new_thread_local(const MemArena *ma)
+{
+	MemArena *ma_local = BLI_memarena_new(ma->bufsize, ma->name);
+	ma_local->align = ma->align;
+	ma_local->use_calloc = ma->use_calloc;
+	return ma_local;
+}
+
+/**
+ * Move all buffers of \a ma_src into \a ma and free \a ma_src.
+ * Memory allocated from either arena stays valid until \a ma is cleared or freed.
+ */
+void BLI_memarena_merge(MemArena *ma, MemArena *ma_src)
+{
+	BLI_assert(ma->align == ma_src->align);
+	BLI_assert(ma->use_calloc == ma_src->use_calloc);
+
+	if (ma_src->bufs) {
+		if (ma->bufs == NULL) {
+			/* Continue allocating from the current buffer of the source. */
+			ma->bufs = ma_src->bufs;
+			ma->curbuf = ma_src->curbuf;
+			ma->cursize = ma_src->cursize;
+		}
+		else {
+			/* Keep the current buffer first, it's the one #BLI_memarena_clear keeps. */
+			LinkNode *bufs_last = ma_src->bufs;
+			while (bufs_last->next) {
+				bufs_last = bufs_last->next;
+			}
+			bufs_last->next = ma->bufs->next;
+			ma->bufs->next = ma_src->bufs;
+		}
+	}
+
+	/* Buffers are owned by 'ma' now. Allocations stay registered to
+	 * the valgrind pool of the source, so it is not destroyed. */
+	MEM_freeN(ma_src);
+}
@@ -136,6 +136,9 @@ struct BLI_mempool {
 	/* keeps aligned to 16 bits */
 
 	BLI_freenode *free;         /* free element list. Interleaved into chunk datas. */
+	/* last element of the free list (only valid while 'free' isn't NULL),
+	 * so the free list of another pool can be spliced in by #BLI_mempool_merge */
+	BLI_freenode *free_tail;
 	uint maxchunks;     /* use to know how many chunks to keep for BLI_mempool_clear */
 	uint totused;       /* number of elements currently in use */
 #ifdef USE_TOTALLOC
@@ -269,6 +272,9 @@ static BLI_freenode *mempool_chunk_add(BLI_mempool *pool, BLI_mempool_chunk *mpc
 		lasttail->next = CHUNK_DATA(mpchunk);
 	}
 
+	/* either the free list was empty or 'lasttail' was its end */
+	pool->free_tail = curnode;
+
 	return curnode;
 }
 
@@ -425,6 +431,9 @@ void BLI_mempool_free(BLI_mempool *pool, void *addr)
 		newhead->freeword = FREEWORD;
 	}
 
+	if (UNLIKELY(pool->free == NULL)) {
+		pool->free_tail = newhead;
+	}
 	newhead->next = pool->free;
 	pool->free = newhead;
 
@@ -467,6 +476,7 @@ void BLI_mempool_free(BLI_mempool *pool, void *addr)
 		}
 		curnode = NODE_STEP_PREV(curnode);
 		curnode->next = NULL; /* terminate the list */
+		pool->free_tail = curnode;
 
 #ifdef WITH_MEM_VALGRIND
 		VALGRIND_MEMPOOL_FREE(pool, CHUNK_DATA(first));
@@ -779,6 +789,62 @@ void BLI_mempool_destroy(BLI_mempool *pool)
 	MEM_freeN(pool);
 }
 
+/**
+ * Create an empty pool with the same element and chunk size as \a pool,
+ * for a thread which can't allocate from \a pool since other threads do.
+ * Merge it back into \a pool with #BLI_mempool_merge once threads are done.
+ */
+BLI_mempool *BLI_mempool_create_thread_local(const BLI_mempool *pool)
+{
+	BLI_mempool *pool_local = BLI_mempool_create(pool->esize, 0, pool->pchunk, pool->flag);
+
+	/* Chunk size is rounded when creating, make sure it matches exactly. */
+	pool_local->csize = pool->csize;
+	pool_local->pchunk = pool->pchunk;
+	pool_local->maxchunks = pool->maxchunks;
+
+	return pool_local;
+}
+
+/**
+ * Move all chunks and elements of \a pool_src into \a pool and free \a pool_src.
+ * Elements of \a pool_src stay valid, they are freed with \a pool and iterated after its own ones.
+ */
+void BLI_mempool_merge(BLI_mempool *pool, BLI_mempool *pool_src)
+{
+	BLI_assert(pool->esize == pool_src->esize);
+	BLI_assert(pool->csize == pool_src->csize);
+	BLI_assert(pool->flag == pool_src->flag);
+
+	if (pool_src->chunks) {
+		if (pool->chunks) {
+			pool->chunk_tail->next = pool_src->chunks;
+		}
+		else {
+			pool->chunks = pool_src->chunks;
+		}
+		pool->chunk_tail = pool_src->chunk_tail;
+
+		/* Free elements of the source are used first. */
+		if (pool_src->free) {
+			if (pool->free == NULL) {
+				pool->free_tail = pool_src->free_tail;
+			}
+			pool_src->free_tail->next = pool->free;
+			pool->free = pool_src->free;
+		}
+
+		pool->totused += pool_src->totused;
+#ifdef USE_TOTALLOC
+		pool->totalloc += pool_src->totalloc;
+#endif
+	}
+
+	/* Chunks are owned by 'pool' now. Elements stay registered to
+	 * the valgrind pool of the source, so it is not destroyed. */
+	MEM_freeN(pool_src);
+}
+
 #ifndef NDEBUG
 void BLI_mempool_set_memory_debug(void)
 {
@@ -103,6 +103,10 @@
  * Once a match is found, there is a high chance next chunks match too,
  * so this is checked to avoid performing so many hash-lookups.
  * Otherwise new chunks are created.
+ *
+ * New chunks have a fixed size by default. Stores created with
+ * #BLI_ARRAY_STORE_CONTENT_DEFINED_CHUNKS cut new data where a rolling hash of its bytes matches instead,
+ * so chunk boundaries move along with the content when data is inserted or removed before them.
  */
 
 #include <stdlib.h>
@@ -112,6 +116,7 @@
 
 #include "BLI_listbase.h"
 #include "BLI_mempool.h"
+#include "BLI_task.h"
 
 #include "BLI_strict_flags.h"
 
@@ -161,6 +166,9 @@
  * so 4 -> 7, 5 -> 10, 6 -> 15... etc.
  */
 #  define BCHUNK_HASH_TABLE_ACCUMULATE_STEPS 4
+/* Hash arrays of large states in parallel, in blocks of this many items.
+ */
+#  define BCHUNK_HASH_THREAD_BLOCK_LEN 65536
 #else
 /* How many items to hash (multiplied by stride)
  */
@@ -202,8 +210,20 @@
  * so lower only to check splitting works.
  */
 #  define BCHUNK_SIZE_MAX_MUL 2
+
+/* Support content defined chunk boundaries (see #BLI_ARRAY_STORE_CONTENT_DEFINED_CHUNKS),
+ * chunks are cut between the min/max chunk sizes.
+ */
+#  define USE_CONTENT_DEFINED_CHUNKS
 #endif  /* USE_MERGE_CHUNKS */
 
+#ifdef USE_CONTENT_DEFINED_CHUNKS
+/* Number of bytes the rolling hash depends on,
+ * older bytes are shifted out of its 64 bits.
+ */
+#  define BCHUNK_CDC_WINDOW 64
+#endif
+
 /* slow (keep disabled), but handy for debugging */
 // #define USE_VALIDATE_LIST_SIZE
 
@@ -235,6 +255,12 @@ typedef struct BArrayInfo {
 	size_t accum_steps;
 	size_t accum_read_ahead_len;
 #endif
+
+#ifdef USE_CONTENT_DEFINED_CHUNKS
+	/* chunks are cut where the rolling hash has none of these bits set,
+	 * zero for fixed size chunks */
+	uint64_t cdc_mask;
+#endif
 } BArrayInfo;
 
 typedef struct BArrayMemory {
@@ -640,6 +666,77 @@ static void bchunk_list_append_data(
 #endif
 }
 
+#ifdef USE_CONTENT_DEFINED_CHUNKS
+
+BLI_INLINE uint64_t cdc_hash_step(const uint64_t h, const uchar p)
+{
+	return (h << 1) + ((uint64_t)p + 1) * 0x9e3779b97f4a7c15ull;
+}
+
+/**
+ * Length of the chunk to cut from the start of \a data.
+ *
+ * Chunks end after the first item at which the rolling hash matches #BArrayInfo.cdc_mask,
+ * between the min/max chunk sizes, and never leave less than the minimum size for the next chunk.
+ */
+static size_t bchunk_cdc_len(
+        const BArrayInfo *info, const uchar *data, const size_t data_len)
+{
+	if (data_len <= info->chunk_byte_size_max) {
+		return data_len;
+	}
+
+	const size_t len_cut_max = MIN2(info->chunk_byte_size_max, data_len - info->chunk_byte_size_min);
+	uint64_t h = 0;
+	size_t i = 0;
+
+	/* Only hash the window before the first possible cut,
+	 * so the cut doesn't depend on where the chunk starts. */
+	if (info->chunk_byte_size_min > BCHUNK_CDC_WINDOW) {
+		i = info->chunk_byte_size_min - BCHUNK_CDC_WINDOW;
+	}
+	for (; i < info->chunk_byte_size_min; i++) {
+		h = cdc_hash_step(h, data[i]);
+	}
+
+	while (i < len_cut_max) {
+		for (const size_t i_end = i + info->chunk_stride; i < i_end; i++) {
+			h = cdc_hash_step(h, data[i]);
+		}
+		if ((h & info->cdc_mask) == 0) {
+			return i;
+		}
+	}
+
+	return len_cut_max;
+}
+
+/**
+ * Version of #bchunk_list_append_data_n using content defined chunk boundaries.
+ */
+static void bchunk_list_append_data_n_cdc(
+        const BArrayInfo *info, BArrayMemory *bs_mem,
+        BChunkList *chunk_list,
+        const uchar *data, const size_t data_len)
+{
+	size_t i_prev = 0;
+
+	while (i_prev != data_len) {
+		const size_t i = i_prev + bchunk_cdc_len(info, &data[i_prev], data_len - i_prev);
+		if (i_prev == 0) {
+			/* may be merged with the last chunk of the list */
+			bchunk_list_append_data(info, bs_mem, chunk_list, data, i);
+		}
+		else {
+			BChunk *chunk = bchunk_new_copydata(bs_mem, &data[i_prev], i - i_prev);
+			bchunk_list_append_only(bs_mem, chunk_list, chunk);
+		}
+		i_prev = i;
+	}
+}
+
+#endif  /* USE_CONTENT_DEFINED_CHUNKS */
+
 /**
  * Similar to #bchunk_list_append_data, but handle multiple chunks.
  * Use for adding arrays of arbitrary sized memory at once.
@@ -652,6 +749,13 @@ static void bchunk_list_append_data_n(
         BChunkList *chunk_list,
         const uchar *data, size_t data_len)
 {
+#ifdef USE_CONTENT_DEFINED_CHUNKS
+	if (info->cdc_mask != 0) {
+		bchunk_list_append_data_n_cdc(info, bs_mem, chunk_list, data, data_len);
+		return;
+	}
+#endif
+
 	size_t data_trim_len, data_last_chunk_len;
 	bchunk_list_calc_trim_len(info, data_len, &data_trim_len, &data_last_chunk_len);
 
@@ -715,6 +819,15 @@ static void bchunk_list_fill_from_array(
 {
 	BLI_assert(BLI_listbase_is_empty(&chunk_list->chunk_refs));
 
+#ifdef USE_CONTENT_DEFINED_CHUNKS
+	if (info->cdc_mask != 0) {
+		bchunk_list_append_data_n_cdc(info, bs_mem, chunk_list, data, data_len);
+		ASSERT_CHUNKLIST_SIZE(chunk_list, data_len);
+		ASSERT_CHUNKLIST_DATA(chunk_list, data);
+		return;
+	}
+#endif
+
 	size_t data_trim_len, data_last_chunk_len;
 	bchunk_list_calc_trim_len(info, data_len, &data_trim_len, &data_last_chunk_len);
 
@@ -872,6 +985,61 @@ static void hash_accum_single(hash_key *hash_array, const size_t hash_array_len,
 	}
 }
 
+typedef struct HashArrayThreadData {
+	const BArrayInfo *info;
+	const uchar *data;
+	hash_key *hash_array;
+	size_t hash_array_len;
+} HashArrayThreadData;
+
+static void hash_array_from_data_accum_block_cb(
+        void *__restrict userdata,
+        const int block,
+        const ParallelRangeTLS *__restrict UNUSED(tls))
+{
+	const HashArrayThreadData *data = userdata;
+	const BArrayInfo *info = data->info;
+	const size_t i_start = (size_t)block * BCHUNK_HASH_THREAD_BLOCK_LEN;
+	const size_t i_end = MIN2(i_start + BCHUNK_HASH_THREAD_BLOCK_LEN, data->hash_array_len);
+	/* Also hash the items accumulated into the end of this block,
+	 * so the result matches accumulating the whole array at once. */
+	const size_t i_read_end = MIN2(i_end + info->accum_read_ahead_len, data->hash_array_len);
+	const size_t block_len = i_read_end - i_start;
+
+	hash_key *hash_block = MEM_mallocN(sizeof(*hash_block) * block_len, __func__);
+	hash_array_from_data(info, &data->data[i_start * info->chunk_stride], block_len * info->chunk_stride, hash_block);
+	hash_accum(hash_block, block_len, info->accum_steps);
+	memcpy(&data->hash_array[i_start], hash_block, sizeof(*hash_block) * (i_end - i_start));
+	MEM_freeN(hash_block);
+}
+
+/**
+ * Fill \a hash_array with accumulated hashes of every item in \a data,
+ * large arrays are hashed in parallel.
+ */
+static void hash_array_from_data_accum(
+        const BArrayInfo *info, const uchar *data, const size_t hash_array_len,
+        hash_key *hash_array)
+{
+	if (hash_array_len > BCHUNK_HASH_THREAD_BLOCK_LEN) {
+		HashArrayThreadData thread_data = {
+			.info = info,
+			.data = data,
+			.hash_array = hash_array,
+			.hash_array_len = hash_array_len,
+		};
+		const int blocks_len = (int)((hash_array_len + BCHUNK_HASH_THREAD_BLOCK_LEN - 1) / BCHUNK_HASH_THREAD_BLOCK_LEN);
+
+		ParallelRangeSettings settings;
+		BLI_parallel_range_settings_defaults(&settings);
+		BLI_task_parallel_range(0, blocks_len, &thread_data, hash_array_from_data_accum_block_cb, &settings);
+	}
+	else {
+		hash_array_from_data(info, data, hash_array_len * info->chunk_stride, hash_array);
+		hash_accum(hash_array, hash_array_len, info->accum_steps);
+	}
+}
+
 static hash_key key_from_chunk_ref(
         const BArrayInfo *info, const BChunkRef *cref,
         /* avoid reallocating each time */
@@ -1212,9 +1380,7 @@ static BChunkList *bchunk_list_from_data_merge(
 		size_t i_table_start = i_prev;
 		const size_t table_hash_array_len = (data_len - i_prev) / info->chunk_stride;
 		hash_key  *table_hash_array = MEM_mallocN(sizeof(*table_hash_array) * table_hash_array_len, __func__);
-		hash_array_from_data(info, &data[i_prev], data_len - i_prev, table_hash_array);
-
-		hash_accum(table_hash_array, table_hash_array_len, info->accum_steps);
+		hash_array_from_data_accum(info, &data[i_prev], table_hash_array_len, table_hash_array);
 #else
 		/* dummy vars */
 		uint i_table_start = 0;
@@ -1423,11 +1589,16 @@ static BChunkList *bchunk_list_from_data_merge(
  * - Larger values reduce the *book keeping* overhead,
  *   but increase the chance a small, isolated change will cause a larger amount of data to be duplicated.
  *
+ * \param flag: Options, #BLI_ARRAY_STORE_CONTENT_DEFINED_CHUNKS
+ * picks chunk boundaries from the data so new chunks stay aligned with previous states
+ * when elements are inserted or removed, chunks then vary in size around \a chunk_count.
+ *
  * \return A new array store, to be freed with #BLI_array_store_destroy.
  */
-BArrayStore *BLI_array_store_create(
+BArrayStore *BLI_array_store_create_ex(
         uint stride,
-        uint chunk_count)
+        uint chunk_count,
+        const int flag)
 {
 	BArrayStore *bs = MEM_callocN(sizeof(BArrayStore), __func__);
 
@@ -1450,6 +1621,21 @@ BArrayStore *BLI_array_store_create(
 	bs->info.accum_read_ahead_bytes = BCHUNK_HASH_LEN  * stride;
 #endif
 
+#ifdef USE_CONTENT_DEFINED_CHUNKS
+	if (flag & BLI_ARRAY_STORE_CONTENT_DEFINED_CHUNKS) {
+		/* Aim for the regular chunk size on average,
+		 * cuts are tested once per item after the minimum size. */
+		const uint cut_count = MAX2(2u, chunk_count - (chunk_count / BCHUNK_SIZE_MIN_DIV));
+		uint cdc_bits = 1;
+		while ((2u << cdc_bits) <= cut_count) {
+			cdc_bits++;
+		}
+		bs->info.cdc_mask = (((uint64_t)1 << cdc_bits) - 1) << (64 - cdc_bits);
+	}
+#else
+	UNUSED_VARS(flag);
+#endif
+
 	bs->memory.chunk_list   = BLI_mempool_create(sizeof(BChunkList), 0, 512, BLI_MEMPOOL_NOP);
 	bs->memory.chunk_ref    = BLI_mempool_create(sizeof(BChunkRef),  0, 512, BLI_MEMPOOL_NOP);
 	/* allow iteration to simplify freeing, otherwise its not needed
@@ -1459,6 +1645,13 @@ BArrayStore *BLI_array_store_create(
 	return bs;
 }
 
+BArrayStore *BLI_array_store_create(
+        uint stride,
+        uint chunk_count)
+{
+	return BLI_array_store_create_ex(stride, chunk_count, 0);
+}
+
 static void array_store_free_data(BArrayStore *bs)
 {
 	/* free chunk data */
@@ -32,9 +32,13 @@
 
 #include "BLI_math_base.h"
 
-BArrayStore *BLI_array_store_at_size_ensure(
+/**
+ * \param flag: Passed to #BLI_array_store_create_ex when the store for \a stride is created,
+ * an existing store keeps the flags it was created with.
+ */
+BArrayStore *BLI_array_store_at_size_ensure_ex(
         struct BArrayStore_AtSize *bs_stride,
-        const int stride, const int chunk_size)
+        const int stride, const int chunk_size, const int flag)
 {
 	if (bs_stride->stride_table_len < stride) {
 		bs_stride->stride_table_len = stride;
@@ -56,11 +60,18 @@ BArrayStore *BLI_array_store_at_size_ensure(
 		}
 #endif
 
-		(*bs_p) = BLI_array_store_create(stride, chunk_count);
+		(*bs_p) = BLI_array_store_create_ex(stride, chunk_count, flag);
 	}
 	return *bs_p;
 }
 
+BArrayStore *BLI_array_store_at_size_ensure(
+        struct BArrayStore_AtSize *bs_stride,
+        const int stride, const int chunk_size)
+{
+	return BLI_array_store_at_size_ensure_ex(bs_stride, stride, chunk_size, 0);
+}
+
 BArrayStore *BLI_array_store_at_size_get(
         struct BArrayStore_AtSize *bs_stride,
         const int stride)
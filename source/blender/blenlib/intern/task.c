@@ -24,6 +24,7 @@
  * A generic task system which can be used for any task based subsystem.
  */
 
+#include <limits.h>
 #include <stdlib.h>
 
 #include "MEM_guardedalloc.h"
@@ -32,10 +33,13 @@
 
 #include "BLI_listbase.h"
 #include "BLI_math.h"
+#include "BLI_memarena.h"
 #include "BLI_mempool.h"
 #include "BLI_task.h"
 #include "BLI_threads.h"
 
+#include "PIL_time.h"
+
 #include "atomic_ops.h"
 
 /* Define this to enable some detailed statistic print. */
@@ -49,16 +53,19 @@
  */
 #define MEMPOOL_SIZE 256
 
-/* Number of tasks which are pushed directly to local thread queue.
- *
- * This allows thread to fetch next task without locking the whole queue.
+/* Number of tasks which fit into a queue of a single thread, must be a power
+ * of two. Once the queue is full, tasks are pushed to the scheduler's shared
+ * queue instead.
  */
-#define LOCAL_QUEUE_SIZE 1
+#define THREAD_QUEUE_SIZE 1024
+
+/* Number of task priorities, each thread has a queue per priority. */
+#define NUM_PRIORITIES 2
 
 /* Number of tasks which are allowed to be scheduled in a delayed manner.
  *
- * This allows to use less locks per graph node children schedule. More details
- * could be found at TaskThreadLocalStorage::do_delayed_push.
+ * This allows to wake up worker threads once per graph node children schedule.
+ * More details could be found at TaskThreadLocalStorage::do_delayed_push.
  */
 #define DELAYED_QUEUE_SIZE 4096
 
@@ -142,37 +149,63 @@ typedef struct TaskThreadLocalStorage {
 	 */
 	TaskMemPool task_mempool;
 
-	/* Local queue keeps thread alive by keeping small amount of tasks ready
-	 * to be picked up without causing global thread locks for synchronization.
-	 */
-	int num_local_queue;
-	Task *local_queue[LOCAL_QUEUE_SIZE];
-
 	/* Thread can be marked for delayed tasks push. This is helpful when it's
 	 * know that lots of subsequent task pushed will happen from the same thread
 	 * without "interrupting" for task execution.
 	 *
-	 * We try to accumulate as much tasks as possible in a local queue without
-	 * any locks first, and then we push all of them into a scheduler's queue
-	 * from within a single mutex lock.
+	 * We try to accumulate as much tasks as possible in a local queue first,
+	 * and then we push all of them at once, waking up sleeping worker threads
+	 * only once.
 	 */
 	bool do_delayed_push;
 	int num_delayed_queue;
 	Task *delayed_queue[DELAYED_QUEUE_SIZE];
 } TaskThreadLocalStorage;
 
+/* Work-stealing queue of a single thread, after "Dynamic Circular Work-Stealing
+ * Deque" by Chase and Lev.
+ *
+ * Only the thread owning the queue pushes and pops tasks at its bottom, so it
+ * handles the tasks it spawned itself first, while their data is still in the
+ * cache. Any other thread steals the oldest tasks from the top. None of these
+ * takes a lock, only the very last task in the queue is raced for using an
+ * atomic compare and swap.
+ */
+typedef struct TaskQueueItem {
+	Task *task;
+	/* Stored next to the task so threads looking for tasks of some pool don't
+	 * have to read memory of a task which might be done and freed already.
+	 */
+	TaskPool *pool;
+} TaskQueueItem;
+
+typedef struct TaskQueue {
+	/* Index of the oldest task, advanced by the owner and by thieves. */
+	int64_t top;
+	/* Keep top and bottom in different cache lines. */
+	char pad[64 - sizeof(int64_t)];
+	/* Index after the newest task, only changed by the owner. */
+	int64_t bottom;
+	TaskQueueItem items[THREAD_QUEUE_SIZE];
+} TaskQueue;
+
 struct TaskPool {
 	TaskScheduler *scheduler;
 
-	volatile size_t num;
+	size_t num;
 	ThreadMutex num_mutex;
 	ThreadCondition num_cond;
 
+	/* Number of threads sleeping on num_cond, and a counter which is changed
+	 * on every push so they are only woken up when there is new work.
+	 */
+	uint32_t num_waiting;
+	uint32_t push_epoch;
+
 	void *userdata;
 	ThreadMutex user_mutex;
 
 	volatile bool do_cancel;
-	volatile bool do_work;
 
 	volatile bool is_suspended;
 	ListBase suspended_queue;
@@ -210,9 +243,23 @@ struct TaskScheduler {
 	int num_threads;
 	bool background_thread_only;
 
+	/* Shared queue for the tasks which are not in a thread's queue: tasks of
+	 * background pools, tasks pushed from threads which are not part of the
+	 * scheduler and tasks which did not fit into a thread's queue.
+	 */
 	ListBase queue;
 	ThreadMutex queue_mutex;
-	ThreadCondition queue_cond;
+	volatile size_t num_queued;
+
+	/* Worker threads which found no work sleep on park_cond. Pushes only wake
+	 * them up when any are sleeping, push_epoch is changed on every push so
+	 * threads don't go to sleep when a task was pushed while they were looking
+	 * for one.
+	 */
+	ThreadMutex park_mutex;
+	ThreadCondition park_cond;
+	uint32_t num_parked;
+	uint32_t push_epoch;
 
 	volatile bool do_exit;
 
@@ -224,6 +271,7 @@ typedef struct TaskThread {
 	TaskScheduler *scheduler;
 	int id;
 	TaskThreadLocalStorage tls;
+	TaskQueue queues[NUM_PRIORITIES];
 } TaskThread;
 
 /* Helper */
@@ -326,17 +374,130 @@ static void task_free(TaskPool *pool, Task *task, const int thread_id)
 	}
 }
 
+/* Task Queue */
+
+BLI_INLINE int64_t task_queue_index_get(int64_t *index)
+{
+	return *(volatile int64_t *)index;
+}
+
+BLI_INLINE bool task_queue_is_empty(TaskQueue *queue)
+{
+	return task_queue_index_get(&queue->top) >= task_queue_index_get(&queue->bottom);
+}
+
+/* Push a task at the bottom, only called by the owner of the queue.
+ * Returns false if the queue is full. */
+static bool task_queue_push(TaskQueue *queue, Task *task)
+{
+	const int64_t bottom = queue->bottom;
+
+	/* Reading an outdated top only makes the queue look fuller. */
+	if (bottom - task_queue_index_get(&queue->top) >= THREAD_QUEUE_SIZE) {
+		return false;
+	}
+
+	TaskQueueItem *item = &queue->items[bottom & (THREAD_QUEUE_SIZE - 1)];
+	item->task = task;
+	item->pool = task->pool;
+
+	/* Atomic operation also acts as a barrier, so the item is written before
+	 * thieves can see it. */
+	atomic_add_and_fetch_int64(&queue->bottom, 1);
+
+	return true;
+}
+
+/* Pop the newest task from the bottom, only called by the owner of the queue.
+ * If pool is not NULL, only a task of that pool is taken. */
+static Task *task_queue_pop(TaskQueue *queue, TaskPool *pool)
+{
+	const int64_t bottom = queue->bottom - 1;
+	TaskQueueItem *item = &queue->items[bottom & (THREAD_QUEUE_SIZE - 1)];
+
+	if (bottom < task_queue_index_get(&queue->top)) {
+		return NULL;
+	}
+	if (pool != NULL && item->pool != pool) {
+		return NULL;
+	}
+
+	/* Reserve the task first, then see whether thieves got to it. */
+	atomic_sub_and_fetch_int64(&queue->bottom, 1);
+	const int64_t top = task_queue_index_get(&queue->top);
+	Task *task = item->task;
+
+	if (top < bottom) {
+		return task;
+	}
+
+	if (top == bottom) {
+		/* Last task in the queue, race against thieves for it. */
+		if (atomic_cas_int64(&queue->top, top, top + 1) != top) {
+			task = NULL;
+		}
+	}
+	else {
+		task = NULL;
+	}
+
+	/* Queue is empty now, top == bottom. */
+	atomic_add_and_fetch_int64(&queue->bottom, 1);
+
+	return task;
+}
+
+/* Steal the oldest task from the top, may be called by any thread.
+ * If pool is not NULL, only a task of that pool is taken. */
+static Task *task_queue_steal(TaskQueue *queue, TaskPool *pool)
+{
+	if (task_queue_is_empty(queue)) {
+		return NULL;
+	}
+
+	/* Atomic read acts as a barrier, so bottom is read after top. */
+	const int64_t top = atomic_fetch_and_add_int64(&queue->top, 0);
+	const int64_t bottom = task_queue_index_get(&queue->bottom);
+
+	if (top >= bottom) {
+		return NULL;
+	}
+
+	/* Copy the item, it might be overwritten as soon as other threads
+	 * advance top. That is detected by the compare and swap below. */
+	TaskQueueItem item = queue->items[top & (THREAD_QUEUE_SIZE - 1)];
+
+	if (pool != NULL && item.pool != pool) {
+		return NULL;
+	}
+	if (atomic_cas_int64(&queue->top, top, top + 1) != top) {
+		return NULL;
+	}
+
+	return item.task;
+}
+
 /* Task Scheduler */
 
 static void task_pool_num_decrease(TaskPool *pool, size_t done)
 {
+	/* Lock free unless this finishes the pool. */
+	size_t num = pool->num;
+	while (num > done) {
+		const size_t prev_num = atomic_cas_z(&pool->num, num, num - done);
+		if (prev_num == num) {
+			return;
+		}
+		num = prev_num;
+	}
+
+	/* Threads waiting for the pool may free it as soon as they see it's done,
+	 * so this is done under the lock they check it with. */
 	BLI_mutex_lock(&pool->num_mutex);
 
 	BLI_assert(pool->num >= done);
 
-	pool->num -= done;
-
-	if (pool->num == 0)
+	if (atomic_sub_and_fetch_z(&pool->num, done) == 0)
 		BLI_condition_notify_all(&pool->num_cond);
 
 	BLI_mutex_unlock(&pool->num_mutex);
@@ -344,82 +505,229 @@ static void task_pool_num_decrease(TaskPool *pool, size_t done)
 
 static void task_pool_num_increase(TaskPool *pool, size_t new)
 {
-	BLI_mutex_lock(&pool->num_mutex);
+	atomic_add_and_fetch_z(&pool->num, new);
+}
 
-	pool->num += new;
-	BLI_condition_notify_all(&pool->num_cond);
+/* Wake up threads waiting for the pool, after new tasks were pushed. */
+static void task_pool_wakeup(TaskPool *pool)
+{
+	atomic_add_and_fetch_uint32(&pool->push_epoch, 1);
 
-	BLI_mutex_unlock(&pool->num_mutex);
+	if (pool->num_waiting != 0) {
+		BLI_mutex_lock(&pool->num_mutex);
+		BLI_condition_notify_all(&pool->num_cond);
+		BLI_mutex_unlock(&pool->num_mutex);
+	}
+}
+
+/* Wake up sleeping worker threads, after new tasks were pushed. */
+static void task_scheduler_wakeup(TaskScheduler *scheduler, int num_tasks)
+{
+	atomic_add_and_fetch_uint32(&scheduler->push_epoch, 1);
+
+	if (scheduler->num_parked != 0) {
+		BLI_mutex_lock(&scheduler->park_mutex);
+		if (num_tasks == 1)
+			BLI_condition_notify_one(&scheduler->park_cond);
+		else
+			BLI_condition_notify_all(&scheduler->park_cond);
+		BLI_mutex_unlock(&scheduler->park_mutex);
+	}
+}
+
+/* Thread owning the queues the calling thread may push to and pop from, NULL
+ * for threads which are not part of the scheduler. */
+static TaskThread *task_scheduler_current_thread(TaskScheduler *scheduler)
+{
+	if (scheduler->background_thread_only) {
+		/* Only the shared queue is used, its tasks are picked by pool. */
+		return NULL;
+	}
+	if (BLI_thread_is_main()) {
+		return &scheduler->task_threads[0];
+	}
+	return pthread_getspecific(scheduler->tls_id_key);
 }
 
-static bool task_scheduler_thread_wait_pop(TaskScheduler *scheduler, Task **task)
+static void task_scheduler_queue(TaskScheduler *scheduler,
+                                 TaskThread *thread,
+                                 Task *task,
+                                 TaskPriority priority)
 {
-	bool found_task = false;
+	/* Background pools may never be waited for, keep their tasks where the
+	 * background thread finds them. */
+	if (thread != NULL && !task->pool->run_in_background) {
+		if (task_queue_push(&thread->queues[priority], task)) {
+			return;
+		}
+	}
+
 	BLI_mutex_lock(&scheduler->queue_mutex);
 
-	while (!scheduler->queue.first && !scheduler->do_exit)
-		BLI_condition_wait(&scheduler->queue_cond, &scheduler->queue_mutex);
+	if (priority == TASK_PRIORITY_HIGH)
+		BLI_addhead(&scheduler->queue, task);
+	else
+		BLI_addtail(&scheduler->queue, task);
+
+	scheduler->num_queued++;
 
-	do {
-		Task *current_task;
+	BLI_mutex_unlock(&scheduler->queue_mutex);
+}
 
-		/* Assuming we can only have a void queue in 'exit' case here seems logical (we should only be here after
-		 * our worker thread has been woken up from a condition_wait(), which only happens after a new task was
-		 * added to the queue), but it is wrong.
-		 * Waiting on condition may wake up the thread even if condition is not signaled (spurious wake-ups), and some
-		 * race condition may also empty the queue **after** condition has been signaled, but **before** awoken thread
-		 * reaches this point...
-		 * See http://stackoverflow.com/questions/8594591
-		 *
-		 * So we only abort here if do_exit is set.
-		 */
-		if (scheduler->do_exit) {
-			BLI_mutex_unlock(&scheduler->queue_mutex);
-			return false;
+/* Pop a task from the shared queue. If pool is NULL a task of any pool which
+ * may run on worker threads is taken, otherwise only a task of that pool. */
+static Task *task_scheduler_queue_pop(TaskScheduler *scheduler, TaskPool *pool)
+{
+	Task *task;
+
+	if (scheduler->num_queued == 0) {
+		return NULL;
+	}
+
+	BLI_mutex_lock(&scheduler->queue_mutex);
+
+	for (task = scheduler->queue.first; task; task = task->next) {
+		if (pool != NULL) {
+			if (task->pool != pool) {
+				continue;
+			}
+		}
+		else if (scheduler->background_thread_only && !task->pool->run_in_background) {
+			continue;
 		}
 
-		for (current_task = scheduler->queue.first;
-		     current_task != NULL;
-		     current_task = current_task->next)
+		BLI_remlink(&scheduler->queue, task);
+		scheduler->num_queued--;
+		break;
+	}
+
+	BLI_mutex_unlock(&scheduler->queue_mutex);
+
+	return task;
+}
+
+/* Find a task to run. Threads own queues are checked first, then the shared
+ * queue, then tasks are stolen from other threads. If pool is not NULL only
+ * tasks of that pool are taken. */
+static Task *task_scheduler_find_task(TaskScheduler *scheduler,
+                                      TaskThread *thread,
+                                      TaskPool *pool)
+{
+	Task *task;
+
+	if (thread != NULL) {
+		if ((task = task_queue_pop(&thread->queues[TASK_PRIORITY_HIGH], pool)) ||
+		    (task = task_queue_pop(&thread->queues[TASK_PRIORITY_LOW], pool)))
 		{
-			TaskPool *pool = current_task->pool;
+			return task;
+		}
+	}
 
-			if (scheduler->background_thread_only && !pool->run_in_background) {
-				continue;
+	if ((task = task_scheduler_queue_pop(scheduler, pool))) {
+		return task;
+	}
+
+	if (scheduler->background_thread_only) {
+		return NULL;
+	}
+
+	/* Start with the next thread, so thieves spread over all victims. The
+	 * thread's own queue comes last, a pool's task may be on top of it. */
+	const int num_queues = scheduler->num_threads + 1;
+	const int start = (thread != NULL) ? thread->id + 1 : 0;
+
+	for (int priority = TASK_PRIORITY_HIGH; priority >= TASK_PRIORITY_LOW; priority--) {
+		for (int i = 0; i < num_queues; i++) {
+			TaskThread *victim = &scheduler->task_threads[(start + i) % num_queues];
+			if ((task = task_queue_steal(&victim->queues[priority], pool))) {
+				return task;
 			}
+		}
+	}
 
-			*task = current_task;
-			found_task = true;
-			BLI_remlink(&scheduler->queue, *task);
-			break;
+	return NULL;
+}
+
+/* Move all tasks from the thread's own queues to the shared queue, returns
+ * false if there were none.
+ *
+ * Used before a thread goes to sleep waiting for a pool. Tasks of other pools
+ * which are left in its queues could otherwise only be stolen in order, and a
+ * task of the pool which is waited for might be stuck behind them. */
+static bool task_scheduler_queue_flush(TaskScheduler *scheduler, TaskThread *thread)
+{
+	if (task_queue_is_empty(&thread->queues[TASK_PRIORITY_HIGH]) &&
+	    task_queue_is_empty(&thread->queues[TASK_PRIORITY_LOW]))
+	{
+		return false;
+	}
+
+	int num_tasks = 0;
+
+	BLI_mutex_lock(&scheduler->queue_mutex);
+
+	for (int priority = TASK_PRIORITY_LOW; priority <= TASK_PRIORITY_HIGH; priority++) {
+		TaskQueue *queue = &thread->queues[priority];
+		Task *task, *prev_task = NULL;
+
+		/* Tasks are popped newest first, keep them in order of pushing. */
+		while ((task = task_queue_pop(queue, NULL))) {
+			if (priority == TASK_PRIORITY_HIGH)
+				BLI_addhead(&scheduler->queue, task);
+			else if (prev_task != NULL)
+				BLI_insertlinkbefore(&scheduler->queue, prev_task, task);
+			else
+				BLI_addtail(&scheduler->queue, task);
+
+			prev_task = task;
+			num_tasks++;
 		}
-		if (!found_task)
-			BLI_condition_wait(&scheduler->queue_cond, &scheduler->queue_mutex);
-	} while (!found_task);
+	}
+
+	scheduler->num_queued += num_tasks;
 
 	BLI_mutex_unlock(&scheduler->queue_mutex);
 
+	if (num_tasks == 0) {
+		return false;
+	}
+
+	task_scheduler_wakeup(scheduler, num_tasks);
+
 	return true;
 }
 
-BLI_INLINE void handle_local_queue(TaskThreadLocalStorage *tls,
-                                   const int thread_id)
+static bool task_scheduler_thread_wait_pop(TaskScheduler *scheduler,
+                                           TaskThread *thread,
+                                           Task **task)
 {
-	BLI_assert(!tls->do_delayed_push);
-	while (tls->num_local_queue > 0) {
-		/* We pop task from queue before handling it so handler of the task can
-		 * push next job to the local queue.
-		 */
-		tls->num_local_queue--;
-		Task *local_task = tls->local_queue[tls->num_local_queue];
-		/* TODO(sergey): Double-check work_and_wait() doesn't handle other's
-		 * pool tasks.
-		 */
-		TaskPool *local_pool = local_task->pool;
-		local_task->run(local_pool, local_task->taskdata, thread_id);
-		task_free(local_pool, local_task, thread_id);
+	if (scheduler->background_thread_only) {
+		thread = NULL;
+	}
+
+	while (true) {
+		/* Atomic read acts as a barrier, any task pushed before the epoch was
+		 * changed is found below. */
+		const uint32_t push_epoch = atomic_fetch_and_add_uint32(&scheduler->push_epoch, 0);
+
+		if (scheduler->do_exit) {
+			return false;
+		}
+
+		if ((*task = task_scheduler_find_task(scheduler, thread, NULL))) {
+			return true;
+		}
+
+		/* Nothing to do, sleep unless something was pushed meanwhile. */
+		BLI_mutex_lock(&scheduler->park_mutex);
+		atomic_add_and_fetch_uint32(&scheduler->num_parked, 1);
+
+		if (push_epoch == scheduler->push_epoch && !scheduler->do_exit)
+			BLI_condition_wait(&scheduler->park_cond, &scheduler->park_mutex);
+
+		atomic_sub_and_fetch_uint32(&scheduler->num_parked, 1);
+		BLI_mutex_unlock(&scheduler->park_mutex);
 	}
-	BLI_assert(!tls->do_delayed_push);
 }
 
 static void *task_scheduler_thread_run(void *thread_p)
@@ -432,21 +740,22 @@ static void *task_scheduler_thread_run(void *thread_p)
 
 	pthread_setspecific(scheduler->tls_id_key, thread);
 
+	UNUSED_VARS_NDEBUG(tls);
+
 	/* keep popping off tasks */
-	while (task_scheduler_thread_wait_pop(scheduler, &task)) {
+	while (task_scheduler_thread_wait_pop(scheduler, thread, &task)) {
 		TaskPool *pool = task->pool;
 
-		/* run task */
-		BLI_assert(!tls->do_delayed_push);
-		task->run(pool, task->taskdata, thread_id);
-		BLI_assert(!tls->do_delayed_push);
+		/* run task, unless its pool is being canceled */
+		if (!pool->do_cancel) {
+			BLI_assert(!tls->do_delayed_push);
+			task->run(pool, task->taskdata, thread_id);
+			BLI_assert(!tls->do_delayed_push);
+		}
 
 		/* delete task */
 		task_free(pool, task, thread_id);
 
-		/* Handle all tasks from local queue. */
-		handle_local_queue(tls, thread_id);
-
 		/* notify pool task was done */
 		task_pool_num_decrease(pool, 1);
 	}
@@ -464,7 +773,9 @@ TaskScheduler *BLI_task_scheduler_create(int num_threads)
 
 	BLI_listbase_clear(&scheduler->queue);
 	BLI_mutex_init(&scheduler->queue_mutex);
-	BLI_condition_init(&scheduler->queue_cond);
+
+	BLI_mutex_init(&scheduler->park_mutex);
+	BLI_condition_init(&scheduler->park_cond);
 
 	if (num_threads == 0) {
 		/* automatic number of threads will be main thread + num cores */
@@ -480,7 +791,8 @@ TaskScheduler *BLI_task_scheduler_create(int num_threads)
 		num_threads = 1;
 	}
 
-	scheduler->task_threads = MEM_mallocN(sizeof(TaskThread) * (num_threads + 1),
+	/* Queues of all threads start empty. */
+	scheduler->task_threads = MEM_callocN(sizeof(TaskThread) * (num_threads + 1),
 	                                      "TaskScheduler task threads");
 
 	/* Initialize TLS for main thread. */
@@ -515,10 +827,11 @@ void BLI_task_scheduler_free(TaskScheduler *scheduler)
 	Task *task;
 
 	/* stop all waiting threads */
-	BLI_mutex_lock(&scheduler->queue_mutex);
+	BLI_mutex_lock(&scheduler->park_mutex);
 	scheduler->do_exit = true;
-	BLI_condition_notify_all(&scheduler->queue_cond);
-	BLI_mutex_unlock(&scheduler->queue_mutex);
+	atomic_add_and_fetch_uint32(&scheduler->push_epoch, 1);
+	BLI_condition_notify_all(&scheduler->park_cond);
+	BLI_mutex_unlock(&scheduler->park_mutex);
 
 	pthread_key_delete(scheduler->tls_id_key);
 
@@ -537,8 +850,17 @@ void BLI_task_scheduler_free(TaskScheduler *scheduler)
 	/* Delete task thread data */
 	if (scheduler->task_threads) {
 		for (int i = 0; i < scheduler->num_threads + 1; ++i) {
-			TaskThreadLocalStorage *tls = &scheduler->task_threads[i].tls;
-			free_task_tls(tls);
+			TaskThread *thread = &scheduler->task_threads[i];
+
+			/* delete leftover tasks */
+			for (int priority = 0; priority < NUM_PRIORITIES; priority++) {
+				while ((task = task_queue_pop(&thread->queues[priority], NULL))) {
+					task_data_free(task, 0);
+					MEM_freeN(task);
+				}
+			}
+
+			free_task_tls(&thread->tls);
 		}
 
 		MEM_freeN(scheduler->task_threads);
@@ -552,7 +874,8 @@ void BLI_task_scheduler_free(TaskScheduler *scheduler)
 
 	/* delete mutex/condition */
 	BLI_mutex_end(&scheduler->queue_mutex);
-	BLI_condition_end(&scheduler->queue_cond);
+	BLI_mutex_end(&scheduler->park_mutex);
+	BLI_condition_end(&scheduler->park_cond);
 
 	MEM_freeN(scheduler);
 }
@@ -564,18 +887,18 @@ int BLI_task_scheduler_num_threads(TaskScheduler *scheduler)
 
 static void task_scheduler_push(TaskScheduler *scheduler, Task *task, TaskPriority priority)
 {
-	task_pool_num_increase(task->pool, 1);
+	TaskPool *pool = task->pool;
 
-	/* add task to queue */
-	BLI_mutex_lock(&scheduler->queue_mutex);
+	/* Keep the pool busy until waiting threads were woken up, the task could
+	 * be done and the pool freed before that otherwise. */
+	task_pool_num_increase(pool, 2);
 
-	if (priority == TASK_PRIORITY_HIGH)
-		BLI_addhead(&scheduler->queue, task);
-	else
-		BLI_addtail(&scheduler->queue, task);
+	task_scheduler_queue(scheduler, task_scheduler_current_thread(scheduler), task, priority);
 
-	BLI_condition_notify_one(&scheduler->queue_cond);
-	BLI_mutex_unlock(&scheduler->queue_mutex);
+	task_scheduler_wakeup(scheduler, 1);
+	task_pool_wakeup(pool);
+
+	task_pool_num_decrease(pool, 1);
 }
 
 static void task_scheduler_push_all(TaskScheduler *scheduler,
@@ -587,16 +910,19 @@ static void task_scheduler_push_all(TaskScheduler *scheduler,
 		return;
 	}
 
-	task_pool_num_increase(pool, num_tasks);
+	TaskThread *thread = task_scheduler_current_thread(scheduler);
 
-	BLI_mutex_lock(&scheduler->queue_mutex);
+	task_pool_num_increase(pool, num_tasks + 1);
 
-	for (int i = 0; i < num_tasks; i++) {
-		BLI_addhead(&scheduler->queue, tasks[i]);
+	/* Push in reverse, so the owner pops them in the original order. */
+	for (int i = num_tasks - 1; i >= 0; i--) {
+		task_scheduler_queue(scheduler, thread, tasks[i], TASK_PRIORITY_HIGH);
 	}
 
-	BLI_condition_notify_all(&scheduler->queue_cond);
-	BLI_mutex_unlock(&scheduler->queue_mutex);
+	task_scheduler_wakeup(scheduler, num_tasks);
+	task_pool_wakeup(pool);
+
+	task_pool_num_decrease(pool, 1);
 }
 
 static void task_scheduler_clear(TaskScheduler *scheduler, TaskPool *pool)
@@ -614,6 +940,7 @@ static void task_scheduler_clear(TaskScheduler *scheduler, TaskPool *pool)
 			task_data_free(task, pool->thread_id);
 			BLI_freelinkN(&scheduler->queue, task);
 
+			scheduler->num_queued--;
 			done++;
 		}
 	}
@@ -621,7 +948,9 @@ static void task_scheduler_clear(TaskScheduler *scheduler, TaskPool *pool)
 	BLI_mutex_unlock(&scheduler->queue_mutex);
 
 	/* notify done */
-	task_pool_num_decrease(pool, done);
+	if (done > 0) {
+		task_pool_num_decrease(pool, done);
+	}
 }
 
 /* Task Pool */
@@ -647,8 +976,9 @@ static TaskPool *task_pool_create_ex(TaskScheduler *scheduler,
 
 	pool->scheduler = scheduler;
 	pool->num = 0;
+	pool->num_waiting = 0;
+	pool->push_epoch = 0;
 	pool->do_cancel = false;
-	pool->do_work = false;
 	pool->is_suspended = is_suspended;
 	pool->num_suspended = 0;
 	pool->suspended_queue.first = pool->suspended_queue.last = NULL;
@@ -766,11 +1096,6 @@ void BLI_task_pool_free(TaskPool *pool)
 	BLI_threaded_malloc_end();
 }
 
-BLI_INLINE bool task_can_use_local_queues(TaskPool *pool, int thread_id)
-{
-	return (thread_id != -1 && (thread_id != pool->thread_id || pool->do_work));
-}
-
 static void task_pool_push(
         TaskPool *pool, TaskRunFunction run, void *taskdata,
         bool free_taskdata, TaskFreeFunction freedata, TaskPriority priority,
@@ -794,30 +1119,20 @@ static void task_pool_push(
 		atomic_fetch_and_add_z(&pool->num_suspended, 1);
 		return;
 	}
-	/* Populate to any local queue first, this is cheapest push ever. */
-	if (task_can_use_local_queues(pool, thread_id)) {
+	/* If we are in the delayed tasks push mode, we push tasks to a
+	 * temporary local queue first, and then push all of them at once.
+	 */
+	if (thread_id != -1) {
 		ASSERT_THREAD_ID(pool->scheduler, thread_id);
 		TaskThreadLocalStorage *tls = get_task_tls(pool, thread_id);
-		/* Try to push to a local execution queue.
-		 * These tasks will be picked up next.
-		 */
-		if (tls->num_local_queue < LOCAL_QUEUE_SIZE) {
-			tls->local_queue[tls->num_local_queue] = task;
-			tls->num_local_queue++;
-			return;
-		}
-		/* If we are in the delayed tasks push mode, we push tasks to a
-		 * temporary local queue first without any locks, and then move them
-		 * to global execution queue with a single lock.
-		 */
 		if (tls->do_delayed_push && tls->num_delayed_queue < DELAYED_QUEUE_SIZE) {
 			tls->delayed_queue[tls->num_delayed_queue] = task;
 			tls->num_delayed_queue++;
 			return;
 		}
 	}
-	/* Do push to a global execution ppol, slowest possible method,
-	 * causes quite reasonable amount of threading overhead.
+	/* Push to the queue of the calling thread, or to the shared one when it's
+	 * not part of the scheduler.
 	 */
 	task_scheduler_push(pool->scheduler, task, priority);
 }
@@ -841,79 +1156,82 @@ void BLI_task_pool_push_from_thread(TaskPool *pool, TaskRunFunction run,
 	task_pool_push(pool, run, taskdata, free_taskdata, NULL, priority, thread_id);
 }
 
-void BLI_task_pool_work_and_wait(TaskPool *pool)
+/* Run tasks of the pool from the calling thread until all of them are done.
+ * When canceling, tasks are discarded instead of run. */
+static void task_pool_work_until_done(TaskPool *pool, TaskThread *thread, const bool do_cancel)
 {
-	TaskThreadLocalStorage *tls = get_task_tls(pool, pool->thread_id);
 	TaskScheduler *scheduler = pool->scheduler;
 
-	if (atomic_fetch_and_and_uint8((uint8_t *)&pool->is_suspended, 0)) {
-		if (pool->num_suspended) {
-			task_pool_num_increase(pool, pool->num_suspended);
-			BLI_mutex_lock(&scheduler->queue_mutex);
+	while (true) {
+		/* Atomic read acts as a barrier, any task pushed before the epoch was
+		 * changed is found below. */
+		const uint32_t push_epoch = atomic_fetch_and_add_uint32(&pool->push_epoch, 0);
+		Task *task = task_scheduler_find_task(scheduler, thread, pool);
 
-			BLI_movelisttolist(&scheduler->queue, &pool->suspended_queue);
+		if (task != NULL) {
+			if (do_cancel) {
+				task_data_free(task, pool->thread_id);
+				MEM_freeN(task);
+			}
+			else {
+				TaskThreadLocalStorage *tls = get_task_tls(pool, pool->thread_id);
+				BLI_assert(!tls->do_delayed_push);
+				task->run(pool, task->taskdata, pool->thread_id);
+				BLI_assert(!tls->do_delayed_push);
+				UNUSED_VARS_NDEBUG(tls);
+
+				task_free(pool, task, pool->thread_id);
+			}
 
-			BLI_condition_notify_all(&scheduler->queue_cond);
-			BLI_mutex_unlock(&scheduler->queue_mutex);
+			task_pool_num_decrease(pool, 1);
+			continue;
 		}
-	}
 
-	pool->do_work = true;
+		if (thread != NULL && task_scheduler_queue_flush(scheduler, thread)) {
+			continue;
+		}
 
-	ASSERT_THREAD_ID(pool->scheduler, pool->thread_id);
+		/* Wait for other threads to finish tasks of the pool, or push new ones. */
+		BLI_mutex_lock(&pool->num_mutex);
 
-	BLI_mutex_lock(&pool->num_mutex);
+		if (pool->num == 0) {
+			BLI_mutex_unlock(&pool->num_mutex);
+			break;
+		}
 
-	while (pool->num != 0) {
-		Task *task, *work_task = NULL;
-		bool found_task = false;
+		atomic_add_and_fetch_uint32(&pool->num_waiting, 1);
+		if (push_epoch == pool->push_epoch)
+			BLI_condition_wait(&pool->num_cond, &pool->num_mutex);
+		atomic_sub_and_fetch_uint32(&pool->num_waiting, 1);
 
 		BLI_mutex_unlock(&pool->num_mutex);
+	}
+}
 
-		BLI_mutex_lock(&scheduler->queue_mutex);
-
-		/* find task from this pool. if we get a task from another pool,
-		 * we can get into deadlock */
-
-		for (task = scheduler->queue.first; task; task = task->next) {
-			if (task->pool == pool) {
-				work_task = task;
-				found_task = true;
-				BLI_remlink(&scheduler->queue, task);
-				break;
-			}
-		}
-
-		BLI_mutex_unlock(&scheduler->queue_mutex);
+void BLI_task_pool_work_and_wait(TaskPool *pool)
+{
+	TaskScheduler *scheduler = pool->scheduler;
+	TaskThread *thread = task_scheduler_current_thread(scheduler);
 
-		/* if found task, do it, otherwise wait until other tasks are done */
-		if (found_task) {
-			/* run task */
-			BLI_assert(!tls->do_delayed_push);
-			work_task->run(pool, work_task->taskdata, pool->thread_id);
-			BLI_assert(!tls->do_delayed_push);
+	if (atomic_fetch_and_and_uint8((uint8_t *)&pool->is_suspended, 0)) {
+		if (pool->num_suspended) {
+			Task *task, *nexttask;
 
-			/* delete task */
-			task_free(pool, task, pool->thread_id);
+			task_pool_num_increase(pool, pool->num_suspended);
 
-			/* Handle all tasks from local queue. */
-			handle_local_queue(tls, pool->thread_id);
+			for (task = pool->suspended_queue.first; task; task = nexttask) {
+				nexttask = task->next;
+				task_scheduler_queue(scheduler, thread, task, TASK_PRIORITY_LOW);
+			}
+			BLI_listbase_clear(&pool->suspended_queue);
 
-			/* notify pool task was done */
-			task_pool_num_decrease(pool, 1);
+			task_scheduler_wakeup(scheduler, (int)pool->num_suspended);
 		}
-
-		BLI_mutex_lock(&pool->num_mutex);
-		if (pool->num == 0)
-			break;
-
-		if (!found_task)
-			BLI_condition_wait(&pool->num_cond, &pool->num_mutex);
 	}
 
-	BLI_mutex_unlock(&pool->num_mutex);
+	ASSERT_THREAD_ID(pool->scheduler, pool->thread_id);
 
-	handle_local_queue(tls, pool->thread_id);
+	task_pool_work_until_done(pool, thread, false);
 }
 
 void BLI_task_pool_cancel(TaskPool *pool)
@@ -922,11 +1240,8 @@ void BLI_task_pool_cancel(TaskPool *pool)
 
 	task_scheduler_clear(pool->scheduler, pool);
 
-	/* wait until all entries are cleared */
-	BLI_mutex_lock(&pool->num_mutex);
-	while (pool->num)
-		BLI_condition_wait(&pool->num_cond, &pool->num_mutex);
-	BLI_mutex_unlock(&pool->num_mutex);
+	/* Discard queued tasks and wait until running ones are done. */
+	task_pool_work_until_done(pool, task_scheduler_current_thread(pool->scheduler), true);
 
 	pool->do_cancel = false;
 }
@@ -948,7 +1263,7 @@ ThreadMutex *BLI_task_pool_user_mutex(TaskPool *pool)
 
 void BLI_task_pool_delayed_push_begin(TaskPool *pool, int thread_id)
 {
-	if (task_can_use_local_queues(pool, thread_id)) {
+	if (thread_id != -1) {
 		ASSERT_THREAD_ID(pool->scheduler, thread_id);
 		TaskThreadLocalStorage *tls = get_task_tls(pool, thread_id);
 		tls->do_delayed_push = true;
@@ -957,7 +1272,7 @@ void BLI_task_pool_delayed_push_begin(TaskPool *pool, int thread_id)
 
 void BLI_task_pool_delayed_push_end(TaskPool *pool, int thread_id)
 {
-	if (task_can_use_local_queues(pool, thread_id)) {
+	if (thread_id != -1) {
 		ASSERT_THREAD_ID(pool->scheduler, thread_id);
 		TaskThreadLocalStorage *tls = get_task_tls(pool, thread_id);
 		BLI_assert(tls->do_delayed_push);
@@ -989,42 +1304,210 @@ void BLI_task_pool_delayed_push_end(TaskPool *pool, int thread_id)
 #define MALLOCA(_size) ((_size) <= 8192) ? alloca((_size)) : MEM_mallocN((_size), __func__)
 #define MALLOCA_FREE(_mem, _size) if (((_mem) != NULL) && ((_size) > 8192)) MEM_freeN((_mem))
 
+/* Ranges are split lazily: a task starts with the whole range and splits off
+ * the upper half of what is left only when other threads ask for work, that is
+ * when they stole everything from its thread's queue. Between these checks
+ * iterations run in chunks, with the chunk size following the measured cost of
+ * iterations, so cheap iterations are not slowed down by checks and expensive
+ * ones do not keep other threads waiting for a split. */
+
+/* Time in seconds a chunk of iterations is aimed to take. */
+#define RANGE_CHUNK_TIME 2e-5
+
+/* Arenas and pools of the threads of a parallel loop, created when the thread
+ * first runs iterations of the loop, merged into the caller's ones at the end. */
+typedef struct ParallelThreadAllocators {
+	MemArena *memarena;
+	BLI_mempool *mempool;
+	MemArena **thread_memarenas;
+	BLI_mempool **thread_mempools;
+} ParallelThreadAllocators;
+
+static void parallel_thread_allocators_init(
+        ParallelThreadAllocators *allocators,
+        MemArena *memarena, BLI_mempool *mempool,
+        const int num_threads)
+{
+	allocators->memarena = memarena;
+	allocators->mempool = mempool;
+	allocators->thread_memarenas = (memarena != NULL) ?
+	        MEM_callocN(sizeof(MemArena *) * (size_t)num_threads, "thread_memarenas") : NULL;
+	allocators->thread_mempools = (mempool != NULL) ?
+	        MEM_callocN(sizeof(BLI_mempool *) * (size_t)num_threads, "thread_mempools") : NULL;
+}
+
+static void parallel_thread_allocators_merge(
+        ParallelThreadAllocators *allocators,
+        const int num_threads)
+{
+	int i;
+
+	if (allocators->thread_memarenas != NULL) {
+		for (i = 0; i < num_threads; i++) {
+			if (allocators->thread_memarenas[i] != NULL) {
+				BLI_memarena_merge(allocators->memarena, allocators->thread_memarenas[i]);
+			}
+		}
+		MEM_freeN(allocators->thread_memarenas);
+		allocators->thread_memarenas = NULL;
+	}
+	if (allocators->thread_mempools != NULL) {
+		for (i = 0; i < num_threads; i++) {
+			if (allocators->thread_mempools[i] != NULL) {
+				BLI_mempool_merge(allocators->mempool, allocators->thread_mempools[i]);
+			}
+		}
+		MEM_freeN(allocators->thread_mempools);
+		allocators->thread_mempools = NULL;
+	}
+}
+
+BLI_INLINE MemArena *parallel_thread_memarena_get(ParallelThreadAllocators *allocators, const int thread_id)
+{
+	if (allocators->thread_memarenas == NULL) {
+		return NULL;
+	}
+	if (allocators->thread_memarenas[thread_id] == NULL) {
+		allocators->thread_memarenas[thread_id] = BLI_memarena_new_thread_local(allocators->memarena);
+	}
+	return allocators->thread_memarenas[thread_id];
+}
+
+BLI_INLINE BLI_mempool *parallel_thread_mempool_get(ParallelThreadAllocators *allocators, const int thread_id)
+{
+	if (allocators->thread_mempools == NULL) {
+		return NULL;
+	}
+	if (allocators->thread_mempools[thread_id] == NULL) {
+		allocators->thread_mempools[thread_id] = BLI_mempool_create_thread_local(allocators->mempool);
+	}
+	return allocators->thread_mempools[thread_id];
+}
+
 typedef struct ParallelRangeState {
-	int start, stop;
 	void *userdata;
 
 	TaskParallelRangeFunc func;
 
-	int iter;
-	int chunk_size;
+	/* Ranges are not split into parts smaller than this. */
+	int grain_size;
+	/* Split down to grain size right away, instead of on demand. */
+	bool use_eager_split;
+
+	/* Copies of the user chunk, one per thread, made when the thread first
+	 * runs iterations of the range. */
+	void *userdata_chunk;
+	size_t userdata_chunk_size;
+	char *userdata_chunk_array;
+	bool *userdata_chunk_used;
+
+	ParallelThreadAllocators allocators;
 } ParallelRangeState;
 
-BLI_INLINE bool parallel_range_next_iter_get(
-        ParallelRangeState * __restrict state,
-        int * __restrict iter, int * __restrict count)
+typedef struct ParallelRangeTask {
+	int start, stop;
+} ParallelRangeTask;
+
+static void parallel_range_func(TaskPool * __restrict pool, void *taskdata, int thread_id);
+
+static void parallel_range_push(TaskPool *pool, const int start, const int stop, const int thread_id)
+{
+	ParallelRangeTask *range = MEM_mallocN(sizeof(*range), "ParallelRangeTask");
+	range->start = start;
+	range->stop = stop;
+
+	BLI_task_pool_push_from_thread(pool,
+	                               parallel_range_func,
+	                               range, true,
+	                               TASK_PRIORITY_HIGH,
+	                               thread_id);
+}
+
+/* Other threads ran out of work if they took all tasks the calling thread
+ * pushed before. Threads outside of the scheduler push to the shared queue. */
+BLI_INLINE bool parallel_range_need_split(TaskScheduler *scheduler, TaskThread *thread)
 {
-	int previter = atomic_fetch_and_add_int32(&state->iter, state->chunk_size);
+	if (thread != NULL) {
+		return task_queue_is_empty(&thread->queues[TASK_PRIORITY_HIGH]);
+	}
+	return scheduler->num_queued == 0;
+}
 
-	*iter = previter;
-	*count = max_ii(0, min_ii(state->chunk_size, state->stop - previter));
+/* Only one thread at a time runs tasks with the same thread ID, so it is the
+ * only one accessing its copy while the range is processed. */
+BLI_INLINE void *parallel_range_userdata_chunk_get(ParallelRangeState *state, const int thread_id)
+{
+	if (state->userdata_chunk_array == NULL) {
+		return NULL;
+	}
+
+	void *userdata_chunk_local = state->userdata_chunk_array + state->userdata_chunk_size * thread_id;
+
+	if (!state->userdata_chunk_used[thread_id]) {
+		memcpy(userdata_chunk_local, state->userdata_chunk, state->userdata_chunk_size);
+		state->userdata_chunk_used[thread_id] = true;
+	}
 
-	return (previter < state->stop);
+	return userdata_chunk_local;
 }
 
 static void parallel_range_func(
         TaskPool * __restrict pool,
-        void *userdata_chunk,
+        void *taskdata,
         int thread_id)
 {
 	ParallelRangeState * __restrict state = BLI_task_pool_userdata(pool);
+	const ParallelRangeTask *range = taskdata;
+	TaskScheduler *scheduler = pool->scheduler;
+	TaskThread *thread = task_scheduler_current_thread(scheduler);
 	ParallelRangeTLS tls = {
 		.thread_id = thread_id,
-		.userdata_chunk = userdata_chunk,
+		.userdata_chunk = parallel_range_userdata_chunk_get(state, thread_id),
+		.memarena = parallel_thread_memarena_get(&state->allocators, thread_id),
+		.mempool = parallel_thread_mempool_get(&state->allocators, thread_id),
 	};
-	int iter, count;
-	while (parallel_range_next_iter_get(state, &iter, &count)) {
-		for (int i = 0; i < count; ++i) {
-			state->func(state->userdata, iter + i, &tls);
+	int start = range->start, stop = range->stop;
+	int chunk_size = state->grain_size;
+
+	while (start < stop) {
+		/* Hand the upper half over to other threads. Pushing it fills the
+		 * queue again, so lazy splitting stops until the half was stolen. */
+		while (stop - start >= state->grain_size * 2 &&
+		       (state->use_eager_split || parallel_range_need_split(scheduler, thread)))
+		{
+			const int mid = start + (stop - start) / 2;
+			parallel_range_push(pool, mid, stop, thread_id);
+			stop = mid;
+		}
+
+		if (state->use_eager_split) {
+			for (int i = start; i < stop; ++i) {
+				state->func(state->userdata, i, &tls);
+			}
+			break;
+		}
+
+		const int chunk_stop = (stop - start > chunk_size) ? start + chunk_size : stop;
+		const double time_start = PIL_check_seconds_timer();
+
+		for (int i = start; i < chunk_stop; ++i) {
+			state->func(state->userdata, i, &tls);
+		}
+
+		const double time = PIL_check_seconds_timer() - time_start;
+		const int count = chunk_stop - start;
+		start = chunk_stop;
+
+		/* Size the next chunk after the cost of iterations so far. Growth is
+		 * limited, the first iterations of a range may be cheaper than the
+		 * rest, shrinking is not. */
+		const int chunk_size_max = (chunk_size < INT_MAX / 2) ? chunk_size * 2 : INT_MAX;
+		if (time * 2.0 < RANGE_CHUNK_TIME) {
+			chunk_size = chunk_size_max;
+		}
+		else {
+			const double chunk_size_fit = RANGE_CHUNK_TIME * count / time;
+			chunk_size = (chunk_size_fit < chunk_size_max) ? max_ii(1, (int)chunk_size_fit) : chunk_size_max;
 		}
 	}
 }
@@ -1045,6 +1528,8 @@ static void palallel_range_single_thread(const int start, int const stop,
 	ParallelRangeTLS tls = {
 		.thread_id = 0,
 		.userdata_chunk = userdata_chunk_local,
+		.memarena = settings->memarena,
+		.mempool = settings->mempool,
 	};
 	for (int i = start; i < stop; ++i) {
 		func(userdata, i, &tls);
@@ -1058,6 +1543,9 @@ static void palallel_range_single_thread(const int start, int const stop,
 /**
  * This function allows to parallelized for loops in a similar way to OpenMP's 'parallel for' statement.
  *
+ * It may be called from tasks, including iterations of another parallel range. The calling thread
+ * then works on the nested range, while idle threads of the scheduler help out.
+ *
  * See public API doc of ParallelRangeSettings for description of all settings.
  */
 void BLI_task_parallel_range(const int start, const int stop,
@@ -1068,11 +1556,10 @@ void BLI_task_parallel_range(const int start, const int stop,
 	TaskScheduler *task_scheduler;
 	TaskPool *task_pool;
 	ParallelRangeState state;
-	int i, num_threads, num_tasks;
+	int i, num_threads;
 
 	void *userdata_chunk = settings->userdata_chunk;
 	const size_t userdata_chunk_size = settings->userdata_chunk_size;
-	void *userdata_chunk_local = NULL;
 	void *userdata_chunk_array = NULL;
 	const bool use_userdata_chunk = (userdata_chunk_size != 0) && (userdata_chunk != NULL);
 
@@ -1099,33 +1586,23 @@ void BLI_task_parallel_range(const int start, const int stop,
 	task_scheduler = BLI_task_scheduler_get();
 	num_threads = BLI_task_scheduler_num_threads(task_scheduler);
 
-	/* The idea here is to prevent creating task for each of the loop iterations
-	 * and instead have tasks which are evenly distributed across CPU cores and
-	 * pull next iter to be crunched using the queue.
-	 */
-	num_tasks = num_threads + 2;
-
-	state.start = start;
-	state.stop = stop;
 	state.userdata = userdata;
 	state.func = func;
-	state.iter = start;
 	switch (settings->scheduling_mode) {
 		case TASK_SCHEDULING_STATIC:
-			state.chunk_size = max_ii(
-			        settings->min_iter_per_thread,
-			        (stop - start) / (num_tasks));
+			/* Between one and two parts of equal size per thread. */
+			state.grain_size = max_iii(1,
+			                           settings->min_iter_per_thread,
+			                           (stop - start) / (num_threads * 2));
+			state.use_eager_split = true;
 			break;
 		case TASK_SCHEDULING_DYNAMIC:
-			/* TODO(sergey): Make it configurable from min_iter_per_thread. */
-			state.chunk_size = 32;
+			state.grain_size = max_ii(1, settings->min_iter_per_thread);
+			state.use_eager_split = false;
 			break;
 	}
 
-	num_tasks = min_ii(num_tasks,
-	                   max_ii(1, (stop - start) / state.chunk_size));
-
-	if (num_tasks == 1) {
+	if (stop - start < state.grain_size * 2) {
 		palallel_range_single_thread(start, stop,
 		                             userdata,
 		                             func,
@@ -1133,43 +1610,48 @@ void BLI_task_parallel_range(const int start, const int stop,
 		return;
 	}
 
-	task_pool = BLI_task_pool_create_suspended(task_scheduler, &state);
-
-	/* NOTE: This way we are adding a memory barrier and ensure all worker
-	 * threads can read and modify the value, without any locks. */
-	atomic_fetch_and_add_int32(&state.iter, 0);
-
+	/* Thread IDs are in the range of [0, num_threads). */
 	if (use_userdata_chunk) {
-		userdata_chunk_array = MALLOCA(userdata_chunk_size * num_tasks);
+		userdata_chunk_array = MALLOCA((userdata_chunk_size + sizeof(bool)) * num_threads);
+		state.userdata_chunk = userdata_chunk;
+		state.userdata_chunk_size = userdata_chunk_size;
+		state.userdata_chunk_array = userdata_chunk_array;
+		state.userdata_chunk_used = (bool *)(state.userdata_chunk_array + userdata_chunk_size * num_threads);
+		memset(state.userdata_chunk_used, 0, sizeof(bool) * num_threads);
 	}
-
-	for (i = 0; i < num_tasks; i++) {
-		if (use_userdata_chunk) {
-			userdata_chunk_local = (char *)userdata_chunk_array + (userdata_chunk_size * i);
-			memcpy(userdata_chunk_local, userdata_chunk, userdata_chunk_size);
-		}
-		/* Use this pool's pre-allocated tasks. */
-		BLI_task_pool_push_from_thread(task_pool,
-		                               parallel_range_func,
-		                               userdata_chunk_local, false,
-		                               TASK_PRIORITY_HIGH,
-		                               task_pool->thread_id);
+	else {
+		state.userdata_chunk = NULL;
+		state.userdata_chunk_size = 0;
+		state.userdata_chunk_array = NULL;
+		state.userdata_chunk_used = NULL;
 	}
 
+	parallel_thread_allocators_init(&state.allocators, settings->memarena, settings->mempool, num_threads);
+
+	task_pool = BLI_task_pool_create_suspended(task_scheduler, &state);
+
+	/* A single task for the whole range, it gets split when the pool runs. */
+	parallel_range_push(task_pool, start, stop, task_pool->thread_id);
+
 	BLI_task_pool_work_and_wait(task_pool);
 	BLI_task_pool_free(task_pool);
 
+	parallel_thread_allocators_merge(&state.allocators, num_threads);
+
 	if (use_userdata_chunk) {
 		if (settings->func_finalize != NULL) {
-			for (i = 0; i < num_tasks; i++) {
-				userdata_chunk_local = (char *)userdata_chunk_array + (userdata_chunk_size * i);
-				settings->func_finalize(userdata, userdata_chunk_local);
+			for (i = 0; i < num_threads; i++) {
+				if (state.userdata_chunk_used[i]) {
+					settings->func_finalize(userdata, state.userdata_chunk_array + userdata_chunk_size * i);
+				}
 			}
 		}
-		MALLOCA_FREE(userdata_chunk_array, userdata_chunk_size * num_tasks);
+		MALLOCA_FREE(userdata_chunk_array, (userdata_chunk_size + sizeof(bool)) * num_threads);
 	}
 }
 
+#undef RANGE_CHUNK_TIME
+
 #undef MALLOCA
 #undef MALLOCA_FREE
 
@@ -1291,38 +1773,45 @@ void BLI_task_parallel_listbase(
 typedef struct ParallelMempoolState {
 	void *userdata;
 	TaskParallelMempoolFunc func;
+	TaskParallelMempoolFuncEx func_ex;
+	ParallelThreadAllocators allocators;
 } ParallelMempoolState;
 
 static void parallel_mempool_func(
         TaskPool * __restrict pool,
         void *taskdata,
-        int UNUSED(threadid))
+        int threadid)
 {
 	ParallelMempoolState * __restrict state = BLI_task_pool_userdata(pool);
 	BLI_mempool_iter *iter = taskdata;
 	MempoolIterData *item;
 
-	while ((item = BLI_mempool_iterstep(iter)) != NULL) {
-		state->func(state->userdata, item);
+	if (state->func_ex != NULL) {
+		ParallelRangeTLS tls = {
+			.thread_id = threadid,
+			.userdata_chunk = NULL,
+			.memarena = parallel_thread_memarena_get(&state->allocators, threadid),
+			.mempool = parallel_thread_mempool_get(&state->allocators, threadid),
+		};
+		while ((item = BLI_mempool_iterstep(iter)) != NULL) {
+			state->func_ex(state->userdata, item, &tls);
+		}
+	}
+	else {
+		while ((item = BLI_mempool_iterstep(iter)) != NULL) {
+			state->func(state->userdata, item);
+		}
 	}
 }
 
-/**
- * This function allows to parallelize for loops over Mempool items.
- *
- * \param mempool: The iterable BLI_mempool to loop over.
- * \param userdata: Common userdata passed to all instances of \a func.
- * \param func: Callback function.
- * \param use_threading: If \a true, actually split-execute loop in threads, else just do a sequential for loop
- * (allows caller to use any kind of test to switch on parallelization or not).
- *
- * \note There is no static scheduling here.
- */
-void BLI_task_parallel_mempool(
+static void task_parallel_mempool(
         BLI_mempool *mempool,
         void *userdata,
         TaskParallelMempoolFunc func,
-        const bool use_threading)
+        TaskParallelMempoolFuncEx func_ex,
+        const bool use_threading,
+        MemArena *memarena,
+        BLI_mempool *alloc_pool)
 {
 	TaskScheduler *task_scheduler;
 	TaskPool *task_pool;
@@ -1334,11 +1823,22 @@ void BLI_task_parallel_mempool(
 	}
 
 	if (!use_threading) {
+		ParallelRangeTLS tls = {
+			.thread_id = 0,
+			.userdata_chunk = NULL,
+			.memarena = memarena,
+			.mempool = alloc_pool,
+		};
 		BLI_mempool_iter iter;
 		BLI_mempool_iternew(mempool, &iter);
 
 		for (void *item = BLI_mempool_iterstep(&iter); item != NULL; item = BLI_mempool_iterstep(&iter)) {
-			func(userdata, item);
+			if (func_ex != NULL) {
+				func_ex(userdata, item, &tls);
+			}
+			else {
+				func(userdata, item);
+			}
 		}
 		return;
 	}
@@ -1355,6 +1855,8 @@ void BLI_task_parallel_mempool(
 
 	state.userdata = userdata;
 	state.func = func;
+	state.func_ex = func_ex;
+	parallel_thread_allocators_init(&state.allocators, memarena, alloc_pool, num_threads);
 
 	BLI_mempool_iter *mempool_iterators = BLI_mempool_iter_threadsafe_create(mempool, (size_t)num_tasks);
 
@@ -1370,5 +1872,44 @@ void BLI_task_parallel_mempool(
 	BLI_task_pool_work_and_wait(task_pool);
 	BLI_task_pool_free(task_pool);
 
+	parallel_thread_allocators_merge(&state.allocators, num_threads);
+
 	BLI_mempool_iter_threadsafe_free(mempool_iterators);
 }
+
+/**
+ * This function allows to parallelize for loops over Mempool items.
+ *
+ * \param mempool: The iterable BLI_mempool to loop over.
+ * \param userdata: Common userdata passed to all instances of \a func.
+ * \param func: Callback function.
+ * \param use_threading: If \a true, actually split-execute loop in threads, else just do a sequential for loop
+ * (allows caller to use any kind of test to switch on parallelization or not).
+ *
+ * \note There is no static scheduling here.
+ */
+void BLI_task_parallel_mempool(
+        BLI_mempool *mempool,
+        void *userdata,
+        TaskParallelMempoolFunc func,
+        const bool use_threading)
+{
+	task_parallel_mempool(mempool, userdata, func, NULL, use_threading, NULL, NULL);
+}
+
+/**
+ * Same as #BLI_task_parallel_mempool, but \a func also gets the thread's #ParallelRangeTLS.
+ *
+ * Only \a use_threading, \a memarena and \a mempool of \a settings are used,
+ * they work the same as for #BLI_task_parallel_range.
+ */
+void BLI_task_parallel_mempool_ex(
+        BLI_mempool *mempool,
+        void *userdata,
+        TaskParallelMempoolFuncEx func,
+        const ParallelRangeSettings *settings)
+{
+	BLI_assert(settings->userdata_chunk == NULL);
+	task_parallel_mempool(mempool, userdata, NULL, func, settings->use_threading,
+	                      settings->memarena, settings->mempool);
+}
@@ -608,7 +608,9 @@ static void read_file_bhead_idname_map_create(FileData *fd)
 
 	BLI_assert(fd->bhead_idname_hash == NULL);
 
-	fd->bhead_idname_hash = BLI_ghash_str_new_ex(__func__, reserve);
+	/* Only filled once and then looked up, no pointers into the hash are kept. */
+	fd->bhead_idname_hash = BLI_ghash_new_flag(
+	        BLI_ghashutil_strhash_p, BLI_ghashutil_strcmp, __func__, reserve, GHASH_FLAG_OPEN_ADDRESSING);
 
 	for (bhead = blo_firstbhead(fd); bhead; bhead = blo_nextbhead(fd, bhead)) {
 		if (code_prev != bhead->code) {
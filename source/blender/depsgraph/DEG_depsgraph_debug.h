@@ -60,6 +60,11 @@ void DEG_debug_stats_gnuplot(const struct Depsgraph *graph,
                              const char *label,
                              const char *output_filename);
 
+/* Write timing of operations evaluated by the last graph evaluation as comma
+ * separated values, header is only written to an empty stream.
+ */
+void DEG_debug_stats_profile(const struct Depsgraph *graph, FILE *stream);
+
 /* ************************************************ */
 
 /* Compare two dependency graphs. */
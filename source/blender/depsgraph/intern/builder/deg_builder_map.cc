@@ -37,30 +37,51 @@
 
 namespace DEG {
 
-BuilderMap::BuilderMap() {
+BuilderMap::BuilderMap()
+        : parent_(NULL)
+{
 	set = BLI_gset_ptr_new("deg builder gset");
+	BLI_spin_init(&lock_);
 }
 
+BuilderMap::BuilderMap(BuilderMap *parent)
+        : set(parent->set),
+          parent_(parent)
+{
+}
 
 BuilderMap::~BuilderMap() {
-	BLI_gset_free(set, NULL);
+	if (parent_ == NULL) {
+		BLI_gset_free(set, NULL);
+		BLI_spin_end(&lock_);
+	}
 }
 
 bool BuilderMap::checkIsBuilt(ID *id) {
-	return BLI_gset_haskey(set, id);
+	SpinLock *lock = (parent_ != NULL) ? &parent_->lock_ : &lock_;
+	BLI_spin_lock(lock);
+	const bool is_built = BLI_gset_haskey(set, id);
+	BLI_spin_unlock(lock);
+	return is_built;
 }
 
 void BuilderMap::tagBuild(ID *id) {
+	SpinLock *lock = (parent_ != NULL) ? &parent_->lock_ : &lock_;
+	BLI_spin_lock(lock);
 	BLI_gset_insert(set, id);
+	BLI_spin_unlock(lock);
 }
 
 bool BuilderMap::checkIsBuiltAndTag(ID *id) {
+	SpinLock *lock = (parent_ != NULL) ? &parent_->lock_ : &lock_;
 	void **key_p;
-	if (!BLI_gset_ensure_p_ex(set, id, &key_p)) {
+	BLI_spin_lock(lock);
+	const bool is_built = BLI_gset_ensure_p_ex(set, id, &key_p);
+	if (!is_built) {
 		*key_p = id;
-		return false;
 	}
-	return true;
+	BLI_spin_unlock(lock);
+	return is_built;
 }
 
 }  // namespace DEG
@@ -30,6 +30,8 @@
 
 #pragma once
 
+#include "BLI_threads.h"  /* for SpinLock */
+
 struct GSet;
 struct ID;
 
@@ -38,6 +40,10 @@ namespace DEG {
 class BuilderMap {
 public:
 	BuilderMap();
+	/* Map which shares its tags with the given one. Tags of shared maps are
+	 * safe to be checked and set from multiple threads.
+	 */
+	explicit BuilderMap(BuilderMap *parent);
 	~BuilderMap();
 
 	/* Check whether given ID is already handled by builder (or if it's being
@@ -64,6 +70,11 @@ public:
 	}
 
 	GSet *set;
+
+protected:
+	/* Map which owns the set, NULL for the map itself. */
+	BuilderMap *parent_;
+	SpinLock lock_;
 };
 
 }  // namespace DEG
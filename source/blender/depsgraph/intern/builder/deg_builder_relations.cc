@@ -40,6 +40,8 @@
 
 #include "BLI_utildefines.h"
 #include "BLI_blenlib.h"
+#include "BLI_task.h"
+#include "BLI_threads.h"
 
 extern "C" {
 #include "DNA_action_types.h"
@@ -95,6 +97,8 @@ extern "C" {
 #include "RNA_types.h"
 } /* extern "C" */
 
+#include "atomic_ops.h"
+
 #include "DEG_depsgraph.h"
 #include "DEG_depsgraph_build.h"
 
@@ -174,7 +178,19 @@ DepsgraphRelationBuilder::DepsgraphRelationBuilder(Main *bmain,
                                                    Depsgraph *graph)
     : bmain_(bmain),
       graph_(graph),
-      scene_(NULL)
+      scene_(NULL),
+      pending_relations_(NULL)
+{
+}
+
+DepsgraphRelationBuilder::DepsgraphRelationBuilder(
+        DepsgraphRelationBuilder *parent,
+        PendingRelations *pending_relations)
+    : bmain_(parent->bmain_),
+      graph_(parent->graph_),
+      scene_(parent->scene_),
+      built_map_(&parent->built_map_),
+      pending_relations_(pending_relations)
 {
 }
 
@@ -247,6 +263,11 @@ DepsRelation *DepsgraphRelationBuilder::add_time_relation(
         bool check_unique)
 {
 	if (timesrc && node_to) {
+		if (pending_relations_ != NULL) {
+			PendingRelation relation = {timesrc, node_to, description, check_unique, false};
+			pending_relations_->push_back(relation);
+			return NULL;
+		}
 		return graph_->add_new_relation(timesrc, node_to, description, check_unique);
 	}
 	else {
@@ -265,6 +286,11 @@ DepsRelation *DepsgraphRelationBuilder::add_operation_relation(
         bool check_unique)
 {
 	if (node_from && node_to) {
+		if (pending_relations_ != NULL) {
+			PendingRelation relation = {node_from, node_to, description, check_unique, true};
+			pending_relations_->push_back(relation);
+			return NULL;
+		}
 		return graph_->add_new_relation(node_from,
 		                                node_to,
 		                                description,
@@ -320,7 +346,7 @@ void DepsgraphRelationBuilder::add_forcefield_relations(
         bool add_absorption,
         const char *name)
 {
-	ListBase *effectors = pdInitEffectors(scene, object, psys, eff, false);
+	ListBase *effectors = init_effectors(scene, object, psys, eff);
 	if (effectors != NULL) {
 		LISTBASE_FOREACH(EffectorCache *, eff, effectors) {
 			if (eff->ob != object) {
@@ -370,6 +396,53 @@ void DepsgraphRelationBuilder::add_forcefield_relations(
 	pdEndEffectors(&effectors);
 }
 
+void DepsgraphRelationBuilder::add_customdata_mask(OperationDepsNode *node,
+                                                   uint64_t mask)
+{
+	uint64_t old_mask = node->customdata_mask;
+	while ((old_mask | mask) != old_mask) {
+		const uint64_t prev_mask = atomic_cas_uint64(&node->customdata_mask,
+		                                             old_mask,
+		                                             old_mask | mask);
+		if (prev_mask == old_mask) {
+			break;
+		}
+		old_mask = prev_mask;
+	}
+}
+
+ListBase *DepsgraphRelationBuilder::init_effectors(Scene *scene,
+                                                   Object *object,
+                                                   ParticleSystem *psys,
+                                                   EffectorWeights *weights)
+{
+	/* Effectors are precalculated, which modifies their settings and caches. */
+	static ThreadMutex effectors_lock = BLI_MUTEX_INITIALIZER;
+	BLI_mutex_lock(&effectors_lock);
+	ListBase *effectors = pdInitEffectors(scene, object, psys, weights, false);
+	BLI_mutex_unlock(&effectors_lock);
+	return effectors;
+}
+
+void DepsgraphRelationBuilder::add_pending_relations(
+        const PendingRelations &pending_relations)
+{
+	foreach (const PendingRelation &relation, pending_relations) {
+		if (relation.is_operation) {
+			graph_->add_new_relation((OperationDepsNode *)relation.from,
+			                         (OperationDepsNode *)relation.to,
+			                         relation.description,
+			                         relation.check_unique);
+		}
+		else {
+			graph_->add_new_relation(relation.from,
+			                         relation.to,
+			                         relation.description,
+			                         relation.check_unique);
+		}
+	}
+}
+
 Depsgraph *DepsgraphRelationBuilder::getGraph()
 {
 	return graph_;
@@ -487,7 +560,10 @@ void DepsgraphRelationBuilder::build_object(Object *object)
 	}
 	/* Object that this is a proxy for. */
 	if (object->proxy != NULL) {
-		object->proxy->proxy_from = object;
+		/* Scene objects have this assigned before building from threads. */
+		if (object->proxy->proxy_from != object) {
+			object->proxy->proxy_from = object;
+		}
 		build_object(object->proxy);
 		/* TODO(sergey): This is an inverted relation, matches old depsgraph
 		 * behavior and need to be investigated if it still need to be inverted.
@@ -575,7 +651,7 @@ void DepsgraphRelationBuilder::build_object_parent(Object *object)
 			/* XXX not sure what this is for or how you could be done properly - lukas */
 			OperationDepsNode *parent_node = find_operation_node(parent_key);
 			if (parent_node != NULL) {
-				parent_node->customdata_mask |= CD_MASK_ORIGINDEX;
+				add_customdata_mask(parent_node, CD_MASK_ORIGINDEX);
 			}
 
 			ComponentKey transform_key(&object->parent->id, DEG_NODE_TYPE_TRANSFORM);
@@ -785,7 +861,7 @@ void DepsgraphRelationBuilder::build_constraints(ID *id,
 					if (ct->tar->type == OB_MESH) {
 						OperationDepsNode *node2 = find_operation_node(target_key);
 						if (node2 != NULL) {
-							node2->customdata_mask |= CD_MASK_MDEFORMVERT;
+							add_customdata_mask(node2, CD_MASK_MDEFORMVERT);
 						}
 					}
 				}
@@ -932,9 +1008,9 @@ void DepsgraphRelationBuilder::build_animdata_curves_targets(
 			add_relation(adt_key, pose_init_key, "Animation -> Prop", true);
 			continue;
 		}
-		graph_->add_new_relation(operation_from, operation_to,
-		                         "Animation -> Prop",
-		                         true);
+		add_operation_relation(operation_from, operation_to,
+		                       "Animation -> Prop",
+		                       true);
 	}
 }
 
@@ -167,9 +167,28 @@ struct RNAPathKey
 	PropertyRNA *prop;
 };
 
+/* Relation which is added to the graph once all threads finished building. */
+struct PendingRelation
+{
+	DepsNode *from;
+	DepsNode *to;
+	const char *description;
+	bool check_unique;
+	/* Relation between operations, otherwise from time source. */
+	bool is_operation;
+};
+
+typedef vector<PendingRelation> PendingRelations;
+
 struct DepsgraphRelationBuilder
 {
 	DepsgraphRelationBuilder(Main *bmain, Depsgraph *graph);
+	/* Builder which is used from a worker thread: built IDs are shared with
+	 * the parent builder and relations are stored in the given buffer instead
+	 * of being added to the graph directly.
+	 */
+	DepsgraphRelationBuilder(DepsgraphRelationBuilder *parent,
+	                         PendingRelations *pending_relations);
 
 	void begin_build();
 
@@ -192,6 +211,7 @@ struct DepsgraphRelationBuilder
 	                                       bool check_unique = false);
 
 	void build_scene(Scene *scene);
+	void build_scene_objects(Scene *scene);
 	void build_group(Object *object, Group *group);
 	void build_object(Object *object);
 	void build_object_data(Object *object);
@@ -264,6 +284,22 @@ struct DepsgraphRelationBuilder
 	template <typename KeyType>
 	OperationDepsNode *find_operation_node(const KeyType &key);
 
+	/* Add customdata layers which are needed from the operation, safe to be
+	 * used for nodes of other IDs while building from multiple threads.
+	 */
+	void add_customdata_mask(OperationDepsNode *node, uint64_t mask);
+
+	/* Same as pdInitEffectors(), which can not be used from multiple threads
+	 * at once.
+	 */
+	ListBase *init_effectors(Scene *scene,
+	                         Object *object,
+	                         ParticleSystem *psys,
+	                         EffectorWeights *weights);
+
+	/* Add relations which were collected by worker builders to the graph. */
+	void add_pending_relations(const PendingRelations &pending_relations);
+
 	Depsgraph *getGraph();
 
 protected:
@@ -336,6 +372,9 @@ private:
 	Scene *scene_;
 
 	BuilderMap built_map_;
+
+	/* Relations are stored here when building from a worker thread. */
+	PendingRelations *pending_relations_;
 };
 
 struct DepsNodeHandle
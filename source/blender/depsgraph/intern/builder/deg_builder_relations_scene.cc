@@ -40,6 +40,8 @@
 
 #include "BLI_utildefines.h"
 #include "BLI_blenlib.h"
+#include "BLI_ghash.h"
+#include "BLI_task.h"
 
 extern "C" {
 #include "DNA_node_types.h"
@@ -68,6 +70,77 @@ extern "C" {
 
 namespace DEG {
 
+namespace {
+
+struct BuildObjectsData {
+	DepsgraphRelationBuilder *builder;
+	vector<Object *> objects;
+	/* Relations of every object, added to the graph in order of the objects.
+	 * Relations of shared IDs are stored with whichever object reached them
+	 * first, so their order in the graph depends on scheduling, but the set
+	 * of relations does not.
+	 */
+	vector<PendingRelations> pending_relations;
+};
+
+void build_object_func(void *__restrict data_v,
+                       const int i,
+                       const ParallelRangeTLS *__restrict /*tls*/)
+{
+	BuildObjectsData *data = (BuildObjectsData *)data_v;
+	DepsgraphRelationBuilder builder(data->builder,
+	                                 &data->pending_relations[i]);
+	builder.build_object(data->objects[i]);
+}
+
+}  /* namespace */
+
+/* Relations of scene objects are built from multiple threads, nodes of all
+ * objects already exist so only relations need to be collected. Objects which
+ * are shared (parents, groups, ...) are built by whichever thread reaches them
+ * first.
+ */
+void DepsgraphRelationBuilder::build_scene_objects(Scene *scene)
+{
+	BuildObjectsData data;
+	data.builder = this;
+	LISTBASE_FOREACH (Base *, base, &scene->base) {
+		Object *object = base->object;
+		/* Proxy is built from the thread of its object, but it might be built
+		 * from another one as well.
+		 */
+		if (object->proxy != NULL) {
+			object->proxy->proxy_from = object;
+		}
+		data.objects.push_back(object);
+	}
+	const int num_objects = data.objects.size();
+	data.pending_relations.resize(num_objects);
+	/* Entry and exit operations of components are cached on first access,
+	 * do it here so threads only read them.
+	 */
+	foreach (IDDepsNode *id_node, graph_->id_nodes) {
+		GHASH_FOREACH_BEGIN(ComponentDepsNode *, comp_node, id_node->components)
+		{
+			comp_node->get_entry_operation();
+			comp_node->get_exit_operation();
+		}
+		GHASH_FOREACH_END();
+	}
+	ParallelRangeSettings settings;
+	BLI_parallel_range_settings_defaults(&settings);
+	/* Cost of objects differs a lot, rigs are much heavier than props. */
+	settings.scheduling_mode = TASK_SCHEDULING_DYNAMIC;
+	settings.use_threading = (num_objects > 16);
+	BLI_task_parallel_range(0, num_objects,
+	                        &data,
+	                        build_object_func,
+	                        &settings);
+	foreach (const PendingRelations &pending_relations, data.pending_relations) {
+		add_pending_relations(pending_relations);
+	}
+}
+
 void DepsgraphRelationBuilder::build_scene(Scene *scene)
 {
 	if (scene->set != NULL) {
@@ -76,10 +149,7 @@ void DepsgraphRelationBuilder::build_scene(Scene *scene)
 	/* Setup currently building context. */
 	scene_ = scene;
 	/* Scene objects. */
-	LISTBASE_FOREACH (Base *, base, &scene->base) {
-		Object *object = base->object;
-		build_object(object);
-	}
+	build_scene_objects(scene);
 	/* Rigidbody. */
 	if (scene->rigidbody_world != NULL) {
 		build_rigidbody(scene);
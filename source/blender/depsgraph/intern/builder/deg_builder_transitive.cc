@@ -30,8 +30,14 @@
 
 #include "intern/builder/deg_builder_transitive.h"
 
+#include <cstring>
+
 #include "MEM_guardedalloc.h"
 
+#include "BLI_utildefines.h"
+#include "BLI_bitmap.h"
+#include "BLI_task.h"
+
 #include "intern/nodes/deg_node.h"
 #include "intern/nodes/deg_node_component.h"
 #include "intern/nodes/deg_node_operation.h"
@@ -48,8 +54,11 @@ namespace DEG {
 /* Performs a transitive reduction to remove redundant relations.
  * https://en.wikipedia.org/wiki/Transitive_reduction
  *
- * XXX The current implementation is somewhat naive and has O(V*E) worst case
- * runtime.
+ * For every operation all nodes it depends on are traversed, and relations
+ * from nodes which are also reachable through other relations are removed.
+ * This has O(V*E) worst case runtime, but targets are handled in parallel,
+ * and only the traversed nodes are tagged in bitmaps local to the thread.
+ *
  * A more optimized algorithm can be implemented later, e.g.
  *
  *   http://www.sciencedirect.com/science/article/pii/0304397588900321/pdf?md5=3391e309b708b6f9cdedcd08f84f4afc&pid=1-s2.0-0304397588900321-main.pdf
@@ -58,66 +67,157 @@ namespace DEG {
  * too! (unless we can to prevent this case early on).
  */
 
-enum {
-	OP_VISITED = 1,
-	OP_REACHABLE = 2,
+namespace {
+
+typedef vector<OperationDepsNode *> OperationStack;
+typedef vector<DepsRelation *> RelationsVector;
+
+struct ReductionData {
+	Depsgraph *graph;
+	int num_removed_relations;
 };
 
-static void deg_graph_tag_paths_recursive(DepsNode *node)
+/* Per-thread state, indexed by position of the operation in the graph. */
+struct ReductionTLS {
+	BLI_bitmap *visited;
+	BLI_bitmap *reachable;
+	OperationStack *stack;
+	/* Visited nodes, so only those are cleared after each target. */
+	OperationStack *visited_nodes;
+	RelationsVector *removed_relations;
+};
+
+BLI_INLINE OperationDepsNode *relation_operation_from(DepsRelation *rel)
 {
-	if (node->done & OP_VISITED) {
-		return;
-	}
-	node->done |= OP_VISITED;
-	foreach (DepsRelation *rel, node->inlinks) {
-		deg_graph_tag_paths_recursive(rel->from);
-		/* Do this only in inlinks loop, so the target node does not get
-		 * flagged.
-		 */
-		rel->from->done |= OP_REACHABLE;
+	/* HACK: time source nodes are not operations and are not part of the
+	 * graph's operations, relations from them are kept.
+	 */
+	/* TODO: there will be other types in future. */
+	if (rel->from->type == DEG_NODE_TYPE_TIMESOURCE) {
+		return NULL;
 	}
+	return (OperationDepsNode *)rel->from;
 }
 
-void deg_graph_transitive_reduction(Depsgraph *graph)
+BLI_INLINE void reduction_visit(ReductionTLS *tls, OperationDepsNode *node)
 {
-	int num_removed_relations = 0;
-	foreach (OperationDepsNode *target, graph->operations) {
-		/* Clear tags. */
-		foreach (OperationDepsNode *node, graph->operations) {
-			node->done = 0;
-		}
-		/* Mark nodes from which we can reach the target
-		 * start with children, so the target node and direct children are not
-		 * flagged.
-		 */
-		target->done |= OP_VISITED;
-		foreach (DepsRelation *rel, target->inlinks) {
-			deg_graph_tag_paths_recursive(rel->from);
+	/* Index of the node is stored in its done field, see below. */
+	BLI_BITMAP_ENABLE(tls->visited, node->done);
+	tls->visited_nodes->push_back(node);
+	tls->stack->push_back(node);
+}
+
+void transitive_reduction_func(void *__restrict data_v,
+                               const int i,
+                               const ParallelRangeTLS *__restrict tls_v)
+{
+	ReductionData *data = (ReductionData *)data_v;
+	ReductionTLS *tls = (ReductionTLS *)tls_v->userdata_chunk;
+	OperationDepsNode *target = data->graph->operations[i];
+	/* Single relation can not be reached through any other one. */
+	if (target->inlinks.size() < 2) {
+		return;
+	}
+	if (tls->visited == NULL) {
+		const int num_operations = data->graph->operations.size();
+		tls->visited = BLI_BITMAP_NEW(num_operations, __func__);
+		tls->reachable = BLI_BITMAP_NEW(num_operations, __func__);
+		tls->stack = OBJECT_GUARDED_NEW(OperationStack);
+		tls->visited_nodes = OBJECT_GUARDED_NEW(OperationStack);
+		tls->removed_relations = OBJECT_GUARDED_NEW(RelationsVector);
+	}
+	/* Mark nodes from which we can reach the target, start with children, so
+	 * the target node and direct children are not flagged as reachable.
+	 */
+	BLI_BITMAP_ENABLE(tls->visited, target->done);
+	tls->visited_nodes->push_back(target);
+	foreach (DepsRelation *rel, target->inlinks) {
+		OperationDepsNode *from = relation_operation_from(rel);
+		if (from != NULL && !BLI_BITMAP_TEST(tls->visited, from->done)) {
+			reduction_visit(tls, from);
 		}
-		/* Remove redundant paths to the target. */
-		for (DepsNode::Relations::const_iterator it_rel = target->inlinks.begin();
-		     it_rel != target->inlinks.end();
-		     )
-		{
-			DepsRelation *rel = *it_rel;
-			if (rel->from->type == DEG_NODE_TYPE_TIMESOURCE) {
-				/* HACK: time source nodes don't get "done" flag set/cleared. */
-				/* TODO: there will be other types in future, so iterators above
-				 * need modifying.
-				 */
-				++it_rel;
-			}
-			else if (rel->from->done & OP_REACHABLE) {
-				rel->unlink();
-				OBJECT_GUARDED_DELETE(rel, DepsRelation);
-				++num_removed_relations;
+	}
+	while (!tls->stack->empty()) {
+		OperationDepsNode *node = tls->stack->back();
+		tls->stack->pop_back();
+		foreach (DepsRelation *rel, node->inlinks) {
+			OperationDepsNode *from = relation_operation_from(rel);
+			if (from == NULL) {
+				continue;
 			}
-			else {
-				++it_rel;
+			BLI_BITMAP_ENABLE(tls->reachable, from->done);
+			if (!BLI_BITMAP_TEST(tls->visited, from->done)) {
+				reduction_visit(tls, from);
 			}
 		}
 	}
-	DEG_DEBUG_PRINTF(BUILD, "Removed %d relations\n", num_removed_relations);
+	/* Relations to the target are only removed once all threads are done,
+	 * other threads might be traversing them.
+	 */
+	foreach (DepsRelation *rel, target->inlinks) {
+		OperationDepsNode *from = relation_operation_from(rel);
+		if (from != NULL && BLI_BITMAP_TEST(tls->reachable, from->done)) {
+			tls->removed_relations->push_back(rel);
+		}
+	}
+	foreach (OperationDepsNode *node, *tls->visited_nodes) {
+		BLI_BITMAP_DISABLE(tls->visited, node->done);
+		BLI_BITMAP_DISABLE(tls->reachable, node->done);
+	}
+	tls->visited_nodes->clear();
+}
+
+void transitive_reduction_finalize(void *__restrict data_v,
+                                   void *__restrict tls_v)
+{
+	ReductionData *data = (ReductionData *)data_v;
+	ReductionTLS *tls = (ReductionTLS *)tls_v;
+	if (tls->visited == NULL) {
+		return;
+	}
+	foreach (DepsRelation *rel, *tls->removed_relations) {
+		rel->unlink();
+		OBJECT_GUARDED_DELETE(rel, DepsRelation);
+	}
+	data->num_removed_relations += (int)tls->removed_relations->size();
+	MEM_freeN(tls->visited);
+	MEM_freeN(tls->reachable);
+	OBJECT_GUARDED_DELETE(tls->stack, OperationStack);
+	OBJECT_GUARDED_DELETE(tls->visited_nodes, OperationStack);
+	OBJECT_GUARDED_DELETE(tls->removed_relations, RelationsVector);
+}
+
+}  /* namespace */
+
+void deg_graph_transitive_reduction(Depsgraph *graph)
+{
+	const int num_operations = graph->operations.size();
+	/* Store index of every operation in its done field, used to address the
+	 * per-thread bitmaps.
+	 */
+	for (int i = 0; i < num_operations; i++) {
+		graph->operations[i]->done = i;
+	}
+	ReductionData data;
+	data.graph = graph;
+	data.num_removed_relations = 0;
+	ReductionTLS tls;
+	memset(&tls, 0, sizeof(tls));
+	ParallelRangeSettings settings;
+	BLI_parallel_range_settings_defaults(&settings);
+	settings.scheduling_mode = TASK_SCHEDULING_DYNAMIC;
+	settings.min_iter_per_thread = 64;
+	settings.userdata_chunk = &tls;
+	settings.userdata_chunk_size = sizeof(tls);
+	settings.func_finalize = transitive_reduction_finalize;
+	BLI_task_parallel_range(0, num_operations,
+	                        &data,
+	                        transitive_reduction_func,
+	                        &settings);
+	foreach (OperationDepsNode *node, graph->operations) {
+		node->done = 0;
+	}
+	DEG_DEBUG_PRINTF(BUILD, "Removed %d relations\n", data.num_removed_relations);
 }
 
 }  // namespace DEG
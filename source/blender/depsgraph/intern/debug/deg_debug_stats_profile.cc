@@ -0,0 +1,76 @@
+/*
+ * ***** BEGIN GPL LICENSE BLOCK *****
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * The Original Code is Copyright (C) 2018 Blender Foundation.
+ * All rights reserved.
+ *
+ * The Original Code is: all of this file.
+ *
+ * Contributor(s): none yet.
+ *
+ * ***** END GPL LICENSE BLOCK *****
+ */
+
+
+/** \file blender/depsgraph/intern/debug/deg_debug_stats_profile.cc
+ *  \ingroup depsgraph
+ */
+
+#include "DEG_depsgraph_debug.h"
+
+#include "intern/depsgraph.h"
+#include "intern/nodes/deg_node_component.h"
+#include "intern/nodes/deg_node_id.h"
+#include "intern/nodes/deg_node_operation.h"
+#include "intern/nodes/deg_node_time.h"
+
+#include "util/deg_util_foreach.h"
+
+extern "C" {
+#include "DNA_ID.h"
+} /* extern "C" */
+
+#define NL "\r\n"
+
+void DEG_debug_stats_profile(const Depsgraph *depsgraph, FILE *f)
+{
+	if (depsgraph == NULL) {
+		return;
+	}
+	const DEG::Depsgraph *graph = (const DEG::Depsgraph *)depsgraph;
+	const float frame = graph->find_time_source()->cfra;
+	/* Header is only written once, so profiles of subsequent evaluations can
+	 * be appended to the same file.
+	 */
+	if (ftell(f) == 0) {
+		fprintf(f, "frame,id,component,operation,time,average_time,critical_time" NL);
+	}
+	foreach (const DEG::OperationDepsNode *op_node, graph->operations) {
+		if (op_node->stats.current_time == 0.0) {
+			continue;
+		}
+		const DEG::ComponentDepsNode *comp_node = op_node->owner;
+		fprintf(f, "%f,\"%s\",\"%s\",\"%s\",%f,%f,%f" NL,
+		        frame,
+		        comp_node->owner->id->name + 2,
+		        comp_node->identifier().c_str(),
+		        op_node->identifier().c_str(),
+		        op_node->stats.current_time,
+		        op_node->stats.get_average_time(),
+		        op_node->critical_time);
+	}
+}
@@ -50,6 +50,8 @@ extern "C" {
 #include "BKE_modifier.h"
 } /* extern "C" */
 
+#include "atomic_ops.h"
+
 #include "DEG_depsgraph.h"
 #include "DEG_depsgraph_debug.h"
 #include "DEG_depsgraph_build.h"
@@ -182,7 +184,8 @@ void DEG_add_special_eval_flag(Depsgraph *graph, ID *id, short flag)
 		BLI_assert(!"ID should always be valid");
 		return;
 	}
-	id_node->eval_flags |= flag;
+	/* Relations of different objects might be built from multiple threads. */
+	atomic_fetch_and_or_int32((int32_t *)&id_node->eval_flags, flag);
 }
 
 /* ******************** */
@@ -345,7 +348,11 @@ void DEG_add_forcefield_relations(DepsNodeHandle *handle,
                                   int skip_forcefield,
                                   const char *name)
 {
-	ListBase *effectors = pdInitEffectors(scene, object, NULL, effector_weights, false);
+	DEG::DepsNodeHandle *deg_handle = get_handle(handle);
+	ListBase *effectors = deg_handle->builder->init_effectors(scene,
+	                                                          object,
+	                                                          NULL,
+	                                                          effector_weights);
 	if (effectors == NULL) {
 		return;
 	}
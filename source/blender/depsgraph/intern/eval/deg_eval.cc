@@ -37,8 +37,12 @@
 #include "BLI_utildefines.h"
 #include "BLI_task.h"
 #include "BLI_ghash.h"
+#include "BLI_threads.h"
 
 extern "C" {
+#include "BLI_compiler_attrs.h"
+#include "BLI_heap.h"
+
 #include "BKE_depsgraph.h"
 #include "BKE_global.h"
 } /* extern "C" */
@@ -76,8 +80,23 @@ struct DepsgraphEvalState {
 	Depsgraph *graph;
 	unsigned int layers;
 	bool do_stats;
+	/* Operations which are ready to be evaluated, ordered by their critical
+	 * time. Only used when evaluating from multiple threads, tasks then do
+	 * not carry an operation but take the most critical ready one.
+	 */
+	bool use_priority;
+	Heap *ready_heap;
+	SpinLock ready_lock;
 };
 
+static OperationDepsNode *ready_operation_pop(DepsgraphEvalState *state)
+{
+	BLI_spin_lock(&state->ready_lock);
+	OperationDepsNode *node = (OperationDepsNode *)BLI_heap_pop_min(state->ready_heap);
+	BLI_spin_unlock(&state->ready_lock);
+	return node;
+}
+
 static void deg_task_run_func(TaskPool *pool,
                               void *taskdata,
                               int thread_id)
@@ -85,17 +104,17 @@ static void deg_task_run_func(TaskPool *pool,
 	void *userdata_v = BLI_task_pool_userdata(pool);
 	DepsgraphEvalState *state = (DepsgraphEvalState *)userdata_v;
 	OperationDepsNode *node = (OperationDepsNode *)taskdata;
+	if (node == NULL) {
+		node = ready_operation_pop(state);
+	}
 	/* Sanity checks. */
 	BLI_assert(!node->is_noop() && "NOOP nodes should not actually be scheduled");
-	/* Perform operation. */
-	if (state->do_stats) {
-		const double start_time = PIL_check_seconds_timer();
-		node->evaluate(state->eval_ctx);
-		node->stats.current_time += PIL_check_seconds_timer() - start_time;
-	}
-	else {
-		node->evaluate(state->eval_ctx);
-	}
+	/* Perform operation. Timing is always measured, it is used to schedule
+	 * following evaluations.
+	 */
+	const double start_time = PIL_check_seconds_timer();
+	node->evaluate(state->eval_ctx);
+	node->stats.add_time(PIL_check_seconds_timer() - start_time);
 	/* Schedule children. */
 	BLI_task_pool_delayed_push_begin(pool, thread_id);
 	schedule_children(pool, state->graph, node, state->layers, thread_id);
@@ -157,17 +176,98 @@ static void calculate_pending_parents(Depsgraph *graph, unsigned int layers)
 	                        &settings);
 }
 
+BLI_INLINE bool operation_needs_evaluation(OperationDepsNode *node,
+                                           unsigned int layers)
+{
+	return (node->owner->owner->layers & layers) != 0 &&
+	       (node->flag & DEPSOP_FLAG_NEEDS_UPDATE) != 0;
+}
+
+/* Calculate critical time of all operations which are to be evaluated, by
+ * going from the last operations of every chain to the first ones.
+ * Cyclic relations are ignored, so the operations form a DAG.
+ */
+static void calculate_critical_time(Depsgraph *graph, unsigned int layers)
+{
+	vector<OperationDepsNode *> stack;
+	/* Number of children which were not handled yet is stored in the done
+	 * field, it is cleared once evaluation is initialized.
+	 */
+	foreach (OperationDepsNode *node, graph->operations) {
+		node->done = 0;
+		node->critical_time = node->stats.get_average_time();
+		if (!operation_needs_evaluation(node, layers)) {
+			continue;
+		}
+		foreach (DepsRelation *rel, node->outlinks) {
+			OperationDepsNode *child = (OperationDepsNode *)rel->to;
+			if ((rel->flag & DEPSREL_FLAG_CYCLIC) == 0 &&
+			    operation_needs_evaluation(child, layers))
+			{
+				++node->done;
+			}
+		}
+		if (node->done == 0) {
+			stack.push_back(node);
+		}
+	}
+	while (!stack.empty()) {
+		OperationDepsNode *node = stack.back();
+		stack.pop_back();
+		foreach (DepsRelation *rel, node->inlinks) {
+			if (rel->from->type != DEG_NODE_TYPE_OPERATION ||
+			    (rel->flag & DEPSREL_FLAG_CYCLIC) != 0)
+			{
+				continue;
+			}
+			OperationDepsNode *parent = (OperationDepsNode *)rel->from;
+			if (!operation_needs_evaluation(parent, layers)) {
+				continue;
+			}
+			const double critical_time = parent->stats.get_average_time() +
+			                             node->critical_time;
+			if (critical_time > parent->critical_time) {
+				parent->critical_time = critical_time;
+			}
+			if (--parent->done == 0) {
+				stack.push_back(parent);
+			}
+		}
+	}
+}
+
 static void initialize_execution(DepsgraphEvalState *state, Depsgraph *graph)
 {
-	const bool do_stats = state->do_stats;
 	calculate_pending_parents(graph, state->layers);
+	if (state->use_priority) {
+		calculate_critical_time(graph, state->layers);
+	}
 	/* Clear tags and other things which needs to be clear. */
 	foreach (OperationDepsNode *node, graph->operations) {
 		node->done = 0;
-		if (do_stats) {
-			node->stats.reset_current();
-		}
+		node->stats.reset_current();
+	}
+}
+
+/* Push task which evaluates given operation. */
+static void schedule_operation(TaskPool *pool,
+                               OperationDepsNode *node,
+                               const int thread_id)
+{
+	DepsgraphEvalState *state = (DepsgraphEvalState *)BLI_task_pool_userdata(pool);
+	if (state->use_priority) {
+		BLI_spin_lock(&state->ready_lock);
+		/* Heap gives the smallest value first. */
+		BLI_heap_insert(state->ready_heap, (float)-node->critical_time, node);
+		BLI_spin_unlock(&state->ready_lock);
+		node = NULL;
 	}
+	BLI_task_pool_push_from_thread(pool,
+	                               deg_task_run_func,
+	                               node,
+	                               false,
+	                               TASK_PRIORITY_HIGH,
+	                               thread_id);
 }
 
 /* Schedule a node if it needs evaluation.
@@ -198,12 +298,7 @@ static void schedule_node(TaskPool *pool, Depsgraph *graph, unsigned int layers,
 				}
 				else {
 					/* children are scheduled once this task is completed */
-					BLI_task_pool_push_from_thread(pool,
-					                               deg_task_run_func,
-					                               node,
-					                               false,
-					                               TASK_PRIORITY_HIGH,
-					                               thread_id);
+					schedule_operation(pool, node, thread_id);
 				}
 			}
 		}
@@ -282,6 +377,18 @@ void deg_evaluate_on_refresh(EvaluationContext *eval_ctx,
 		task_scheduler = BLI_task_scheduler_get();
 		need_free_scheduler = false;
 	}
+	/* Order only matters when operations are evaluated in parallel. The
+	 * single threaded scheduler still counts its background worker next to
+	 * the main thread, so check the debug flag rather than the thread count.
+	 */
+	state.use_priority = ((G.debug & G_DEBUG_DEPSGRAPH_NO_THREADS) == 0);
+	if (state.use_priority) {
+		state.ready_heap = BLI_heap_new();
+		BLI_spin_init(&state.ready_lock);
+	}
+	else {
+		state.ready_heap = NULL;
+	}
 	TaskPool *task_pool = BLI_task_pool_create_suspended(task_scheduler, &state);
 	/* Prepare all nodes for evaluation. */
 	initialize_execution(&state, graph);
@@ -289,6 +396,11 @@ void deg_evaluate_on_refresh(EvaluationContext *eval_ctx,
 	schedule_graph(task_pool, graph, layers);
 	BLI_task_pool_work_and_wait(task_pool);
 	BLI_task_pool_free(task_pool);
+	if (state.use_priority) {
+		BLI_assert(BLI_heap_is_empty(state.ready_heap));
+		BLI_heap_free(state.ready_heap, NULL);
+		BLI_spin_end(&state.ready_lock);
+	}
 	/* Finalize statistics gathering. This is because we only gather single
 	 * operation timing here, without aggregating anything to avoid any extra
 	 * synchronization.
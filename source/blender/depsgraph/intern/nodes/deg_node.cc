@@ -69,6 +69,8 @@ DepsNode::Stats::Stats()
 void DepsNode::Stats::reset()
 {
 	current_time = 0.0;
+	average_time = 0.0;
+	num_evaluations = 0;
 }
 
 void DepsNode::Stats::reset_current()
@@ -76,6 +78,28 @@ void DepsNode::Stats::reset_current()
 	current_time = 0.0;
 }
 
+void DepsNode::Stats::add_time(double time)
+{
+	/* Weight of the new evaluation in the average. Roughly the last dozen
+	 * evaluations contribute, so a node which became cheaper or more
+	 * expensive (edits, modifiers toggled) is re-ranked within a few frames.
+	 */
+	const double weight = 0.15;
+	current_time += time;
+	if (num_evaluations == 0) {
+		average_time = time;
+	}
+	else {
+		average_time += (time - average_time) * weight;
+	}
+	++num_evaluations;
+}
+
+double DepsNode::Stats::get_average_time() const
+{
+	return average_time;
+}
+
 /*******************************************************************************
  * Node itself.
  */
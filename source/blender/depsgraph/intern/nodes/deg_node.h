@@ -66,8 +66,17 @@ struct DepsNode {
 		 * touch averaging accumulators.
 		 */
 		void reset_current();
+		/* Add time spent on the node, to both current and average time. */
+		void add_time(double time);
+		/* Average time of a single evaluation, weighted towards the recent
+		 * evaluations so it follows changes in the scene.
+		 */
+		double get_average_time() const;
 		/* Time spend on this node during current graph evaluation. */
 		double current_time;
+		/* Exponential moving average of the evaluation time. */
+		double average_time;
+		int num_evaluations;
 	};
 	/* Relationships between nodes
 	 * The reason why all depsgraph nodes are descended from this type (apart
@@ -46,7 +46,8 @@ namespace DEG {
 
 OperationDepsNode::OperationDepsNode() :
     flag(0),
-    customdata_mask(0)
+    customdata_mask(0),
+    critical_time(0.0)
 {
 }
 
@@ -87,6 +87,12 @@ struct OperationDepsNode : public DepsNode {
 	/* Extra customdata mask which needs to be evaluated for the object. */
 	uint64_t customdata_mask;
 
+	/* Estimated time to evaluate this operation and the longest chain of
+	 * operations depending on it, based on timing of previous evaluations.
+	 * Operations with the highest value are evaluated first.
+	 */
+	double critical_time;
+
 	DEG_DEPSNODE_DECLARE;
 };
 
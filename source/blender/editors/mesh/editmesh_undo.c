@@ -60,6 +60,8 @@
 #  include "BLI_array_store_utils.h"
    /* check on best size later... */
 #  define ARRAY_CHUNK_SIZE 256
+   /* keep chunks aligned with the previous step when elements are added or removed */
+#  define ARRAY_STORE_FLAG BLI_ARRAY_STORE_CONTENT_DEFINED_CHUNKS
 
 #  define USE_ARRAY_STORE_THREAD
 #endif
@@ -154,7 +156,7 @@ static void um_arraystore_cd_compact(
 		}
 
 		const int stride = CustomData_sizeof(type);
-		BArrayStore *bs = create ? BLI_array_store_at_size_ensure(&um_arraystore.bs_stride, stride, ARRAY_CHUNK_SIZE) : NULL;
+		BArrayStore *bs = create ? BLI_array_store_at_size_ensure_ex(&um_arraystore.bs_stride, stride, ARRAY_CHUNK_SIZE, ARRAY_STORE_FLAG) : NULL;
 		const int layer_len = layer_end - layer_start;
 
 		if (create) {
@@ -288,7 +290,7 @@ static void um_arraystore_compact_ex(
 
 	if (me->key && me->key->totkey) {
 		const size_t stride = me->key->elemsize;
-		BArrayStore *bs = create ? BLI_array_store_at_size_ensure(&um_arraystore.bs_stride, stride, ARRAY_CHUNK_SIZE) : NULL;
+		BArrayStore *bs = create ? BLI_array_store_at_size_ensure_ex(&um_arraystore.bs_stride, stride, ARRAY_CHUNK_SIZE, ARRAY_STORE_FLAG) : NULL;
 		if (create) {
 			um->store.keyblocks = MEM_mallocN(me->key->totkey * sizeof(*um->store.keyblocks), __func__);
 		}
@@ -315,7 +317,7 @@ static void um_arraystore_compact_ex(
 		if (create) {
 			BArrayState *state_reference = um_ref ? um_ref->store.mselect : NULL;
 			const size_t stride = sizeof(*me->mselect);
-			BArrayStore *bs = BLI_array_store_at_size_ensure(&um_arraystore.bs_stride, stride, ARRAY_CHUNK_SIZE);
+			BArrayStore *bs = BLI_array_store_at_size_ensure_ex(&um_arraystore.bs_stride, stride, ARRAY_CHUNK_SIZE, ARRAY_STORE_FLAG);
 			um->store.mselect = BLI_array_store_state_add(
 			        bs, me->mselect, (size_t)me->totselect * stride, state_reference);
 		}
@@ -68,6 +68,19 @@ static void rna_Depsgraph_debug_stats_gnuplot(Depsgraph *depsgraph,
 	fclose(f);
 }
 
+static void rna_Depsgraph_debug_stats_profile(Depsgraph *depsgraph,
+                                              const char *filename)
+{
+	FILE *f = fopen(filename, "a");
+	if (f == NULL) {
+		return;
+	}
+	/* Position of appended stream is not defined before writing. */
+	fseek(f, 0, SEEK_END);
+	DEG_debug_stats_profile(depsgraph, f);
+	fclose(f);
+}
+
 static void rna_Depsgraph_debug_tag_update(Depsgraph *depsgraph)
 {
 	DEG_graph_tag_relations_update(depsgraph);
@@ -106,6 +119,13 @@ static void rna_def_depsgraph(BlenderRNA *brna)
 	                                "File name where gnuplot script will save the result");
 	RNA_def_parameter_flags(parm, 0, PARM_REQUIRED);
 
+	func = RNA_def_function(srna, "debug_stats_profile", "rna_Depsgraph_debug_stats_profile");
+	RNA_def_function_ui_description(func, "Append timing of the last evaluation to a CSV file, "
+	                                "to be called after every frame change for profiling");
+	parm = RNA_def_string_file_path(func, "filename", NULL, FILE_MAX, "File Name",
+	                                "File in which to store timing of the operations");
+	RNA_def_parameter_flags(parm, 0, PARM_REQUIRED);
+
 	func = RNA_def_function(srna, "debug_tag_update", "rna_Depsgraph_debug_tag_update");
 
 	func = RNA_def_function(srna, "debug_stats", "rna_Depsgraph_debug_stats");
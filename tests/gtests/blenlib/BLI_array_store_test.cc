@@ -304,9 +304,9 @@ static void testbuffer_run_tests(
 
 static void testbuffer_run_tests_simple(
         ListBase *lb,
-        const int stride, const int chunk_count)
+        const int stride, const int chunk_count, const int flag = 0)
 {
-	BArrayStore *bs = BLI_array_store_create(stride, chunk_count);
+	BArrayStore *bs = BLI_array_store_create_ex(stride, chunk_count, flag);
 	testbuffer_run_tests(bs, lb);
 	BLI_array_store_destroy(bs);
 }
@@ -453,7 +453,7 @@ TEST(array_store, TextDupeIncreaseDecrease)
  */
 static void plain_text_helper(
         const char *words, int words_len, const char word_delim,
-        const int stride, const int chunk_count, const int random_seed)
+        const int stride, const int chunk_count, const int random_seed, const int flag = 0)
 {
 
 	ListBase lb;
@@ -472,7 +472,7 @@ static void plain_text_helper(
 		testbuffer_list_data_randomize(&lb, random_seed);
 	}
 
-	testbuffer_run_tests_simple(&lb, stride, chunk_count);
+	testbuffer_run_tests_simple(&lb, stride, chunk_count, flag);
 
 	testbuffer_list_free(&lb);
 }
@@ -509,6 +509,15 @@ TEST(array_store, TextSentencesRandom_Stride32_Chunk1)   { plain_text_helper(WOR
 TEST(array_store, TextSentencesRandom_Stride12_Chunk512) { plain_text_helper(WORDS, 'g',  12, 512, 9999); }
 TEST(array_store, TextSentencesRandom_Stride128_Chunk6)  { plain_text_helper(WORDS, 'b',  20,   6, 1000); }
 
+/* content defined chunks */
+#define CDC BLI_ARRAY_STORE_CONTENT_DEFINED_CHUNKS
+TEST(array_store, TextWords_CDC_Chunk1)                     { plain_text_helper(WORDS, ' ',  1,   1,    0, CDC); }
+TEST(array_store, TextWords_CDC_Chunk3)                     { plain_text_helper(WORDS, ' ',  1,   3,    0, CDC); }
+TEST(array_store, TextWords_CDC_Chunk32)                    { plain_text_helper(WORDS, ' ',  1,  32,    0, CDC); }
+TEST(array_store, TextSentences_CDC_Chunk131)               { plain_text_helper(WORDS, '.',  1, 131,    0, CDC); }
+TEST(array_store, TextSentencesRandom_CDC_Stride12_Chunk48) { plain_text_helper(WORDS, 'g', 12,  48, 9999, CDC); }
+#undef CDC
+
 #undef WORDS
 
 
@@ -615,7 +624,7 @@ static void testbuffer_list_state_random_data(
 static void random_data_mutate_helper(
         const int items_size_min, const int items_size_max, const int items_total,
         const int stride, const int chunk_count,
-        const int random_seed, const int mutate)
+        const int random_seed, const int mutate, const int flag = 0)
 {
 
 
@@ -633,7 +642,7 @@ static void random_data_mutate_helper(
 		BLI_rng_free(rng);
 	}
 
-	testbuffer_run_tests_simple(&lb, stride, chunk_count);
+	testbuffer_run_tests_simple(&lb, stride, chunk_count, flag);
 
 	testbuffer_list_free(&lb);
 }
@@ -644,6 +653,65 @@ TEST(array_store, TestData_Stride12_Chunk48_Mutate2) { random_data_mutate_helper
 TEST(array_store, TestData_Stride32_Chunk64_Mutate1) { random_data_mutate_helper(0,   256,  200, 32,  64,  3112, 1); }
 TEST(array_store, TestData_Stride32_Chunk64_Mutate8) { random_data_mutate_helper(0,   256,  200, 32,  64,  7117, 8); }
 
+#define CDC BLI_ARRAY_STORE_CONTENT_DEFINED_CHUNKS
+TEST(array_store, TestData_CDC_Stride1_Chunk32_Mutate2)  { random_data_mutate_helper(0,   100,  400,  1,  32,  9779, 2, CDC); }
+TEST(array_store, TestData_CDC_Stride12_Chunk48_Mutate2) { random_data_mutate_helper(200, 256,  400, 12,  48,  1331, 2, CDC); }
+TEST(array_store, TestData_CDC_Stride32_Chunk64_Mutate8) { random_data_mutate_helper(0,   256,  200, 32,  64,  7117, 8, CDC); }
+#undef CDC
+
+
+/* -------------------------------------------------------------------- */
+/* Large Data Test */
+
+/**
+ * Insert and remove items in a state large enough to be hashed in parallel,
+ * with content defined chunks most chunks after the edits are expected to be shared.
+ */
+static void large_data_insert_helper(
+        const int items_total, const int stride, const int chunk_count,
+        const int random_seed, const int flag)
+{
+	ListBase lb;
+	BLI_listbase_clear(&lb);
+
+	const size_t data_len = (size_t)items_total * stride;
+	RNG *rng = BLI_rng_new(random_seed);
+
+	char *data = (char *)MEM_mallocN(data_len, __func__);
+	BLI_rng_get_char_n(rng, data, data_len);
+	testbuffer_list_add(&lb, (const void *)data, data_len);
+
+	for (int i = 0; i < 4; i++) {
+		TestBuffer *tb_last = (TestBuffer *)lb.last;
+		const size_t offset = (BLI_rng_get_uint(rng) % (unsigned int)items_total) * stride;
+		const size_t insert_len = (1 + (BLI_rng_get_uint(rng) % 3)) * stride;
+		data = (char *)MEM_mallocN(tb_last->data_len + insert_len, __func__);
+		memcpy(data, tb_last->data, offset);
+		BLI_rng_get_char_n(rng, &data[offset], insert_len);
+		memcpy(&data[offset + insert_len], &((const char *)tb_last->data)[offset], tb_last->data_len - offset);
+		testbuffer_list_add(&lb, (const void *)data, tb_last->data_len + insert_len);
+	}
+
+	BLI_rng_free(rng);
+
+	BArrayStore *bs = BLI_array_store_create_ex(stride, chunk_count, flag);
+	testbuffer_list_store_populate(bs, &lb);
+	EXPECT_TRUE(testbuffer_list_validate(&lb));
+	EXPECT_TRUE(BLI_array_store_is_valid(bs));
+	if (flag & BLI_ARRAY_STORE_CONTENT_DEFINED_CHUNKS) {
+		/* each edit may only add a few chunks */
+		EXPECT_LT(BLI_array_store_calc_size_compacted_get(bs), data_len + (data_len / 8));
+	}
+	testbuffer_list_store_clear(bs, &lb);
+	BLI_array_store_destroy(bs);
+
+	testbuffer_list_free(&lb);
+}
+
+TEST(array_store, LargeData_Stride4_Chunk256)     { large_data_insert_helper(200000, 4, 256, 1234, 0); }
+TEST(array_store, LargeData_CDC_Stride4_Chunk256) { large_data_insert_helper(200000, 4, 256, 1234, BLI_ARRAY_STORE_CONTENT_DEFINED_CHUNKS); }
+TEST(array_store, LargeData_CDC_Stride1_Chunk64)  { large_data_insert_helper(300000, 1,  64, 4321, BLI_ARRAY_STORE_CONTENT_DEFINED_CHUNKS); }
+
 
 /* -------------------------------------------------------------------- */
 /* Randomized Chunks Test */
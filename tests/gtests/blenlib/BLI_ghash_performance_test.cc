@@ -163,6 +163,14 @@ TEST(ghash, TextMurmur2a)
 	str_ghash_tests(ghash, "StrGHash - Murmur");
 }
 
+TEST(ghash, TextOpenAddressing)
+{
+	GHash *ghash = BLI_ghash_new_flag(BLI_ghashutil_strhash_p, BLI_ghashutil_strcmp, __func__, 0,
+	                                  GHASH_FLAG_OPEN_ADDRESSING);
+
+	str_ghash_tests(ghash, "StrGHash - Open Addressing");
+}
+
 
 /* Int: uniform 100M first integers. */
 
@@ -319,6 +327,24 @@ TEST(ghash, IntRandGHash50000000)
 }
 #endif
 
+TEST(ghash, IntRandOpenAddressing12000)
+{
+	GHash *ghash = BLI_ghash_new_flag(BLI_ghashutil_inthash_p, BLI_ghashutil_intcmp, __func__, 0,
+	                                  GHASH_FLAG_OPEN_ADDRESSING);
+
+	randint_ghash_tests(ghash, "RandIntGHash - Open Addressing - 12000", 12000);
+}
+
+#ifdef GHASH_RUN_BIG
+TEST(ghash, IntRandOpenAddressing50000000)
+{
+	GHash *ghash = BLI_ghash_new_flag(BLI_ghashutil_inthash_p, BLI_ghashutil_intcmp, __func__, 0,
+	                                  GHASH_FLAG_OPEN_ADDRESSING);
+
+	randint_ghash_tests(ghash, "RandIntGHash - Open Addressing - 50000000", 50000000);
+}
+#endif
+
 TEST(ghash, IntRandMurmur2a12000)
 {
 	GHash *ghash = BLI_ghash_new(BLI_ghashutil_inthash_p_murmur, BLI_ghashutil_intcmp, __func__);
@@ -198,3 +198,207 @@ TEST(ghash, Pop)
 
 	BLI_ghash_free(ghash, NULL, NULL);
 }
+
+/* Open addressing, same tests as above. */
+TEST(ghash, OpenAddressingInsertLookup)
+{
+	GHash *ghash = BLI_ghash_new_flag(BLI_ghashutil_inthash_p, BLI_ghashutil_intcmp, __func__, 0,
+	                                  GHASH_FLAG_OPEN_ADDRESSING);
+	unsigned int keys[TESTCASE_SIZE], *k;
+	int i;
+
+	init_keys(keys, 40);
+
+	for (i = TESTCASE_SIZE, k = keys; i--; k++) {
+		BLI_ghash_insert(ghash, SET_UINT_IN_POINTER(*k), SET_UINT_IN_POINTER(*k));
+	}
+
+	EXPECT_EQ(BLI_ghash_len(ghash), TESTCASE_SIZE);
+
+	for (i = TESTCASE_SIZE, k = keys; i--; k++) {
+		void *v = BLI_ghash_lookup(ghash, SET_UINT_IN_POINTER(*k));
+		EXPECT_EQ(GET_UINT_FROM_POINTER(v), *k);
+	}
+
+	BLI_ghash_free(ghash, NULL, NULL);
+}
+
+TEST(ghash, OpenAddressingInsertRemoveShrink)
+{
+	GHash *ghash = BLI_ghash_new_flag(BLI_ghashutil_inthash_p, BLI_ghashutil_intcmp, __func__, 0,
+	                                  GHASH_FLAG_OPEN_ADDRESSING);
+	unsigned int keys[TESTCASE_SIZE], *k;
+	int i, bkt_size;
+
+	BLI_ghash_flag_set(ghash, GHASH_FLAG_ALLOW_SHRINK);
+	init_keys(keys, 50);
+
+	for (i = TESTCASE_SIZE, k = keys; i--; k++) {
+		BLI_ghash_insert(ghash, SET_UINT_IN_POINTER(*k), SET_UINT_IN_POINTER(*k));
+	}
+
+	EXPECT_EQ(BLI_ghash_len(ghash), TESTCASE_SIZE);
+	bkt_size = BLI_ghash_buckets_len(ghash);
+
+	for (i = TESTCASE_SIZE, k = keys; i--; k++) {
+		void *v = BLI_ghash_popkey(ghash, SET_UINT_IN_POINTER(*k), NULL);
+		EXPECT_EQ(GET_UINT_FROM_POINTER(v), *k);
+	}
+
+	EXPECT_EQ(BLI_ghash_len(ghash), 0);
+	EXPECT_LT(BLI_ghash_buckets_len(ghash), bkt_size);
+
+	BLI_ghash_free(ghash, NULL, NULL);
+}
+
+TEST(ghash, OpenAddressingCopy)
+{
+	GHash *ghash = BLI_ghash_new_flag(BLI_ghashutil_inthash_p, BLI_ghashutil_intcmp, __func__, 0,
+	                                  GHASH_FLAG_OPEN_ADDRESSING);
+	GHash *ghash_copy;
+	unsigned int keys[TESTCASE_SIZE], *k;
+	int i;
+
+	init_keys(keys, 60);
+
+	for (i = TESTCASE_SIZE, k = keys; i--; k++) {
+		BLI_ghash_insert(ghash, SET_UINT_IN_POINTER(*k), SET_UINT_IN_POINTER(*k));
+	}
+
+	ghash_copy = BLI_ghash_copy(ghash, NULL, NULL);
+
+	EXPECT_EQ(BLI_ghash_len(ghash_copy), TESTCASE_SIZE);
+	EXPECT_EQ(BLI_ghash_buckets_len(ghash_copy), BLI_ghash_buckets_len(ghash));
+
+	for (i = TESTCASE_SIZE, k = keys; i--; k++) {
+		void *v = BLI_ghash_lookup(ghash_copy, SET_UINT_IN_POINTER(*k));
+		EXPECT_EQ(GET_UINT_FROM_POINTER(v), *k);
+	}
+
+	BLI_ghash_free(ghash, NULL, NULL);
+	BLI_ghash_free(ghash_copy, NULL, NULL);
+}
+
+TEST(ghash, OpenAddressingPop)
+{
+	GHash *ghash = BLI_ghash_new_flag(BLI_ghashutil_inthash_p, BLI_ghashutil_intcmp, __func__, 0,
+	                                  GHASH_FLAG_OPEN_ADDRESSING);
+	unsigned int keys[TESTCASE_SIZE], *k;
+	int i;
+
+	BLI_ghash_flag_set(ghash, GHASH_FLAG_ALLOW_SHRINK);
+	init_keys(keys, 70);
+
+	for (i = TESTCASE_SIZE, k = keys; i--; k++) {
+		BLI_ghash_insert(ghash, SET_UINT_IN_POINTER(*k), SET_UINT_IN_POINTER(*k));
+	}
+
+	GHashIterState pop_state = {0};
+
+	for (i = TESTCASE_SIZE / 2; i--; ) {
+		void *k, *v;
+		bool success = BLI_ghash_pop(ghash, &pop_state, &k, &v);
+		EXPECT_EQ(k, v);
+		EXPECT_TRUE(success);
+
+		if (i % 2) {
+			BLI_ghash_insert(ghash, SET_UINT_IN_POINTER(i * 4), SET_UINT_IN_POINTER(i * 4));
+		}
+	}
+
+	EXPECT_EQ(BLI_ghash_len(ghash), (TESTCASE_SIZE - TESTCASE_SIZE / 2 + TESTCASE_SIZE / 4));
+
+	{
+		void *k, *v;
+		while (BLI_ghash_pop(ghash, &pop_state, &k, &v)) {
+			EXPECT_EQ(k, v);
+		}
+	}
+	EXPECT_EQ(BLI_ghash_len(ghash), 0);
+
+	BLI_ghash_free(ghash, NULL, NULL);
+}
+
+/* Poor hash, so most keys collide, to exercise Robin Hood displacement & backward shift removal. */
+static unsigned int ghash_collide_hash(const void *key)
+{
+	return GET_UINT_FROM_POINTER(key) % 7;
+}
+
+/* Random insertions & removals, checked against a chaining GHash (iteration included). */
+TEST(ghash, OpenAddressingRandom)
+{
+	GHash *ghash = BLI_ghash_new_flag(ghash_collide_hash, BLI_ghashutil_intcmp, __func__, 0,
+	                                  GHASH_FLAG_OPEN_ADDRESSING);
+	GHash *ghash_ref = BLI_ghash_int_new(__func__);
+	RNG *rng = BLI_rng_new(80);
+	GHashIterator gh_iter;
+	int i;
+
+	BLI_ghash_flag_set(ghash, GHASH_FLAG_ALLOW_SHRINK);
+
+	for (i = 0; i < TESTCASE_SIZE; i++) {
+		void *key = SET_UINT_IN_POINTER(BLI_rng_get_uint(rng) % 512);
+		void **val_p;
+		if (BLI_rng_get_float(rng) < 0.6f) {
+			if (!BLI_ghash_ensure_p(ghash, key, &val_p)) {
+				*val_p = SET_INT_IN_POINTER(i);
+				BLI_ghash_insert(ghash_ref, key, SET_INT_IN_POINTER(i));
+			}
+		}
+		else {
+			EXPECT_EQ(BLI_ghash_remove(ghash, key, NULL, NULL), BLI_ghash_remove(ghash_ref, key, NULL, NULL));
+		}
+		EXPECT_EQ(BLI_ghash_len(ghash), BLI_ghash_len(ghash_ref));
+	}
+
+	i = 0;
+	GHASH_ITER (gh_iter, ghash) {
+		void **val_p = BLI_ghash_lookup_p(ghash_ref, BLI_ghashIterator_getKey(&gh_iter));
+		ASSERT_TRUE(val_p != NULL);
+		EXPECT_EQ(*val_p, BLI_ghashIterator_getValue(&gh_iter));
+		i++;
+	}
+	EXPECT_EQ(i, BLI_ghash_len(ghash_ref));
+
+	GHASH_ITER (gh_iter, ghash_ref) {
+		EXPECT_EQ(BLI_ghash_lookup(ghash, BLI_ghashIterator_getKey(&gh_iter)), BLI_ghashIterator_getValue(&gh_iter));
+	}
+
+	BLI_rng_free(rng);
+	BLI_ghash_free(ghash, NULL, NULL);
+	BLI_ghash_free(ghash_ref, NULL, NULL);
+}
+
+TEST(ghash, OpenAddressingGSet)
+{
+	GSet *gset = BLI_gset_new_flag(BLI_ghashutil_inthash_p, BLI_ghashutil_intcmp, __func__, 0,
+	                               GHASH_FLAG_OPEN_ADDRESSING);
+	GSetIterator gs_iter;
+	unsigned int keys[TESTCASE_SIZE], *k;
+	int i;
+
+	init_keys(keys, 90);
+
+	for (i = TESTCASE_SIZE, k = keys; i--; k++) {
+		EXPECT_TRUE(BLI_gset_add(gset, SET_UINT_IN_POINTER(*k)));
+	}
+	for (i = TESTCASE_SIZE, k = keys; i--; k++) {
+		EXPECT_FALSE(BLI_gset_add(gset, SET_UINT_IN_POINTER(*k)));
+	}
+	EXPECT_EQ(BLI_gset_len(gset), TESTCASE_SIZE);
+
+	i = 0;
+	GSET_ITER (gs_iter, gset) {
+		EXPECT_TRUE(BLI_gset_haskey(gset, BLI_gsetIterator_getKey(&gs_iter)));
+		i++;
+	}
+	EXPECT_EQ(i, TESTCASE_SIZE);
+
+	for (i = TESTCASE_SIZE, k = keys; i--; k++) {
+		EXPECT_EQ(BLI_gset_pop_key(gset, SET_UINT_IN_POINTER(*k)), SET_UINT_IN_POINTER(*k));
+	}
+	EXPECT_EQ(BLI_gset_len(gset), 0);
+
+	BLI_gset_free(gset, NULL);
+}
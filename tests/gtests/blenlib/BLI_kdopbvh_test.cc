@@ -56,10 +56,10 @@ TEST(kdopbvh, Single)
  * Note that a small epsilon is added to the BVH nodes bounds, even if we pass in zero.
  * Use rounding to ensure very close nodes don't cause the wrong node to be found as nearest.
  */
-static void find_nearest_points_test(int points_len, float scale, int round, int random_seed)
+static void find_nearest_points_test(int points_len, float scale, int round, int random_seed, int flag = 0)
 {
 	struct RNG *rng = BLI_rng_new(random_seed);
-	BVHTree *tree = BLI_bvhtree_new(points_len, 0.0, 8, 8);
+	BVHTree *tree = BLI_bvhtree_new_ex(points_len, 0.0, 8, 8, flag);
 
 	void *mem = MEM_mallocN(sizeof(float[3]) * points_len, __func__);
 	float (*points)[3] = (float (*)[3])mem;
@@ -95,3 +95,77 @@ static void find_nearest_points_test(int points_len, float scale, int round, int
 TEST(kdopbvh, FindNearest_1)		{ find_nearest_points_test(1, 1.0, 1000, 1234); }
 TEST(kdopbvh, FindNearest_2)		{ find_nearest_points_test(2, 1.0, 1000, 123); }
 TEST(kdopbvh, FindNearest_500)		{ find_nearest_points_test(500, 1.0, 1000, 12); }
+TEST(kdopbvh, FindNearest_SAH_1)	{ find_nearest_points_test(1, 1.0, 1000, 1234, BVH_BUILD_SAH); }
+TEST(kdopbvh, FindNearest_SAH_2)	{ find_nearest_points_test(2, 1.0, 1000, 123, BVH_BUILD_SAH); }
+TEST(kdopbvh, FindNearest_SAH_500)	{ find_nearest_points_test(500, 1.0, 1000, 12, BVH_BUILD_SAH); }
+
+/**
+ * Batched queries have to give the same results as queries one by one,
+ * query count is not a multiple of the packet size on purpose.
+ * Axis aligned rays check the handling of their infinite inverse direction.
+ */
+static void batch_queries_test(
+        int boxes_len, int queries_len, char tree_type, int random_seed, int flag, bool axis_aligned = false)
+{
+	struct RNG *rng = BLI_rng_new(random_seed);
+	BVHTree *tree = BLI_bvhtree_new_ex(boxes_len, 0.0, tree_type, 6, flag);
+
+	for (int i = 0; i < boxes_len; i++) {
+		float co[2][3];
+		rng_v3_round(co[0], 3, rng, 1000, 1.0f);
+		rng_v3_round(co[1], 3, rng, 1000, 0.05f);
+		add_v3_v3(co[1], co[0]);
+		BLI_bvhtree_insert(tree, i, co[0], 2);
+	}
+	BLI_bvhtree_balance(tree);
+
+	void *mem = MEM_mallocN(sizeof(float[3]) * queries_len * 2, __func__);
+	float (*co)[3] = (float (*)[3])mem;
+	float (*dir)[3] = co + queries_len;
+	BVHTreeRayHit *hit = (BVHTreeRayHit *)MEM_mallocN(sizeof(*hit) * queries_len, __func__);
+	BVHTreeNearest *nearest = (BVHTreeNearest *)MEM_mallocN(sizeof(*nearest) * queries_len, __func__);
+
+	for (int i = 0; i < queries_len; i++) {
+		rng_v3_round(co[i], 3, rng, 1000, 1.5f);
+		if (axis_aligned) {
+			zero_v3(dir[i]);
+			dir[i][BLI_rng_get_int(rng) % 3] = (BLI_rng_get_int(rng) & 1) ? 1.0f : -1.0f;
+		}
+		else {
+			BLI_rng_get_float_unit_v3(rng, dir[i]);
+		}
+		hit[i].index = -1;
+		hit[i].dist = BVH_RAYCAST_DIST_MAX;
+		nearest[i].index = -1;
+		nearest[i].dist_sq = FLT_MAX;
+	}
+
+	BLI_bvhtree_ray_cast_batch(tree, co, dir, 0.0f, hit, queries_len, NULL, NULL, BVH_RAYCAST_DEFAULT);
+	BLI_bvhtree_find_nearest_batch(tree, co, nearest, queries_len, NULL, NULL);
+
+	for (int i = 0; i < queries_len; i++) {
+		BVHTreeRayHit hit_single = {-1};
+		hit_single.dist = BVH_RAYCAST_DIST_MAX;
+		EXPECT_EQ(hit[i].index, BLI_bvhtree_ray_cast(tree, co[i], dir[i], 0.0f, &hit_single, NULL, NULL));
+		if (hit[i].index != -1) {
+			EXPECT_FLOAT_EQ(hit[i].dist, hit_single.dist);
+		}
+
+		BVHTreeNearest nearest_single = {-1};
+		nearest_single.dist_sq = FLT_MAX;
+		EXPECT_EQ(nearest[i].index, BLI_bvhtree_find_nearest(tree, co[i], &nearest_single, NULL, NULL));
+		EXPECT_FLOAT_EQ(nearest[i].dist_sq, nearest_single.dist_sq);
+	}
+
+	BLI_bvhtree_free(tree);
+	BLI_rng_free(rng);
+	MEM_freeN(mem);
+	MEM_freeN(hit);
+	MEM_freeN(nearest);
+}
+
+TEST(kdopbvh, Batch_2)			{ batch_queries_test(1000, 1001, 2, 1234, 0); }
+TEST(kdopbvh, Batch_4)			{ batch_queries_test(1000, 1002, 4, 123, 0); }
+TEST(kdopbvh, Batch_SAH_2)		{ batch_queries_test(1000, 1003, 2, 12, BVH_BUILD_SAH); }
+TEST(kdopbvh, Batch_SAH_4)		{ batch_queries_test(1000, 1001, 4, 1, BVH_BUILD_SAH); }
+TEST(kdopbvh, Batch_AxisAligned)	{ batch_queries_test(1000, 1001, 4, 1234, 0, true); }
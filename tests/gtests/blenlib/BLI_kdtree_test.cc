@@ -0,0 +1,161 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+extern "C" {
+#include "BLI_compiler_attrs.h"
+#include "BLI_kdtree.h"
+#include "BLI_rand.h"
+#include "BLI_math_vector.h"
+#include "BLI_threads.h"
+#include "MEM_guardedalloc.h"
+}
+
+#define POINTS_NUM 20000
+#define QUERY_NUM 2000
+#define NEAREST_N 8
+
+/* -------------------------------------------------------------------- */
+/* Helper Functions */
+
+static KDTree *kdtree_random_new(float (*points)[3], int points_len, struct RNG *rng)
+{
+	KDTree *tree = BLI_kdtree_new((unsigned int)points_len);
+	for (int i = 0; i < points_len; i++) {
+		BLI_rng_get_float_unit_v3(rng, points[i]);
+		mul_v3_fl(points[i], BLI_rng_get_float(rng));
+		BLI_kdtree_insert(tree, i, points[i]);
+	}
+	BLI_kdtree_balance(tree);
+	return tree;
+}
+
+static float nearest_dist_sq_brute_force(const float (*points)[3], int points_len, const float co[3])
+{
+	float dist_sq_min = FLT_MAX;
+	for (int i = 0; i < points_len; i++) {
+		dist_sq_min = min_ff(dist_sq_min, len_squared_v3v3(points[i], co));
+	}
+	return dist_sq_min;
+}
+
+static bool range_count_cb(void *user_data, int co_index, int UNUSED(index), const float UNUSED(co[3]), float UNUSED(dist_sq))
+{
+	int *count = (int *)user_data;
+	count[co_index]++;
+	return true;
+}
+
+/* -------------------------------------------------------------------- */
+/* Tests */
+
+TEST(kdtree, Empty)
+{
+	KDTree *tree = BLI_kdtree_new(0);
+	BLI_kdtree_balance(tree);
+	float co[3] = {0.0f};
+	EXPECT_EQ(BLI_kdtree_find_nearest(tree, co, NULL), -1);
+	BLI_kdtree_free(tree);
+}
+
+TEST(kdtree, FindNearestBatch)
+{
+	BLI_threadapi_init();
+
+	float (*points)[3] = (float (*)[3])MEM_mallocN(sizeof(*points) * POINTS_NUM, __func__);
+	float (*queries)[3] = (float (*)[3])MEM_mallocN(sizeof(*queries) * QUERY_NUM, __func__);
+	int *index = (int *)MEM_mallocN(sizeof(*index) * QUERY_NUM, __func__);
+	KDTreeNearest *nearest = (KDTreeNearest *)MEM_mallocN(sizeof(*nearest) * QUERY_NUM, __func__);
+
+	RNG *rng = BLI_rng_new(0);
+	KDTree *tree = kdtree_random_new(points, POINTS_NUM, rng);
+	for (int i = 0; i < QUERY_NUM; i++) {
+		BLI_rng_get_float_unit_v3(rng, queries[i]);
+	}
+
+	BLI_kdtree_find_nearest_batch(tree, queries, QUERY_NUM, index, nearest);
+
+	for (int i = 0; i < QUERY_NUM; i++) {
+		const float dist_sq = nearest_dist_sq_brute_force(points, POINTS_NUM, queries[i]);
+		EXPECT_EQ(index[i], nearest[i].index);
+		EXPECT_EQ(len_squared_v3v3(points[index[i]], queries[i]), dist_sq);
+		EXPECT_EQ(BLI_kdtree_find_nearest(tree, queries[i], NULL), index[i]);
+	}
+
+	BLI_kdtree_free(tree);
+	BLI_rng_free(rng);
+	MEM_freeN(points);
+	MEM_freeN(queries);
+	MEM_freeN(index);
+	MEM_freeN(nearest);
+}
+
+TEST(kdtree, FindNearestNBatch)
+{
+	BLI_threadapi_init();
+
+	float (*points)[3] = (float (*)[3])MEM_mallocN(sizeof(*points) * POINTS_NUM, __func__);
+	float (*queries)[3] = (float (*)[3])MEM_mallocN(sizeof(*queries) * QUERY_NUM, __func__);
+	int *found = (int *)MEM_mallocN(sizeof(*found) * QUERY_NUM, __func__);
+	KDTreeNearest *nearest = (KDTreeNearest *)MEM_mallocN(sizeof(*nearest) * QUERY_NUM * NEAREST_N, __func__);
+
+	RNG *rng = BLI_rng_new(1);
+	KDTree *tree = kdtree_random_new(points, POINTS_NUM, rng);
+	for (int i = 0; i < QUERY_NUM; i++) {
+		BLI_rng_get_float_unit_v3(rng, queries[i]);
+	}
+
+	BLI_kdtree_find_nearest_n_batch(tree, queries, QUERY_NUM, nearest, found, NEAREST_N);
+
+	for (int i = 0; i < QUERY_NUM; i++) {
+		KDTreeNearest nearest_single[NEAREST_N];
+		const int found_single = BLI_kdtree_find_nearest_n(tree, queries[i], nearest_single, NEAREST_N);
+		EXPECT_EQ(found[i], NEAREST_N);
+		EXPECT_EQ(found[i], found_single);
+		for (int j = 0; j < found_single; j++) {
+			EXPECT_EQ(nearest[i * NEAREST_N + j].index, nearest_single[j].index);
+		}
+	}
+
+	BLI_kdtree_free(tree);
+	BLI_rng_free(rng);
+	MEM_freeN(points);
+	MEM_freeN(queries);
+	MEM_freeN(found);
+	MEM_freeN(nearest);
+}
+
+TEST(kdtree, RangeSearchBatch)
+{
+	BLI_threadapi_init();
+
+	const float range = 0.1f;
+	float (*points)[3] = (float (*)[3])MEM_mallocN(sizeof(*points) * POINTS_NUM, __func__);
+	float (*queries)[3] = (float (*)[3])MEM_mallocN(sizeof(*queries) * QUERY_NUM, __func__);
+	int *count = (int *)MEM_callocN(sizeof(*count) * QUERY_NUM, __func__);
+
+	RNG *rng = BLI_rng_new(2);
+	KDTree *tree = kdtree_random_new(points, POINTS_NUM, rng);
+	for (int i = 0; i < QUERY_NUM; i++) {
+		BLI_rng_get_float_unit_v3(rng, queries[i]);
+		mul_v3_fl(queries[i], 0.5f);
+	}
+
+	BLI_kdtree_range_search_cb_batch(tree, queries, QUERY_NUM, range, range_count_cb, count);
+
+	for (int i = 0; i < QUERY_NUM; i++) {
+		int count_brute_force = 0;
+		for (int j = 0; j < POINTS_NUM; j++) {
+			if (len_squared_v3v3(points[j], queries[i]) <= range * range) {
+				count_brute_force++;
+			}
+		}
+		EXPECT_EQ(count[i], count_brute_force);
+	}
+
+	BLI_kdtree_free(tree);
+	BLI_rng_free(rng);
+	MEM_freeN(points);
+	MEM_freeN(queries);
+	MEM_freeN(count);
+}
@@ -5,7 +5,10 @@
 
 #include "atomic_ops.h"
 
+#include "MEM_guardedalloc.h"
+
 extern "C" {
+#include "BLI_memarena.h"
 #include "BLI_mempool.h"
 #include "BLI_task.h"
 #include "BLI_utildefines.h"
@@ -74,3 +77,347 @@ TEST(task, MempoolIter)
 
 	BLI_mempool_destroy(mempool);
 }
+
+/* Each item copies itself into the pool of its thread. */
+static void task_mempool_iter_alloc_func(void *userdata, MempoolIterData *item, const ParallelRangeTLS *__restrict tls)
+{
+	int **data = (int **)userdata;
+	int *elem = (int *)BLI_mempool_alloc(tls->mempool);
+
+	*elem = *(int *)item;
+	data[*elem] = elem;
+}
+
+TEST(task, MempoolIterAlloc)
+{
+	int **data = (int **)MEM_callocN(sizeof(int *) * NUM_ITEMS, __func__);
+	BLI_mempool *mempool = BLI_mempool_create(sizeof(int), NUM_ITEMS, 32, BLI_MEMPOOL_ALLOW_ITER);
+	BLI_mempool *mempool_dst = BLI_mempool_create(sizeof(int), 0, 32, BLI_MEMPOOL_ALLOW_ITER);
+
+	for (int i = 0; i < NUM_ITEMS; i++) {
+		int *elem = (int *)BLI_mempool_alloc(mempool);
+		*elem = i;
+	}
+
+	ParallelRangeSettings settings;
+	BLI_parallel_range_settings_defaults(&settings);
+	settings.mempool = mempool_dst;
+	BLI_task_parallel_mempool_ex(mempool, data, task_mempool_iter_alloc_func, &settings);
+
+	/* Pools of all threads now belong to the one given in settings. */
+	EXPECT_EQ(BLI_mempool_len(mempool_dst), NUM_ITEMS);
+	for (int i = 0; i < NUM_ITEMS; i++) {
+		EXPECT_EQ(*data[i], i);
+	}
+
+	int count = 0;
+	BLI_mempool_iter iter;
+	BLI_mempool_iternew(mempool_dst, &iter);
+	for (int *elem = (int *)BLI_mempool_iterstep(&iter); elem; elem = (int *)BLI_mempool_iterstep(&iter)) {
+		EXPECT_EQ(data[*elem], elem);
+		count++;
+	}
+	EXPECT_EQ(count, NUM_ITEMS);
+
+	BLI_mempool_destroy(mempool);
+	BLI_mempool_destroy(mempool_dst);
+	MEM_freeN(data);
+}
+
+/* Scheduler */
+
+#define NUM_THREADS 4
+#define NUM_TASKS 10000
+#define TREE_DEPTH 12
+
+static void task_count_func(TaskPool *__restrict pool, void *UNUSED(taskdata), int UNUSED(threadid))
+{
+	int *count = (int *)BLI_task_pool_userdata(pool);
+	atomic_add_and_fetch_uint32((uint32_t *)count, 1);
+}
+
+TEST(task, PoolPush)
+{
+	BLI_threadapi_init();
+	TaskScheduler *scheduler = BLI_task_scheduler_create(NUM_THREADS);
+
+	for (int priority = TASK_PRIORITY_LOW; priority <= TASK_PRIORITY_HIGH; priority++) {
+		int count = 0;
+		TaskPool *pool = BLI_task_pool_create(scheduler, &count);
+
+		for (int i = 0; i < NUM_TASKS; i++) {
+			BLI_task_pool_push(pool, task_count_func, NULL, false, (TaskPriority)priority);
+		}
+
+		BLI_task_pool_work_and_wait(pool);
+		BLI_task_pool_free(pool);
+
+		EXPECT_EQ(count, NUM_TASKS);
+	}
+
+	BLI_task_scheduler_free(scheduler);
+}
+
+/* Every task pushes two children from the thread it runs on, so most tasks
+ * are spawned by worker threads and taken from their queues. */
+static void task_tree_func(TaskPool *__restrict pool, void *taskdata, int threadid)
+{
+	int *count = (int *)BLI_task_pool_userdata(pool);
+	intptr_t depth = (intptr_t)taskdata;
+
+	atomic_add_and_fetch_uint32((uint32_t *)count, 1);
+
+	if (depth < TREE_DEPTH) {
+		BLI_task_pool_push_from_thread(pool, task_tree_func, (void *)(depth + 1), false, TASK_PRIORITY_HIGH, threadid);
+		BLI_task_pool_push_from_thread(pool, task_tree_func, (void *)(depth + 1), false, TASK_PRIORITY_LOW, threadid);
+	}
+}
+
+TEST(task, PoolSpawn)
+{
+	BLI_threadapi_init();
+	TaskScheduler *scheduler = BLI_task_scheduler_create(NUM_THREADS);
+
+	int count = 0;
+	TaskPool *pool = BLI_task_pool_create(scheduler, &count);
+
+	BLI_task_pool_push(pool, task_tree_func, (void *)0, false, TASK_PRIORITY_HIGH);
+	BLI_task_pool_work_and_wait(pool);
+	BLI_task_pool_free(pool);
+
+	EXPECT_EQ(count, (1 << (TREE_DEPTH + 1)) - 1);
+
+	BLI_task_scheduler_free(scheduler);
+}
+
+/* Tasks waiting for pools of their own, while other tasks are in the queues. */
+static void task_nested_func(TaskPool *__restrict pool, void *taskdata, int UNUSED(threadid))
+{
+	int *count = (int *)BLI_task_pool_userdata(pool);
+	TaskScheduler *scheduler = (TaskScheduler *)taskdata;
+	TaskPool *nested_pool = BLI_task_pool_create(scheduler, count);
+
+	for (int i = 0; i < 16; i++) {
+		BLI_task_pool_push(nested_pool, task_count_func, NULL, false, TASK_PRIORITY_LOW);
+	}
+
+	BLI_task_pool_work_and_wait(nested_pool);
+	BLI_task_pool_free(nested_pool);
+}
+
+TEST(task, PoolNested)
+{
+	BLI_threadapi_init();
+	TaskScheduler *scheduler = BLI_task_scheduler_create(NUM_THREADS);
+
+	int count = 0;
+	TaskPool *pool = BLI_task_pool_create(scheduler, &count);
+
+	for (int i = 0; i < NUM_TASKS / 16; i++) {
+		BLI_task_pool_push(pool, task_nested_func, scheduler, false, TASK_PRIORITY_LOW);
+	}
+
+	BLI_task_pool_work_and_wait(pool);
+	BLI_task_pool_free(pool);
+
+	EXPECT_EQ(count, (NUM_TASKS / 16) * 16);
+
+	BLI_task_scheduler_free(scheduler);
+}
+
+/* Data of all tasks is freed, whether they ran or were discarded. */
+typedef struct CancelData {
+	int num_run;
+	int num_freed;
+} CancelData;
+
+static void task_cancel_run_func(TaskPool *__restrict pool, void *UNUSED(taskdata), int UNUSED(threadid))
+{
+	CancelData *data = (CancelData *)BLI_task_pool_userdata(pool);
+	atomic_add_and_fetch_uint32((uint32_t *)&data->num_run, 1);
+}
+
+static void task_cancel_free_func(TaskPool *__restrict pool, void *taskdata, int UNUSED(threadid))
+{
+	CancelData *data = (CancelData *)BLI_task_pool_userdata(pool);
+	atomic_add_and_fetch_uint32((uint32_t *)&data->num_freed, 1);
+	MEM_freeN(taskdata);
+}
+
+TEST(task, PoolCancel)
+{
+	BLI_threadapi_init();
+	TaskScheduler *scheduler = BLI_task_scheduler_create(NUM_THREADS);
+
+	CancelData data = {0, 0};
+	TaskPool *pool = BLI_task_pool_create(scheduler, &data);
+
+	for (int i = 0; i < NUM_TASKS; i++) {
+		void *taskdata = MEM_mallocN(sizeof(int), __func__);
+		BLI_task_pool_push_ex(pool, task_cancel_run_func, taskdata, true, task_cancel_free_func, TASK_PRIORITY_LOW);
+	}
+
+	BLI_task_pool_cancel(pool);
+
+	EXPECT_LE(data.num_run, NUM_TASKS);
+	EXPECT_EQ(data.num_freed, NUM_TASKS);
+
+	BLI_task_pool_free(pool);
+	BLI_task_scheduler_free(scheduler);
+}
+
+/* Parallel range */
+
+#define RANGE_SIZE 10000
+#define RANGE_NESTED_SIZE 100
+
+typedef struct RangeData {
+	int *data;
+	int sum;
+} RangeData;
+
+static void task_range_iter_func(void *__restrict userdata, const int iter, const ParallelRangeTLS *__restrict tls)
+{
+	RangeData *range_data = (RangeData *)userdata;
+	int *sum = (int *)tls->userdata_chunk;
+
+	range_data->data[iter] += 1;
+	*sum += iter;
+}
+
+static void task_range_finalize_func(void *__restrict userdata, void *__restrict userdata_chunk)
+{
+	RangeData *range_data = (RangeData *)userdata;
+	range_data->sum += *(int *)userdata_chunk;
+}
+
+TEST(task, ParallelRange)
+{
+	BLI_threadapi_init();
+
+	for (int mode = TASK_SCHEDULING_STATIC; mode <= TASK_SCHEDULING_DYNAMIC; mode++) {
+		RangeData range_data;
+		range_data.data = (int *)MEM_callocN(sizeof(int) * RANGE_SIZE, __func__);
+		range_data.sum = 0;
+		int sum = 0;
+
+		ParallelRangeSettings settings;
+		BLI_parallel_range_settings_defaults(&settings);
+		settings.scheduling_mode = (eTaskSchedulingMode)mode;
+		settings.userdata_chunk = &sum;
+		settings.userdata_chunk_size = sizeof(sum);
+		settings.func_finalize = task_range_finalize_func;
+
+		BLI_task_parallel_range(0, RANGE_SIZE, &range_data, task_range_iter_func, &settings);
+
+		/* Every iteration ran once, and all copies of the chunk were finalized. */
+		for (int i = 0; i < RANGE_SIZE; i++) {
+			EXPECT_EQ(range_data.data[i], 1);
+		}
+		EXPECT_EQ(range_data.sum, RANGE_SIZE * (RANGE_SIZE - 1) / 2);
+
+		MEM_freeN(range_data.data);
+	}
+}
+
+/* Each iteration of the outer range runs a nested range over one row. */
+static void task_range_outer_iter_func(void *__restrict userdata, const int iter, const ParallelRangeTLS *__restrict UNUSED(tls))
+{
+	RangeData range_data;
+	range_data.data = (int *)userdata + iter * RANGE_NESTED_SIZE;
+	range_data.sum = 0;
+	int sum = 0;
+
+	ParallelRangeSettings settings;
+	BLI_parallel_range_settings_defaults(&settings);
+	settings.scheduling_mode = TASK_SCHEDULING_DYNAMIC;
+	settings.userdata_chunk = &sum;
+	settings.userdata_chunk_size = sizeof(sum);
+	settings.func_finalize = task_range_finalize_func;
+
+	BLI_task_parallel_range(0, RANGE_NESTED_SIZE, &range_data, task_range_iter_func, &settings);
+
+	EXPECT_EQ(range_data.sum, RANGE_NESTED_SIZE * (RANGE_NESTED_SIZE - 1) / 2);
+}
+
+TEST(task, ParallelRangeNested)
+{
+	BLI_threadapi_init();
+
+	int *data = (int *)MEM_callocN(sizeof(int) * RANGE_NESTED_SIZE * RANGE_NESTED_SIZE, __func__);
+
+	ParallelRangeSettings settings;
+	BLI_parallel_range_settings_defaults(&settings);
+	settings.scheduling_mode = TASK_SCHEDULING_DYNAMIC;
+
+	BLI_task_parallel_range(0, RANGE_NESTED_SIZE, data, task_range_outer_iter_func, &settings);
+
+	for (int i = 0; i < RANGE_NESTED_SIZE * RANGE_NESTED_SIZE; i++) {
+		EXPECT_EQ(data[i], 1);
+	}
+
+	MEM_freeN(data);
+}
+
+/* Each iteration allocates from the arena and the pool of its thread. */
+static void task_range_alloc_iter_func(void *__restrict userdata, const int iter, const ParallelRangeTLS *__restrict tls)
+{
+	int **data = (int **)userdata;
+	int *elem_arena = (int *)BLI_memarena_alloc(tls->memarena, sizeof(int));
+	int *elem_pool = (int *)BLI_mempool_alloc(tls->mempool);
+
+	*elem_arena = iter;
+	*elem_pool = iter;
+	data[iter * 2] = elem_arena;
+	data[iter * 2 + 1] = elem_pool;
+}
+
+TEST(task, ParallelRangeAlloc)
+{
+	BLI_threadapi_init();
+
+	for (int mode = TASK_SCHEDULING_STATIC; mode <= TASK_SCHEDULING_DYNAMIC; mode++) {
+		int **data = (int **)MEM_callocN(sizeof(int *) * RANGE_SIZE * 2, __func__);
+		MemArena *arena = BLI_memarena_new(BLI_MEMARENA_STD_BUFSIZE, __func__);
+		BLI_mempool *mempool = BLI_mempool_create(sizeof(int), 0, 64, BLI_MEMPOOL_ALLOW_ITER);
+
+		ParallelRangeSettings settings;
+		BLI_parallel_range_settings_defaults(&settings);
+		settings.scheduling_mode = (eTaskSchedulingMode)mode;
+		settings.memarena = arena;
+		settings.mempool = mempool;
+
+		BLI_task_parallel_range(0, RANGE_SIZE, data, task_range_alloc_iter_func, &settings);
+
+		/* Memory of all threads now belongs to the arena and pool given in settings. */
+		EXPECT_EQ(BLI_mempool_len(mempool), RANGE_SIZE);
+		for (int i = 0; i < RANGE_SIZE; i++) {
+			EXPECT_EQ(*data[i * 2], i);
+			EXPECT_EQ(*data[i * 2 + 1], i);
+		}
+
+		int count = 0;
+		BLI_mempool_iter iter;
+		BLI_mempool_iternew(mempool, &iter);
+		while (BLI_mempool_iterstep(&iter)) {
+			count++;
+		}
+		EXPECT_EQ(count, RANGE_SIZE);
+
+		for (int i = 0; i < RANGE_SIZE; i += 2) {
+			BLI_mempool_free(mempool, data[i * 2 + 1]);
+		}
+		EXPECT_EQ(BLI_mempool_len(mempool), RANGE_SIZE / 2);
+
+		/* Free elements of all threads were spliced into one list. */
+		for (int i = 0; i < RANGE_SIZE; i++) {
+			int *elem = (int *)BLI_mempool_alloc(mempool);
+			*elem = i;
+		}
+		EXPECT_EQ(BLI_mempool_len(mempool), RANGE_SIZE / 2 + RANGE_SIZE);
+
+		BLI_memarena_free(arena);
+		BLI_mempool_destroy(mempool);
+		MEM_freeN(data);
+	}
+}
@@ -0,0 +1,118 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#ifndef WIN32
+#  include <pthread.h>
+#endif
+#include <string.h>
+
+#include "MEM_guardedalloc.h"
+
+#define NUM_THREADS 4
+#define NUM_BLOCKS 1000
+
+namespace {
+
+size_t BlockSize(int i)
+{
+	/* Sizes of and around the cached size classes, and larger ones. */
+	return (size_t)((i * 7) % 600);
+}
+
+size_t BlockLen(int i)
+{
+	return (BlockSize(i) + 3) & ~(size_t)3;
+}
+
+void *AllocBlocks(void *data)
+{
+	void **blocks = (void **)data;
+	for (int i = 0; i < NUM_BLOCKS; i++) {
+		blocks[i] = MEM_mallocN(BlockSize(i), "test");
+		memset(blocks[i], i & 0xff, BlockSize(i));
+	}
+	return NULL;
+}
+
+}  // namespace
+
+TEST(guardedalloc, LockfreeMemoryInUse)
+{
+	const size_t mem_in_use = MEM_get_memory_in_use();
+	const unsigned int blocks_in_use = MEM_get_memory_blocks_in_use();
+	void *blocks[NUM_BLOCKS];
+	size_t len = 0;
+
+	/* Allocate twice, so that the second time reuses freed blocks where
+	 * they are cached per thread. */
+	for (int pass = 0; pass < 2; pass++) {
+		AllocBlocks(blocks);
+		for (int i = 0; i < NUM_BLOCKS; i++) {
+			len += (pass == 0) ? BlockLen(i) : 0;
+			EXPECT_EQ(MEM_allocN_len(blocks[i]), BlockLen(i));
+		}
+		EXPECT_EQ(MEM_get_memory_in_use(), mem_in_use + len);
+		EXPECT_EQ(MEM_get_memory_blocks_in_use(), blocks_in_use + NUM_BLOCKS);
+		EXPECT_GE(MEM_get_peak_memory(), mem_in_use + len);
+
+		for (int i = 0; i < NUM_BLOCKS; i++) {
+			MEM_freeN(blocks[i]);
+		}
+		EXPECT_EQ(MEM_get_memory_in_use(), mem_in_use);
+		EXPECT_EQ(MEM_get_memory_blocks_in_use(), blocks_in_use);
+	}
+}
+
+TEST(guardedalloc, LockfreeCallocReused)
+{
+	char *block = (char *)MEM_mallocN(100, "test");
+	memset(block, 0xff, 100);
+	MEM_freeN(block);
+
+	block = (char *)MEM_callocN(100, "test");
+	for (int i = 0; i < 100; i++) {
+		EXPECT_EQ(block[i], 0);
+	}
+	MEM_freeN(block);
+}
+
+/* Statistics and caches are only kept per thread where thread exit can be
+ * noticed, elsewhere all threads share atomic counters. */
+#ifndef WIN32
+TEST(guardedalloc, LockfreeMemoryInUseThreads)
+{
+	const size_t mem_in_use = MEM_get_memory_in_use();
+	const unsigned int blocks_in_use = MEM_get_memory_blocks_in_use();
+	pthread_t threads[NUM_THREADS];
+	void *blocks[NUM_THREADS][NUM_BLOCKS];
+	size_t len = 0;
+
+	for (int i = 0; i < NUM_BLOCKS; i++) {
+		len += BlockLen(i) * NUM_THREADS;
+	}
+
+	for (int t = 0; t < NUM_THREADS; t++) {
+		pthread_create(&threads[t], NULL, AllocBlocks, blocks[t]);
+	}
+	for (int t = 0; t < NUM_THREADS; t++) {
+		pthread_join(threads[t], NULL);
+	}
+
+	/* Counters of exited threads are kept. */
+	EXPECT_EQ(MEM_get_memory_in_use(), mem_in_use + len);
+	EXPECT_EQ(MEM_get_memory_blocks_in_use(), blocks_in_use + NUM_BLOCKS * NUM_THREADS);
+
+	/* Free blocks from another thread than they were allocated by. */
+	for (int t = 0; t < NUM_THREADS; t++) {
+		for (int i = 0; i < NUM_BLOCKS; i++) {
+			if (BlockSize(i) != 0) {
+				EXPECT_EQ(((unsigned char *)blocks[t][i])[0], i & 0xff);
+			}
+			MEM_freeN(blocks[t][i]);
+		}
+	}
+	EXPECT_EQ(MEM_get_memory_in_use(), mem_in_use);
+	EXPECT_EQ(MEM_get_memory_blocks_in_use(), blocks_in_use);
+}
+#endif  /* WIN32 */
@@ -0,0 +1,358 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include <Python.h>
+
+#include <string>
+#include <vector>
+#include <sstream>
+#include <fstream>
+#include <iostream>
+
+#ifndef WIN32
+#  include <sys/resource.h>
+#  include <sys/wait.h>
+#  include <unistd.h>
+#endif
+
+extern "C" {
+#include "MEM_guardedalloc.h"
+#include "BLI_utildefines.h"
+#include "BLI_fileops.h"
+#include "BLI_fileops_types.h"
+#include "BLI_path_util.h"
+#include "BLI_string.h"
+#include "PIL_time.h"
+
+#include "DNA_scene_types.h"
+#include "DNA_modifier_types.h"
+#include "DNA_smoke_types.h"
+
+#include "BKE_smoke.h"
+
+#include "manta_fluid_API.h"
+#include "manta_python_API.h"
+}
+
+/* Headless benchmark of the FLUID pipeline. Every scenario builds a domain with the
+ * modifier defaults, emits from a sphere through the grid registry and runs the
+ * same bake/write/read calls as smokeModifier_process. One JSON object per
+ * scenario and resolution is printed, and appended to --fluid_report if given.
+ * Each resolution runs in its own process where fork() is available, so the
+ * reported peak memory covers that run only. */
+
+DEFINE_int32(fluid_steps, 10, "Number of frames to simulate per scenario.");
+DEFINE_string(fluid_resolutions, "32,64", "Comma separated list of domain resolutions.");
+DEFINE_string(fluid_cache_dir, "", "Scratch directory for cache files, defaults to the system temp directory.");
+DEFINE_string(fluid_report, "", "Append machine-readable results (JSON lines) to this file.");
+
+enum {
+	FLUID_BENCH_SMOKE     = 0,
+	FLUID_BENCH_NOISE     = (1 << 0),
+	FLUID_BENCH_LIQUID    = (1 << 1),
+	FLUID_BENCH_MESH      = (1 << 2),
+	FLUID_BENCH_PARTICLES = (1 << 3),
+};
+
+static const char *fluid_bench_cache_subdirs[] = {
+	FLUID_CACHE_DIR_DATA, FLUID_CACHE_DIR_NOISE, FLUID_CACHE_DIR_MESH, FLUID_CACHE_DIR_PARTICLES};
+
+typedef struct FluidBenchResult {
+	double init, step, write, read, noise, mesh, particles;
+	size_t cache_bytes;
+	long peak_rss_kb;
+} FluidBenchResult;
+
+static void fluid_bench_python_ensure(void)
+{
+	if (!Py_IsInitialized()) {
+		PyImport_AppendInittab("manta", Manta_initPython);
+		Py_Initialize();
+		/* FLUID acquires the GIL itself. */
+		PyEval_SaveThread();
+	}
+}
+
+static std::vector<int> fluid_bench_resolutions(void)
+{
+	std::vector<int> resolutions;
+	std::istringstream in(FLAGS_fluid_resolutions);
+	std::string token;
+	while (std::getline(in, token, ',')) {
+		int res = atoi(token.c_str());
+		if (res > 0) resolutions.push_back(res);
+	}
+	return resolutions;
+}
+
+static std::string fluid_bench_cache_root(void)
+{
+	if (!FLAGS_fluid_cache_dir.empty()) return FLAGS_fluid_cache_dir;
+#ifdef WIN32
+	const char *tmp = getenv("TEMP");
+#else
+	const char *tmp = getenv("TMPDIR");
+#endif
+	return tmp ? tmp : "/tmp";
+}
+
+/* Peak resident memory of this process, which is the child running a single
+ * resolution when forked. Not measured on Windows. */
+static long fluid_bench_peak_rss_kb(void)
+{
+#ifndef WIN32
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) == 0) {
+#  ifdef __APPLE__
+		return usage.ru_maxrss / 1024; /* bytes on macOS */
+#  else
+		return usage.ru_maxrss;
+#  endif
+	}
+#endif
+	return 0;
+}
+
+static size_t fluid_bench_dir_size(const char *dir)
+{
+	struct direntry *files;
+	size_t size = 0;
+
+	if (!BLI_is_dir(dir)) return 0;
+
+	const unsigned int totfile = BLI_filelist_dir_contents(dir, &files);
+	for (unsigned int i = 0; i < totfile; i++) {
+		if (FILENAME_IS_CURRPAR(files[i].relname)) continue;
+		if (S_ISDIR(files[i].type)) size += fluid_bench_dir_size(files[i].path);
+		else size += files[i].s.st_size;
+	}
+	BLI_filelist_free(files, totfile);
+	return size;
+}
+
+/* Scenario settings on top of the defaults from smokeModifier_createType(). */
+static void fluid_bench_domain_init(SmokeDomainSettings *sds, int flags, const char *cache_dir)
+{
+	BLI_strncpy(sds->cache_directory, cache_dir, sizeof(sds->cache_directory));
+
+	if (flags & FLUID_BENCH_LIQUID) {
+		sds->type = MOD_SMOKE_DOMAIN_TYPE_LIQUID;
+		sds->gravity[2] = -9.81f;
+		if (flags & FLUID_BENCH_MESH) sds->flags |= MOD_SMOKE_MESH;
+		if (flags & FLUID_BENCH_PARTICLES) {
+			sds->particle_type = MOD_SMOKE_PARTICLE_DROP | MOD_SMOKE_PARTICLE_BUBBLE | MOD_SMOKE_PARTICLE_FLOAT;
+		}
+	}
+	else {
+		sds->type = MOD_SMOKE_DOMAIN_TYPE_GAS;
+		sds->active_fields = SM_ACTIVE_HEAT;
+		if (flags & FLUID_BENCH_NOISE) sds->flags |= MOD_SMOKE_NOISE;
+	}
+}
+
+/* Emit from a sphere in the lower part of the domain, written straight into the
+ * shared solver buffers like update_flowsfluids() does. */
+static void fluid_bench_emit(struct FLUID *fluid, int res, bool liquid)
+{
+	const float center[3] = {0.5f * res, 0.5f * res, 0.25f * res};
+	const float radius = 0.15f * res;
+	float *phi_in = NULL, *density = NULL, *heat = NULL;
+	int h_phi_in = -1, h_density = -1, h_heat = -1;
+
+	if (liquid) {
+		h_phi_in = fluid_grid_find(fluid, "phiIn");
+		phi_in = fluid_grid_get_float(fluid, h_phi_in);
+		ASSERT_TRUE(phi_in != NULL);
+	}
+	else {
+		h_density = fluid_grid_find(fluid, "density");
+		h_heat = fluid_grid_find(fluid, "heat");
+		density = fluid_grid_get_float(fluid, h_density);
+		heat = fluid_grid_get_float(fluid, h_heat);
+		ASSERT_TRUE(density != NULL);
+	}
+
+	for (int z = 0; z < res; z++) {
+		for (int y = 0; y < res; y++) {
+			for (int x = 0; x < res; x++) {
+				const size_t index = smoke_get_index(x, res, y, res, z);
+				const float d[3] = {x + 0.5f - center[0], y + 0.5f - center[1], z + 0.5f - center[2]};
+				const float dist = sqrtf(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]) - radius;
+
+				if (phi_in) {
+					phi_in[index] = dist;
+				}
+				else if (dist < 0.0f) {
+					density[index] = 1.0f;
+					if (heat) heat[index] = 1.0f;
+				}
+			}
+		}
+	}
+
+	fluid_grid_tag_changed(fluid, h_phi_in);
+	fluid_grid_tag_changed(fluid, h_density);
+	fluid_grid_tag_changed(fluid, h_heat);
+}
+
+static void fluid_bench_report(const char *name, int res, const FluidBenchResult *r)
+{
+	char line[1024];
+	const double mb = (double)r->cache_bytes / (1024.0 * 1024.0);
+
+	BLI_snprintf(line, sizeof(line),
+	             "{\"scenario\": \"%s\", \"res\": %d, \"steps\": %d, "
+	             "\"init_s\": %.6f, \"step_s\": %.6f, \"write_s\": %.6f, \"read_s\": %.6f, "
+	             "\"noise_s\": %.6f, \"mesh_s\": %.6f, \"particles_s\": %.6f, "
+	             "\"cache_mb\": %.3f, \"write_mb_per_s\": %.3f, \"read_mb_per_s\": %.3f, "
+	             "\"peak_rss_kb\": %ld}",
+	             name, res, FLAGS_fluid_steps,
+	             r->init, r->step, r->write, r->read,
+	             r->noise, r->mesh, r->particles,
+	             mb, (r->write > 0.0) ? mb / r->write : 0.0, (r->read > 0.0) ? mb / r->read : 0.0,
+	             r->peak_rss_kb);
+
+	printf("%s\n", line);
+	if (!FLAGS_fluid_report.empty()) {
+		std::ofstream report(FLAGS_fluid_report.c_str(), std::ios::app);
+		report << line << std::endl;
+	}
+}
+
+static void fluid_bench_run_resolution(const char *name, int flags, int res)
+{
+	const bool liquid = (flags & FLUID_BENCH_LIQUID) != 0;
+	int resv[3] = {res, res, res};
+	char cache_dir[FILE_MAX];
+	FluidBenchResult r = {0};
+	double t;
+
+	fluid_bench_python_ensure();
+
+	/* Fresh cache per run, Manta does not overwrite existing cache files. */
+	BLI_snprintf(cache_dir, sizeof(cache_dir), "%s/fluid_bench_%s_%d", fluid_bench_cache_root().c_str(), name, res);
+	BLI_delete(cache_dir, true, true);
+	for (int j = 0; j < ARRAY_SIZE(fluid_bench_cache_subdirs); j++) {
+		char dir[FILE_MAX];
+		BLI_join_dirfile(dir, sizeof(dir), cache_dir, fluid_bench_cache_subdirs[j]);
+		BLI_dir_create_recursive(dir);
+	}
+
+	Scene *scene = (Scene *)MEM_callocN(sizeof(Scene), __func__);
+	SmokeModifierData *smd = (SmokeModifierData *)MEM_callocN(sizeof(SmokeModifierData), __func__);
+	scene->r.frs_sec = 25;
+	scene->r.frs_sec_base = 1.0f;
+	scene->r.cfra = 1;
+	smd->modifier.scene = scene;
+	smd->type = MOD_SMOKE_TYPE_DOMAIN;
+	smokeModifier_createType(smd);
+	fluid_bench_domain_init(smd->domain, flags, cache_dir);
+
+	t = PIL_check_seconds_timer();
+	struct FLUID *fluid = smoke_init(resv, smd);
+	r.init = PIL_check_seconds_timer() - t;
+
+	for (int frame = 1; frame <= FLAGS_fluid_steps; frame++) {
+		scene->r.cfra = frame;
+
+		t = PIL_check_seconds_timer();
+		fluid_update_variables_low(fluid, smd);
+		fluid_adapt_timestep(fluid);
+		fluid_bench_emit(fluid, res, liquid);
+		fluid_bake_data(fluid, smd, frame);
+		r.step += PIL_check_seconds_timer() - t;
+
+		t = PIL_check_seconds_timer();
+		fluid_write_data(fluid, smd, frame);
+		r.write += PIL_check_seconds_timer() - t;
+
+		if (flags & FLUID_BENCH_NOISE) {
+			t = PIL_check_seconds_timer();
+			fluid_update_variables_high(fluid, smd);
+			fluid_bake_noise(fluid, smd, frame);
+			r.noise += PIL_check_seconds_timer() - t;
+		}
+		if (flags & FLUID_BENCH_MESH) {
+			t = PIL_check_seconds_timer();
+			fluid_bake_mesh(fluid, smd, frame);
+			r.mesh += PIL_check_seconds_timer() - t;
+		}
+		if (flags & FLUID_BENCH_PARTICLES) {
+			t = PIL_check_seconds_timer();
+			fluid_bake_particles(fluid, smd, frame);
+			r.particles += PIL_check_seconds_timer() - t;
+		}
+	}
+
+	/* Everything the bake wrote: data, noise, mesh and particles. */
+	for (int j = 0; j < ARRAY_SIZE(fluid_bench_cache_subdirs); j++) {
+		char dir[FILE_MAX];
+		BLI_join_dirfile(dir, sizeof(dir), cache_dir, fluid_bench_cache_subdirs[j]);
+		r.cache_bytes += fluid_bench_dir_size(dir);
+	}
+
+	/* Read the whole data cache back, the way playback of a baked domain does. */
+	t = PIL_check_seconds_timer();
+	for (int frame = 1; frame <= FLAGS_fluid_steps; frame++) {
+		EXPECT_EQ(1, fluid_read_data(fluid, smd, frame));
+	}
+	r.read = PIL_check_seconds_timer() - t;
+
+	r.peak_rss_kb = fluid_bench_peak_rss_kb();
+	EXPECT_GT(r.cache_bytes, 0u);
+
+	/* Frees the solver as well. */
+	smokeModifier_free(smd);
+	MEM_freeN(smd);
+	MEM_freeN(scene);
+	BLI_delete(cache_dir, true, true);
+
+	fluid_bench_report(name, res, &r);
+}
+
+static void fluid_bench_run(const char *name, int flags)
+{
+	std::vector<int> resolutions = fluid_bench_resolutions();
+
+	for (size_t i = 0; i < resolutions.size(); i++) {
+#ifndef WIN32
+		/* Python and the solver threads only ever start in the child. */
+		fflush(stdout);
+		const pid_t pid = fork();
+		ASSERT_NE(-1, pid);
+		if (pid == 0) {
+			fluid_bench_run_resolution(name, flags, resolutions[i]);
+			fflush(stdout);
+			_exit(::testing::Test::HasFailure() ? 1 : 0);
+		}
+
+		int status = 0;
+		ASSERT_EQ(pid, waitpid(pid, &status, 0));
+		EXPECT_TRUE(WIFEXITED(status));
+		EXPECT_EQ(0, WEXITSTATUS(status));
+#else
+		fluid_bench_run_resolution(name, flags, resolutions[i]);
+#endif
+	}
+}
+
+TEST(fluid_performance, smoke)
+{
+	fluid_bench_run("smoke", FLUID_BENCH_SMOKE);
+}
+
+TEST(fluid_performance, smoke_noise)
+{
+	fluid_bench_run("smoke_noise", FLUID_BENCH_SMOKE | FLUID_BENCH_NOISE);
+}
+
+TEST(fluid_performance, liquid)
+{
+	fluid_bench_run("liquid", FLUID_BENCH_LIQUID);
+}
+
+TEST(fluid_performance, liquid_mesh_particles)
+{
+	fluid_bench_run("liquid_mesh_particles", FLUID_BENCH_LIQUID | FLUID_BENCH_MESH | FLUID_BENCH_PARTICLES);
+}